@@ -0,0 +1,300 @@
+#include "si.h"
+#include "anomaly.h"
+
+/******************************************************************************
+MODULE:  open_anomaly
+
+PURPOSE:  Opens the climatology mean and standard deviation rasters for the
+specified spectral index and allocates the strip buffers.
+
+RETURN VALUE:
+Type = Anomaly_t*
+Value      Description
+-----      -----------
+NULL       Error opening the rasters or they don't match the scene
+non-NULL   Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The rasters must be nlines x nsamps int16 values, aligned with the
+     scene.  Only the size of the files can be checked.
+******************************************************************************/
+Anomaly_t *open_anomaly
+(
+    Mysi_list_t si,          /* I: spectral index compared to the
+                                climatology */
+    char *mean_file,         /* I: name of the climatology mean file */
+    char *std_file,          /* I: name of the climatology standard deviation
+                                file */
+    int nlines,              /* I: number of lines in the scene */
+    int nsamps               /* I: number of samples in the scene */
+)
+{
+    char FUNC_NAME[] = "open_anomaly";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable for the two rasters */
+    long size;                /* size of the current raster file */
+    long expected;            /* expected size of the raster files */
+    char *file[2];            /* names of the mean and std files */
+    FILE *fp[2];              /* mean and std file pointers */
+    Anomaly_t *this = NULL;   /* climatology to be returned */
+
+    this = malloc (sizeof (Anomaly_t));
+    if (this == NULL)
+    {
+        sprintf (errmsg, "Allocating the climatology structure");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    this->si = si;
+    this->nlines = nlines;
+    this->nsamps = nsamps;
+    this->fp_mean = NULL;
+    this->fp_std = NULL;
+    this->mean_buf = NULL;
+    this->std_buf = NULL;
+    this->io_limit = NULL;
+
+    /* Open both rasters and make sure they cover the scene */
+    file[0] = mean_file;
+    file[1] = std_file;
+    expected = (long) nlines * nsamps * sizeof (int16);
+    for (i = 0; i < 2; i++)
+    {
+        fp[i] = open_raw_binary (file[i], "rb");
+        if (fp[i] == NULL)
+        {
+            sprintf (errmsg, "Opening the climatology file: %s", file[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_anomaly (this);
+            return (NULL);
+        }
+        if (i == 0)
+            this->fp_mean = fp[i];
+        else
+            this->fp_std = fp[i];
+
+        fseek (fp[i], 0, SEEK_END);
+        size = ftell (fp[i]);
+        if (size != expected)
+        {
+            sprintf (errmsg, "Climatology file %s is %ld bytes; a %d x %d "
+                "int16 raster is %ld bytes", file[i], size, nsamps, nlines,
+                expected);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_anomaly (this);
+            return (NULL);
+        }
+    }
+
+    this->mean_buf = prof_malloc (PBUF_CLIMATOLOGY, PROC_NLINES * nsamps *
+        sizeof (int16));
+    this->std_buf = prof_malloc (PBUF_CLIMATOLOGY, PROC_NLINES * nsamps *
+        sizeof (int16));
+    if (this->mean_buf == NULL || this->std_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating the climatology strips");
+        error_handler (true, FUNC_NAME, errmsg);
+        close_anomaly (this);
+        return (NULL);
+    }
+
+    return (this);
+}
+
+
+/******************************************************************************
+MODULE:  get_anomaly_lines
+
+PURPOSE:  Reads a strip of the climatology mean and standard deviation,
+alongside the same strip of the reflectance bands.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error reading the climatology
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+int get_anomaly_lines
+(
+    Anomaly_t *this,         /* I/O: climatology */
+    int iline,               /* I: first line of the strip (0-based) */
+    int nlines               /* I: number of lines in the strip */
+)
+{
+    char FUNC_NAME[] = "get_anomaly_lines";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    long loc;                 /* offset of the strip in the files */
+
+    rate_limit_io (this->io_limit, 2 * (size_t) nlines * this->nsamps *
+        sizeof (int16));
+    loc = (long) iline * this->nsamps * sizeof (int16);
+    if (fseek (this->fp_mean, loc, SEEK_SET) ||
+        read_raw_binary (this->fp_mean, nlines, this->nsamps, sizeof (int16),
+        this->mean_buf) != SUCCESS ||
+        fseek (this->fp_std, loc, SEEK_SET) ||
+        read_raw_binary (this->fp_std, nlines, this->nsamps, sizeof (int16),
+        this->std_buf) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading %d lines of the climatology starting at "
+            "line %d", nlines, iline);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  make_anomaly
+
+PURPOSE:  Computes the standardized anomaly, and optionally the percent of
+normal, of a strip of index values against the climatology strip.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. anomaly = (index - mean) / std, and percent of normal =
+     100 * index / mean.  The index and climatology are in the same scale,
+     so the scale cancels.
+  2. Fill in the index or the climatology, or a std or mean which isn't
+     positive (for the anomaly and percent of normal respectively), gives
+     fill.  Saturated index values stay saturated.
+******************************************************************************/
+void make_anomaly
+(
+    Anomaly_t *this,         /* I: climatology holding the current strip */
+    int16 *spec_indx,        /* I: nlines * nsamps index values */
+    int nlines,              /* I: number of lines in the strip */
+    int16 *anom,             /* O: standardized anomaly */
+    int16 *pctn              /* O: percent of normal; NULL if not wanted */
+)
+{
+    long pix;                 /* current pixel */
+    long npix = (long) nlines * this->nsamps;  /* pixels in the strip */
+    int16 val;                /* current index value */
+    int16 mean;               /* current climatology mean */
+    int16 std;                /* current climatology standard deviation */
+    float z;                  /* scaled output value */
+
+    for (pix = 0; pix < npix; pix++)
+    {
+        val = spec_indx[pix];
+        mean = this->mean_buf[pix];
+        std = this->std_buf[pix];
+
+        if (val == FILL_VALUE || mean == FILL_VALUE || std == FILL_VALUE)
+        {
+            anom[pix] = FILL_VALUE;
+            if (pctn != NULL)
+                pctn[pix] = FILL_VALUE;
+            continue;
+        }
+        if (val == SATURATE_VALUE)
+        {
+            anom[pix] = SATURATE_VALUE;
+            if (pctn != NULL)
+                pctn[pix] = SATURATE_VALUE;
+            continue;
+        }
+
+        if (std <= 0)
+            anom[pix] = FILL_VALUE;
+        else
+        {
+            z = (float) (val - mean) / std * ANOM_FLOAT_TO_INT;
+            if (z > ANOM_MAX_VALUE)
+                z = ANOM_MAX_VALUE;
+            else if (z < -ANOM_MAX_VALUE)
+                z = -ANOM_MAX_VALUE;
+            anom[pix] = (int16) lroundf (z);
+        }
+
+        if (pctn == NULL)
+            continue;
+        if (mean <= 0)
+            pctn[pix] = FILL_VALUE;
+        else
+        {
+            z = 100.0 * val / mean * PCTN_FLOAT_TO_INT;
+            if (z > ANOM_MAX_VALUE)
+                z = ANOM_MAX_VALUE;
+            else if (z < -ANOM_MAX_VALUE)
+                z = -ANOM_MAX_VALUE;
+            pctn[pix] = (int16) lroundf (z);
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  set_anomaly_band_meta
+
+PURPOSE:  Sets the scale, valid range, and units of an anomaly output band,
+which open_output set up like an index band.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void set_anomaly_band_meta
+(
+    Espa_band_meta_t *bmeta, /* I/O: band metadata of the output band */
+    bool pct_normal          /* I: percent of normal band?  Otherwise the
+                                standardized anomaly */
+)
+{
+    bmeta->scale_factor = pct_normal ? PCTN_SCALE_FACTOR : ANOM_SCALE_FACTOR;
+    bmeta->valid_range[0] = (float) -ANOM_MAX_VALUE;
+    bmeta->valid_range[1] = (float) ANOM_MAX_VALUE;
+    strcpy (bmeta->data_units, pct_normal ? "percent of normal" :
+        "standard deviations");
+}
+
+
+/******************************************************************************
+MODULE:  close_anomaly
+
+PURPOSE:  Closes the climatology rasters and frees the climatology structure.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void close_anomaly
+(
+    Anomaly_t *this          /* I: climatology to close and free */
+)
+{
+    if (this == NULL)
+        return;
+
+    if (this->fp_mean != NULL)
+        close_raw_binary (this->fp_mean);
+    if (this->fp_std != NULL)
+        close_raw_binary (this->fp_std);
+    free (this->mean_buf);
+    free (this->std_buf);
+    free (this);
+}
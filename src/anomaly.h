@@ -0,0 +1,76 @@
+#ifndef _ANOMALY_H_
+#define _ANOMALY_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "common.h"
+#include "rate_limit.h"
+#include "espa_metadata.h"
+
+/* The climatology mean and standard deviation rasters are raw int16 files
+   on the scene grid, in the same scale as the index products (FLOAT_TO_INT)
+   with FILL_VALUE as fill */
+
+/* Standardized anomalies are stored in thousandths of a standard deviation
+   and percent of normal in tenths of a percent, both clamped to
+   +/- ANOM_MAX_VALUE */
+#define ANOM_FLOAT_TO_INT 1000.0
+#define ANOM_SCALE_FACTOR 0.001
+#define PCTN_FLOAT_TO_INT 10.0
+#define PCTN_SCALE_FACTOR 0.1
+#define ANOM_MAX_VALUE 10000
+
+/* Structure for the climatology the index is compared against */
+typedef struct {
+    Mysi_list_t si;          /* spectral index compared to the climatology */
+    int nlines;              /* number of lines in the scene */
+    int nsamps;              /* number of samples in the scene */
+    FILE *fp_mean;           /* climatology mean file */
+    FILE *fp_std;            /* climatology standard deviation file */
+    int16 *mean_buf;         /* PROC_NLINES lines of the mean */
+    int16 *std_buf;          /* PROC_NLINES lines of the standard deviation */
+    Rate_limit_t *io_limit;  /* I/O rate limiter for the reads; NULL if
+                                unlimited */
+} Anomaly_t;
+
+/* Prototypes */
+Anomaly_t *open_anomaly
+(
+    Mysi_list_t si,          /* I: spectral index compared to the
+                                climatology */
+    char *mean_file,         /* I: name of the climatology mean file */
+    char *std_file,          /* I: name of the climatology standard deviation
+                                file */
+    int nlines,              /* I: number of lines in the scene */
+    int nsamps               /* I: number of samples in the scene */
+);
+
+int get_anomaly_lines
+(
+    Anomaly_t *this,         /* I/O: climatology */
+    int iline,               /* I: first line of the strip (0-based) */
+    int nlines               /* I: number of lines in the strip */
+);
+
+void make_anomaly
+(
+    Anomaly_t *this,         /* I: climatology holding the current strip */
+    int16 *spec_indx,        /* I: nlines * nsamps index values */
+    int nlines,              /* I: number of lines in the strip */
+    int16 *anom,             /* O: standardized anomaly */
+    int16 *pctn              /* O: percent of normal; NULL if not wanted */
+);
+
+void set_anomaly_band_meta
+(
+    Espa_band_meta_t *bmeta, /* I/O: band metadata of the output band */
+    bool pct_normal          /* I: percent of normal band?  Otherwise the
+                                standardized anomaly */
+);
+
+void close_anomaly
+(
+    Anomaly_t *this          /* I: climatology to close and free */
+);
+
+#endif
@@ -0,0 +1,162 @@
+#include "output.h"
+#include "browse.h"
+#include "profile.h"
+
+/******************************************************************************
+MODULE:  open_browse
+
+PURPOSE:  Sets up the browse image for the specified spectral index and
+allocates the decimated buffer.
+
+RETURN VALUE:
+Type = Browse_t*
+Value      Description
+-----      -----------
+NULL       Error occurred allocating memory
+non-NULL   Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The browse is (nlines + factor - 1) / factor lines by
+     (nsamps + factor - 1) / factor samples.  Use close_browse to write the PNG
+     and free the memory.
+******************************************************************************/
+Browse_t *open_browse
+(
+    Mysi_list_t si,          /* I: spectral index shown in the browse */
+    int factor,              /* I: decimation factor */
+    int nlines,              /* I: number of lines in the index product */
+    int nsamps,              /* I: number of samples in the index product */
+    char *png_file           /* I: name of the browse PNG file */
+)
+{
+    char FUNC_NAME[] = "open_browse";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Browse_t *this = NULL;    /* browse image to be returned */
+
+    this = malloc (sizeof (Browse_t));
+    if (this == NULL)
+    {
+        sprintf (errmsg, "Allocating the browse structure");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    this->si = si;
+    this->factor = factor;
+    this->nlines = (nlines + factor - 1) / factor;
+    this->nsamps = (nsamps + factor - 1) / factor;
+    snprintf (this->png_file, sizeof (this->png_file), "%s", png_file);
+    this->vals = prof_malloc (PBUF_PREVIEW, (size_t) this->nlines *
+        this->nsamps * sizeof (int16));
+    if (this->vals == NULL)
+    {
+        sprintf (errmsg, "Allocating the %dx%d browse image", this->nsamps,
+            this->nlines);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (this);
+        return (NULL);
+    }
+
+    return (this);
+}
+
+
+/******************************************************************************
+MODULE:  add_browse_lines
+
+PURPOSE:  Adds the browse pixels from a strip of index values, as the strip
+is produced.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Nearest neighbor decimation; every factor'th sample of every factor'th
+     line is kept.
+******************************************************************************/
+void add_browse_lines
+(
+    Browse_t *this,          /* I/O: browse image */
+    int16 *spec_indx,        /* I: nlines * nsamps index values for the strip */
+    int iline,               /* I: first line of the strip (0-based) */
+    int nlines,              /* I: number of lines in the strip */
+    int nsamps               /* I: number of samples in the index product */
+)
+{
+    int line;                 /* first strip line on the browse grid */
+    int samp;                 /* looping variable for browse samples */
+    int16 *in = NULL;         /* current strip line */
+    int16 *out = NULL;        /* current browse line */
+
+    line = (iline + this->factor - 1) / this->factor * this->factor;
+    for (; line < iline + nlines; line += this->factor)
+    {
+        in = &spec_indx[(long) (line - iline) * nsamps];
+        out = &this->vals[(long) (line / this->factor) * this->nsamps];
+        for (samp = 0; samp < this->nsamps; samp++)
+            out[samp] = in[samp * this->factor];
+    }
+}
+
+
+/******************************************************************************
+MODULE:  close_browse
+
+PURPOSE:  Applies the colormap to the browse image, writes the PNG, and frees
+the browse structure.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred writing the PNG
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The ndvi colormap is used; fill is transparent.
+******************************************************************************/
+int close_browse
+(
+    Browse_t *this           /* I: browse image to write and free */
+)
+{
+    char FUNC_NAME[] = "close_browse";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int status;               /* return status */
+    uint8 *rgba = NULL;       /* colormapped browse */
+
+    rgba = malloc ((size_t) this->nlines * this->nsamps * 4);
+    if (rgba == NULL)
+    {
+        free (this->vals);
+        free (this);
+        sprintf (errmsg, "Allocating the RGBA browse image");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    apply_colormap (this->vals, (long) this->nlines * this->nsamps, CMAP_NDVI,
+        rgba);
+    status = write_png_rgba (this->png_file, rgba, this->nlines,
+        this->nsamps);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the browse image: %.900s",
+            this->png_file);
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+
+    free (rgba);
+    free (this->vals);
+    free (this);
+    return (status);
+}
@@ -0,0 +1,46 @@
+#ifndef _BROWSE_H_
+#define _BROWSE_H_
+
+#include "common.h"
+#include "colormap.h"
+#include "png_write.h"
+
+/* Default decimation factor for the browse image */
+#define BROWSE_FACTOR 8
+
+/* Structure for the browse image built while the index strips are
+   produced */
+typedef struct {
+    Mysi_list_t si;          /* spectral index shown in the browse */
+    int factor;              /* decimation factor in lines and samples */
+    int nlines;              /* number of lines in the browse image */
+    int nsamps;              /* number of samples in the browse image */
+    int16 *vals;             /* decimated index values */
+    char png_file[STR_SIZE]; /* name of the browse PNG file */
+} Browse_t;
+
+/* Prototypes */
+Browse_t *open_browse
+(
+    Mysi_list_t si,          /* I: spectral index shown in the browse */
+    int factor,              /* I: decimation factor */
+    int nlines,              /* I: number of lines in the index product */
+    int nsamps,              /* I: number of samples in the index product */
+    char *png_file           /* I: name of the browse PNG file */
+);
+
+void add_browse_lines
+(
+    Browse_t *this,          /* I/O: browse image */
+    int16 *spec_indx,        /* I: nlines * nsamps index values for the strip */
+    int iline,               /* I: first line of the strip (0-based) */
+    int nlines,              /* I: number of lines in the strip */
+    int nsamps               /* I: number of samples in the index product */
+);
+
+int close_browse
+(
+    Browse_t *this           /* I: browse image to write and free */
+);
+
+#endif
@@ -0,0 +1,144 @@
+#include "si.h"
+#include "calibration.h"
+
+/******************************************************************************
+MODULE:  read_calibration
+
+PURPOSE:  Reads the rates of a calibration profile written by si_io_bench.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error opening the file or it isn't a calibration profile
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. See calibration.h for the format.  Unknown keys are ignored, so newer
+     profiles can be read, and missing rates are left at 0.
+******************************************************************************/
+int read_calibration
+(
+    char *cal_file,          /* I: name of the calibration profile */
+    Calibration_t *cal       /* O: calibration */
+)
+{
+    char FUNC_NAME[] = "read_calibration";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char line[STR_SIZE];      /* current line of the file */
+    char key[STR_SIZE];       /* key of the current line */
+    char value[STR_SIZE];     /* value of the current line */
+    char index_key[STR_SIZE]; /* key of the kernel rate of an index */
+    int i;                    /* looping variable for indices */
+    FILE *fp = NULL;          /* calibration file */
+
+    memset (cal, 0, sizeof (Calibration_t));
+
+    fp = fopen (cal_file, "r");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the calibration profile: %s", cal_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (fgets (line, sizeof (line), fp) == NULL ||
+        strncmp (line, CALIBRATION_MAGIC, strlen (CALIBRATION_MAGIC)))
+    {
+        sprintf (errmsg, "%s is not a calibration profile", cal_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        fclose (fp);
+        return (ERROR);
+    }
+
+    while (fgets (line, sizeof (line), fp) != NULL)
+    {
+        if (sscanf (line, " %1023[^= ] = %1023s", key, value) != 2)
+            continue;
+
+        if (!strcmp (key, "backend"))
+            snprintf (cal->backend, sizeof (cal->backend), "%s", value);
+        else if (!strcmp (key, "read_mb_per_sec"))
+            cal->read_mbps = atof (value);
+        else if (!strcmp (key, "write_mb_per_sec"))
+            cal->write_mbps = atof (value);
+        else
+        {
+            for (i = 0; i < NUM_SI; i++)
+            {
+                sprintf (index_key, "%s_mpix_per_sec", si_short_name (i));
+                if (!strcmp (key, index_key))
+                    cal->mpix_per_sec[i] = atof (value);
+            }
+        }
+    }
+
+    fclose (fp);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_calibration
+
+PURPOSE:  Writes the measured rates as a calibration profile.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error writing the file
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Rates which weren't measured (0) aren't written.
+******************************************************************************/
+int write_calibration
+(
+    char *cal_file,          /* I: name of the calibration profile */
+    Calibration_t *cal       /* I: calibration */
+)
+{
+    char FUNC_NAME[] = "write_calibration";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable for indices */
+    FILE *fp = NULL;          /* calibration file */
+
+    fp = fopen (cal_file, "w");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the calibration profile: %s", cal_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fprintf (fp, "%s\n", CALIBRATION_MAGIC);
+    fprintf (fp, "app_version = spectral_indices_%s\n", INDEX_VERSION);
+    if (cal->backend[0] != '\0')
+        fprintf (fp, "backend = %s\n", cal->backend);
+    if (cal->read_mbps > 0.0)
+        fprintf (fp, "read_mb_per_sec = %.1f\n", cal->read_mbps);
+    if (cal->write_mbps > 0.0)
+        fprintf (fp, "write_mb_per_sec = %.1f\n", cal->write_mbps);
+    for (i = 0; i < NUM_SI; i++)
+    {
+        if (cal->mpix_per_sec[i] > 0.0)
+            fprintf (fp, "%s_mpix_per_sec = %.2f\n", si_short_name (i),
+                cal->mpix_per_sec[i]);
+    }
+
+    if (fclose (fp) != 0)
+    {
+        sprintf (errmsg, "Writing the calibration profile: %s", cal_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
@@ -0,0 +1,40 @@
+#ifndef _CALIBRATION_H_
+#define _CALIBRATION_H_
+
+#include "common.h"
+#include "espa_metadata.h"
+
+/* Identifies a calibration profile file */
+#define CALIBRATION_MAGIC "SI_CALIBRATION"
+
+/* Throughput of a node's storage and CPU for the strip pattern of
+   spectral_indices, as measured by si_io_bench --calibration.  The profile
+   is a text file of key = value lines after the magic line:
+     app_version = version of the application which measured the rates
+     backend = I/O backend the rates were measured with
+     read_mb_per_sec = strip read rate of the int16 band files
+     write_mb_per_sec = strip write rate of the int16 band files
+     {index}_mpix_per_sec = kernel rate of each index, one thread
+   Missing rates are left at 0 (unknown). */
+typedef struct {
+    char backend[STR_SIZE];  /* I/O backend the rates were measured with */
+    double read_mbps;        /* strip read rate in MB/s */
+    double write_mbps;       /* strip write rate in MB/s */
+    double mpix_per_sec[NUM_SI]; /* kernel rate of each index in millions
+                                of pixels per second */
+} Calibration_t;
+
+/* Prototypes */
+int read_calibration
+(
+    char *cal_file,          /* I: name of the calibration profile */
+    Calibration_t *cal       /* O: calibration */
+);
+
+int write_calibration
+(
+    char *cal_file,          /* I: name of the calibration profile */
+    Calibration_t *cal       /* I: calibration */
+);
+
+#endif
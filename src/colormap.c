@@ -0,0 +1,128 @@
+#include "output.h"
+#include "colormap.h"
+
+/******************************************************************************
+MODULE:  get_colormap
+
+PURPOSE:  Looks up the colormap with the specified name.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+-1         Unknown colormap name
+cmap       Colormap_t value for the colormap
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+int get_colormap
+(
+    char *name            /* I: name of the colormap (gray or ndvi) */
+)
+{
+    if (!strcmp (name, "gray"))
+        return (CMAP_GRAY);
+    else if (!strcmp (name, "ndvi"))
+        return (CMAP_NDVI);
+
+    return (-1);
+}
+
+
+/******************************************************************************
+MODULE:  apply_colormap
+
+PURPOSE:  Renders scaled index values to RGBA using the specified colormap.
+Index values from -1.0 to 1.0 are spread over the colormap; values beyond
+that range (i.e. EVI) are clamped.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Fill pixels are fully transparent and saturated pixels are opaque white.
+  2. The ndvi colormap runs from dark blue (water) through tan (bare soil) to
+     dark green (dense vegetation).  The palettes are built once from the
+     control points by linear interpolation.
+******************************************************************************/
+void apply_colormap
+(
+    int16 *spec_indx,     /* I: array of scaled index values */
+    long npix,            /* I: number of pixels in the array */
+    Colormap_t cmap,      /* I: colormap to apply */
+    uint8 *rgba           /* O: npix RGBA pixels */
+)
+{
+    static bool init = false;  /* have the palettes been built? */
+    static uint8 palette[NUM_CMAP][CMAP_NCOLORS][3];  /* RGB palettes */
+    static float ndvi_val[] = {-1.0, 0.0, 0.2, 0.4, 0.6, 0.8, 1.0};
+                               /* ndvi colormap control point values */
+    static uint8 ndvi_rgb[][3] = {{5, 24, 82}, {206, 197, 180},
+        {191, 163, 124}, {179, 174, 96}, {112, 147, 39}, {38, 104, 0},
+        {0, 68, 0}};           /* ndvi colormap control point colors */
+    int npts = sizeof (ndvi_val) / sizeof (ndvi_val[0]);  /* number of ndvi
+                                  control points */
+    int ic;                    /* looping variable for palette entries */
+    int ip;                    /* looping variable for control points */
+    int ib;                    /* looping variable for RGB */
+    int color;                 /* palette entry for the current pixel */
+    float val;                 /* index value for the palette entry */
+    float frac;                /* fraction between the control points */
+    long pix;                  /* looping variable for pixels */
+
+    /* Build the palettes the first time through */
+    if (!init)
+    {
+        for (ic = 0; ic < CMAP_NCOLORS; ic++)
+        {
+            val = -1.0 + 2.0 * ic / (CMAP_NCOLORS - 1);
+
+            for (ib = 0; ib < 3; ib++)
+                palette[CMAP_GRAY][ic][ib] = ic;
+
+            for (ip = 1; ip < npts - 1 && val > ndvi_val[ip]; ip++)
+                ;
+            frac = (val - ndvi_val[ip-1]) / (ndvi_val[ip] - ndvi_val[ip-1]);
+            if (frac < 0.0)
+                frac = 0.0;
+            else if (frac > 1.0)
+                frac = 1.0;
+            for (ib = 0; ib < 3; ib++)
+                palette[CMAP_NDVI][ic][ib] = (uint8) (ndvi_rgb[ip-1][ib] +
+                    frac * (ndvi_rgb[ip][ib] - ndvi_rgb[ip-1][ib]) + 0.5);
+        }
+        init = true;
+    }
+
+    for (pix = 0; pix < npix; pix++, rgba += 4)
+    {
+        if (spec_indx[pix] == FILL_VALUE)
+        {
+            rgba[0] = rgba[1] = rgba[2] = rgba[3] = 0;
+            continue;
+        }
+        if (spec_indx[pix] == SATURATE_VALUE)
+        {
+            rgba[0] = rgba[1] = rgba[2] = rgba[3] = 255;
+            continue;
+        }
+
+        color = ((int) spec_indx[pix] + (int) FLOAT_TO_INT) *
+            (CMAP_NCOLORS - 1) / (int) (2 * FLOAT_TO_INT);
+        if (color < 0)
+            color = 0;
+        else if (color > CMAP_NCOLORS - 1)
+            color = CMAP_NCOLORS - 1;
+
+        rgba[0] = palette[cmap][color][0];
+        rgba[1] = palette[cmap][color][1];
+        rgba[2] = palette[cmap][color][2];
+        rgba[3] = 255;
+    }
+}
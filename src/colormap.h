@@ -0,0 +1,26 @@
+#ifndef _COLORMAP_H_
+#define _COLORMAP_H_
+
+#include "common.h"
+
+/* Supported colormaps for rendering index values to RGBA */
+typedef enum {CMAP_GRAY=0, CMAP_NDVI, NUM_CMAP} Colormap_t;
+
+/* Number of entries in each colormap palette */
+#define CMAP_NCOLORS 256
+
+/* Prototypes */
+int get_colormap
+(
+    char *name            /* I: name of the colormap (gray or ndvi) */
+);
+
+void apply_colormap
+(
+    int16 *spec_indx,     /* I: array of scaled index values */
+    long npix,            /* I: number of pixels in the array */
+    Colormap_t cmap,      /* I: colormap to apply */
+    uint8 *rgba           /* O: npix RGBA pixels */
+);
+
+#endif
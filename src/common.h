@@ -3,14 +3,21 @@
 
 /* Define the spectral index products to be processed */
 typedef enum {SI_NDVI=0, SI_EVI, SI_SAVI, SI_MSAVI, SI_NDMI, SI_NBR, SI_NBR2,
-  NUM_SI} Mysi_list_t;
+  SI_NDRE, SI_PRI, SI_CCI, NUM_SI} Mysi_list_t;
 
 typedef signed short int16;
 typedef unsigned char uint8;
+typedef unsigned short uint16;
 
 /* Spectral index version */
 #define INDEX_VERSION "2.6.0"
 
+/* Maximum number of input reflectance bands used by any one index */
+#define MAX_SI_BANDS 3
+
+/* Exit status when the pre-scan rejects the scene as mostly fill or cloud */
+#define PRESCAN_REJECT 2
+
 /* How many lines of data should be processed at one time */
 #define PROC_NLINES 1000
 
@@ -0,0 +1,248 @@
+#include <strings.h>
+#include <ctype.h>
+#include "si.h"
+#include "cube_header.h"
+
+/******************************************************************************
+MODULE:  get_header_value
+
+PURPOSE:  Finds the value of the specified key in the text of an ENVI header.
+
+RETURN VALUE:
+Type = char *
+Value      Description
+-----      -----------
+NULL       The key isn't in the header
+non-NULL   Pointer to the first character of the value, after the '='
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Keys are matched at the start of a line, ignoring case and the spaces
+     around them.
+******************************************************************************/
+static char *get_header_value
+(
+    char *text,              /* I: header text */
+    char *key                /* I: key to find */
+)
+{
+    char *line = text;       /* start of the current line */
+    char *ptr = NULL;        /* current character */
+    size_t len = strlen (key);  /* length of the key */
+
+    while (line != NULL && *line != '\0')
+    {
+        ptr = line;
+        while (*ptr == ' ' || *ptr == '\t')
+            ptr++;
+        if (!strncasecmp (ptr, key, len))
+        {
+            ptr += len;
+            while (*ptr == ' ' || *ptr == '\t')
+                ptr++;
+            if (*ptr == '=')
+                return (ptr + 1);
+        }
+
+        line = strchr (line, '\n');
+        if (line != NULL)
+            line++;
+    }
+
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE:  read_cube_header
+
+PURPOSE:  Reads the ENVI header of a multi-band reflectance cube: the size,
+interleave, and the center wavelength of each band.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error reading the header, or the cube isn't supported
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The header is the cube file name with the extension replaced by .hdr.
+  2. Only int16 cubes in the host (little endian) byte order, interleaved by
+     band (BSQ) or by line (BIL), are supported.
+  3. The wavelengths are converted to nanometers.  If the header doesn't
+     give the units, wavelengths below CUBE_MAX_MICRONS are taken to be in
+     micrometers.
+******************************************************************************/
+int read_cube_header
+(
+    char *cube_file,         /* I: name of the cube image file */
+    Cube_header_t *hdr       /* O: cube header; the wavelength array is
+                                allocated and must be freed by the caller */
+)
+{
+    char FUNC_NAME[] = "read_cube_header";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char hdr_file[STR_SIZE];  /* name of the header file */
+    char interleave[STR_SIZE]; /* interleave of the cube */
+    char units[STR_SIZE];     /* wavelength units */
+    char *cptr = NULL;        /* pointer to the file extension */
+    char *text = NULL;        /* header text */
+    char *value = NULL;       /* value of the current key */
+    char *end = NULL;         /* end of the parsed number */
+    int ib;                   /* looping variable for bands */
+    long size;                /* size of the header file */
+    float scale = 1.0;        /* factor to convert the wavelengths to nm */
+    float max_wl = 0.0;       /* largest wavelength in the header */
+    FILE *fp = NULL;          /* header file pointer */
+
+    hdr->wavelength = NULL;
+
+    /* Read the whole header */
+    snprintf (hdr_file, sizeof (hdr_file), "%s", cube_file);
+    cptr = strrchr (hdr_file, '.');
+    if (cptr != NULL && strchr (cptr, '/') == NULL)
+        *cptr = '\0';
+    strncat (hdr_file, ".hdr", sizeof (hdr_file) - strlen (hdr_file) - 1);
+    fp = fopen (hdr_file, "r");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the cube header: %s", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    fseek (fp, 0, SEEK_END);
+    size = ftell (fp);
+    rewind (fp);
+    text = malloc (size + 1);
+    if (text == NULL || fread (text, 1, size, fp) != (size_t) size)
+    {
+        free (text);
+        fclose (fp);
+        sprintf (errmsg, "Reading the cube header: %s", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    text[size] = '\0';
+    fclose (fp);
+
+    if (strncmp (text, "ENVI", 4))
+    {
+        free (text);
+        sprintf (errmsg, "Not an ENVI header: %s", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Size, type, and layout */
+    hdr->nbands = hdr->nlines = hdr->nsamps = 0;
+    hdr->data_type = -1;
+    hdr->byte_order = 0;
+    hdr->header_offset = 0;
+    strcpy (interleave, "bsq");
+    if ((value = get_header_value (text, "bands")) != NULL)
+        hdr->nbands = atoi (value);
+    if ((value = get_header_value (text, "lines")) != NULL)
+        hdr->nlines = atoi (value);
+    if ((value = get_header_value (text, "samples")) != NULL)
+        hdr->nsamps = atoi (value);
+    if ((value = get_header_value (text, "data type")) != NULL)
+        hdr->data_type = atoi (value);
+    if ((value = get_header_value (text, "byte order")) != NULL)
+        hdr->byte_order = atoi (value);
+    if ((value = get_header_value (text, "header offset")) != NULL)
+        hdr->header_offset = atol (value);
+    if ((value = get_header_value (text, "interleave")) != NULL)
+        sscanf (value, " %3s", interleave);
+
+    if (hdr->nbands < 1 || hdr->nlines < 1 || hdr->nsamps < 1 ||
+        hdr->header_offset < 0)
+    {
+        free (text);
+        sprintf (errmsg, "Invalid size in the cube header: %s", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (hdr->data_type != CUBE_ENVI_INT16 || hdr->byte_order != 0)
+    {
+        free (text);
+        sprintf (errmsg, "Only little endian int16 cubes are supported: %s",
+            hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (!strcasecmp (interleave, "bil"))
+        hdr->bil = true;
+    else if (!strcasecmp (interleave, "bsq"))
+        hdr->bil = false;
+    else
+    {
+        free (text);
+        sprintf (errmsg, "Unsupported cube interleave %s; only BSQ and BIL "
+            "are supported: %s", interleave, hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Band center wavelengths, which may span several lines */
+    value = get_header_value (text, "wavelength");
+    if (value != NULL)
+        value = strchr (value, '{');
+    if (value == NULL)
+    {
+        free (text);
+        sprintf (errmsg, "No band wavelengths in the cube header: %s",
+            hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    hdr->wavelength = malloc (hdr->nbands * sizeof (float));
+    if (hdr->wavelength == NULL)
+    {
+        free (text);
+        sprintf (errmsg, "Allocating the cube wavelengths");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    value++;
+    for (ib = 0; ib < hdr->nbands; ib++)
+    {
+        while (isspace ((unsigned char) *value) || *value == ',')
+            value++;
+        hdr->wavelength[ib] = strtof (value, &end);
+        if (end == value)
+            break;
+        if (hdr->wavelength[ib] > max_wl)
+            max_wl = hdr->wavelength[ib];
+        value = end;
+    }
+    if (ib < hdr->nbands)
+    {
+        free (text);
+        free (hdr->wavelength);
+        hdr->wavelength = NULL;
+        sprintf (errmsg, "Expected %d band wavelengths in the cube header: "
+            "%s", hdr->nbands, hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Convert the wavelengths to nanometers */
+    units[0] = '\0';
+    if ((value = get_header_value (text, "wavelength units")) != NULL)
+        sscanf (value, " %255s", units);
+    if (!strncasecmp (units, "micro", 5) || !strcasecmp (units, "um"))
+        scale = 1000.0;
+    else if (units[0] == '\0' && max_wl < CUBE_MAX_MICRONS)
+        scale = 1000.0;
+    for (ib = 0; ib < hdr->nbands; ib++)
+        hdr->wavelength[ib] *= scale;
+
+    free (text);
+    return (SUCCESS);
+}
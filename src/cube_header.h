@@ -0,0 +1,41 @@
+#ifndef _CUBE_HEADER_H_
+#define _CUBE_HEADER_H_
+
+#include <stdbool.h>
+
+/* Multi-band reflectance cubes are listed in the XML file as one band named
+   sr_cube (product sr_refl) or toa_cube (product toa_refl).  The band count,
+   interleave, and band center wavelengths come from the ENVI header next to
+   the cube file ({cube}.hdr, with the .img extension replaced). */
+#define CUBE_SR_NAME "sr_cube"
+#define CUBE_TOA_NAME "toa_cube"
+
+/* ENVI data type code of the int16 cubes which are supported */
+#define CUBE_ENVI_INT16 2
+
+/* Wavelengths below this are taken as micrometers when the header doesn't
+   give the wavelength units */
+#define CUBE_MAX_MICRONS 100.0
+
+/* ENVI header of a reflectance cube */
+typedef struct {
+    int nbands;              /* number of bands in the cube */
+    int nlines;              /* number of lines */
+    int nsamps;              /* number of samples */
+    int data_type;           /* ENVI data type code */
+    int byte_order;          /* 0 = little endian, 1 = big endian */
+    long header_offset;      /* bytes before the first pixel */
+    bool bil;                /* band interleaved by line?  Otherwise band
+                                sequential */
+    float *wavelength;       /* center wavelength of each band in nm */
+} Cube_header_t;
+
+/* Prototypes */
+int read_cube_header
+(
+    char *cube_file,         /* I: name of the cube image file */
+    Cube_header_t *hdr       /* O: cube header; the wavelength array is
+                                allocated and must be freed by the caller */
+);
+
+#endif
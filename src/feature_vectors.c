@@ -0,0 +1,415 @@
+#include <stdlib.h>
+#include <string.h>
+#include "feature_vectors.h"
+#include "raw_binary_io.h"
+
+/* ENVI data type codes of the feature and line/sample files */
+#define ENVI_INT16 2
+#define ENVI_INT32 3
+#define ENVI_FLOAT32 4
+
+/******************************************************************************
+MODULE:  open_features
+
+PURPOSE:  Sets up the column names and block buffers of the feature vectors
+and opens the feature vector and line/sample files.
+
+RETURN VALUE:
+Type = Features_t*
+Value      Description
+-----      -----------
+NULL       Error occurred allocating memory or opening the files
+non-NULL   Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The feature vectors are written to {product_id}_features.img, one after
+     the other, with the reflectance bands read (in buffer order) and then
+     the indices.  The line and sample of each vector are written to
+     {product_id}_features_pix.img as a pair of int32.  Both get an ENVI
+     header at close_features.
+  2. The band columns are named {refl_prefix}_{wavelength}nm, after the
+     center wavelength of the band read.
+******************************************************************************/
+Features_t *open_features
+(
+    char *product_id,        /* I: product ID the files are named after */
+    bool float32,            /* I: write unscaled float32 values, otherwise
+                                the scaled int16 values */
+    Input_t *input,          /* I: reflectance bands, for their count,
+                                wavelengths, fill, and scale */
+    char *refl_prefix,       /* I: prefix of the band column names (sr, toa,
+                                or dn) */
+    int nindex,              /* I: number of index columns */
+    char index_names[][STR_SIZE] /* I: name of each index column */
+)
+{
+    char FUNC_NAME[] = "open_features";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int ib;                   /* looping variable for bands */
+    Features_t *this = NULL;  /* feature vectors to be returned */
+
+    this = calloc (1, sizeof (Features_t));
+    if (this == NULL)
+    {
+        sprintf (errmsg, "Allocating the feature vector structure");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    this->float32 = float32;
+    this->nrefl = input->nrefl_band;
+    this->nindex = nindex;
+    this->ncol = this->nrefl + nindex;
+    this->nsamps = input->nsamps;
+    this->refl_fill = input->refl_fill;
+    this->refl_scale = input->refl_scale_fact;
+    for (ib = 0; ib < this->nrefl; ib++)
+        snprintf (this->col_name[ib], STR_SIZE, "%s_%.0fnm", refl_prefix,
+            input->cat_wavelength[input->cat_band[ib]]);
+    for (ib = 0; ib < nindex; ib++)
+        strcpy (this->col_name[this->nrefl + ib], index_names[ib]);
+
+    snprintf (this->img_file, sizeof (this->img_file), "%s_features.img",
+        product_id);
+    snprintf (this->hdr_file, sizeof (this->hdr_file), "%s_features.hdr",
+        product_id);
+    snprintf (this->pix_file, sizeof (this->pix_file),
+        "%s_features_pix.img", product_id);
+    snprintf (this->pix_hdr_file, sizeof (this->pix_hdr_file),
+        "%s_features_pix.hdr", product_id);
+
+    this->block = malloc ((size_t) FEATURE_BLOCK * this->ncol *
+        (float32 ? sizeof (float) : sizeof (int16)));
+    this->pix = malloc (FEATURE_BLOCK * 2 * sizeof (int32_t));
+    if (this->block == NULL || this->pix == NULL)
+    {
+        sprintf (errmsg, "Allocating the feature vector block");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_features (this);
+        return (NULL);
+    }
+
+    this->fp_img = open_raw_binary (this->img_file, "wb");
+    if (this->fp_img == NULL)
+    {
+        sprintf (errmsg, "Opening the feature vector file %.900s",
+            this->img_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_features (this);
+        return (NULL);
+    }
+    this->fp_pix = open_raw_binary (this->pix_file, "wb");
+    if (this->fp_pix == NULL)
+    {
+        sprintf (errmsg, "Opening the feature vector file %.900s",
+            this->pix_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_features (this);
+        return (NULL);
+    }
+
+    return (this);
+}
+
+
+/******************************************************************************
+MODULE:  add_features_lines
+
+PURPOSE:  Writes the feature vector of each valid pixel of a strip, from the
+reflectance and index strips already in memory.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred writing the feature vectors
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. A pixel is valid if none of its bands is fill and none of its indices
+     is FILL_VALUE; only valid pixels get a feature vector.
+  2. The strip is transposed FEATURE_BLOCK pixels at a time.  Each plane is
+     read sequentially into its column of the block, so both the planes and
+     the block are walked in cache order, and the block is written once it
+     holds the valid pixels of the span.
+  3. The float32 values are the band values times the band scale factor and
+     the index values times SCALE_FACTOR.
+******************************************************************************/
+int add_features_lines
+(
+    Features_t *this,        /* I/O: feature vectors */
+    int16 **refl_buf,        /* I: strip of each reflectance band */
+    int16 **index_buf,       /* I: strip of each index, in column order */
+    int iline,               /* I: first line of the strip (0-based) */
+    int nlines               /* I: number of lines in the strip */
+)
+{
+    char FUNC_NAME[] = "add_features_lines";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int c;                    /* looping variable for columns */
+    int j;                    /* looping variable for valid pixels */
+    int p;                    /* looping variable for pixels of the block */
+    int n;                    /* number of pixels in the block */
+    int nvalid;               /* number of valid pixels in the block */
+    int ncol = this->ncol;    /* number of columns */
+    long start;               /* first pixel of the block in the strip */
+    long npix = (long) nlines * this->nsamps; /* pixels in the strip */
+    int16 fill[MAX_FEATURES]; /* fill value of each column */
+    float scale[MAX_FEATURES]; /* scale factor of each column */
+    int16 *plane[MAX_FEATURES]; /* strip of each column */
+    int16 *src = NULL;        /* current block of the current plane */
+    int16 *out16 = NULL;      /* int16 feature vectors */
+    float *out32 = NULL;      /* float32 feature vectors */
+    char ok[FEATURE_BLOCK];   /* is each pixel of the block valid so far? */
+
+    for (c = 0; c < ncol; c++)
+    {
+        if (c < this->nrefl)
+        {
+            plane[c] = refl_buf[c];
+            fill[c] = this->refl_fill;
+            scale[c] = this->refl_scale;
+        }
+        else
+        {
+            plane[c] = index_buf[c - this->nrefl];
+            fill[c] = FILL_VALUE;
+            scale[c] = SCALE_FACTOR;
+        }
+    }
+    out16 = this->block;
+    out32 = this->block;
+
+    for (start = 0; start < npix; start += FEATURE_BLOCK)
+    {
+        n = (npix - start < FEATURE_BLOCK) ? npix - start : FEATURE_BLOCK;
+
+        /* Mask the fill of each plane, then gather the valid pixels */
+        memset (ok, 1, n);
+        for (c = 0; c < ncol; c++)
+        {
+            src = &plane[c][start];
+            for (p = 0; p < n; p++)
+                ok[p] &= (src[p] != fill[c]);
+        }
+        nvalid = 0;
+        for (p = 0; p < n; p++)
+        {
+            if (ok[p])
+                this->valid[nvalid++] = p;
+        }
+        if (nvalid == 0)
+            continue;
+
+        /* Copy each plane into its column of the block */
+        for (c = 0; c < ncol; c++)
+        {
+            src = &plane[c][start];
+            if (this->float32)
+            {
+                for (j = 0; j < nvalid; j++)
+                    out32[j * ncol + c] = src[this->valid[j]] * scale[c];
+            }
+            else
+            {
+                for (j = 0; j < nvalid; j++)
+                    out16[j * ncol + c] = src[this->valid[j]];
+            }
+        }
+        for (j = 0; j < nvalid; j++)
+        {
+            this->pix[2*j] = iline + (start + this->valid[j]) / this->nsamps;
+            this->pix[2*j+1] = (start + this->valid[j]) % this->nsamps;
+        }
+
+        if (write_raw_binary (this->fp_img, nvalid, ncol, this->float32 ?
+            sizeof (float) : sizeof (int16), this->block) != SUCCESS ||
+            write_raw_binary (this->fp_pix, nvalid, 2, sizeof (int32_t),
+            this->pix) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the feature vectors of line %d",
+                iline + (int) (start / this->nsamps));
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        this->nrows += nvalid;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_features_hdr
+
+PURPOSE:  Writes the ENVI header of a file of pixel-interleaved vectors.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred writing the header
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The vectors are described as one line of nrows samples, interleaved by
+     pixel (BIP), so each sample is a vector.  There is no map info.
+  2. The gains are given only for the scaled int16 feature vectors.
+******************************************************************************/
+static int write_features_hdr
+(
+    char *hdr_file,          /* I: name of the header file */
+    long long nrows,         /* I: number of vectors */
+    int ncol,                /* I: number of columns in each vector */
+    int data_type,           /* I: ENVI data type code */
+    char col_name[][STR_SIZE], /* I: name of each column */
+    float *gain              /* I: scale factor of each column; NULL if
+                                none */
+)
+{
+    char FUNC_NAME[] = "write_features_hdr";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int c;                    /* looping variable for columns */
+    FILE *fp = NULL;          /* header file pointer */
+
+    fp = fopen (hdr_file, "w");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the header file %s", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fprintf (fp, "ENVI\n");
+    fprintf (fp, "description = {spectral_indices_%s pixel feature "
+        "vectors}\n", INDEX_VERSION);
+    fprintf (fp, "samples = %lld\n", nrows);
+    fprintf (fp, "lines = 1\n");
+    fprintf (fp, "bands = %d\n", ncol);
+    fprintf (fp, "header offset = 0\n");
+    fprintf (fp, "file type = ENVI Standard\n");
+    fprintf (fp, "data type = %d\n", data_type);
+    fprintf (fp, "interleave = bip\n");
+    fprintf (fp, "byte order = 0\n");
+    fprintf (fp, "band names = {");
+    for (c = 0; c < ncol; c++)
+        fprintf (fp, "%s%s", c ? ", " : "", col_name[c]);
+    fprintf (fp, "}\n");
+    if (gain != NULL)
+    {
+        fprintf (fp, "data gain values = {");
+        for (c = 0; c < ncol; c++)
+            fprintf (fp, "%s%g", c ? ", " : "", gain[c]);
+        fprintf (fp, "}\n");
+    }
+
+    if (fclose (fp) != 0)
+    {
+        sprintf (errmsg, "Writing the header file %s", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  close_features
+
+PURPOSE:  Closes the feature vector and line/sample files and writes their
+ENVI headers.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred closing the files or writing the headers
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The file names stay in the structure until free_features, for the
+     upload.
+******************************************************************************/
+int close_features
+(
+    Features_t *this         /* I: feature vectors to close */
+)
+{
+    char FUNC_NAME[] = "close_features";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char pix_name[2][STR_SIZE] = {"line", "sample"}; /* line/sample columns */
+    float gain[MAX_FEATURES]; /* scale factor of each column */
+    int c;                    /* looping variable for columns */
+    int status = SUCCESS;     /* return status */
+
+    if (fclose (this->fp_img) != 0)
+        status = ERROR;
+    if (fclose (this->fp_pix) != 0)
+        status = ERROR;
+    this->fp_img = NULL;
+    this->fp_pix = NULL;
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Closing the feature vector files");
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+
+    for (c = 0; c < this->ncol; c++)
+        gain[c] = (c < this->nrefl) ? this->refl_scale : SCALE_FACTOR;
+    if (write_features_hdr (this->hdr_file, this->nrows, this->ncol,
+        this->float32 ? ENVI_FLOAT32 : ENVI_INT16, this->col_name,
+        this->float32 ? NULL : gain) != SUCCESS ||
+        write_features_hdr (this->pix_hdr_file, this->nrows, 2, ENVI_INT32,
+        pix_name, NULL) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the feature vector headers");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  free_features
+
+PURPOSE:  Frees the feature vector structure, closing any files still open.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void free_features
+(
+    Features_t *this         /* I: feature vectors to free; may be NULL */
+)
+{
+    if (this == NULL)
+        return;
+
+    if (this->fp_img != NULL)
+        fclose (this->fp_img);
+    if (this->fp_pix != NULL)
+        fclose (this->fp_pix);
+    free (this->block);
+    free (this->pix);
+    free (this);
+}
@@ -0,0 +1,79 @@
+#ifndef _FEATURE_VECTORS_H_
+#define _FEATURE_VECTORS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "common.h"
+#include "input.h"
+#include "output.h"
+
+/* Number of pixels transposed at a time.  The block of feature vectors
+   (FEATURE_BLOCK * ncol values) stays in the L1 cache while each input
+   plane is copied into its column. */
+#define FEATURE_BLOCK 256
+
+/* Most columns of a feature vector: every band read plus every index */
+#define MAX_FEATURES (NBAND_REFL_MAX + NUM_SI)
+
+/* Structure for the pixel-interleaved feature vectors written while the
+   index strips are produced */
+typedef struct {
+    bool float32;            /* write unscaled float32 values, otherwise
+                                the scaled int16 values */
+    int nrefl;               /* number of reflectance band columns */
+    int nindex;              /* number of index columns */
+    int ncol;                /* number of columns in each feature vector */
+    int nsamps;              /* number of samples in the scene */
+    int16 refl_fill;         /* fill value of the reflectance bands */
+    float refl_scale;        /* scale factor of the reflectance bands */
+    long long nrows;         /* number of feature vectors written */
+    char col_name[MAX_FEATURES][STR_SIZE]; /* name of each column */
+    char img_file[STR_SIZE]; /* feature vector file */
+    char hdr_file[STR_SIZE]; /* ENVI header of the feature vector file */
+    char pix_file[STR_SIZE]; /* line and sample of each feature vector */
+    char pix_hdr_file[STR_SIZE]; /* ENVI header of the line and sample
+                                file */
+    FILE *fp_img;            /* feature vector file pointer */
+    FILE *fp_pix;            /* line and sample file pointer */
+    void *block;             /* FEATURE_BLOCK feature vectors */
+    int32_t *pix;            /* line and sample of each feature vector in
+                                the block */
+    int valid[FEATURE_BLOCK]; /* offset in the strip of each valid pixel of
+                                the block */
+} Features_t;
+
+/* Prototypes */
+Features_t *open_features
+(
+    char *product_id,        /* I: product ID the files are named after */
+    bool float32,            /* I: write unscaled float32 values, otherwise
+                                the scaled int16 values */
+    Input_t *input,          /* I: reflectance bands, for their count,
+                                wavelengths, fill, and scale */
+    char *refl_prefix,       /* I: prefix of the band column names (sr, toa,
+                                or dn) */
+    int nindex,              /* I: number of index columns */
+    char index_names[][STR_SIZE] /* I: name of each index column */
+);
+
+int add_features_lines
+(
+    Features_t *this,        /* I/O: feature vectors */
+    int16 **refl_buf,        /* I: strip of each reflectance band */
+    int16 **index_buf,       /* I: strip of each index, in column order */
+    int iline,               /* I: first line of the strip (0-based) */
+    int nlines               /* I: number of lines in the strip */
+);
+
+int close_features
+(
+    Features_t *this         /* I: feature vectors to close */
+);
+
+void free_features
+(
+    Features_t *this         /* I: feature vectors to free; may be NULL */
+);
+
+#endif
@@ -0,0 +1,413 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "si.h"
+#include "flight.h"
+
+/* Names of the events for the dump */
+static const char *flight_name[NUM_FLIGHT] = {"start", "fetch", "read",
+    "climatology", "preview", "compute", "anomaly", "write", "tile",
+    "upload", "strip", "finish", "wait"};
+
+/* Signals the ring is dumped on before the process dies */
+static const int flight_signal[] = {SIGTERM, SIGINT, SIGSEGV, SIGBUS,
+    SIGABRT};
+#define FLIGHT_NSIGNAL (int) (sizeof (flight_signal) / sizeof (int))
+
+/* The ring lives in memory until it's moved to a file */
+static Flight_ring_t flight_local;
+static Flight_ring_t *flight = &flight_local;
+
+/* Alternate stack, so a stack overflow can still be dumped */
+#define FLIGHT_STACK_SIZE 65536
+static char flight_stack[FLIGHT_STACK_SIZE];
+
+/******************************************************************************
+MODULE:  append_str, append_int
+
+PURPOSE:  Append a string or a decimal integer to a line being dumped.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The dump runs in signal handlers, so stdio can't be used.
+  2. The integer is zero-padded to width digits.
+******************************************************************************/
+static void append_str
+(
+    char *buf,               /* I/O: line being built */
+    int *len,                /* I/O: length of the line */
+    const char *str          /* I: string to append */
+)
+{
+    while (*str != '\0' && *len < STR_SIZE - 1)
+        buf[(*len)++] = *str++;
+}
+
+static void append_int
+(
+    char *buf,               /* I/O: line being built */
+    int *len,                /* I/O: length of the line */
+    int64_t val,             /* I: value to append */
+    int width                /* I: minimum number of digits */
+)
+{
+    char digits[24];         /* digits of the value, reversed */
+    int n = 0;               /* number of digits */
+    uint64_t u;              /* magnitude of the value */
+
+    u = val < 0 ? (uint64_t) -(val + 1) + 1 : (uint64_t) val;
+    do
+    {
+        digits[n++] = '0' + u % 10;
+        u /= 10;
+    } while (u > 0);
+    while (n < width)
+        digits[n++] = '0';
+    if (val < 0 && *len < STR_SIZE - 1)
+        buf[(*len)++] = '-';
+    while (n > 0 && *len < STR_SIZE - 1)
+        buf[(*len)++] = digits[--n];
+}
+
+
+/******************************************************************************
+MODULE:  flight_signal_handler
+
+PURPOSE:  Dumps the ring on a fatal signal, then lets the signal take its
+default action.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The handler is installed with SA_RESETHAND and SA_NODEFER, so raising
+     the signal again terminates the process (with a core where the signal
+     produces one).
+******************************************************************************/
+static void flight_signal_handler
+(
+    int sig                  /* I: signal received */
+)
+{
+    char reason[64];         /* reason for the dump */
+    int len = 0;             /* length of the reason */
+
+    append_str (reason, &len, "signal ");
+    append_int (reason, &len, sig, 1);
+    reason[len] = '\0';
+    flight_dump (reason);
+    raise (sig);
+}
+
+
+/******************************************************************************
+MODULE:  flight_exit_handler
+
+PURPOSE:  Dumps the ring when the process exits with ERROR.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Every fatal error in the application is reported through
+     error_handler and followed by exit (ERROR), so this catches them all.
+******************************************************************************/
+static void flight_exit_handler
+(
+    int status,              /* I: exit status */
+    void *arg                /* I: not used */
+)
+{
+    if (status == ERROR)
+        flight_dump ("exit status 1");
+}
+
+
+/******************************************************************************
+MODULE:  flight_open
+
+PURPOSE:  Starts the flight recorder.  The ring is moved to a shared mapping
+of the flight recorder file if one is specified, and the ring is set up to be
+dumped on a fatal error or signal.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error creating or mapping the flight recorder file
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The file is mapped MAP_SHARED, so the events are in the page cache as
+     soon as they're recorded and outlive the process however it dies.
+******************************************************************************/
+int flight_open
+(
+    char *flight_file        /* I: file to keep the ring in; NULL to keep
+                                it in memory only */
+)
+{
+    char FUNC_NAME[] = "flight_open";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable for signals */
+    int fd;                   /* flight recorder file */
+    void *map = NULL;         /* mapping of the file */
+    stack_t ss;               /* alternate signal stack */
+    struct sigaction sa;      /* fatal signal action */
+
+    if (flight_file != NULL)
+    {
+        fd = open (flight_file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            sprintf (errmsg, "Creating flight recorder file %.900s: %s",
+                flight_file, strerror (errno));
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        if (ftruncate (fd, sizeof (Flight_ring_t)) != 0)
+        {
+            sprintf (errmsg, "Sizing flight recorder file %.900s: %s",
+                flight_file, strerror (errno));
+            error_handler (true, FUNC_NAME, errmsg);
+            close (fd);
+            return (ERROR);
+        }
+        map = mmap (NULL, sizeof (Flight_ring_t), PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+        close (fd);
+        if (map == MAP_FAILED)
+        {
+            sprintf (errmsg, "Mapping flight recorder file %.900s: %s",
+                flight_file, strerror (errno));
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        flight = map;
+    }
+
+    memcpy (flight->magic, FLIGHT_MAGIC, sizeof (flight->magic));
+    flight->nevent = FLIGHT_NEVENT;
+    flight->pid = getpid ();
+    flight->head = 0;
+    flight->state = FLIGHT_RUNNING;
+    flight->start_ns = 0;
+    flight->start_ns = flight_now ();
+
+    /* Dump the ring on the way down */
+    ss.ss_sp = flight_stack;
+    ss.ss_size = sizeof (flight_stack);
+    ss.ss_flags = 0;
+    sigaltstack (&ss, NULL);
+
+    memset (&sa, 0, sizeof (sa));
+    sa.sa_handler = flight_signal_handler;
+    sa.sa_flags = SA_RESETHAND | SA_NODEFER | SA_ONSTACK;
+    sigemptyset (&sa.sa_mask);
+    for (i = 0; i < FLIGHT_NSIGNAL; i++)
+        sigaction (flight_signal[i], &sa, NULL);
+    on_exit (flight_exit_handler, NULL);
+
+    flight_event (FLIGHT_START, -1, -1, 0, flight_now ());
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  flight_now
+
+PURPOSE:  Returns the time since the start of the run in ns, for timing an
+event.
+
+RETURN VALUE:
+Type = int64_t
+Value      Description
+-----      -----------
+>=0        Time since the start of the run in ns
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+int64_t flight_now ()
+{
+    struct timespec ts;      /* current time */
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ((int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec -
+        flight->start_ns);
+}
+
+
+/******************************************************************************
+MODULE:  flight_event
+
+PURPOSE:  Records an event in the ring, overwriting the oldest one.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Lock-free, so it can be called from any thread: the slot is claimed
+     with an atomic increment of the head, and its sequence number is
+     published last so the dump can skip a slot caught mid-write.
+  2. The cost is a clock read, the increment, and a few stores.
+******************************************************************************/
+void flight_event
+(
+    Flight_stage_t stage,    /* I: pipeline event */
+    int line,                /* I: first line of the strip; -1 if none */
+    int band,                /* I: band, index, or object; -1 if none */
+    int64_t bytes,           /* I: bytes moved by the event */
+    int64_t start            /* I: flight_now at the start of the event */
+)
+{
+    int64_t now = flight_now ();   /* end of the event */
+    uint64_t seq;                  /* sequence number of the event */
+    Flight_event_t *ev = NULL;     /* slot for the event */
+
+    seq = __atomic_fetch_add (&flight->head, 1, __ATOMIC_RELAXED);
+    ev = &flight->event[seq & (FLIGHT_NEVENT - 1)];
+    __atomic_store_n (&ev->seq, 0, __ATOMIC_RELAXED);
+    ev->time_ns = now;
+    ev->dur_ns = now - start;
+    ev->bytes = bytes;
+    ev->line = line;
+    ev->stage = stage;
+    ev->band = band;
+    __atomic_store_n (&ev->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+
+/******************************************************************************
+MODULE:  flight_dump
+
+PURPOSE:  Writes the most recent events in the ring to stderr, oldest first.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Async-signal-safe: the lines are built by hand and written with
+     write (2).
+  2. Each line has the end time of the event since the start of the run,
+     the strip (or part) and band (or index or object), the event, and the
+     bytes moved and how long it took.
+******************************************************************************/
+void flight_dump
+(
+    char *reason             /* I: why the ring is being dumped */
+)
+{
+    char buf[STR_SIZE];      /* line being dumped */
+    int len;                 /* length of the line */
+    uint64_t head;           /* number of events recorded */
+    uint64_t seq;            /* sequence number of the event being dumped */
+    uint64_t first;          /* first event dumped */
+    Flight_event_t *slot = NULL; /* slot of the event being dumped */
+    Flight_event_t ev;       /* copy of the event being dumped */
+
+    head = __atomic_load_n (&flight->head, __ATOMIC_ACQUIRE);
+    first = head > FLIGHT_NDUMP ? head - FLIGHT_NDUMP : 0;
+
+    len = 0;
+    append_str (buf, &len, "Flight recorder (");
+    append_str (buf, &len, reason);
+    append_str (buf, &len, "): last ");
+    append_int (buf, &len, head - first, 1);
+    append_str (buf, &len, " of ");
+    append_int (buf, &len, head, 1);
+    append_str (buf, &len, " events\n");
+    if (write (STDERR_FILENO, buf, len) < 0)
+        return;
+
+    for (seq = first; seq < head; seq++)
+    {
+        /* Skip a slot which is being rewritten */
+        slot = &flight->event[seq & (FLIGHT_NEVENT - 1)];
+        if (__atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE) != seq + 1)
+            continue;
+        ev = *slot;
+        if (__atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE) != seq + 1 ||
+            ev.stage < 0 || ev.stage >= NUM_FLIGHT)
+            continue;
+
+        len = 0;
+        append_str (buf, &len, "  +");
+        append_int (buf, &len, ev.time_ns / 1000000000, 1);
+        append_str (buf, &len, ".");
+        append_int (buf, &len, ev.time_ns % 1000000000 / 1000, 6);
+        append_str (buf, &len, " s ");
+        append_str (buf, &len, flight_name[ev.stage]);
+        if (ev.line >= 0)
+        {
+            append_str (buf, &len, ev.stage == FLIGHT_UPLOAD ? " part " :
+                " line ");
+            append_int (buf, &len, ev.line, 1);
+        }
+        if (ev.band >= 0)
+        {
+            append_str (buf, &len, " band ");
+            append_int (buf, &len, ev.band, 1);
+        }
+        if (ev.bytes > 0)
+        {
+            append_str (buf, &len, ": ");
+            append_int (buf, &len, ev.bytes, 1);
+            append_str (buf, &len, " bytes");
+        }
+        append_str (buf, &len, " in ");
+        append_int (buf, &len, ev.dur_ns / 1000, 1);
+        append_str (buf, &len, " us\n");
+        if (write (STDERR_FILENO, buf, len) < 0)
+            return;
+    }
+
+    flight->state = FLIGHT_DUMPED;
+}
+
+
+/******************************************************************************
+MODULE:  flight_close
+
+PURPOSE:  Marks the run as complete in the flight recorder file.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The file is left mapped; the exit handler still needs the ring.
+******************************************************************************/
+void flight_close ()
+{
+    flight_event (FLIGHT_FINISH, -1, -1, 0, flight_now ());
+    flight->state = FLIGHT_DONE;
+}
@@ -0,0 +1,83 @@
+#ifndef _FLIGHT_H_
+#define _FLIGHT_H_
+
+#include <stdint.h>
+#include "common.h"
+
+/* Number of events kept in the ring; must be a power of two */
+#define FLIGHT_NEVENT 1024
+
+/* Number of the most recent events dumped to stderr */
+#define FLIGHT_NDUMP 128
+
+/* Identifies a flight recorder file */
+#define FLIGHT_MAGIC "SIFLIGHT"
+
+/* State of the run, as left in a flight recorder file */
+#define FLIGHT_RUNNING 0
+#define FLIGHT_DONE 1
+#define FLIGHT_DUMPED 2
+
+/* Pipeline events which are recorded */
+typedef enum {FLIGHT_START=0, FLIGHT_FETCH, FLIGHT_READ, FLIGHT_CLIMATOLOGY,
+  FLIGHT_PREVIEW, FLIGHT_COMPUTE, FLIGHT_ANOMALY, FLIGHT_WRITE, FLIGHT_TILE,
+  FLIGHT_UPLOAD, FLIGHT_STRIP, FLIGHT_FINISH, FLIGHT_WAIT, NUM_FLIGHT}
+  Flight_stage_t;
+
+/* One recorded event */
+typedef struct {
+    uint64_t seq;            /* sequence number of the event plus one; 0
+                                while the slot is being written */
+    int64_t time_ns;         /* end of the event, in ns since the start of
+                                the run */
+    int64_t dur_ns;          /* duration of the event in ns */
+    int64_t bytes;           /* bytes read, written, or uploaded */
+    int32_t line;            /* first line of the strip, or the part number
+                                of an upload; -1 if none */
+    int16_t stage;           /* Flight_stage_t of the event */
+    int16_t band;            /* input band, index, output band, or object;
+                                -1 if none */
+} Flight_event_t;
+
+/* Ring of the most recent events.  This is also the layout of the flight
+   recorder file, in the byte order of the host, so a run killed outright
+   still leaves its last events behind. */
+typedef struct {
+    char magic[8];           /* FLIGHT_MAGIC, without the terminator */
+    uint32_t nevent;         /* FLIGHT_NEVENT */
+    uint32_t pid;            /* process ID of the run */
+    int64_t start_ns;        /* CLOCK_MONOTONIC start of the run in ns */
+    uint64_t head;           /* number of events recorded; the next event
+                                goes in slot head % nevent */
+    uint32_t state;          /* FLIGHT_RUNNING, FLIGHT_DONE, or
+                                FLIGHT_DUMPED */
+    uint32_t pad;            /* keeps the events 8-byte aligned */
+    Flight_event_t event[FLIGHT_NEVENT]; /* ring of events */
+} Flight_ring_t;
+
+/* Prototypes */
+int flight_open
+(
+    char *flight_file        /* I: file to keep the ring in; NULL to keep
+                                it in memory only */
+);
+
+int64_t flight_now ();
+
+void flight_event
+(
+    Flight_stage_t stage,    /* I: pipeline event */
+    int line,                /* I: first line of the strip; -1 if none */
+    int band,                /* I: band, index, or object; -1 if none */
+    int64_t bytes,           /* I: bytes moved by the event */
+    int64_t start            /* I: flight_now at the start of the event */
+);
+
+void flight_dump
+(
+    char *reason             /* I: why the ring is being dumped */
+);
+
+void flight_close ();
+
+#endif
@@ -0,0 +1,411 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "output.h"
+#include "footprint.h"
+
+/******************************************************************************
+MODULE:  open_footprint
+
+PURPOSE:  Sets up the valid-data footprint of the scene, with no valid
+samples found yet.
+
+RETURN VALUE:
+Type = Footprint_t*
+Value      Description
+-----      -----------
+NULL       Error occurred allocating memory
+non-NULL   Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The footprint is kept as the first and last valid sample of each line,
+     which is 8 bytes per line.  Use close_footprint to free it.
+******************************************************************************/
+Footprint_t *open_footprint
+(
+    Espa_global_meta_t *gmeta, /* I: global metadata of the scene */
+    int nlines,              /* I: number of lines in the scene */
+    int nsamps,              /* I: number of samples in the scene */
+    float pixsize[2]         /* I: pixel size in x and y */
+)
+{
+    char FUNC_NAME[] = "open_footprint";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int line;                 /* looping variable for lines */
+    Footprint_t *this = NULL; /* footprint to be returned */
+
+    this = calloc (1, sizeof (Footprint_t));
+    if (this == NULL)
+    {
+        sprintf (errmsg, "Allocating the footprint structure");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    this->nlines = nlines;
+    this->nsamps = nsamps;
+    this->gmeta = *gmeta;
+    this->pixsize[0] = pixsize[0];
+    this->pixsize[1] = pixsize[1];
+
+    /* Outer corner of the scene, so whole pixels map to their edges */
+    this->ul[0] = gmeta->proj_info.ul_corner[0];
+    this->ul[1] = gmeta->proj_info.ul_corner[1];
+    if (!strcmp (gmeta->proj_info.grid_origin, "CENTER"))
+    {
+        this->ul[0] -= 0.5 * pixsize[0];
+        this->ul[1] += 0.5 * pixsize[1];
+    }
+
+    this->first = malloc (nlines * sizeof (int));
+    this->last = malloc (nlines * sizeof (int));
+    if (this->first == NULL || this->last == NULL)
+    {
+        sprintf (errmsg, "Allocating the footprint of %d lines", nlines);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_footprint (this);
+        return (NULL);
+    }
+    for (line = 0; line < nlines; line++)
+    {
+        this->first[line] = -1;
+        this->last[line] = -1;
+    }
+
+    return (this);
+}
+
+
+/******************************************************************************
+MODULE:  add_footprint_lines
+
+PURPOSE:  Widens the footprint to the valid samples of a strip of index
+values, as the strip is produced.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Called for each index of the strip, so the footprint is the union of
+     the indices.  Only the samples outside the extent already found for a
+     line are looked at, so the later indices of a strip cost next to
+     nothing.
+  2. A sample is valid if it isn't FILL_VALUE.
+******************************************************************************/
+void add_footprint_lines
+(
+    Footprint_t *this,       /* I/O: footprint; nothing is done if NULL */
+    int16 *spec_indx,        /* I: nlines * nsamps index values for the strip */
+    int iline,               /* I: first line of the strip (0-based) */
+    int nlines               /* I: number of lines in the strip */
+)
+{
+    int line;                 /* looping variable for strip lines */
+    int samp;                 /* looping variable for samples */
+    int end;                  /* sample at which the scan stops */
+    int *first = NULL;        /* first valid sample of the current line */
+    int *last = NULL;         /* last valid sample of the current line */
+    int16 *in = NULL;         /* current strip line */
+
+    if (this == NULL)
+        return;
+
+    for (line = 0; line < nlines; line++)
+    {
+        in = &spec_indx[(long) line * this->nsamps];
+        first = &this->first[iline + line];
+        last = &this->last[iline + line];
+
+        /* Scan in from the left up to the current first valid sample */
+        end = (*first == -1) ? this->nsamps : *first;
+        for (samp = 0; samp < end; samp++)
+        {
+            if (in[samp] != FILL_VALUE)
+                break;
+        }
+        if (samp < end)
+            *first = samp;
+        if (*first == -1)
+            continue;  /* no valid samples in this line yet */
+
+        /* Scan in from the right down to the current last valid sample */
+        end = (*last == -1) ? *first - 1 : *last;
+        for (samp = this->nsamps - 1; samp > end; samp--)
+        {
+            if (in[samp] != FILL_VALUE)
+                break;
+        }
+        if (samp > end)
+            *last = samp;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  simplify
+
+PURPOSE:  Marks the vertices of a polyline kept by the Douglas-Peucker
+simplification.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The end points of the span are already kept by the caller.  Recursion
+     only goes as deep as there are kept vertices along the span.
+******************************************************************************/
+static void simplify
+(
+    double *x,               /* I: x of each vertex, in pixels */
+    double *y,               /* I: y of each vertex, in pixels */
+    int start,               /* I: first vertex of the span */
+    int end,                 /* I: last vertex of the span */
+    double tolerance,        /* I: largest distance of a dropped vertex from
+                                the simplified edge, in pixels */
+    char *keep               /* O: set for each vertex which is kept */
+)
+{
+    int i;                    /* looping variable for vertices */
+    int imax = -1;            /* vertex farthest from the edge */
+    double dx, dy;            /* direction of the edge */
+    double len;               /* length of the edge */
+    double dist;              /* distance of a vertex from the edge */
+    double dmax = tolerance;  /* farthest distance found */
+
+    dx = x[end] - x[start];
+    dy = y[end] - y[start];
+    len = sqrt (dx * dx + dy * dy);
+    for (i = start + 1; i < end; i++)
+    {
+        if (len > 0.0)
+            dist = fabs (dx * (y[i] - y[start]) - dy * (x[i] - x[start])) /
+                len;
+        else
+            dist = hypot (x[i] - x[start], y[i] - y[start]);
+        if (dist > dmax)
+        {
+            dmax = dist;
+            imax = i;
+        }
+    }
+
+    if (imax != -1)
+    {
+        keep[imax] = 1;
+        simplify (x, y, start, imax, tolerance, keep);
+        simplify (x, y, imax, end, tolerance, keep);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  write_footprint
+
+PURPOSE:  Writes the simplified footprint polygon and bounding box of the
+valid data, in the projection coordinates of the scene, as a GeoJSON
+feature.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred writing the file
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The outline follows the outer edge of the first valid sample down the
+     lines and of the last valid sample back up, so it is the line-by-line
+     hull of the valid data.  Fill between valid samples of a line, and
+     lines with no valid samples in between valid lines, are not cut out.
+     It is then simplified to FOOTPRINT_TOLERANCE pixels.
+  2. The coordinates are those of the scene projection (the projection
+     units of the XML), not longitude and latitude.  The named crs of the
+     2008 GeoJSON draft is given for UTM scenes, taking the WGS84 datum.
+     The projection is also given in the properties.
+  3. A scene with no valid data gets a null geometry and bbox.
+******************************************************************************/
+int write_footprint
+(
+    Footprint_t *this,       /* I: footprint */
+    char *geojson_file       /* I: name of the GeoJSON file to write */
+)
+{
+    char FUNC_NAME[] = "write_footprint";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int line;                 /* looping variable for lines */
+    int i;                    /* looping variable for vertices */
+    int n = 0;                /* number of vertices in the outline */
+    int nkept;                /* number of vertices kept */
+    int nvalid = 0;           /* number of lines with valid samples */
+    int line0 = -1;           /* first line with valid samples */
+    int line1 = -1;           /* last line with valid samples */
+    int samp0 = -1;           /* leftmost valid sample */
+    int samp1 = -1;           /* rightmost valid sample */
+    int zone;                 /* UTM zone; negative in the south */
+    double *x = NULL;         /* x of each outline vertex, in pixels */
+    double *y = NULL;         /* y of each outline vertex, in pixels */
+    char *keep = NULL;        /* is each outline vertex kept? */
+    FILE *fp = NULL;          /* GeoJSON file */
+
+    /* Extent of the valid data */
+    for (line = 0; line < this->nlines; line++)
+    {
+        if (this->first[line] == -1)
+            continue;
+        if (line0 == -1)
+            line0 = line;
+        line1 = line;
+        if (samp0 == -1 || this->first[line] < samp0)
+            samp0 = this->first[line];
+        if (this->last[line] > samp1)
+            samp1 = this->last[line];
+        nvalid++;
+    }
+
+    /* Outline in pixel edges: down the left side, then back up the right */
+    if (nvalid > 0)
+    {
+        x = malloc (4 * nvalid * sizeof (double));
+        y = malloc (4 * nvalid * sizeof (double));
+        keep = calloc (4 * nvalid, sizeof (char));
+        if (x == NULL || y == NULL || keep == NULL)
+        {
+            sprintf (errmsg, "Allocating the footprint outline");
+            error_handler (true, FUNC_NAME, errmsg);
+            free (x);
+            free (y);
+            free (keep);
+            return (ERROR);
+        }
+
+        n = 0;
+        for (line = line0; line <= line1; line++)
+        {
+            if (this->first[line] == -1)
+                continue;
+            x[n] = this->first[line];
+            y[n++] = line;
+            x[n] = this->first[line];
+            y[n++] = line + 1;
+        }
+        for (line = line1; line >= line0; line--)
+        {
+            if (this->last[line] == -1)
+                continue;
+            x[n] = this->last[line] + 1;
+            y[n++] = line + 1;
+            x[n] = this->last[line] + 1;
+            y[n++] = line;
+        }
+
+        /* The top edge closes the ring, so simplify the rest as one
+           polyline */
+        keep[0] = 1;
+        keep[n-1] = 1;
+        simplify (x, y, 0, n - 1, FOOTPRINT_TOLERANCE, keep);
+    }
+
+    fp = fopen (geojson_file, "w");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the footprint file %s", geojson_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (x);
+        free (y);
+        free (keep);
+        return (ERROR);
+    }
+
+    fprintf (fp, "{\n  \"type\": \"Feature\",\n");
+    zone = this->gmeta.proj_info.utm_zone;
+    if (zone != 0 && abs (zone) <= 60)
+        fprintf (fp, "  \"crs\": {\"type\": \"name\", \"properties\": "
+            "{\"name\": \"urn:ogc:def:crs:EPSG::%d\"}},\n",
+            (zone > 0 ? 32600 : 32700) + abs (zone));
+    fprintf (fp, "  \"properties\": {\n");
+    fprintf (fp, "    \"product_id\": \"%s\",\n", this->gmeta.product_id);
+    fprintf (fp, "    \"proj_type\": %d,\n", this->gmeta.proj_info.proj_type);
+    if (zone != 0 && abs (zone) <= 60)
+        fprintf (fp, "    \"utm_zone\": %d,\n", zone);
+    fprintf (fp, "    \"units\": \"%s\",\n", this->gmeta.proj_info.units);
+    fprintf (fp, "    \"pixel_size\": [%.15g, %.15g],\n", this->pixsize[0],
+        this->pixsize[1]);
+    fprintf (fp, "    \"valid_lines\": %d\n  },\n", nvalid);
+
+    if (nvalid == 0)
+        fprintf (fp, "  \"bbox\": null,\n  \"geometry\": null\n}\n");
+    else
+    {
+        fprintf (fp, "  \"bbox\": [%.15g, %.15g, %.15g, %.15g],\n",
+            this->ul[0] + samp0 * this->pixsize[0],
+            this->ul[1] - (line1 + 1) * this->pixsize[1],
+            this->ul[0] + (samp1 + 1) * this->pixsize[0],
+            this->ul[1] - line0 * this->pixsize[1]);
+
+        /* Projection x,y of the kept vertices, closed at the first */
+        fprintf (fp, "  \"geometry\": {\n    \"type\": \"Polygon\",\n"
+            "    \"coordinates\": [[");
+        nkept = 0;
+        for (i = 0; i <= n; i++)
+        {
+            if (i < n && !keep[i])
+                continue;
+            fprintf (fp, "%s\n      [%.15g, %.15g]", nkept++ ? "," : "",
+                this->ul[0] + x[i % n] * this->pixsize[0],
+                this->ul[1] - y[i % n] * this->pixsize[1]);
+        }
+        fprintf (fp, "\n    ]]\n  }\n}\n");
+    }
+
+    free (x);
+    free (y);
+    free (keep);
+    if (fclose (fp) != 0)
+    {
+        sprintf (errmsg, "Writing the footprint file %s", geojson_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  close_footprint
+
+PURPOSE:  Frees the footprint.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void close_footprint
+(
+    Footprint_t *this        /* I: footprint to free; may be NULL */
+)
+{
+    if (this == NULL)
+        return;
+
+    free (this->first);
+    free (this->last);
+    free (this);
+}
@@ -0,0 +1,55 @@
+#ifndef _FOOTPRINT_H_
+#define _FOOTPRINT_H_
+
+#include "common.h"
+#include "espa_metadata.h"
+
+/* Tolerance of the footprint simplification, in pixels.  The line-by-line
+   outline is a staircase along the slanted scene edges; vertices within
+   this distance of the simplified edge are dropped. */
+#define FOOTPRINT_TOLERANCE 2.0
+
+/* Structure for the valid-data footprint tracked while the index strips
+   are produced */
+typedef struct {
+    int nlines;              /* number of lines in the scene */
+    int nsamps;              /* number of samples in the scene */
+    int *first;              /* first valid sample of each line; -1 if the
+                                line has no valid samples */
+    int *last;               /* last valid sample of each line; -1 if the
+                                line has no valid samples */
+    double ul[2];            /* projection x,y of the outer upper left
+                                corner of the scene */
+    double pixsize[2];       /* pixel size in x and y */
+    Espa_global_meta_t gmeta; /* global metadata of the scene */
+} Footprint_t;
+
+/* Prototypes */
+Footprint_t *open_footprint
+(
+    Espa_global_meta_t *gmeta, /* I: global metadata of the scene */
+    int nlines,              /* I: number of lines in the scene */
+    int nsamps,              /* I: number of samples in the scene */
+    float pixsize[2]         /* I: pixel size in x and y */
+);
+
+void add_footprint_lines
+(
+    Footprint_t *this,       /* I/O: footprint; nothing is done if NULL */
+    int16 *spec_indx,        /* I: nlines * nsamps index values for the strip */
+    int iline,               /* I: first line of the strip (0-based) */
+    int nlines               /* I: number of lines in the strip */
+);
+
+int write_footprint
+(
+    Footprint_t *this,       /* I: footprint */
+    char *geojson_file       /* I: name of the GeoJSON file to write */
+);
+
+void close_footprint
+(
+    Footprint_t *this        /* I: footprint to free; may be NULL */
+);
+
+#endif
@@ -22,20 +22,79 @@ NOTES:
   1. Memory is allocated for the input file.  This should be character a
      pointer set to NULL on input.  The caller is responsible for freeing the
      allocated memory upon successful return.
+  2. Same for the shared-memory ring name, the browse index name, the
+     node-wide I/O bucket name, the S3 URL, the tile grid, the anomaly index
+     name, the climatology files, and the calibration profile, which are
+     left NULL if not specified.
 ******************************************************************************/
 short get_args
 (
     int argc,             /* I: number of cmd-line args */
     char *argv[],         /* I: string of cmd-line args */
     char **xml_infile,    /* O: address of input XML file */
+    char **shm_name,      /* O: address of the shared-memory ring name */
     bool *toa,            /* O: flag to process TOA reflectance */
+    bool *dn,             /* O: flag to process the 8-bit Level-1 DN bands */
     bool *ndvi,           /* O: flag to process NDVI */
     bool *ndmi,           /* O: flag to process NDMI */
     bool *nbr,            /* O: flag to process NBR */
     bool *nbr2,           /* O: flag to process NBR2 */
+    bool *ndre,           /* O: flag to process NDRE */
+    bool *pri,            /* O: flag to process PRI */
+    bool *cci,            /* O: flag to process CCI */
     bool *savi,           /* O: flag to process SAVI */
     bool *msavi,          /* O: flag to process MSAVI */
     bool *evi,            /* O: flag to process EVI */
+    bool *virtual,        /* O: flag to write virtual index descriptors */
+    char **browse_name,   /* O: address of the index for the browse image */
+    int *browse_factor,   /* O: decimation factor for the browse image */
+    float *prescan,       /* O: minimum valid fraction for the pre-scan; -1.0
+                                if no pre-scan */
+    bool *prescan_qa,     /* O: flag to use pixel_qa in the pre-scan */
+    bool *mmap_output,    /* O: flag to write the index bands through
+                                preallocated memory maps */
+    int *write_buffer,    /* O: size of the per-band write-combining buffer
+                                in megabytes; 0 for none */
+    float *io_rate_limit, /* O: per-process I/O limit in MB/s; 0 for none */
+    float *io_node_limit, /* O: node-wide I/O limit in MB/s; 0 for none */
+    char **io_node_bucket, /* O: address of the node-wide I/O bucket name */
+    int *http_cache,      /* O: memory budget for the remote band block
+                                caches in megabytes */
+    char **s3_output,     /* O: address of the S3 URL to upload the products
+                                to */
+    int *s3_part_size,    /* O: multipart upload part size in megabytes */
+    int *s3_threads,      /* O: number of parallel part uploads */
+    char **tile_grid,     /* O: address of the tile grid to write the
+                                indices to */
+    int *tile_buffer,     /* O: memory budget for the partial tiles in
+                                megabytes */
+    char **anomaly_name,  /* O: address of the index to compare with the
+                                climatology */
+    char **clim_mean,     /* O: address of the climatology mean file */
+    char **clim_std,      /* O: address of the climatology standard
+                                deviation file */
+    bool *pct_normal,     /* O: flag to also write the percent of normal */
+    bool *progressive,    /* O: flag to publish coarse previews first */
+    bool *profile,        /* O: flag to report the memory and faults of each
+                                stage */
+    char **flight_file,   /* O: address of the file to keep the flight
+                                recorder in */
+    char **metrics_file,  /* O: address of the file to write the metrics
+                                to */
+    bool *footprint,      /* O: flag to write the valid-data footprint */
+    char **features,      /* O: address of the data type of the feature
+                                vectors (int16 or float32) */
+    char **sample_labels, /* O: address of the label raster to draw the
+                                sample by */
+    int *sample_size,     /* O: number of pixels to draw from each class */
+    bool *plan,           /* O: flag to print the run plan instead of
+                                processing */
+    char **cal_file,      /* O: address of the calibration profile to
+                                estimate the run time from */
+    bool *follow,         /* O: flag to wait for the strips of band files
+                                which are still being written */
+    float *follow_timeout, /* O: most seconds the band files may go without
+                                growing */
     bool *verbose         /* O: verbose flag */
 )
 {
@@ -43,27 +102,77 @@ short get_args
     int option_index;                /* index for the command-line option */
     static int verbose_flag=0;       /* verbose flag */
     static int toa_flag=0;           /* process TOA flag */
+    static int dn_flag=0;            /* process Level-1 DN flag */
     static int ndvi_flag=0;          /* process NDVI flag */
     static int ndmi_flag=0;          /* process NDMI flag */
     static int nbr_flag=0;           /* process NBR flag */
     static int nbr2_flag=0;          /* process NBR2 flag */
+    static int ndre_flag=0;          /* process NDRE flag */
+    static int pri_flag=0;           /* process PRI flag */
+    static int cci_flag=0;           /* process CCI flag */
     static int savi_flag=0;          /* process SAVI flag */
     static int msavi_flag=0;         /* process MSAVI flag */
     static int evi_flag=0;           /* process EVI flag */
+    static int virtual_flag=0;       /* write virtual index descriptors flag */
+    static int prescan_qa_flag=0;    /* use pixel_qa in the pre-scan flag */
+    static int mmap_output_flag=0;   /* memory-mapped output flag */
+    static int pct_normal_flag=0;    /* write percent of normal flag */
+    static int progressive_flag=0;   /* publish coarse previews flag */
+    static int profile_flag=0;       /* report memory and faults flag */
+    static int footprint_flag=0;     /* write the footprint flag */
+    static int plan_flag=0;          /* print the run plan flag */
+    static int follow_flag=0;        /* follow growing band files flag */
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
     static struct option long_options[] =
     {
         {"verbose", no_argument, &verbose_flag, 1},
         {"toa", no_argument, &toa_flag, 1},
+        {"dn", no_argument, &dn_flag, 1},
         {"ndvi", no_argument, &ndvi_flag, 1},
         {"ndmi", no_argument, &ndmi_flag, 1},
         {"nbr", no_argument, &nbr_flag, 1},
         {"nbr2", no_argument, &nbr2_flag, 1},
+        {"ndre", no_argument, &ndre_flag, 1},
+        {"pri", no_argument, &pri_flag, 1},
+        {"cci", no_argument, &cci_flag, 1},
         {"savi", no_argument, &savi_flag, 1},
         {"msavi", no_argument, &msavi_flag, 1},
         {"evi", no_argument, &evi_flag, 1},
+        {"virtual", no_argument, &virtual_flag, 1},
+        {"prescan_qa", no_argument, &prescan_qa_flag, 1},
+        {"mmap_output", no_argument, &mmap_output_flag, 1},
+        {"pct_normal", no_argument, &pct_normal_flag, 1},
+        {"progressive", no_argument, &progressive_flag, 1},
+        {"profile", no_argument, &profile_flag, 1},
+        {"footprint", no_argument, &footprint_flag, 1},
+        {"plan", no_argument, &plan_flag, 1},
+        {"follow", no_argument, &follow_flag, 1},
         {"xml", required_argument, 0, 'i'},
+        {"shm", required_argument, 0, 'm'},
+        {"browse", required_argument, 0, 'b'},
+        {"browse_factor", required_argument, 0, 'f'},
+        {"prescan", required_argument, 0, 'p'},
+        {"write_buffer", required_argument, 0, 'w'},
+        {"io_rate_limit", required_argument, 0, 'r'},
+        {"io_node_limit", required_argument, 0, 'l'},
+        {"io_node_bucket", required_argument, 0, 'k'},
+        {"http_cache", required_argument, 0, 'c'},
+        {"s3_output", required_argument, 0, 'o'},
+        {"s3_part_size", required_argument, 0, 's'},
+        {"s3_threads", required_argument, 0, 't'},
+        {"tile_grid", required_argument, 0, 'g'},
+        {"tile_buffer", required_argument, 0, 'u'},
+        {"anomaly", required_argument, 0, 'a'},
+        {"clim_mean", required_argument, 0, 'e'},
+        {"clim_std", required_argument, 0, 'd'},
+        {"flight_file", required_argument, 0, 'x'},
+        {"metrics_file", required_argument, 0, 'y'},
+        {"features", required_argument, 0, 'n'},
+        {"sample", required_argument, 0, 'z'},
+        {"sample_size", required_argument, 0, 'j'},
+        {"calibration", required_argument, 0, 'q'},
+        {"follow_timeout", required_argument, 0, 'F'},
         {"help", no_argument, 0, 'h'},
         {"version", no_argument, 0, 'v'},
         {0, 0, 0, 0}
@@ -72,13 +181,37 @@ short get_args
     /* Initialize the flags to false */
     *verbose = false;
     *toa = false;
+    *dn = false;
     *ndvi = false;
     *ndmi = false;
     *nbr = false;
     *nbr2 = false;
+    *ndre = false;
+    *pri = false;
+    *cci = false;
     *savi = false;
     *msavi = false;
     *evi = false;
+    *virtual = false;
+    *browse_factor = BROWSE_FACTOR;
+    *prescan = -1.0;
+    *prescan_qa = false;
+    *mmap_output = false;
+    *write_buffer = 0;
+    *io_rate_limit = 0.0;
+    *io_node_limit = 0.0;
+    *http_cache = HTTP_CACHE_MB;
+    *s3_part_size = S3_PART_MB;
+    *s3_threads = S3_THREADS;
+    *tile_buffer = TILE_BUFFER_MB;
+    *pct_normal = false;
+    *progressive = false;
+    *profile = false;
+    *footprint = false;
+    *sample_size = SAMPLE_SIZE;
+    *plan = false;
+    *follow = false;
+    *follow_timeout = FOLLOW_TIMEOUT;
 
     /* Loop through all the cmd-line options */
     opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
@@ -111,6 +244,198 @@ short get_args
                 *xml_infile = strdup (optarg);
                 break;
      
+            case 'm':  /* shared-memory ring */
+                *shm_name = strdup (optarg);
+                break;
+
+            case 'b':  /* index for the browse image */
+                *browse_name = strdup (optarg);
+                break;
+
+            case 'f':  /* browse decimation factor */
+                *browse_factor = atoi (optarg);
+                if (*browse_factor < 1)
+                {
+                    sprintf (errmsg, "Browse factor must be 1 or greater: %s",
+                        optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'p':  /* pre-scan threshold */
+                *prescan = atof (optarg);
+                if (*prescan < 0.0 || *prescan > 1.0)
+                {
+                    sprintf (errmsg, "Pre-scan threshold must be between 0.0 "
+                        "and 1.0: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'w':  /* write-combining buffer size */
+                *write_buffer = atoi (optarg);
+                if (*write_buffer < 1)
+                {
+                    sprintf (errmsg, "Write buffer size must be 1 MB or "
+                        "greater: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'r':  /* per-process I/O limit */
+                *io_rate_limit = atof (optarg);
+                if (*io_rate_limit <= 0.0)
+                {
+                    sprintf (errmsg, "I/O rate limit must be greater than 0 "
+                        "MB/s: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'l':  /* node-wide I/O limit */
+                *io_node_limit = atof (optarg);
+                if (*io_node_limit <= 0.0)
+                {
+                    sprintf (errmsg, "Node I/O limit must be greater than 0 "
+                        "MB/s: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'k':  /* node-wide I/O bucket */
+                *io_node_bucket = strdup (optarg);
+                break;
+
+            case 'c':  /* remote band block cache budget */
+                *http_cache = atoi (optarg);
+                if (*http_cache < 1)
+                {
+                    sprintf (errmsg, "HTTP cache size must be 1 MB or "
+                        "greater: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'o':  /* S3 URL for the products */
+                *s3_output = strdup (optarg);
+                break;
+
+            case 's':  /* multipart upload part size */
+                *s3_part_size = atoi (optarg);
+                if (*s3_part_size < S3_MIN_PART_MB)
+                {
+                    sprintf (errmsg, "S3 part size must be %d MB or greater: "
+                        "%s", S3_MIN_PART_MB, optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 't':  /* number of parallel part uploads */
+                *s3_threads = atoi (optarg);
+                if (*s3_threads < 1 || *s3_threads > S3_MAX_THREADS)
+                {
+                    sprintf (errmsg, "S3 upload threads must be between 1 and "
+                        "%d: %s", S3_MAX_THREADS, optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'g':  /* tile grid */
+                *tile_grid = strdup (optarg);
+                break;
+
+            case 'u':  /* partial tile budget */
+                *tile_buffer = atoi (optarg);
+                if (*tile_buffer < 1)
+                {
+                    sprintf (errmsg, "Tile buffer size must be 1 MB or "
+                        "greater: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'a':  /* index to compare with the climatology */
+                *anomaly_name = strdup (optarg);
+                break;
+
+            case 'e':  /* climatology mean */
+                *clim_mean = strdup (optarg);
+                break;
+
+            case 'd':  /* climatology standard deviation */
+                *clim_std = strdup (optarg);
+                break;
+
+            case 'x':  /* flight recorder file */
+                *flight_file = strdup (optarg);
+                break;
+
+            case 'y':  /* Prometheus metrics file */
+                *metrics_file = strdup (optarg);
+                break;
+
+            case 'n':  /* data type of the feature vectors */
+                if (strcmp (optarg, "int16") && strcmp (optarg, "float32"))
+                {
+                    sprintf (errmsg, "Feature vector type must be int16 or "
+                        "float32: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                *features = strdup (optarg);
+                break;
+
+            case 'z':  /* label raster for the sample */
+                *sample_labels = strdup (optarg);
+                break;
+
+            case 'j':  /* pixels drawn from each class */
+                *sample_size = atoi (optarg);
+                if (*sample_size < 1)
+                {
+                    sprintf (errmsg, "Sample size must be 1 or greater: %s",
+                        optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'q':  /* calibration profile */
+                *cal_file = strdup (optarg);
+                break;
+
+            case 'F':  /* seconds the band files may go without growing */
+                *follow_timeout = atof (optarg);
+                if (*follow_timeout <= 0.0)
+                {
+                    sprintf (errmsg, "Follow timeout must be greater than 0: "
+                        "%s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
             case '?':
             default:
                 sprintf (errmsg, "Unknown option %s", argv[optind-1]);
@@ -133,6 +458,8 @@ short get_args
     /* Check the spectral index flags */
     if (toa_flag)
         *toa = true;
+    if (dn_flag)
+        *dn = true;
     if (ndvi_flag)
         *ndvi = true;
     if (ndmi_flag)
@@ -141,12 +468,155 @@ short get_args
         *nbr = true;
     if (nbr2_flag)
         *nbr2 = true;
+    if (ndre_flag)
+        *ndre = true;
+    if (pri_flag)
+        *pri = true;
+    if (cci_flag)
+        *cci = true;
     if (savi_flag)
         *savi = true;
     if (msavi_flag)
         *msavi = true;
     if (evi_flag)
         *evi = true;
+    if (virtual_flag)
+        *virtual = true;
+    if (prescan_qa_flag)
+        *prescan_qa = true;
+    if (mmap_output_flag)
+        *mmap_output = true;
+    if (pct_normal_flag)
+        *pct_normal = true;
+    if (progressive_flag)
+        *progressive = true;
+    if (profile_flag)
+        *profile = true;
+    if (footprint_flag)
+        *footprint = true;
+    if (plan_flag)
+        *plan = true;
+    if (follow_flag)
+        *follow = true;
+
+    /* The mapped band files are written by the kernel, not buffered */
+    if (*mmap_output && *write_buffer > 0)
+    {
+        sprintf (errmsg, "--write_buffer can't be used with --mmap_output");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Uploaded bands are streamed, not written to local files */
+    if (*s3_output != NULL && (*mmap_output || *write_buffer > 0))
+    {
+        sprintf (errmsg, "--s3_output can't be used with --mmap_output or "
+            "--write_buffer");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Tiles replace the scene band files */
+    if (*tile_grid != NULL && (*mmap_output || *write_buffer > 0 ||
+        *s3_output != NULL))
+    {
+        sprintf (errmsg, "--tile_grid can't be used with --mmap_output, "
+            "--write_buffer, or --s3_output");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* The feature vectors are gathered from the index strips in memory */
+    if (*features != NULL && (*mmap_output || *virtual))
+    {
+        sprintf (errmsg, "--features can't be used with --mmap_output or "
+            "--virtual");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* The sample is drawn in place of the index bands, from the strips in
+       memory */
+    if (*sample_labels != NULL && (*virtual || *mmap_output ||
+        *write_buffer > 0 || *s3_output != NULL || *tile_grid != NULL ||
+        *anomaly_name != NULL || *progressive))
+    {
+        sprintf (errmsg, "--sample can't be used with --virtual, "
+            "--mmap_output, --write_buffer, --s3_output, --tile_grid, "
+            "--anomaly, or --progressive");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* The DN bands are read from the band files as bytes */
+    if (*dn && (*toa || *shm_name != NULL || *virtual))
+    {
+        sprintf (errmsg, "--dn can't be used with --toa, --shm, or "
+            "--virtual");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* The anomaly needs both climatology rasters */
+    if (*anomaly_name != NULL && (*clim_mean == NULL || *clim_std == NULL))
+    {
+        sprintf (errmsg, "--anomaly requires --clim_mean and --clim_std");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+    if (*anomaly_name == NULL && (*clim_mean != NULL || *clim_std != NULL ||
+        *pct_normal))
+    {
+        sprintf (errmsg, "--clim_mean, --clim_std, and --pct_normal require "
+            "--anomaly");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* The QA flag only applies to the pre-scan */
+    if (*prescan_qa && *prescan < 0.0)
+    {
+        sprintf (errmsg, "--prescan_qa requires --prescan");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* The plan can't look at the ring without taking its strips, and the
+       calibration is only used for the plan's estimate */
+    if (*plan && *shm_name != NULL)
+    {
+        sprintf (errmsg, "--plan can't be used with --shm");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+    if (*cal_file != NULL && !*plan)
+    {
+        sprintf (errmsg, "--calibration requires --plan");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Following reads each strip once, in order, as it's written */
+    if (*follow && (*shm_name != NULL || *virtual || *prescan >= 0.0 ||
+        *progressive || *plan))
+    {
+        sprintf (errmsg, "--follow can't be used with --shm, --virtual, "
+            "--prescan, --progressive, or --plan");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
 
     /* Check the verbose flag */
     if (verbose_flag)
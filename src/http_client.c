@@ -0,0 +1,870 @@
+#include <errno.h>
+#include <ctype.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "si.h"
+#include "http_client.h"
+
+/******************************************************************************
+MODULE:  is_http_url
+
+PURPOSE:  Determines if a file name is an http:// URL.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+true       The name is an http:// URL
+false      The name is a local file name
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+bool is_http_url
+(
+    char *name               /* I: file name or URL */
+)
+{
+    return (name != NULL && !strncasecmp (name, "http://", 7));
+}
+
+
+/******************************************************************************
+MODULE:  parse_http_url
+
+PURPOSE:  Splits an http:// URL into the host, port, and path.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      The URL isn't a valid http:// URL
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. https:// isn't supported; use an http endpoint or a local proxy.
+******************************************************************************/
+int parse_http_url
+(
+    char *url,               /* I: http://host[:port]/path URL */
+    Http_url_t *parsed       /* O: parsed URL */
+)
+{
+    char FUNC_NAME[] = "parse_http_url";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *host = NULL;        /* start of the host name */
+    char *path = NULL;        /* start of the path */
+    char *port = NULL;        /* start of the port */
+    size_t len;               /* length of the host name */
+
+    if (!is_http_url (url))
+    {
+        sprintf (errmsg, "Only http:// URLs are supported: %.900s", url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    host = url + 7;
+    path = strchr (host, '/');
+    if (path == NULL)
+        path = host + strlen (host);
+    port = memchr (host, ':', path - host);
+
+    len = (port != NULL ? port : path) - host;
+    if (len == 0 || len >= sizeof (parsed->host) ||
+        strlen (path) >= sizeof (parsed->path) - 1)
+    {
+        sprintf (errmsg, "Invalid URL: %.900s", url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    memcpy (parsed->host, host, len);
+    parsed->host[len] = '\0';
+
+    parsed->port = 80;
+    if (port != NULL)
+    {
+        parsed->port = atoi (port + 1);
+        if (parsed->port <= 0 || parsed->port > 65535)
+        {
+            sprintf (errmsg, "Invalid port in URL: %.900s", url);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    if (*path == '\0')
+        strcpy (parsed->path, "/");
+    else
+        strcpy (parsed->path, path);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  connect_http
+
+PURPOSE:  Connects the socket for an HTTP connection.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred connecting
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static int connect_http
+(
+    Http_conn_t *conn        /* I/O: connection to connect */
+)
+{
+    char FUNC_NAME[] = "connect_http";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char port[16];            /* port number as a string */
+    int one = 1;              /* option value for TCP_NODELAY */
+    struct addrinfo hints;    /* address lookup hints */
+    struct addrinfo *addrs = NULL;  /* addresses for the host */
+    struct addrinfo *ai = NULL;     /* current address */
+    struct timeval tv;        /* send/receive timeout */
+
+    memset (&hints, 0, sizeof (hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    sprintf (port, "%d", conn->url.port);
+    if (getaddrinfo (conn->url.host, port, &hints, &addrs) != 0)
+    {
+        sprintf (errmsg, "Unable to resolve host %s", conn->url.host);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (ai = addrs; ai != NULL; ai = ai->ai_next)
+    {
+        conn->sock = socket (ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (conn->sock < 0)
+            continue;
+        if (connect (conn->sock, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+        close (conn->sock);
+        conn->sock = -1;
+    }
+    freeaddrinfo (addrs);
+
+    if (conn->sock < 0)
+    {
+        sprintf (errmsg, "Unable to connect to %s:%d", conn->url.host,
+            conn->url.port);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    tv.tv_sec = HTTP_TIMEOUT_SECS;
+    tv.tv_usec = 0;
+    setsockopt (conn->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+    setsockopt (conn->sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof (tv));
+    setsockopt (conn->sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof (one));
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  open_http_conn
+
+PURPOSE:  Sets up a keep-alive connection to the host of a URL.  The socket
+is connected on the first request.
+
+RETURN VALUE:
+Type = Http_conn_t*
+Value      Description
+-----      -----------
+NULL       Error occurred allocating the connection
+non-NULL   Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. A connection may only be used by one thread at a time.
+******************************************************************************/
+Http_conn_t *open_http_conn
+(
+    Http_url_t *url          /* I: URL of the host to connect to */
+)
+{
+    char FUNC_NAME[] = "open_http_conn";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Http_conn_t *conn = NULL; /* connection to be returned */
+
+    conn = malloc (sizeof (Http_conn_t));
+    if (conn == NULL)
+    {
+        sprintf (errmsg, "Allocating the HTTP connection");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    conn->url = *url;
+    conn->sock = -1;
+    conn->bytes_in = 0;
+    conn->bytes_out = 0;
+    conn->nrequest = 0;
+
+    return (conn);
+}
+
+
+/******************************************************************************
+MODULE:  close_http_conn
+
+PURPOSE:  Closes and frees an HTTP connection.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void close_http_conn
+(
+    Http_conn_t *conn        /* I: connection to close and free */
+)
+{
+    if (conn == NULL)
+        return;
+
+    if (conn->sock >= 0)
+        close (conn->sock);
+    free (conn);
+}
+
+
+/******************************************************************************
+MODULE:  send_all
+
+PURPOSE:  Sends all of a buffer on a socket.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred sending
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static int send_all
+(
+    int sock,                /* I: connected socket */
+    const void *buf,         /* I: data to send */
+    size_t len               /* I: number of bytes to send */
+)
+{
+    const char *ptr = buf;   /* next byte to send */
+    ssize_t n;               /* number of bytes sent by one call */
+
+    while (len > 0)
+    {
+        n = send (sock, ptr, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return (ERROR);
+        ptr += n;
+        len -= n;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  recv_body
+
+PURPOSE:  Receives body bytes, first from the bytes already read with the
+header and then from the socket.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred receiving, or the connection was closed early
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. If dst is NULL the bytes are discarded.
+******************************************************************************/
+static int recv_body
+(
+    int sock,                /* I: connected socket */
+    char **pending,          /* I/O: bytes read past the header */
+    size_t *npending,        /* I/O: number of pending bytes */
+    char *dst,               /* O: received bytes; NULL to discard */
+    size_t len               /* I: number of bytes to receive */
+)
+{
+    char discard[4096];      /* buffer for discarded bytes */
+    size_t n;                /* number of bytes from the pending bytes */
+    ssize_t nrecv;           /* number of bytes received by one call */
+
+    n = (*npending < len) ? *npending : len;
+    if (n > 0)
+    {
+        if (dst != NULL)
+        {
+            memcpy (dst, *pending, n);
+            dst += n;
+        }
+        *pending += n;
+        *npending -= n;
+        len -= n;
+    }
+
+    while (len > 0)
+    {
+        if (dst != NULL)
+            nrecv = recv (sock, dst, len, 0);
+        else
+            nrecv = recv (sock, discard, len < sizeof (discard) ? len :
+                sizeof (discard), 0);
+        if (nrecv < 0 && errno == EINTR)
+            continue;
+        if (nrecv <= 0)
+            return (ERROR);
+        if (dst != NULL)
+            dst += nrecv;
+        len -= nrecv;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  recv_line
+
+PURPOSE:  Receives one CRLF-terminated line, used for the chunk sizes of a
+chunked response.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred receiving, or the line is too long
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static int recv_line
+(
+    int sock,                /* I: connected socket */
+    char **pending,          /* I/O: bytes read past the header */
+    size_t *npending,        /* I/O: number of pending bytes */
+    char *line,              /* O: line without the CRLF */
+    size_t size              /* I: size of line */
+)
+{
+    size_t len = 0;          /* length of the line */
+    char c;                  /* current character */
+
+    while (1)
+    {
+        if (recv_body (sock, pending, npending, &c, 1) != SUCCESS)
+            return (ERROR);
+        if (c == '\n')
+            break;
+        if (c != '\r')
+        {
+            if (len + 1 >= size)
+                return (ERROR);
+            line[len++] = c;
+        }
+    }
+    line[len] = '\0';
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  try_http_request
+
+PURPOSE:  Makes one attempt at an HTTP request on the connection.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred on the connection; the request may be retried
+SUCCESS    A response was received
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. See http_request.
+******************************************************************************/
+static int try_http_request
+(
+    Http_conn_t *conn,       /* I/O: connection to the host */
+    char *method,            /* I: request method */
+    char *path,              /* I: path and query to request */
+    char *headers,           /* I: additional header lines; NULL for none */
+    void *body,              /* I: request body; NULL for none */
+    size_t body_len,         /* I: size of the request body */
+    void *buf,               /* O: buffer for the response body; NULL to
+                                allocate resp->body */
+    size_t buf_size,         /* I: size of buf */
+    Http_response_t *resp    /* O: response */
+)
+{
+    char request[HTTP_HEADER_SIZE]; /* request line and header */
+    char value[STR_SIZE];    /* header value */
+    char line[64];           /* chunk size line */
+    char *pending = NULL;    /* body bytes read with the header */
+    char *end = NULL;        /* end of the response header */
+    char *dst = NULL;        /* destination for the body */
+    char *grown = NULL;      /* reallocated body */
+    size_t npending = 0;     /* number of body bytes read with the header */
+    size_t nhdr = 0;         /* number of header bytes received */
+    size_t chunk;            /* size of the current chunk */
+    size_t alloc = 0;        /* allocated size of the body */
+    ssize_t n;               /* number of bytes received by one call */
+    int len;                 /* length of the request header */
+    bool chunked = false;    /* is the body chunked? */
+    bool close_conn = false; /* will the server close the connection? */
+
+    if (conn->sock < 0 && connect_http (conn) != SUCCESS)
+        return (ERROR);
+
+    /* Send the request */
+    len = snprintf (request, sizeof (request), "%s %s HTTP/1.1\r\n"
+        "Host: %s:%d\r\nConnection: keep-alive\r\n", method, path,
+        conn->url.host, conn->url.port);
+    if (body != NULL || strcmp (method, "PUT") == 0 ||
+        strcmp (method, "POST") == 0)
+        len += snprintf (request + len, sizeof (request) - len,
+            "Content-Length: %zu\r\n", body_len);
+    len += snprintf (request + len, sizeof (request) - len, "%s\r\n",
+        headers != NULL ? headers : "");
+    if (len >= (int) sizeof (request))
+        return (ERROR);
+    if (send_all (conn->sock, request, len) != SUCCESS ||
+        (body_len > 0 && send_all (conn->sock, body, body_len) != SUCCESS))
+        return (ERROR);
+    conn->bytes_out += body_len;
+    conn->nrequest++;
+
+    /* Receive the response header */
+    while (1)
+    {
+        n = recv (conn->sock, resp->header + nhdr,
+            sizeof (resp->header) - 1 - nhdr, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return (ERROR);
+        nhdr += n;
+        resp->header[nhdr] = '\0';
+        end = strstr (resp->header, "\r\n\r\n");
+        if (end != NULL)
+            break;
+        if (nhdr >= sizeof (resp->header) - 1)
+            return (ERROR);
+    }
+    pending = end + 4;
+    npending = nhdr - (pending - resp->header);
+    end[2] = '\0';
+
+    if (sscanf (resp->header, "HTTP/%*d.%*d %d", &resp->status) != 1)
+        return (ERROR);
+    if (get_http_header (resp, "Content-Length", value, sizeof (value))
+        == SUCCESS)
+        resp->content_length = atoll (value);
+    if (get_http_header (resp, "Transfer-Encoding", value, sizeof (value))
+        == SUCCESS && strstr (value, "chunked") != NULL)
+        chunked = true;
+    if (get_http_header (resp, "Connection", value, sizeof (value))
+        == SUCCESS && !strcasecmp (value, "close"))
+        close_conn = true;
+
+    /* HEAD responses and 1xx/204/304 have no body */
+    if (!strcmp (method, "HEAD") || resp->status == 204 ||
+        resp->status == 304 || resp->status / 100 == 1)
+    {
+        if (close_conn)
+        {
+            close (conn->sock);
+            conn->sock = -1;
+        }
+        return (SUCCESS);
+    }
+
+    /* Receive the body */
+    if (chunked)
+    {
+        while (1)
+        {
+            if (recv_line (conn->sock, &pending, &npending, line,
+                sizeof (line)) != SUCCESS)
+                return (ERROR);
+            chunk = strtoul (line, NULL, 16);
+            if (chunk == 0)
+                break;
+
+            if (buf != NULL)
+            {
+                if (resp->body_len + chunk > buf_size)
+                    return (ERROR);
+                dst = (char *) buf + resp->body_len;
+            }
+            else
+            {
+                if (resp->body_len + chunk + 1 > alloc)
+                {
+                    alloc = 2 * (resp->body_len + chunk + 1);
+                    grown = realloc (resp->body, alloc);
+                    if (grown == NULL)
+                        return (ERROR);
+                    resp->body = grown;
+                }
+                dst = resp->body + resp->body_len;
+            }
+            if (recv_body (conn->sock, &pending, &npending, dst, chunk)
+                != SUCCESS ||
+                recv_line (conn->sock, &pending, &npending, line,
+                sizeof (line)) != SUCCESS)
+                return (ERROR);
+            resp->body_len += chunk;
+        }
+
+        /* Skip any trailer lines */
+        do
+        {
+            if (recv_line (conn->sock, &pending, &npending, line,
+                sizeof (line)) != SUCCESS)
+                return (ERROR);
+        } while (line[0] != '\0');
+    }
+    else if (resp->content_length >= 0)
+    {
+        if (buf != NULL)
+        {
+            if ((size_t) resp->content_length > buf_size)
+                return (ERROR);
+            dst = buf;
+        }
+        else
+        {
+            resp->body = malloc (resp->content_length + 1);
+            if (resp->body == NULL)
+                return (ERROR);
+            dst = resp->body;
+        }
+        if (recv_body (conn->sock, &pending, &npending, dst,
+            resp->content_length) != SUCCESS)
+            return (ERROR);
+        resp->body_len = resp->content_length;
+    }
+    else
+    {
+        /* Body runs to the end of the connection */
+        close_conn = true;
+        while (1)
+        {
+            if (buf == NULL && resp->body_len + 4097 > alloc)
+            {
+                alloc = 2 * (resp->body_len + 4097);
+                grown = realloc (resp->body, alloc);
+                if (grown == NULL)
+                    return (ERROR);
+                resp->body = grown;
+            }
+            if (buf != NULL && resp->body_len >= buf_size)
+                return (ERROR);
+            dst = (buf != NULL ? (char *) buf : resp->body) + resp->body_len;
+            if (npending > 0)
+            {
+                n = npending;
+                if (buf != NULL && resp->body_len + n > buf_size)
+                    return (ERROR);
+                memcpy (dst, pending, n);
+                npending = 0;
+            }
+            else
+            {
+                n = recv (conn->sock, dst, buf != NULL ?
+                    buf_size - resp->body_len : 4096, 0);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0)
+                    return (ERROR);
+                if (n == 0)
+                    break;
+            }
+            resp->body_len += n;
+        }
+    }
+    if (resp->body != NULL)
+        resp->body[resp->body_len] = '\0';
+    conn->bytes_in += resp->body_len;
+
+    if (close_conn)
+    {
+        close (conn->sock);
+        conn->sock = -1;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  http_request
+
+PURPOSE:  Makes an HTTP/1.1 request on a keep-alive connection and receives
+the response.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred on the connection after all retries
+SUCCESS    A response was received; check resp->status
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The response body goes into buf if it is given and large enough;
+     otherwise the request fails.  If buf is NULL, the body is allocated in
+     resp->body (NUL terminated) and the caller frees it.
+  2. Connection failures, including a stale keep-alive connection closed by
+     the server, are retried on a new connection up to HTTP_RETRIES times.
+******************************************************************************/
+int http_request
+(
+    Http_conn_t *conn,       /* I/O: connection to the host */
+    char *method,            /* I: request method (GET, HEAD, PUT, POST, ...) */
+    char *path,              /* I: path and query to request */
+    char *headers,           /* I: additional "Name: value\r\n" header lines;
+                                NULL for none */
+    void *body,              /* I: request body; NULL for none */
+    size_t body_len,         /* I: size of the request body */
+    void *buf,               /* O: buffer for the response body; NULL to
+                                allocate resp->body */
+    size_t buf_size,         /* I: size of buf */
+    Http_response_t *resp    /* O: response status, header, and body */
+)
+{
+    char FUNC_NAME[] = "http_request";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int attempt;              /* current attempt */
+
+    for (attempt = 0; attempt < HTTP_RETRIES; attempt++)
+    {
+        resp->status = 0;
+        resp->content_length = -1;
+        resp->header[0] = '\0';
+        resp->body = NULL;
+        resp->body_len = 0;
+
+        if (try_http_request (conn, method, path, headers, body, body_len,
+            buf, buf_size, resp) == SUCCESS)
+            return (SUCCESS);
+
+        free (resp->body);
+        resp->body = NULL;
+        if (conn->sock >= 0)
+        {
+            close (conn->sock);
+            conn->sock = -1;
+        }
+    }
+
+    snprintf (errmsg, sizeof (errmsg), "%s http://%.200s:%d%.700s failed",
+        method, conn->url.host, conn->url.port, path);
+    error_handler (true, FUNC_NAME, errmsg);
+    return (ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  get_http_header
+
+PURPOSE:  Finds the value of a header in a response.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      The header isn't in the response
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+int get_http_header
+(
+    Http_response_t *resp,   /* I: response */
+    char *name,              /* I: header name (case insensitive) */
+    char *value,             /* O: header value */
+    size_t size              /* I: size of value */
+)
+{
+    char *line = NULL;       /* current header line */
+    char *eol = NULL;        /* end of the current line */
+    size_t name_len = strlen (name);  /* length of the header name */
+    size_t len;              /* length of the value */
+
+    line = strstr (resp->header, "\r\n");
+    while (line != NULL && line[2] != '\0')
+    {
+        line += 2;
+        eol = strstr (line, "\r\n");
+        if (eol == NULL)
+            eol = line + strlen (line);
+        if (!strncasecmp (line, name, name_len) && line[name_len] == ':')
+        {
+            line += name_len + 1;
+            while (*line == ' ' || *line == '\t')
+                line++;
+            len = eol - line;
+            while (len > 0 && isspace ((unsigned char) line[len - 1]))
+                len--;
+            if (len >= size)
+                len = size - 1;
+            memcpy (value, line, len);
+            value[len] = '\0';
+            return (SUCCESS);
+        }
+        line = eol;
+        if (*line == '\0')
+            break;
+    }
+
+    return (ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  http_get_range
+
+PURPOSE:  Reads a byte range of an object with a Range request.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred reading the range
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The server must honor the range (206 Partial Content).  A 200 response
+     with the whole object is rejected rather than transferring it.
+******************************************************************************/
+int http_get_range
+(
+    Http_conn_t *conn,       /* I/O: connection to the host */
+    char *path,              /* I: path of the object */
+    long long offset,        /* I: first byte of the range */
+    size_t nbytes,           /* I: number of bytes in the range */
+    void *buf                /* O: nbytes of the object */
+)
+{
+    char FUNC_NAME[] = "http_get_range";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char range[STR_SIZE];     /* Range header */
+    Http_response_t resp;     /* response */
+
+    sprintf (range, "Range: bytes=%lld-%lld\r\n", offset,
+        offset + (long long) nbytes - 1);
+    if (http_request (conn, "GET", path, range, NULL, 0, buf, nbytes, &resp)
+        != SUCCESS)
+        return (ERROR);
+
+    if (resp.status != 206 || resp.body_len != nbytes)
+    {
+        sprintf (errmsg, "Range %lld-%lld of %.800s returned status %d with "
+            "%zu bytes", offset, offset + (long long) nbytes - 1, path,
+            resp.status, resp.body_len);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  http_get_size
+
+PURPOSE:  Gets the size of an object with a HEAD request.
+
+RETURN VALUE:
+Type = long long
+Value      Description
+-----      -----------
+-1         Error occurred, or the size isn't known
+>=0        Size of the object in bytes
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+long long http_get_size
+(
+    Http_conn_t *conn,       /* I/O: connection to the host */
+    char *path               /* I: path of the object */
+)
+{
+    char FUNC_NAME[] = "http_get_size";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Http_response_t resp;     /* response */
+
+    if (http_request (conn, "HEAD", path, NULL, NULL, 0, NULL, 0, &resp)
+        != SUCCESS)
+        return (-1);
+
+    if (resp.status != 200 || resp.content_length < 0)
+    {
+        sprintf (errmsg, "HEAD %.800s returned status %d", path, resp.status);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (-1);
+    }
+
+    return (resp.content_length);
+}
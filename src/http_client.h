@@ -0,0 +1,106 @@
+#ifndef _HTTP_CLIENT_H_
+#define _HTTP_CLIENT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "espa_metadata.h"
+
+/* Maximum size of a host name in a URL */
+#define HTTP_HOST_SIZE 256
+
+/* Maximum size of the HTTP response header */
+#define HTTP_HEADER_SIZE 16384
+
+/* Send/receive timeout for the connections, in seconds */
+#define HTTP_TIMEOUT_SECS 60
+
+/* Number of times a request is attempted when the connection fails */
+#define HTTP_RETRIES 3
+
+/* Parsed http:// URL */
+typedef struct {
+    char host[HTTP_HOST_SIZE]; /* host name or address */
+    int port;                /* TCP port; 80 if not specified */
+    char path[STR_SIZE];     /* path and query, starting with '/' */
+} Http_url_t;
+
+/* Keep-alive connection to one host */
+typedef struct {
+    Http_url_t url;          /* URL the connection was opened for */
+    int sock;                /* connected socket; -1 if not connected */
+    long long bytes_in;      /* number of body bytes received */
+    long long bytes_out;     /* number of body bytes sent */
+    long nrequest;           /* number of requests made */
+} Http_conn_t;
+
+/* Response to a request */
+typedef struct {
+    int status;              /* HTTP status code */
+    long long content_length; /* Content-Length; -1 if not given */
+    char header[HTTP_HEADER_SIZE]; /* response header lines */
+    char *body;              /* body, if it was allocated by http_request;
+                                the caller frees it */
+    size_t body_len;         /* number of body bytes received */
+} Http_response_t;
+
+/* Prototypes */
+bool is_http_url
+(
+    char *name               /* I: file name or URL */
+);
+
+int parse_http_url
+(
+    char *url,               /* I: http://host[:port]/path URL */
+    Http_url_t *parsed       /* O: parsed URL */
+);
+
+Http_conn_t *open_http_conn
+(
+    Http_url_t *url          /* I: URL of the host to connect to */
+);
+
+void close_http_conn
+(
+    Http_conn_t *conn        /* I: connection to close and free */
+);
+
+int http_request
+(
+    Http_conn_t *conn,       /* I/O: connection to the host */
+    char *method,            /* I: request method (GET, HEAD, PUT, POST, ...) */
+    char *path,              /* I: path and query to request */
+    char *headers,           /* I: additional "Name: value\r\n" header lines;
+                                NULL for none */
+    void *body,              /* I: request body; NULL for none */
+    size_t body_len,         /* I: size of the request body */
+    void *buf,               /* O: buffer for the response body; NULL to
+                                allocate resp->body */
+    size_t buf_size,         /* I: size of buf */
+    Http_response_t *resp    /* O: response status, header, and body */
+);
+
+int get_http_header
+(
+    Http_response_t *resp,   /* I: response */
+    char *name,              /* I: header name (case insensitive) */
+    char *value,             /* O: header value */
+    size_t size              /* I: size of value */
+);
+
+int http_get_range
+(
+    Http_conn_t *conn,       /* I/O: connection to the host */
+    char *path,              /* I: path of the object */
+    long long offset,        /* I: first byte of the range */
+    size_t nbytes,           /* I: number of bytes in the range */
+    void *buf                /* O: nbytes of the object */
+);
+
+long long http_get_size
+(
+    Http_conn_t *conn,       /* I/O: connection to the host */
+    char *path               /* I: path of the object */
+);
+
+#endif
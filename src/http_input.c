@@ -0,0 +1,405 @@
+#include "si.h"
+#include "http_input.h"
+
+/******************************************************************************
+MODULE:  open_http_file
+
+PURPOSE:  Sets up a remote band file for range reads through a bounded block
+cache.  The size of the object is checked with a HEAD request.
+
+RETURN VALUE:
+Type = Http_file_t*
+Value      Description
+-----      -----------
+NULL       Error occurred opening the remote file
+non-NULL   Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Use close_http_file to close the connection and free the cache.
+******************************************************************************/
+Http_file_t *open_http_file
+(
+    char *url,               /* I: URL of the band file */
+    int ncache               /* I: number of blocks to cache */
+)
+{
+    char FUNC_NAME[] = "open_http_file";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable for cache blocks */
+    Http_file_t *this = NULL; /* remote file to be returned */
+
+    this = calloc (1, sizeof (Http_file_t));
+    if (this == NULL)
+    {
+        sprintf (errmsg, "Allocating the remote file structure");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    pthread_mutex_init (&this->lock, NULL);
+    pthread_mutex_init (&this->conn_lock, NULL);
+    pthread_cond_init (&this->loaded, NULL);
+
+    this->url = strdup (url);
+    if (this->url == NULL || parse_http_url (url, &this->parsed) != SUCCESS)
+    {
+        close_http_file (this);
+        sprintf (errmsg, "Invalid band URL: %.900s", url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    this->conn = open_http_conn (&this->parsed);
+    if (this->conn == NULL)
+    {
+        close_http_file (this);
+        sprintf (errmsg, "Opening a connection for %.900s", url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    this->size = http_get_size (this->conn, this->parsed.path);
+    if (this->size < 0)
+    {
+        close_http_file (this);
+        sprintf (errmsg, "Unable to get the size of %.900s", url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    this->ncache = ncache;
+    this->cache = calloc (ncache, sizeof (Http_block_t));
+    if (this->cache == NULL)
+    {
+        close_http_file (this);
+        sprintf (errmsg, "Allocating the block cache for %.900s", url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    for (i = 0; i < ncache; i++)
+    {
+        this->cache[i].block = -1;
+        this->cache[i].state = HTTP_BLOCK_EMPTY;
+        this->cache[i].data = prof_malloc (PBUF_HTTP, HTTP_BLOCK_SIZE);
+        if (this->cache[i].data == NULL)
+        {
+            close_http_file (this);
+            sprintf (errmsg, "Allocating the block cache for %.900s", url);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+    }
+
+    return (this);
+}
+
+
+/******************************************************************************
+MODULE:  close_http_file
+
+PURPOSE:  Closes the connection and frees the block cache of a remote file.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void close_http_file
+(
+    Http_file_t *this        /* I: remote file to close and free */
+)
+{
+    int i;                    /* looping variable for cache blocks */
+
+    if (this == NULL)
+        return;
+
+    if (this->cache != NULL)
+    {
+        for (i = 0; i < this->ncache; i++)
+            free (this->cache[i].data);
+        free (this->cache);
+    }
+    close_http_conn (this->conn);
+    pthread_mutex_destroy (&this->lock);
+    pthread_mutex_destroy (&this->conn_lock);
+    pthread_cond_destroy (&this->loaded);
+    free (this->url);
+    free (this);
+}
+
+
+/******************************************************************************
+MODULE:  find_http_block
+
+PURPOSE:  Finds a block in the cache.
+
+RETURN VALUE:
+Type = Http_block_t*
+Value      Description
+-----      -----------
+NULL       The block isn't cached or loading
+non-NULL   Cache entry for the block
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The caller holds the cache lock.
+******************************************************************************/
+static Http_block_t *find_http_block
+(
+    Http_file_t *this,       /* I: remote file */
+    long long block          /* I: block number */
+)
+{
+    int i;                    /* looping variable for cache blocks */
+
+    for (i = 0; i < this->ncache; i++)
+    {
+        if (this->cache[i].block == block &&
+            this->cache[i].state != HTTP_BLOCK_EMPTY)
+            return (&this->cache[i]);
+    }
+
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE:  fetch_http_blocks
+
+PURPOSE:  Makes sure the blocks covering a byte range are in the cache,
+fetching the missing ones with range requests.  Used both for the strip being
+read and for read-ahead of the next strip.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred fetching a block
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The least recently used block that isn't loading is replaced.  Blocks
+     are marked loading while the request is outstanding so other threads
+     wait for them rather than fetching them again.
+  2. Safe to call from several threads for the same file; the requests on
+     the file's connection are serialized.
+******************************************************************************/
+int fetch_http_blocks
+(
+    Http_file_t *this,       /* I/O: remote file */
+    long long offset,        /* I: first byte needed */
+    size_t nbytes            /* I: number of bytes needed */
+)
+{
+    char FUNC_NAME[] = "fetch_http_blocks";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    long long block;          /* current block number */
+    long long last_block;     /* last block needed */
+    long long start;          /* first byte of the current block */
+    int i;                    /* looping variable for cache blocks */
+    int status;               /* return status */
+    Http_block_t *entry = NULL;  /* cache entry for the current block */
+
+    if (nbytes == 0)
+        return (SUCCESS);
+    if (offset + (long long) nbytes > this->size)
+        nbytes = this->size - offset;
+
+    last_block = (offset + nbytes - 1) / HTTP_BLOCK_SIZE;
+    for (block = offset / HTTP_BLOCK_SIZE; block <= last_block; block++)
+    {
+        /* Claim the least recently used entry unless the block is already
+           cached or on its way */
+        pthread_mutex_lock (&this->lock);
+        if (find_http_block (this, block) != NULL)
+        {
+            pthread_mutex_unlock (&this->lock);
+            continue;
+        }
+        entry = NULL;
+        for (i = 0; i < this->ncache; i++)
+        {
+            if (this->cache[i].state == HTTP_BLOCK_LOADING)
+                continue;
+            if (entry == NULL ||
+                this->cache[i].last_used < entry->last_used)
+                entry = &this->cache[i];
+        }
+        if (entry == NULL)
+        {
+            pthread_mutex_unlock (&this->lock);
+            sprintf (errmsg, "No free block in the cache for %.900s",
+                this->url);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        entry->block = block;
+        entry->state = HTTP_BLOCK_LOADING;
+        entry->last_used = ++this->nuse;
+        pthread_mutex_unlock (&this->lock);
+
+        /* Fetch the block straight into the cache entry */
+        start = block * HTTP_BLOCK_SIZE;
+        entry->len = (this->size - start < HTTP_BLOCK_SIZE) ?
+            this->size - start : HTTP_BLOCK_SIZE;
+        pthread_mutex_lock (&this->conn_lock);
+        status = http_get_range (this->conn, this->parsed.path, start,
+            entry->len, entry->data);
+        pthread_mutex_unlock (&this->conn_lock);
+
+        pthread_mutex_lock (&this->lock);
+        if (status == SUCCESS)
+        {
+            entry->state = HTTP_BLOCK_VALID;
+            this->bytes_fetched += entry->len;
+            metric_add (this->fetch_bytes, entry->len);
+        }
+        else
+        {
+            entry->state = HTTP_BLOCK_EMPTY;
+            entry->block = -1;
+        }
+        pthread_cond_broadcast (&this->loaded);
+        pthread_mutex_unlock (&this->lock);
+
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Fetching block %lld of %.900s", block,
+                this->url);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_http_file
+
+PURPOSE:  Reads a byte range of a remote file, from the block cache where
+possible.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred reading the range
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Small reads which aren't already cached are fetched with an exact range
+     request and bypass the cache.
+  2. If a block is loading in another thread the read waits for it; if a
+     block was evicted before it could be copied, it is fetched again.
+******************************************************************************/
+int read_http_file
+(
+    Http_file_t *this,       /* I/O: remote file */
+    long long offset,        /* I: first byte to read */
+    size_t nbytes,           /* I: number of bytes to read */
+    void *buf                /* O: nbytes of the file */
+)
+{
+    char FUNC_NAME[] = "read_http_file";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *dst = buf;          /* next byte of buf to fill */
+    long long pos = offset;   /* next byte of the file to copy */
+    long long end = offset + nbytes;  /* end of the range */
+    long long block;          /* block holding pos */
+    size_t skip;              /* offset of pos in its block */
+    size_t n;                 /* number of bytes copied from the block */
+    int status;               /* return status */
+    Http_block_t *entry = NULL;  /* cache entry for the block */
+
+    if (end > this->size)
+    {
+        sprintf (errmsg, "Reading past the end of %.900s", this->url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Fetch small, uncached reads exactly */
+    if (nbytes < HTTP_SMALL_READ)
+    {
+        pthread_mutex_lock (&this->lock);
+        entry = find_http_block (this, offset / HTTP_BLOCK_SIZE);
+        if (entry == NULL || entry->block !=
+            (end - 1) / HTTP_BLOCK_SIZE)
+            entry = NULL;
+        pthread_mutex_unlock (&this->lock);
+        if (entry == NULL)
+        {
+            pthread_mutex_lock (&this->conn_lock);
+            status = http_get_range (this->conn, this->parsed.path, offset,
+                nbytes, buf);
+            pthread_mutex_unlock (&this->conn_lock);
+            if (status != SUCCESS)
+            {
+                sprintf (errmsg, "Reading %zu bytes at %lld of %.900s",
+                    nbytes, offset, this->url);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            pthread_mutex_lock (&this->lock);
+            this->bytes_fetched += nbytes;
+            pthread_mutex_unlock (&this->lock);
+            metric_add (this->fetch_bytes, nbytes);
+            return (SUCCESS);
+        }
+    }
+
+    while (pos < end)
+    {
+        block = pos / HTTP_BLOCK_SIZE;
+
+        pthread_mutex_lock (&this->lock);
+        entry = find_http_block (this, block);
+        while (entry != NULL && entry->state == HTTP_BLOCK_LOADING)
+        {
+            pthread_cond_wait (&this->loaded, &this->lock);
+            entry = find_http_block (this, block);
+        }
+        if (entry == NULL)
+        {
+            /* Not cached; fetch the rest of the range and try again */
+            pthread_mutex_unlock (&this->lock);
+            if (fetch_http_blocks (this, pos, end - pos) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading %zu bytes at %lld of %.900s",
+                    nbytes, offset, this->url);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            continue;
+        }
+
+        skip = pos - block * HTTP_BLOCK_SIZE;
+        n = entry->len - skip;
+        if ((long long) n > end - pos)
+            n = end - pos;
+        memcpy (dst, entry->data + skip, n);
+        entry->last_used = ++this->nuse;
+        pthread_mutex_unlock (&this->lock);
+
+        dst += n;
+        pos += n;
+    }
+
+    return (SUCCESS);
+}
@@ -0,0 +1,76 @@
+#ifndef _HTTP_INPUT_H_
+#define _HTTP_INPUT_H_
+
+#include <pthread.h>
+#include "http_client.h"
+#include "metrics.h"
+
+/* Size of the blocks fetched and cached for each remote band */
+#define HTTP_BLOCK_SIZE (1024 * 1024)
+
+/* Default memory budget for the remote block caches, in megabytes */
+#define HTTP_CACHE_MB 256
+
+/* Reads smaller than this are fetched with an exact range request and not
+   cached, so sparse reads such as the pre-scan don't pull whole blocks */
+#define HTTP_SMALL_READ (HTTP_BLOCK_SIZE / 4)
+
+/* Block states */
+#define HTTP_BLOCK_EMPTY 0
+#define HTTP_BLOCK_LOADING 1
+#define HTTP_BLOCK_VALID 2
+
+/* One cached block of a remote band */
+typedef struct {
+    long long block;         /* block number in the object; -1 if unused */
+    int state;               /* HTTP_BLOCK_EMPTY, LOADING, or VALID */
+    unsigned long last_used; /* access counter value when last used */
+    size_t len;              /* number of valid bytes (short at the end) */
+    char *data;              /* HTTP_BLOCK_SIZE bytes */
+} Http_block_t;
+
+/* Remote band file read with range requests through a block cache */
+typedef struct {
+    char *url;               /* URL of the band file */
+    Http_url_t parsed;       /* parsed URL */
+    Http_conn_t *conn;       /* keep-alive connection for the band */
+    pthread_mutex_t conn_lock; /* serializes the requests on conn */
+    long long size;          /* size of the object in bytes */
+    int ncache;              /* number of blocks in the cache */
+    Http_block_t *cache;     /* LRU block cache */
+    unsigned long nuse;      /* access counter for the LRU cache */
+    pthread_mutex_t lock;    /* protects the cache */
+    pthread_cond_t loaded;   /* signaled when a block finishes loading */
+    long long bytes_fetched; /* number of bytes transferred */
+    Metric_t *fetch_bytes;   /* counter of the bytes transferred; NULL if
+                                not exported */
+} Http_file_t;
+
+/* Prototypes */
+Http_file_t *open_http_file
+(
+    char *url,               /* I: URL of the band file */
+    int ncache               /* I: number of blocks to cache */
+);
+
+void close_http_file
+(
+    Http_file_t *this        /* I: remote file to close and free */
+);
+
+int fetch_http_blocks
+(
+    Http_file_t *this,       /* I/O: remote file */
+    long long offset,        /* I: first byte needed */
+    size_t nbytes            /* I: number of bytes needed */
+);
+
+int read_http_file
+(
+    Http_file_t *this,       /* I/O: remote file */
+    long long offset,        /* I: first byte to read */
+    size_t nbytes,           /* I: number of bytes to read */
+    void *buf                /* O: nbytes of the file */
+);
+
+#endif
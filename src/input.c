@@ -1,5 +1,175 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "si.h"
 #include "input.h"
 
+/******************************************************************************
+MODULE:  get_landsat_bands
+
+PURPOSE:  Returns the reflective band numbers of a Landsat instrument and
+their nominal center wavelengths.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+0          Unsupported instrument
+n          Number of reflective bands
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static int get_landsat_bands
+(
+    char *instrument,    /* I: instrument from the global metadata */
+    int band_num[NBAND_LANDSAT_MAX],  /* O: band number of each band */
+    float wavelength[NBAND_LANDSAT_MAX]  /* O: center wavelength (nm) of
+                                            each band */
+)
+{
+    static int tm_num[] = {1, 2, 3, 4, 5, 7};
+    static float tm_wl[] = {485.0, 560.0, 660.0, 830.0, 1650.0, 2215.0};
+    static float etm_wl[] = {478.0, 560.0, 661.0, 835.0, 1650.0, 2208.0};
+    static int oli_num[] = {1, 2, 3, 4, 5, 6, 7};
+    static float oli_wl[] = {443.0, 482.0, 561.0, 655.0, 865.0, 1609.0,
+        2201.0};
+    int ib;              /* looping variable for bands */
+
+    if (!strcmp (instrument, "TM"))
+    {
+        for (ib = 0; ib < 6; ib++)
+        {
+            band_num[ib] = tm_num[ib];
+            wavelength[ib] = tm_wl[ib];
+        }
+        return (6);
+    }
+    else if (!strncmp (instrument, "ETM", 3))
+    {
+        for (ib = 0; ib < 6; ib++)
+        {
+            band_num[ib] = tm_num[ib];
+            wavelength[ib] = etm_wl[ib];
+        }
+        return (6);
+    }
+    else if (!strcmp (instrument, "OLI_TIRS") || !strcmp (instrument, "OLI"))
+    {
+        for (ib = 0; ib < 7; ib++)
+        {
+            band_num[ib] = oli_num[ib];
+            wavelength[ib] = oli_wl[ib];
+        }
+        return (7);
+    }
+
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  select_index_bands
+
+PURPOSE:  Picks the offered bands closest to the wavelengths the specified
+index needs, and assigns each one a reflectance buffer.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      No suitable band for the index, or too many bands to read
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Bands already assigned a buffer for another index are shared.
+  2. The input bands of an index must be distinct bands, so an index whose
+     wavelengths fall in the same broad band isn't computed.
+******************************************************************************/
+static int select_index_bands
+(
+    Input_t *this,       /* I/O: pointer to input data structure */
+    Mysi_list_t si       /* I: spectral index */
+)
+{
+    char FUNC_NAME[] = "select_index_bands";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    float wavelength[MAX_SI_BANDS]; /* center wavelength of each index band */
+    float tolerance[MAX_SI_BANDS];  /* farthest acceptable band center */
+    int cat[MAX_SI_BANDS];    /* offered band picked for each index band */
+    int nband;                /* number of index bands */
+    int i, j;                 /* looping variables for index bands */
+    int ib;                   /* looping variable for offered bands */
+
+    nband = get_index_wavelengths (si, wavelength, tolerance);
+    for (i = 0; i < nband; i++)
+    {
+        cat[i] = -1;
+        for (ib = 0; ib < this->ncat_band; ib++)
+        {
+            if (cat[i] == -1 || fabs (this->cat_wavelength[ib] -
+                wavelength[i]) < fabs (this->cat_wavelength[cat[i]] -
+                wavelength[i]))
+                cat[i] = ib;
+        }
+        if (cat[i] == -1 || fabs (this->cat_wavelength[cat[i]] -
+            wavelength[i]) > tolerance[i])
+        {
+            sprintf (errmsg, "No band within %g nm of the %g nm needed for "
+                "the %s", tolerance[i], wavelength[i], si_upper_name (si));
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        for (j = 0; j < i; j++)
+        {
+            if (cat[j] == cat[i])
+            {
+                sprintf (errmsg, "The %g and %g nm bands of the %s fall in "
+                    "the same input band", wavelength[j], wavelength[i],
+                    si_upper_name (si));
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+
+    /* Share the buffers of bands already being read */
+    for (i = 0; i < nband; i++)
+    {
+        for (ib = 0; ib < this->nrefl_band; ib++)
+        {
+            if (this->cat_band[ib] == cat[i])
+                break;
+        }
+        if (ib == this->nrefl_band)
+        {
+            if (this->nrefl_band == NBAND_REFL_MAX)
+            {
+                sprintf (errmsg, "More than %d bands are needed for the "
+                    "requested indices", NBAND_REFL_MAX);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            this->cat_band[this->nrefl_band++] = cat[i];
+        }
+        this->index_band[si][i] = ib;
+    }
+    this->index_nband[si] = nband;
+
+    return (SUCCESS);
+}
+
+
 /******************************************************************************
 MODULE:  open_input
 
@@ -23,12 +193,39 @@ NOTES:
      for pointers in the input structure.  It is up to the caller to use
      close_input and free_input to close the files and free up the memory when
      done using the input data structure.
+  2. If a shared-memory ring is specified, the band files are not opened and
+     no reflectance buffer is allocated.  The refl_buf pointers are set to the
+     band planes of the shared slot for each strip by get_input_refl_lines.
+     See shm_ring.h for the protocol.  All the Landsat bands are in the ring,
+     so all of them are assigned buffers, in band order.
+  3. Band file names which are http:// URLs are read with range requests
+     through a block cache (see http_input.c).  The http_cache_mb budget is
+     split between the remote bands, but each band always gets room for two
+     strips so the read-ahead of the next strip doesn't evict the current
+     one.
+  4. The 8-bit Level-1 DN bands (b1-b5 and b7) are only available for TM and
+     ETM+.  They are read into dn_buf, and no reflectance buffer is
+     allocated for them; see widen_input_dn for the bands the int16 kernels
+     need.
+  5. The bands offered by the scene are the Landsat reflective bands, at
+     their nominal center wavelengths, or the bands of a multi-band cube
+     (see cube_header.h) at the wavelengths in its ENVI header.  Each index
+     uses the offered bands closest to the wavelengths it needs (see
+     get_index_wavelengths), and only those bands are opened and read.
 ******************************************************************************/
 Input_t *open_input
 (
     Espa_internal_meta_t *metadata,     /* I: input metadata */
-    bool toa         /* I: are we processing TOA reflectance data, otherwise
+    bool toa,        /* I: are we processing TOA reflectance data, otherwise
                            process surface reflectance data */
+    bool dn,         /* I: are we processing the 8-bit Level-1 DN bands
+                           instead of either reflectance product? */
+    bool si_flag[NUM_SI], /* I: indices to be computed; only the bands they
+                           use are read */
+    char *shm_name,  /* I: name of the shared-memory ring to read the strips
+                           from; NULL to read the band files */
+    int http_cache_mb  /* I: memory budget for the remote band block caches,
+                           in megabytes */
 )
 {
     char FUNC_NAME[] = "open_input";   /* function name */
@@ -36,10 +233,24 @@ Input_t *open_input
     Input_t *this = NULL;     /* input data structure to be initialized,
                                  populated, and returned to the caller */
     int ib;                   /* loop counter for bands */
+    int k;                    /* loop counter for the offered bands */
+    int si;                   /* loop counter for the indices */
     int refl_indx = -1;       /* band index in XML file for the reflectance
                                  band */
+    int band_num[NBAND_LANDSAT_MAX]; /* Landsat band numbers */
+    int band_xml[NBAND_LANDSAT_MAX]; /* XML band index of each Landsat band;
+                                 -1 if missing */
+    float band_wl[NBAND_LANDSAT_MAX]; /* Landsat band center wavelengths */
+    char band_name[STR_SIZE]; /* name of a band in the XML file */
+    char *cube_name = NULL;   /* name of the cube band in the XML file */
+    char *product = NULL;     /* reflectance product in the XML file */
+    size_t pix_bytes;         /* bytes per input pixel */
+    int nremote = 0;          /* number of remote bands */
+    int ncache = 0;           /* number of cached blocks per remote band */
+    int strip_blocks;         /* number of blocks spanned by one strip */
     int16 *buf = NULL;        /* temporary buffer to allocate memory for
                                  the reflectance bands */
+    Cube_header_t cube_hdr;   /* ENVI header of the cube */
     Espa_global_meta_t *gmeta = &metadata->global; /* pointer to global meta */
   
     /* Create the Input data structure */
@@ -53,183 +264,153 @@ Input_t *open_input
 
     /* Initialize the input pointers */
     this->refl_open = false;
+    this->nrefl_band = 0;
+    this->ncat_band = 0;
+    this->cat_wavelength = NULL;
+    this->cube = false;
+    this->cube_bil = false;
+    this->cube_offset = 0;
+    this->shm = NULL;
+    this->shm_size = 0;
+    this->shm_strip = -1;
+    this->io_limit = NULL;
+    this->http = false;
+    this->ahead_active = false;
+    this->follow = false;
+    this->follow_fd = -1;
+    this->follow_timeout = 0.0;
+    this->dn = dn;
+    pix_bytes = dn ? sizeof (uint8) : sizeof (int16);
     for (ib = 0; ib < NBAND_REFL_MAX; ib++)
     {
+        this->http_file[ib] = NULL;
         this->file_name[ib] = NULL;
         this->fp_bin[ib] = NULL;
         this->refl_buf[ib] = NULL;
+        this->dn_buf[ib] = NULL;
+        this->dn_widen[ib] = false;
     }
+    for (si = 0; si < NUM_SI; si++)
+        this->index_nband[si] = 0;
 
-    /* Initialize the input fields using information from the metadata
-       structure */
-    if (!strcmp (gmeta->instrument, "TM") ||
-        !strncmp (gmeta->instrument, "ETM", 3))
-    {
-        this->nrefl_band = 6;     /* number of reflectance bands */
-        this->refl_band[0] = 1;
-        this->refl_band[1] = 2;
-        this->refl_band[2] = 3;
-        this->refl_band[3] = 4;
-        this->refl_band[4] = 5;
-        this->refl_band[5] = 7;
-    }
-    else if (!strcmp (gmeta->instrument, "OLI_TIRS") ||
-             !strcmp (gmeta->instrument, "OLI"))
-    {
-        this->nrefl_band = 7;     /* number of reflectance bands */
-        this->refl_band[0] = 1;
-        this->refl_band[1] = 2;
-        this->refl_band[2] = 3;
-        this->refl_band[3] = 4;
-        this->refl_band[4] = 5;
-        this->refl_band[5] = 6;
-        this->refl_band[6] = 7;
-    }
-    else
+    /* Look for a multi-band cube of the reflectance product */
+    cube_name = toa ? CUBE_TOA_NAME : CUBE_SR_NAME;
+    product = toa ? "toa_refl" : "sr_refl";
+    for (ib = 0; ib < metadata->nbands && !dn; ib++)
     {
-        free_input (this);
-        sprintf (errmsg, "Unsupported instrument type.  Currently only "
-            "TM, ETM+, OLI, and OLI_TIRS are supported");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (NULL);
+        if (!strcmp (metadata->band[ib].name, cube_name) &&
+            !strcmp (metadata->band[ib].product, product))
+        {
+            refl_indx = ib;
+            this->cube = true;
+            break;
+        }
     }
 
-    /* If processing TOA bands, then grab the toa_refl product bands.
-       Otherwise grab the surface reflectance bands. */
-    if (toa)
+    if (this->cube)
     {
-        if (!strcmp (gmeta->instrument, "TM") ||
-            !strncmp (gmeta->instrument, "ETM", 3))
+        /* The bands are offered at the wavelengths in the cube header */
+        if (shm_name != NULL)
         {
-            for (ib = 0; ib < metadata->nbands; ib++)
-            {
-                if (!strcmp (metadata->band[ib].name, "toa_band1") &&
-                    !strcmp (metadata->band[ib].product, "toa_refl"))
-                {
-                    /* this is the index we'll use for reflectance band info */
-                    refl_indx = ib;
-                    this->file_name[0] = strdup (metadata->band[ib].file_name);
-                }
-                else if (!strcmp (metadata->band[ib].name, "toa_band2") &&
-                    !strcmp (metadata->band[ib].product, "toa_refl"))
-                    this->file_name[1] = strdup (metadata->band[ib].file_name);
-                else if (!strcmp (metadata->band[ib].name, "toa_band3") &&
-                    !strcmp (metadata->band[ib].product, "toa_refl"))
-                    this->file_name[2] = strdup (metadata->band[ib].file_name);
-                else if (!strcmp (metadata->band[ib].name, "toa_band4") &&
-                    !strcmp (metadata->band[ib].product, "toa_refl"))
-                    this->file_name[3] = strdup (metadata->band[ib].file_name);
-                else if (!strcmp (metadata->band[ib].name, "toa_band5") &&
-                    !strcmp (metadata->band[ib].product, "toa_refl"))
-                    this->file_name[4] = strdup (metadata->band[ib].file_name);
-                else if (!strcmp (metadata->band[ib].name, "toa_band7") &&
-                    !strcmp (metadata->band[ib].product, "toa_refl"))
-                    this->file_name[5] = strdup (metadata->band[ib].file_name);
-            }  /* for ib */
-        }
-        else if (!strcmp (gmeta->instrument, "OLI_TIRS") ||
-                 !strcmp (gmeta->instrument, "OLI"))
+            free_input (this);
+            sprintf (errmsg, "Multi-band cubes can't be read from the "
+                "shared-memory ring");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+        if (read_cube_header (metadata->band[refl_indx].file_name,
+            &cube_hdr) != SUCCESS)
         {
-            for (ib = 0; ib < metadata->nbands; ib++)
-            {
-                if (!strcmp (metadata->band[ib].name, "toa_band1") &&
-                    !strcmp (metadata->band[ib].product, "toa_refl"))
-                {
-                    /* this is the index we'll use for reflectance band info */
-                    refl_indx = ib;
-                    this->file_name[0] = strdup (metadata->band[ib].file_name);
-                }
-                else if (!strcmp (metadata->band[ib].name, "toa_band2") &&
-                    !strcmp (metadata->band[ib].product, "toa_refl"))
-                    this->file_name[1] = strdup (metadata->band[ib].file_name);
-                else if (!strcmp (metadata->band[ib].name, "toa_band3") &&
-                    !strcmp (metadata->band[ib].product, "toa_refl"))
-                    this->file_name[2] = strdup (metadata->band[ib].file_name);
-                else if (!strcmp (metadata->band[ib].name, "toa_band4") &&
-                    !strcmp (metadata->band[ib].product, "toa_refl"))
-                    this->file_name[3] = strdup (metadata->band[ib].file_name);
-                else if (!strcmp (metadata->band[ib].name, "toa_band5") &&
-                    !strcmp (metadata->band[ib].product, "toa_refl"))
-                    this->file_name[4] = strdup (metadata->band[ib].file_name);
-                else if (!strcmp (metadata->band[ib].name, "toa_band6") &&
-                    !strcmp (metadata->band[ib].product, "toa_refl"))
-                    this->file_name[5] = strdup (metadata->band[ib].file_name);
-                else if (!strcmp (metadata->band[ib].name, "toa_band7") &&
-                    !strcmp (metadata->band[ib].product, "toa_refl"))
-                    this->file_name[6] = strdup (metadata->band[ib].file_name);
-            }  /* for ib */
+            free_input (this);
+            snprintf (errmsg, sizeof (errmsg), "Reading the header of the "
+                "cube %.900s", metadata->band[refl_indx].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+        this->ncat_band = cube_hdr.nbands;
+        this->cat_wavelength = cube_hdr.wavelength;
+        this->cube_bil = cube_hdr.bil;
+        this->cube_offset = cube_hdr.header_offset;
+        if (cube_hdr.nlines != metadata->band[refl_indx].nlines ||
+            cube_hdr.nsamps != metadata->band[refl_indx].nsamps)
+        {
+            free_input (this);
+            sprintf (errmsg, "The size of the cube header doesn't match the "
+                "XML file");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
         }
     }
     else
     {
-        if (!strcmp (gmeta->instrument, "TM") ||
-            !strncmp (gmeta->instrument, "ETM", 3))
+        /* The Landsat reflective bands are offered at their nominal
+           wavelengths */
+        this->ncat_band = get_landsat_bands (gmeta->instrument, band_num,
+            band_wl);
+        if (this->ncat_band == 0)
         {
-            for (ib = 0; ib < metadata->nbands; ib++)
-            {
-                if (!strcmp (metadata->band[ib].name, "sr_band1") &&
-                    !strcmp (metadata->band[ib].product, "sr_refl"))
-                {
-                    /* this is the index we'll use for reflectance band info */
-                    refl_indx = ib;
-                    this->file_name[0] = strdup (metadata->band[ib].file_name);
-                }
-                else if (!strcmp (metadata->band[ib].name, "sr_band2") &&
-                    !strcmp (metadata->band[ib].product, "sr_refl"))
-                    this->file_name[1] = strdup (metadata->band[ib].file_name);
-                else if (!strcmp (metadata->band[ib].name, "sr_band3") &&
-                    !strcmp (metadata->band[ib].product, "sr_refl"))
-                    this->file_name[2] = strdup (metadata->band[ib].file_name);
-                else if (!strcmp (metadata->band[ib].name, "sr_band4") &&
-                    !strcmp (metadata->band[ib].product, "sr_refl"))
-                    this->file_name[3] = strdup (metadata->band[ib].file_name);
-                else if (!strcmp (metadata->band[ib].name, "sr_band5") &&
-                    !strcmp (metadata->band[ib].product, "sr_refl"))
-                    this->file_name[4] = strdup (metadata->band[ib].file_name);
-                else if (!strcmp (metadata->band[ib].name, "sr_band7") &&
-                    !strcmp (metadata->band[ib].product, "sr_refl"))
-                    this->file_name[5] = strdup (metadata->band[ib].file_name);
-            }  /* for ib */
-        }
-        else if (!strcmp (gmeta->instrument, "OLI_TIRS") ||
-                 !strcmp (gmeta->instrument, "OLI"))
+            free_input (this);
+            sprintf (errmsg, "Unsupported instrument type.  Currently only "
+                "TM, ETM+, OLI, and OLI_TIRS are supported, or multi-band "
+                "cubes listed as %s", cube_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+        if (dn && (this->ncat_band != 6 || shm_name != NULL))
+        {
+            free_input (this);
+            sprintf (errmsg, "The 8-bit DN bands are only supported for TM "
+                "and ETM+, read from the band files");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+        this->cat_wavelength = malloc (this->ncat_band * sizeof (float));
+        if (this->cat_wavelength == NULL)
+        {
+            free_input (this);
+            sprintf (errmsg, "Allocating the band wavelengths");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+
+        /* If processing the DN bands, then grab the 8-bit Level-1 bands.  If
+           processing TOA bands, then grab the toa_refl product bands.
+           Otherwise grab the surface reflectance bands. */
+        for (k = 0; k < this->ncat_band; k++)
         {
+            this->cat_wavelength[k] = band_wl[k];
+            if (dn)
+                sprintf (band_name, "b%d", band_num[k]);
+            else
+                sprintf (band_name, "%s_band%d", toa ? "toa" : "sr",
+                    band_num[k]);
+
+            band_xml[k] = -1;
             for (ib = 0; ib < metadata->nbands; ib++)
             {
-                if (!strcmp (metadata->band[ib].name, "sr_band1") &&
-                    !strcmp (metadata->band[ib].product, "sr_refl"))
+                if (strcmp (metadata->band[ib].name, band_name))
+                    continue;
+                if ((dn && metadata->band[ib].data_type == ESPA_UINT8) ||
+                    (!dn && !strcmp (metadata->band[ib].product, product)))
                 {
-                    /* this is the index we'll use for reflectance band info */
-                    refl_indx = ib;
-                    this->file_name[0] = strdup (metadata->band[ib].file_name);
+                    band_xml[k] = ib;
+                    break;
                 }
-                else if (!strcmp (metadata->band[ib].name, "sr_band2") &&
-                    !strcmp (metadata->band[ib].product, "sr_refl"))
-                    this->file_name[1] = strdup (metadata->band[ib].file_name);
-                else if (!strcmp (metadata->band[ib].name, "sr_band3") &&
-                    !strcmp (metadata->band[ib].product, "sr_refl"))
-                    this->file_name[2] = strdup (metadata->band[ib].file_name);
-                else if (!strcmp (metadata->band[ib].name, "sr_band4") &&
-                    !strcmp (metadata->band[ib].product, "sr_refl"))
-                    this->file_name[3] = strdup (metadata->band[ib].file_name);
-                else if (!strcmp (metadata->band[ib].name, "sr_band5") &&
-                    !strcmp (metadata->band[ib].product, "sr_refl"))
-                    this->file_name[4] = strdup (metadata->band[ib].file_name);
-                else if (!strcmp (metadata->band[ib].name, "sr_band6") &&
-                    !strcmp (metadata->band[ib].product, "sr_refl"))
-                    this->file_name[5] = strdup (metadata->band[ib].file_name);
-                else if (!strcmp (metadata->band[ib].name, "sr_band7") &&
-                    !strcmp (metadata->band[ib].product, "sr_refl"))
-                    this->file_name[6] = strdup (metadata->band[ib].file_name);
-            }  /* for ib */
+            }
         }
+
+        /* Band 1 is the one we'll use for the reflectance band info */
+        refl_indx = band_xml[0];
     }
 
     /* Make sure we found the bands */
     if (refl_indx == -1)
     {
         free_input (this);
-        if (toa)
+        if (dn)
+            sprintf (errmsg, "Unable to find the 8-bit Level-1 DN bands in "
+                "the XML file.");
+        else if (toa)
             sprintf (errmsg, "Unable to find the TOA reflectance bands in the "
                 "XML file.");
         else
@@ -247,10 +428,123 @@ Input_t *open_input
     this->refl_fill = metadata->band[refl_indx].fill_value;
     this->refl_scale_fact = metadata->band[refl_indx].scale_factor;
     this->refl_saturate_val = metadata->band[refl_indx].saturate_value;
+    if (dn)
+    {
+        /* The kernels take unscaled 0.0-1.0 values, and the fill and
+           saturation values must be ones a byte can hold */
+        this->refl_scale_fact = DN_SCALE_FACT;
+        if (this->refl_fill < 0 || this->refl_fill > 255)
+            this->refl_fill = DN_FILL;
+        if (this->refl_saturate_val < 0 || this->refl_saturate_val > 255)
+            this->refl_saturate_val = DN_SATURATE;
+    }
+
+    /* Pick the bands for each requested index.  The ring carries every
+       band, so they all get buffers, in band order. */
+    if (shm_name != NULL)
+    {
+        for (k = 0; k < this->ncat_band; k++)
+            this->cat_band[this->nrefl_band++] = k;
+    }
+    for (si = 0; si < NUM_SI; si++)
+    {
+        if (si_flag[si] && select_index_bands (this, si) != SUCCESS)
+        {
+            free_input (this);
+            sprintf (errmsg, "Selecting the input bands for the %s",
+                si_upper_name (si));
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+    }
+
+    /* Get the file of each band to be read */
+    for (ib = 0; ib < this->nrefl_band; ib++)
+    {
+        if (this->cube)
+            k = refl_indx;
+        else
+            k = band_xml[this->cat_band[ib]];
+        if (k == -1)
+        {
+            free_input (this);
+            sprintf (errmsg, "Unable to find band %d in the XML file.",
+                band_num[this->cat_band[ib]]);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+        this->file_name[ib] = strdup (metadata->band[k].file_name);
+
+        /* Validate the input data type, for the bands of the shared-memory
+           ring as well; the DN bands were matched by type */
+        if (!dn && metadata->band[k].data_type != ESPA_INT16)
+        {
+            free_input (this);
+            sprintf (errmsg, "Input data type is assumed to be int16, but "
+                "the data in the XML file for the reflectance bands doesn't "
+                "match this data type.");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+    }
+
+    /* If the strips are coming from an upstream producer, attach to the
+       shared-memory ring instead of opening the band files */
+    if (shm_name != NULL)
+    {
+        if (open_shm_input (this, shm_name) != SUCCESS)
+        {
+            free_input (this);
+            sprintf (errmsg, "Attaching to the shared-memory ring: %s",
+                shm_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+        this->refl_open = true;
+        return (this);
+    }
+
+    /* Size the block caches for the remote bands */
+    for (ib = 0; ib < this->nrefl_band; ib++)
+    {
+        if (is_http_url (this->file_name[ib]))
+            nremote++;
+    }
+    if (nremote > 0 && this->cube_bil)
+    {
+        free_input (this);
+        sprintf (errmsg, "Remote cubes must be interleaved by band (BSQ)");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    if (nremote > 0)
+    {
+        this->http = true;
+        strip_blocks = ((long) PROC_NLINES * this->nsamps * pix_bytes +
+            HTTP_BLOCK_SIZE - 1) / HTTP_BLOCK_SIZE + 1;
+        ncache = (long) http_cache_mb * 1024 * 1024 / HTTP_BLOCK_SIZE /
+            nremote;
+        if (ncache < 2 * strip_blocks + 1)
+            ncache = 2 * strip_blocks + 1;
+    }
 
     /* Open each of the reflectance files */
     for (ib = 0; ib < this->nrefl_band; ib++)
     {
+        if (is_http_url (this->file_name[ib]))
+        {
+            this->http_file[ib] = open_http_file (this->file_name[ib],
+                ncache);
+            if (this->http_file[ib] == NULL)
+            {
+                sprintf (errmsg, "Opening remote band: %s",
+                    this->file_name[ib]);
+                error_handler (true, FUNC_NAME, errmsg);
+                free_input (this);
+                return (NULL);
+            }
+            continue;
+        }
         this->fp_bin[ib] = open_raw_binary (this->file_name[ib], "rb");
         if (this->fp_bin[ib] == NULL)
         {
@@ -263,22 +557,29 @@ Input_t *open_input
     }
     this->refl_open = true;
 
-    /* Validate the input data type */
-    if (metadata->band[refl_indx].data_type != ESPA_INT16)
+    /* The DN bands are read as bytes, and only widened as needed */
+    if (dn)
     {
-        close_input (this);
-        free_input (this);
-        sprintf (errmsg, "Input data type is assumed to be int16, but "
-            "the data in the XML file for the reflectance bands doesn't "
-            "match this data type.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (NULL);
+        this->dn_buf[0] = prof_calloc (PBUF_INPUT, PROC_NLINES *
+            this->nsamps * this->nrefl_band, sizeof (uint8));
+        if (this->dn_buf[0] == NULL)
+        {
+            close_input (this);
+            free_input (this);
+            sprintf (errmsg, "Allocating memory for input DN buffer "
+                "containing %d lines.", PROC_NLINES);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+        for (ib = 1; ib < this->nrefl_band; ib++)
+            this->dn_buf[ib] = this->dn_buf[ib-1] + PROC_NLINES * this->nsamps;
+        return (this);
     }
 
     /* Allocate input buffer.  Reflectance buffer has multiple bands.
        Allocate PROC_NLINES of data for each band. */
-    buf = calloc (PROC_NLINES * this->nsamps * this->nrefl_band,
-        sizeof (int16));
+    buf = prof_calloc (PBUF_INPUT, PROC_NLINES * this->nsamps *
+        this->nrefl_band, sizeof (int16));
     if (buf == NULL)
     {
         close_input (this);
@@ -321,12 +622,37 @@ void close_input
 {
     int ib;      /* loop counter for bands */
   
-    /* Close the raw binary files */
+    /* Stop watching the band files */
+    if (this->follow_fd != -1)
+    {
+        close (this->follow_fd);
+        this->follow_fd = -1;
+    }
+
+    /* Detach from the shared-memory ring */
+    if (this->refl_open && this->shm != NULL)
+    {
+        close_shm_input (this);
+        this->refl_open = false;
+    }
+
+    /* Close the raw binary files and the remote bands, after waiting for
+       any read-ahead */
     if (this->refl_open)
     {
+        wait_input_read_ahead (this);
+
         /* Close reflectance SDSs */
         for (ib = 0; ib < this->nrefl_band; ib++)
-            close_raw_binary (this->fp_bin[ib]);
+        {
+            if (this->http_file[ib] != NULL)
+            {
+                close_http_file (this->http_file[ib]);
+                this->http_file[ib] = NULL;
+            }
+            else
+                close_raw_binary (this->fp_bin[ib]);
+        }
         this->refl_open = false;
     }
 }
@@ -367,8 +693,16 @@ void free_input
         for (ib = 0; ib < this->nrefl_band; ib++)
             free (this->file_name[ib]);
   
-        /* Free the data buffers */
-        free (this->refl_buf[0]);
+        /* Free the data buffers; the widened DN bands each have their own */
+        if (this->dn)
+        {
+            for (ib = 0; ib < this->nrefl_band; ib++)
+                free (this->refl_buf[ib]);
+        }
+        else
+            free (this->refl_buf[0]);
+        free (this->dn_buf[0]);
+        free (this->cat_wavelength);
 
         /* Free the data structure */
         free (this);
@@ -376,6 +710,95 @@ void free_input
 }
 
 
+/******************************************************************************
+MODULE:  get_band_offset
+
+PURPOSE:  Returns the byte offset of a line of a reflectance band in its
+file.
+
+RETURN VALUE:
+Type = long long
+Value      Description
+-----      -----------
+>=0        Offset of the first pixel of the line
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The lines of a band are contiguous except in a BIL cube, where each
+     line is followed by the same line of the other bands.
+******************************************************************************/
+static long long get_band_offset
+(
+    Input_t *this,   /* I: pointer to input data structure */
+    int iband,       /* I: reflectance buffer of the band (0-based) */
+    int line         /* I: line (0-based) */
+)
+{
+    long long line_bytes = this->nsamps * (this->dn ? sizeof (uint8) :
+        sizeof (int16));      /* bytes per line */
+
+    if (!this->cube)
+        return (line * line_bytes);
+    if (this->cube_bil)
+        return (this->cube_offset + ((long long) line * this->ncat_band +
+            this->cat_band[iband]) * line_bytes);
+    return (this->cube_offset + ((long long) this->cat_band[iband] *
+        this->nlines + line) * line_bytes);
+}
+
+
+/******************************************************************************
+MODULE:  widen_input_dn
+
+PURPOSE:  Marks a DN band to be widened into refl_buf as it's read, and
+allocates its int16 strip.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error allocating the strip
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Only EVI, the feature vectors, and the training sample read int16
+     strips of the DN bands; the two-band indices are looked up from
+     dn_buf.  Widening just the bands they use saves both the copy and the
+     int16 strip of the others.
+  2. Nothing to do for the reflectance products, which are read as int16.
+******************************************************************************/
+int widen_input_dn
+(
+    Input_t *this,   /* I/O: pointer to input data structure */
+    int iband        /* I: DN band to widen (0-based) */
+)
+{
+    char FUNC_NAME[] = "widen_input_dn";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+
+    if (!this->dn || this->dn_widen[iband])
+        return (SUCCESS);
+
+    this->refl_buf[iband] = prof_calloc (PBUF_INPUT, PROC_NLINES *
+        this->nsamps, sizeof (int16));
+    if (this->refl_buf[iband] == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the widened DN band %d "
+            "containing %d lines.", iband, PROC_NLINES);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    this->dn_widen[iband] = true;
+
+    return (SUCCESS);
+}
+
+
 /******************************************************************************
 MODULE:  get_input_refl_lines
 
@@ -395,6 +818,15 @@ at the USGS EROS
 NOTES:
   1. The Input_t data structure needs to be populated and memory allocated
      before calling this routine.  Use open_input to do that.
+  2. When reading from a shared-memory ring, reading band 0 waits for the
+     producer to fill the slot for the strip starting at iline.  The refl_buf
+     pointer for each band is then pointed at the band plane in the shared
+     slot; no data is copied.  The slot is held until
+     release_input_refl_lines is called.
+  3. The DN bands are read into dn_buf.  Those marked by widen_input_dn are
+     also copied into refl_buf as int16.
+  4. Only the requested band is read out of a cube.  The lines of a BIL cube
+     are read one at a time, skipping the other bands.
 ******************************************************************************/
 int get_input_refl_lines
 (
@@ -407,6 +839,10 @@ int get_input_refl_lines
     char FUNC_NAME[] = "get_input_refl_line";   /* function name */
     char errmsg[STR_SIZE];    /* error message */
     long loc;                 /* current location in the input file */
+    int pix;                  /* current pixel being widened */
+    int il;                   /* first line of the current read */
+    int nread;                /* number of lines in each read */
+    size_t pix_bytes;         /* bytes per input pixel */
     void *buf = NULL;         /* pointer to the buffer for the current band */
   
     /* Check the parameters */
@@ -434,26 +870,1043 @@ int get_input_refl_lines
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-  
-    /* Read the data, but first seek to the correct line */
-    buf = (void *) this->refl_buf[iband];
-    loc = (long) iline * this->nsamps * sizeof (int16);
-    if (fseek (this->fp_bin[iband], loc, SEEK_SET))
-    {
-        strcpy (errmsg, "Seeking to the current line in the input file");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
 
-    if (read_raw_binary (this->fp_bin[iband], nlines, this->nsamps,
-        sizeof (int16), buf) != SUCCESS)
+    /* Point at the shared band plane if reading from the shared-memory ring */
+    if (this->shm != NULL)
     {
-        sprintf (errmsg, "Reading %d lines from reflectance band %d starting "
-            "at line %d", nlines, iband, iline);
+        if (iband == 0 && acquire_shm_strip (this, iline, nlines) != SUCCESS)
+        {
+            sprintf (errmsg, "Waiting for lines %d-%d from the shared-memory "
+                "ring", iline, iline + nlines - 1);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        if (this->shm_strip != iline / PROC_NLINES)
+        {
+            sprintf (errmsg, "Shared-memory strip for line %d has not been "
+                "acquired", iline);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        this->refl_buf[iband] = (int16 *) ((char *) get_shm_slot (this,
+            this->shm_strip) + SHM_SLOT_HDR_SIZE) +
+            (long) iband * this->shm->slot_nlines * this->nsamps;
+        return (SUCCESS);
+    }
+  
+    /* Read the data, but first seek to the correct line.  The DN bands are
+       read as bytes. */
+    pix_bytes = this->dn ? sizeof (uint8) : sizeof (int16);
+    rate_limit_io (this->io_limit, (size_t) nlines * this->nsamps *
+        pix_bytes);
+    if (this->dn)
+        buf = (void *) this->dn_buf[iband];
+    else
+        buf = (void *) this->refl_buf[iband];
+
+    /* Copy remote bands from the block cache, fetching what's missing */
+    if (this->http_file[iband] != NULL)
+    {
+        if (read_http_file (this->http_file[iband], get_band_offset (this,
+            iband, iline), (size_t) nlines * this->nsamps * pix_bytes,
+            buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading %d lines from remote reflectance band "
+                "%d starting at line %d", nlines, iband, iline);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+    else
+    {
+        nread = this->cube_bil ? 1 : nlines;
+        for (il = 0; il < nlines; il += nread)
+        {
+            loc = get_band_offset (this, iband, iline + il);
+            if (fseek (this->fp_bin[iband], loc, SEEK_SET))
+            {
+                strcpy (errmsg, "Seeking to the current line in the input "
+                    "file");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            if (read_raw_binary (this->fp_bin[iband], nread, this->nsamps,
+                pix_bytes, (char *) buf + (size_t) il * this->nsamps *
+                pix_bytes) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading %d lines from reflectance band %d "
+                    "starting at line %d", nlines, iband, iline);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+
+    /* Widen the DN bands the int16 consumers need */
+    if (this->dn && this->dn_widen[iband])
+    {
+        for (pix = 0; pix < nlines * this->nsamps; pix++)
+            this->refl_buf[iband][pix] = this->dn_buf[iband][pix];
+    }
+  
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  http_fetch_thread
+
+PURPOSE:  Thread entry point which fetches a range of a remote band into its
+block cache.
+
+RETURN VALUE:
+Type = void*
+Value      Description
+-----      -----------
+NULL       Always; the status is in the Http_fetch_t
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static void *http_fetch_thread
+(
+    void *arg                /* I/O: Http_fetch_t range to fetch */
+)
+{
+    Http_fetch_t *fetch = arg;   /* range to fetch */
+
+    fetch->status = fetch_http_blocks (fetch->file, fetch->offset,
+        fetch->nbytes);
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE:  wait_input_read_ahead
+
+PURPOSE:  Waits for the read-ahead threads of the remote bands to finish.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Read-ahead errors are ignored; the blocks are fetched again, and any
+     error reported, when the strip is actually read.
+******************************************************************************/
+void wait_input_read_ahead
+(
+    Input_t *this    /* I: pointer to input data structure */
+)
+{
+    int ib;                   /* loop counter for bands */
+
+    if (!this->ahead_active)
+        return;
+
+    for (ib = 0; ib < this->nrefl_band; ib++)
+    {
+        if (this->http_file[ib] != NULL)
+            pthread_join (this->ahead_thread[ib], NULL);
+    }
+    this->ahead_active = false;
+}
+
+
+/******************************************************************************
+MODULE:  prefetch_input_refl_lines
+
+PURPOSE:  Fetches the strip of each remote band in parallel, then starts the
+read-ahead of the next strip in the background while the current strip is
+processed.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred fetching the strip
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Nothing is done for local band files or the shared-memory ring.
+  2. Call before get_input_refl_lines for each strip.  Only the lines of the
+     strips actually read are fetched, at block granularity.
+******************************************************************************/
+int prefetch_input_refl_lines
+(
+    Input_t *this,   /* I: pointer to input data structure */
+    int iline,       /* I: first line of the strip (0-based) */
+    int nlines       /* I: number of lines in the strip */
+)
+{
+    char FUNC_NAME[] = "prefetch_input_refl_lines";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int ib;                   /* loop counter for bands */
+    int nstarted;             /* number of bands whose fetch was started */
+    int status = SUCCESS;     /* return status */
+    int next_nlines;          /* number of lines in the next strip */
+    size_t line_bytes = this->nsamps * (this->dn ? sizeof (uint8) :
+        sizeof (int16));      /* bytes per line */
+    pthread_t thread[NBAND_REFL_MAX];  /* fetch thread for each band */
+    Http_fetch_t fetch[NBAND_REFL_MAX]; /* range fetched for each band */
+
+    if (!this->http)
+        return (SUCCESS);
+
+    /* The read-ahead from the previous strip should have this strip */
+    wait_input_read_ahead (this);
+
+    /* Fetch whatever is still missing for all the bands at once.  The
+       threads use fetch[], so every one started is joined before
+       returning. */
+    for (nstarted = 0; nstarted < this->nrefl_band; nstarted++)
+    {
+        ib = nstarted;
+        if (this->http_file[ib] == NULL)
+            continue;
+        fetch[ib].file = this->http_file[ib];
+        fetch[ib].offset = get_band_offset (this, ib, iline);
+        fetch[ib].nbytes = nlines * line_bytes;
+        fetch[ib].status = ERROR;
+        if (pthread_create (&thread[ib], NULL, http_fetch_thread,
+            &fetch[ib]) != 0)
+        {
+            sprintf (errmsg, "Starting the fetch thread for band %d", ib);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+    }
+    for (ib = 0; ib < nstarted; ib++)
+    {
+        if (this->http_file[ib] == NULL)
+            continue;
+        pthread_join (thread[ib], NULL);
+        if (fetch[ib].status != SUCCESS)
+        {
+            sprintf (errmsg, "Fetching lines %d-%d of remote band %d", iline,
+                iline + nlines - 1, ib);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+    if (status != SUCCESS)
+        return (ERROR);
+
+    /* Start reading the next strip */
+    if (iline + nlines >= this->nlines)
+        return (SUCCESS);
+    next_nlines = PROC_NLINES;
+    if (iline + nlines + next_nlines > this->nlines)
+        next_nlines = this->nlines - iline - nlines;
+    for (ib = 0; ib < this->nrefl_band; ib++)
+    {
+        if (this->http_file[ib] == NULL)
+            continue;
+        this->ahead[ib].file = this->http_file[ib];
+        this->ahead[ib].offset = get_band_offset (this, ib, iline + nlines);
+        this->ahead[ib].nbytes = next_nlines * line_bytes;
+        this->ahead[ib].status = ERROR;
+        if (pthread_create (&this->ahead_thread[ib], NULL, http_fetch_thread,
+            &this->ahead[ib]) != 0)
+        {
+            /* Join what was started; the next strip is fetched when read */
+            for (ib--; ib >= 0; ib--)
+                if (this->http_file[ib] != NULL)
+                    pthread_join (this->ahead_thread[ib], NULL);
+            return (SUCCESS);
+        }
+    }
+    this->ahead_active = true;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  release_input_refl_lines
+
+PURPOSE:  Releases the current strip of reflectance data once the caller is
+done with the refl_buf buffers.  For the shared-memory ring, the slot is
+handed back to the producer for reuse.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred releasing the strip
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Nothing needs to be done when reading from the band files.
+******************************************************************************/
+int release_input_refl_lines
+(
+    Input_t *this    /* I: pointer to input data structure */
+)
+{
+    char FUNC_NAME[] = "release_input_refl_lines";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Shm_ring_slot_t *slot = NULL;  /* slot for the current strip */
+    int ib;                   /* loop counter for bands */
+
+    if (this->shm == NULL || this->shm_strip < 0)
+        return (SUCCESS);
+
+    /* The band planes are no longer valid once the slot is released */
+    for (ib = 0; ib < this->nrefl_band; ib++)
+        this->refl_buf[ib] = NULL;
+
+    slot = get_shm_slot (this, this->shm_strip);
+    slot->state = SHM_SLOT_EMPTY;
+    this->shm_strip = -1;
+    if (sem_post (&this->shm->slots_free) != 0)
+    {
+        sprintf (errmsg, "Releasing the shared-memory slot: %s",
+            strerror (errno));
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-  
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_index_wavelengths
+
+PURPOSE:  Returns the center wavelengths of the input bands of the specified
+spectral index, in the order they are passed to the index kernel, and how far
+from each one a band may be centered and still be used.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+n          Number of input bands for the index
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The kernel band order is (nir, red) for NDVI, SAVI, and MSAVI;
+     (nir, red, blue) for EVI; (nir, mir) for NDMI; (nir, swir) for NBR;
+     (mir, swir) for NBR2; (nir, red edge) for NDRE; (531, 570) for PRI; and
+     (531, 645) for CCI.
+  2. The broad bands accept any Landsat band covering them.  The 531 and
+     570 nm bands of PRI and CCI and the red edge need a narrowband or
+     hyperspectral sensor.
+******************************************************************************/
+int get_index_wavelengths
+(
+    Mysi_list_t si,      /* I: spectral index */
+    float wavelength[MAX_SI_BANDS], /* O: center wavelength (nm) of each
+                                    input band of the index, in kernel order */
+    float tolerance[MAX_SI_BANDS]   /* O: farthest (nm) a band's center may
+                                    be from the wavelength to be used */
+)
+{
+    static float blue[2] = {480.0, 30.0};     /* wavelength, tolerance */
+    static float red[2] = {655.0, 30.0};
+    static float nir[2] = {865.0, 60.0};
+    static float mir[2] = {1610.0, 60.0};
+    static float swir[2] = {2200.0, 60.0};
+    static float red_edge[2] = {705.0, 15.0};
+    static float pri_531[2] = {531.0, 5.0};
+    static float pri_570[2] = {570.0, 5.0};
+    static float cci_645[2] = {645.0, 30.0};
+    float *band[MAX_SI_BANDS];  /* band roles in kernel order */
+    int nband;                  /* number of input bands for the index */
+    int ib;                     /* looping variable for bands */
+
+    switch (si)
+    {
+        case SI_EVI:
+            band[0] = nir;
+            band[1] = red;
+            band[2] = blue;
+            nband = 3;
+            break;
+
+        case SI_NDMI:
+            band[0] = nir;
+            band[1] = mir;
+            nband = 2;
+            break;
+
+        case SI_NBR:
+            band[0] = nir;
+            band[1] = swir;
+            nband = 2;
+            break;
+
+        case SI_NBR2:
+            band[0] = mir;
+            band[1] = swir;
+            nband = 2;
+            break;
+
+        case SI_NDRE:
+            band[0] = nir;
+            band[1] = red_edge;
+            nband = 2;
+            break;
+
+        case SI_PRI:
+            band[0] = pri_531;
+            band[1] = pri_570;
+            nband = 2;
+            break;
+
+        case SI_CCI:
+            band[0] = pri_531;
+            band[1] = cci_645;
+            nband = 2;
+            break;
+
+        default:
+            /* NDVI, SAVI, and MSAVI */
+            band[0] = nir;
+            band[1] = red;
+            nband = 2;
+            break;
+    }
+
+    for (ib = 0; ib < nband; ib++)
+    {
+        wavelength[ib] = band[ib][0];
+        tolerance[ib] = band[ib][1];
+    }
+    return (nband);
+}
+
+
+/******************************************************************************
+MODULE:  get_index_bands
+
+PURPOSE:  Determines which of the reflectance buffers hold the input bands for
+the specified spectral index, in the order they are passed to the index
+kernel.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+0          The index wasn't requested when the input was opened
+n          Number of input bands for the index
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The bands are picked by open_input; see get_index_wavelengths for the
+     kernel band order.
+******************************************************************************/
+int get_index_bands
+(
+    Input_t *this,       /* I: pointer to input data structure */
+    Mysi_list_t si,      /* I: spectral index */
+    int band_indx[MAX_SI_BANDS]  /* O: reflectance buffer (0-based) for each
+                                    input band of the index */
+)
+{
+    int ib;              /* looping variable for bands */
+
+    for (ib = 0; ib < this->index_nband[si]; ib++)
+        band_indx[ib] = this->index_band[si][ib];
+    return (this->index_nband[si]);
+}
+
+
+/******************************************************************************
+MODULE:  open_shm_input
+
+PURPOSE:  Attaches to the shared-memory ring created by the upstream producer
+and validates the ring header against the XML metadata.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred attaching to or validating the ring
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The fill, scale, and saturation values from the ring header override the
+     values from the XML file, since they describe the data actually in the
+     shared band planes.
+******************************************************************************/
+int open_shm_input
+(
+    Input_t *this,   /* I/O: pointer to input data structure */
+    char *shm_name   /* I: name of the shared-memory ring */
+)
+{
+    char FUNC_NAME[] = "open_shm_input";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int fd;                   /* file descriptor for the shared memory */
+    struct stat st;           /* size of the shared memory */
+    void *addr = NULL;        /* mapped shared memory */
+    Shm_ring_header_t *hdr = NULL;  /* ring header */
+
+    fd = shm_open (shm_name, O_RDWR, 0);
+    if (fd < 0)
+    {
+        sprintf (errmsg, "Opening shared memory %s: %s", shm_name,
+            strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (fstat (fd, &st) != 0 || st.st_size < (off_t) sizeof (*hdr))
+    {
+        close (fd);
+        sprintf (errmsg, "Shared memory %s is too small for the ring header",
+            shm_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    addr = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+    if (addr == MAP_FAILED)
+    {
+        sprintf (errmsg, "Mapping shared memory %s: %s", shm_name,
+            strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    hdr = (Shm_ring_header_t *) addr;
+    this->shm = hdr;
+    this->shm_size = st.st_size;
+
+    /* Validate the ring against the XML metadata */
+    if (hdr->magic != SHM_RING_MAGIC || hdr->version != SHM_RING_VERSION)
+        sprintf (errmsg, "Shared memory %s is not a version %d spectral "
+            "indices ring", shm_name, SHM_RING_VERSION);
+    else if (hdr->nbands != this->nrefl_band)
+        sprintf (errmsg, "Ring has %d band planes, but %d reflectance bands "
+            "are expected", hdr->nbands, this->nrefl_band);
+    else if (hdr->nlines != this->nlines || hdr->nsamps != this->nsamps)
+        sprintf (errmsg, "Ring scene size %d/%d doesn't match the XML "
+            "lines/samples %d/%d", hdr->nlines, hdr->nsamps, this->nlines,
+            this->nsamps);
+    else if (hdr->slot_nlines != PROC_NLINES)
+        sprintf (errmsg, "Ring strips of %d lines don't match the %d lines "
+            "processed at a time", hdr->slot_nlines, PROC_NLINES);
+    else if (hdr->nslots < 1 || hdr->slot_size < SHM_SLOT_HDR_SIZE +
+        (int64_t) hdr->nbands * hdr->slot_nlines * hdr->nsamps *
+        (int64_t) sizeof (int16) || hdr->slot_offset < (int64_t) sizeof (*hdr) ||
+        hdr->slot_offset + hdr->nslots * hdr->slot_size > (int64_t) st.st_size)
+        sprintf (errmsg, "Ring slot layout doesn't fit in shared memory %s",
+            shm_name);
+    else
+        errmsg[0] = '\0';
+    if (errmsg[0] != '\0')
+    {
+        close_shm_input (this);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    this->refl_fill = hdr->refl_fill;
+    this->refl_scale_fact = hdr->refl_scale_fact;
+    this->refl_saturate_val = hdr->refl_saturate_val;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  close_shm_input
+
+PURPOSE:  Releases any strip still held and detaches from the shared-memory
+ring.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void close_shm_input
+(
+    Input_t *this    /* I/O: pointer to input data structure */
+)
+{
+    if (this->shm == NULL)
+        return;
+
+    release_input_refl_lines (this);
+    munmap (this->shm, this->shm_size);
+    this->shm = NULL;
+    this->shm_size = 0;
+}
+
+
+/******************************************************************************
+MODULE:  get_shm_slot
+
+PURPOSE:  Returns the address of the ring slot holding the specified strip.
+
+RETURN VALUE:
+Type = Shm_ring_slot_t *
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+Shm_ring_slot_t *get_shm_slot
+(
+    Input_t *this,   /* I: pointer to input data structure */
+    int strip        /* I: strip index (0-based) */
+)
+{
+    return ((Shm_ring_slot_t *) ((char *) this->shm + this->shm->slot_offset +
+        (strip % this->shm->nslots) * this->shm->slot_size));
+}
+
+
+/******************************************************************************
+MODULE:  acquire_shm_strip
+
+PURPOSE:  Waits for the producer to fill the ring slot holding the strip
+which starts at the specified line.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Timed out or the slot doesn't hold the expected lines
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Strips are expected in line order, one strip of PROC_NLINES at a time.
+******************************************************************************/
+int acquire_shm_strip
+(
+    Input_t *this,   /* I/O: pointer to input data structure */
+    int iline,       /* I: first line of the strip (0-based) */
+    int nlines       /* I: number of lines in the strip */
+)
+{
+    char FUNC_NAME[] = "acquire_shm_strip";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int strip = iline / PROC_NLINES;  /* strip index */
+    struct timespec deadline; /* time to give up waiting on the producer */
+    Shm_ring_slot_t *slot = NULL;  /* slot for the strip */
+
+    /* Hand back the previous strip if the caller didn't */
+    if (this->shm_strip >= 0 && this->shm_strip != strip &&
+        release_input_refl_lines (this) != SUCCESS)
+        return (ERROR);
+    if (this->shm_strip == strip)
+        return (SUCCESS);
+
+    clock_gettime (CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += SHM_WAIT_SECS;
+    while (sem_timedwait (&this->shm->slots_full, &deadline) != 0)
+    {
+        if (errno == EINTR)
+            continue;
+        sprintf (errmsg, "Waiting on the producer for strip %d: %s", strip,
+            strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    slot = get_shm_slot (this, strip);
+    if (slot->state != SHM_SLOT_FULL || slot->strip != strip ||
+        slot->iline != iline || slot->nlines != nlines)
+    {
+        sprintf (errmsg, "Ring slot holds lines %d-%d of strip %d, but lines "
+            "%d-%d of strip %d were expected", slot->iline,
+            slot->iline + slot->nlines - 1, slot->strip, iline,
+            iline + nlines - 1, strip);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    this->shm_strip = strip;
+
     return (SUCCESS);
 }
 
+
+/******************************************************************************
+MODULE:  prescan_input
+
+PURPOSE:  Reads a sparse sample of lines from the reflectance bands, and
+optionally the pixel QA band, to estimate the fraction of valid and clear
+pixels in the scene before any index is computed.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred reading the sample lines
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. PRESCAN_NLINES lines, evenly spaced through the scene, are read.  The
+     first line of each reflectance (or DN) buffer is used to hold the
+     sample line.
+  2. A pixel is valid if none of the reflectance bands read for the
+     requested indices are fill, since any fill input produces a fill index
+     value.  A valid pixel is clear if the
+     pixel_qa band flags it as clear or water.  Both fractions are relative
+     to all of the sampled pixels.
+  3. The clear fraction is only computed if use_qa is set; otherwise it is
+     returned as the valid fraction.
+  4. Not available when reading from a shared-memory ring, since the strips
+     can only be read once and in order.
+******************************************************************************/
+int prescan_input
+(
+    Input_t *this,   /* I: pointer to input data structure */
+    Espa_internal_meta_t *metadata,  /* I: input metadata, for the QA band */
+    bool use_qa,     /* I: should the pixel_qa band be used for the clear
+                           fraction? */
+    float *valid_frac,  /* O: estimated fraction of valid pixels */
+    float *clear_frac   /* O: estimated fraction of valid, clear pixels */
+)
+{
+    char FUNC_NAME[] = "prescan_input";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int ib;                   /* loop counter for bands */
+    int il;                   /* loop counter for sample lines */
+    int is;                   /* loop counter for samples */
+    int line;                 /* current sample line */
+    int nsample_lines;        /* number of lines to sample */
+    int qa_indx = -1;         /* band index in XML file for the QA band */
+    long nvalid = 0;          /* number of valid sampled pixels */
+    long nclear = 0;          /* number of valid, clear sampled pixels */
+    long npix = 0;            /* number of sampled pixels */
+    bool valid;               /* is the current pixel valid? */
+    uint16 *qa_buf = NULL;  /* one line of the QA band */
+    FILE *fp_qa = NULL;       /* file pointer for the QA band */
+
+    if (this->shm != NULL)
+    {
+        sprintf (errmsg, "Pre-scan is not supported for the shared-memory "
+            "ring");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Open the pixel QA band if the clear fraction is wanted */
+    if (use_qa)
+    {
+        for (ib = 0; ib < metadata->nbands; ib++)
+        {
+            if (!strcmp (metadata->band[ib].name, "pixel_qa"))
+                qa_indx = ib;
+        }
+        if (qa_indx == -1)
+        {
+            sprintf (errmsg, "Unable to find the pixel_qa band in the XML "
+                "file.");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        if (metadata->band[qa_indx].data_type != ESPA_UINT16 ||
+            metadata->band[qa_indx].nlines != this->nlines ||
+            metadata->band[qa_indx].nsamps != this->nsamps)
+        {
+            sprintf (errmsg, "The pixel_qa band is expected to be uint16 and "
+                "the same size as the reflectance bands.");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        fp_qa = open_raw_binary (metadata->band[qa_indx].file_name, "rb");
+        if (fp_qa == NULL)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Opening raw binary file: "
+                "%.900s", metadata->band[qa_indx].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        qa_buf = malloc (this->nsamps * sizeof (uint16));
+        if (qa_buf == NULL)
+        {
+            close_raw_binary (fp_qa);
+            sprintf (errmsg, "Allocating memory for the QA line");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Read the evenly spaced sample lines */
+    nsample_lines = PRESCAN_NLINES;
+    if (nsample_lines > this->nlines)
+        nsample_lines = this->nlines;
+    for (il = 0; il < nsample_lines; il++)
+    {
+        line = (int) (((long) il * 2 + 1) * this->nlines /
+            (2 * nsample_lines));
+
+        for (ib = 0; ib < this->nrefl_band; ib++)
+        {
+            if (get_input_refl_lines (this, ib, line, 1) != SUCCESS)
+            {
+                free (qa_buf);
+                if (fp_qa != NULL)
+                    close_raw_binary (fp_qa);
+                sprintf (errmsg, "Reading sample line %d", line);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+
+        if (fp_qa != NULL)
+        {
+            rate_limit_io (this->io_limit, this->nsamps * sizeof (uint16));
+            if (fseek (fp_qa, (long) line * this->nsamps * sizeof (uint16),
+                SEEK_SET) || read_raw_binary (fp_qa, 1, this->nsamps,
+                sizeof (uint16), qa_buf) != SUCCESS)
+            {
+                free (qa_buf);
+                close_raw_binary (fp_qa);
+                sprintf (errmsg, "Reading QA sample line %d", line);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+
+        for (is = 0; is < this->nsamps; is++)
+        {
+            valid = true;
+            for (ib = 0; ib < this->nrefl_band; ib++)
+            {
+                if ((this->dn ? this->dn_buf[ib][is] :
+                    this->refl_buf[ib][is]) == this->refl_fill)
+                {
+                    valid = false;
+                    break;
+                }
+            }
+
+            if (valid)
+            {
+                nvalid++;
+                if (fp_qa != NULL && (qa_buf[is] & PIXEL_QA_CLEAR_MASK))
+                    nclear++;
+            }
+        }
+        npix += this->nsamps;
+    }
+
+    /* Clean up the QA band */
+    free (qa_buf);
+    if (fp_qa != NULL)
+        close_raw_binary (fp_qa);
+
+    *valid_frac = (npix > 0) ? (float) nvalid / npix : 0.0;
+    if (use_qa)
+        *clear_frac = (npix > 0) ? (float) nclear / npix : 0.0;
+    else
+        *clear_frac = *valid_frac;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  follow_input
+
+PURPOSE:  Sets up the wait for the strips of band files which are still
+being written.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      The bands are remote or come from the shared-memory ring
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The band files are watched with inotify so a wait ends as soon as a
+     band is written.  If inotify isn't available (i.e. out of watches, or
+     a network filesystem that doesn't report remote writes, which the
+     periodic size check covers anyway), the sizes are only polled.
+******************************************************************************/
+int follow_input
+(
+    Input_t *this,   /* I/O: pointer to input data structure */
+    double timeout   /* I: most seconds the band files may go without
+                           growing */
+)
+{
+    char FUNC_NAME[] = "follow_input";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int ib;                   /* looping variable for bands */
+
+    if (this->http || this->shm != NULL)
+    {
+        sprintf (errmsg, "Only local band files can be followed");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    this->follow = true;
+    this->follow_timeout = timeout;
+    this->follow_fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+    for (ib = 0; ib < this->nrefl_band && this->follow_fd != -1; ib++)
+    {
+        /* A cube is watched once; the repeated watch is the same one */
+        if (inotify_add_watch (this->follow_fd, this->file_name[ib],
+            IN_MODIFY | IN_CLOSE_WRITE) == -1)
+        {
+            close (this->follow_fd);
+            this->follow_fd = -1;
+        }
+    }
+    if (this->follow_fd == -1)
+    {
+        sprintf (errmsg, "Watching the band files: %s; polling their sizes "
+            "every %d ms instead", strerror (errno), FOLLOW_POLL_MS);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  wait_input_refl_lines
+
+PURPOSE:  Waits until every band file being followed holds the lines of a
+strip.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error checking the band files, or they stopped growing for
+           longer than the timeout
+SUCCESS    The strip can be read
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Returns at once if the bands aren't being followed.
+  2. A band is ready once its file reaches the end of the strip's last line,
+     so the writer has to write each band in order and in place.  Band files
+     preallocated to their full size, or written to a temporary name and
+     renamed, can't be followed.
+  3. The timeout counts from the last time any of the files grew, so a slow
+     writer is waited for as long as it keeps writing.
+******************************************************************************/
+int wait_input_refl_lines
+(
+    Input_t *this,   /* I: pointer to input data structure */
+    int iline,       /* I: first line of the strip (0-based) */
+    int nlines       /* I: number of lines in the strip */
+)
+{
+    char FUNC_NAME[] = "wait_input_refl_lines";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char events[4096] __attribute__ ((aligned (8))); /* inotify events,
+                                 which are only drained */
+    int ib;                   /* looping variable for bands */
+    bool ready;               /* do all the bands hold the strip? */
+    long long line_bytes = this->nsamps * (this->dn ? sizeof (uint8) :
+        sizeof (int16));      /* bytes per line */
+    long long total;          /* combined size of the band files */
+    long long last_total = -1; /* combined size at the last check */
+    double stalled;           /* seconds since the files last grew */
+    struct stat st;           /* status of a band file */
+    struct pollfd pfd;        /* inotify instance to wait on */
+    struct timespec t0;       /* time the files last grew */
+    struct timespec t1;       /* current time */
+    struct timespec pause;    /* interval between polls of the sizes */
+
+    if (!this->follow)
+        return (SUCCESS);
+
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    while (1)
+    {
+        ready = true;
+        total = 0;
+        for (ib = 0; ib < this->nrefl_band; ib++)
+        {
+            if (fstat (fileno (this->fp_bin[ib]), &st) != 0)
+            {
+                sprintf (errmsg, "Checking the size of %s: %s",
+                    this->file_name[ib], strerror (errno));
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            if (st.st_size < get_band_offset (this, ib, iline + nlines - 1)
+                + line_bytes)
+                ready = false;
+            total += st.st_size;
+        }
+        if (ready)
+            return (SUCCESS);
+
+        clock_gettime (CLOCK_MONOTONIC, &t1);
+        if (total != last_total)
+        {
+            last_total = total;
+            t0 = t1;
+        }
+        stalled = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+        if (stalled >= this->follow_timeout)
+        {
+            sprintf (errmsg, "The band files haven't grown for %g seconds "
+                "waiting for lines %d to %d", this->follow_timeout, iline,
+                iline + nlines - 1);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Wait for a write to a band, or the next poll, then drain the
+           events; which band was written doesn't matter */
+        if (this->follow_fd != -1)
+        {
+            pfd.fd = this->follow_fd;
+            pfd.events = POLLIN;
+            if (poll (&pfd, 1, FOLLOW_POLL_MS) > 0)
+            {
+                while (read (this->follow_fd, events, sizeof (events)) > 0)
+                    ;
+            }
+        }
+        else
+        {
+            pause.tv_sec = FOLLOW_POLL_MS / 1000;
+            pause.tv_nsec = (FOLLOW_POLL_MS % 1000) * 1000000L;
+            nanosleep (&pause, NULL);
+        }
+    }
+}
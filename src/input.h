@@ -9,36 +9,126 @@
 #include "error_handler.h"
 #include "raw_binary_io.h"
 #include "espa_metadata.h"
+#include "shm_ring.h"
+#include "rate_limit.h"
+#include "http_input.h"
+#include "cube_header.h"
 
 /* There are currently a maximum of 7 reflective bands (Landsat 8 has 7,
    Landsats 4-7 have 6) in the output surface reflectance product */
-#define NBAND_REFL_MAX 7
+#define NBAND_LANDSAT_MAX 7
+
+/* Maximum number of bands read for the requested indices.  The indices use
+   at most nine distinct wavelengths (blue, 531, 570, 645, red, red edge,
+   nir, swir1, and swir2), and the shared-memory ring carries all the Landsat
+   bands. */
+#define NBAND_REFL_MAX 9
+
+/* The 8-bit Level-1 DN bands are unscaled to 0.0-1.0 for the kernels which
+   need unscaled values.  The fill and saturation values are used when the
+   band metadata doesn't have 8-bit ones. */
+#define DN_SCALE_FACT (1.0 / 255.0)
+#define DN_FILL 0
+#define DN_SATURATE 255
+
+/* Number of evenly spaced lines read by the pre-scan */
+#define PRESCAN_NLINES 64
+
+/* pixel_qa bits which mark a pixel as clear for the pre-scan (bit 1 clear,
+   bit 2 water) */
+#define PIXEL_QA_CLEAR_MASK 0x0006
+
+/* Longest the band files may go without growing while they're followed,
+   in seconds, unless --follow_timeout says otherwise */
+#define FOLLOW_TIMEOUT 600.0
+
+/* Interval the band file sizes are checked at while they're followed, in
+   milliseconds; inotify wakes the wait sooner when a band is written */
+#define FOLLOW_POLL_MS 250
+
+/* Range of a remote band to fetch in a prefetch or read-ahead thread */
+typedef struct {
+    Http_file_t *file;       /* remote band file */
+    long long offset;        /* first byte to fetch */
+    size_t nbytes;           /* number of bytes to fetch */
+    int status;              /* return status of the fetch */
+} Http_fetch_t;
 
 /* Structure for the 'input' data type, particularly to handle the file/SDS
    IDs and the band-specific information */
 typedef struct {
     bool refl_open;          /* open reflectance file flag; open = true */
-    int nrefl_band;          /* number of input reflectance bands */
+    int nrefl_band;          /* number of reflectance bands read, which are
+                                only the bands the requested indices use */
     int nlines;              /* number of input lines */
     int nsamps;              /* number of input samples */
     float pixsize[2];        /* pixel size x, y */
-    int refl_band[NBAND_REFL_MAX]; /* band numbers for reflectance data */
+    int ncat_band;           /* number of bands the scene or cube offers */
+    float *cat_wavelength;   /* center wavelength (nm) of each offered
+                                band */
+    int cat_band[NBAND_REFL_MAX]; /* offered band (0-based) read into each
+                                reflectance buffer */
+    int index_nband[NUM_SI]; /* number of input bands of each requested
+                                index; 0 if the index isn't requested */
+    int index_band[NUM_SI][MAX_SI_BANDS]; /* reflectance buffer for each input
+                                band of each requested index, in kernel
+                                order */
+    bool cube;               /* are the bands read out of one multi-band
+                                cube, otherwise one file per band */
+    bool cube_bil;           /* is the cube interleaved by line, otherwise
+                                by band */
+    long cube_offset;        /* bytes before the first pixel of the cube */
     char *file_name[NBAND_REFL_MAX];  
                              /* Name of the input image files */
     int16 *refl_buf[NBAND_REFL_MAX]; /* input data buffer for unscaled
                                 reflectance data (PROC_NLINES lines of data) */
+    bool dn;                 /* are the inputs the 8-bit Level-1 DN bands? */
+    uint8 *dn_buf[NBAND_REFL_MAX]; /* input data buffer for the DN bands;
+                                refl_buf holds the same values widened for
+                                the bands in dn_widen */
+    bool dn_widen[NBAND_REFL_MAX]; /* is each DN band widened into refl_buf
+                                for a consumer of int16 strips? */
     FILE *fp_bin[NBAND_REFL_MAX];  /* file pointer for binary files */
     int16 refl_fill;         /* fill value for reflectance bands */
     float refl_scale_fact;   /* scale factor for reflectance bands */
     int refl_saturate_val;   /* saturation value for reflectance bands */
+    Shm_ring_header_t *shm;  /* shared-memory ring when the strips come from
+                                an upstream producer; NULL for band files */
+    size_t shm_size;         /* size of the mapped shared-memory segment */
+    int shm_strip;           /* strip currently held from the ring; -1 if no
+                                strip is held */
+    Rate_limit_t *io_limit;  /* I/O rate limiter for the reads; NULL if
+                                unlimited */
+    Http_file_t *http_file[NBAND_REFL_MAX]; /* remote band files read with
+                                range requests; NULL for local files */
+    bool http;               /* are any of the bands remote? */
+    bool ahead_active;       /* are the read-ahead threads running? */
+    pthread_t ahead_thread[NBAND_REFL_MAX]; /* read-ahead thread for each
+                                remote band */
+    Http_fetch_t ahead[NBAND_REFL_MAX]; /* range fetched by each read-ahead
+                                thread */
+    bool follow;             /* are the band files still being written, so
+                                each strip is waited for? */
+    int follow_fd;           /* inotify instance watching the band files;
+                                -1 if their sizes are polled */
+    double follow_timeout;   /* most seconds the band files may go without
+                                growing while followed */
 } Input_t;
 
 /* Prototypes */
 Input_t *open_input
 (
     Espa_internal_meta_t *metadata,     /* I: input metadata */
-    bool toa         /* I: are we processing TOA reflectance data, otherwise
+    bool toa,        /* I: are we processing TOA reflectance data, otherwise
                            process surface reflectance data */
+    bool dn,         /* I: are we processing the 8-bit Level-1 DN bands
+                           instead of either reflectance product? */
+    bool si_flag[NUM_SI], /* I: indices to be computed; only the bands they
+                           use are read */
+    char *shm_name,  /* I: name of the shared-memory ring to read the strips
+                           from; NULL to read the band files */
+    int http_cache_mb  /* I: memory budget for the remote band block caches,
+                           in megabytes */
 );
 
 void close_input
@@ -59,4 +149,92 @@ int get_input_refl_lines
     int nlines       /* I: number of lines to read */
 );
 
+int widen_input_dn
+(
+    Input_t *this,   /* I/O: pointer to input data structure */
+    int iband        /* I: DN band to widen (0-based) */
+);
+
+int prefetch_input_refl_lines
+(
+    Input_t *this,   /* I: pointer to input data structure */
+    int iline,       /* I: first line of the strip (0-based) */
+    int nlines       /* I: number of lines in the strip */
+);
+
+void wait_input_read_ahead
+(
+    Input_t *this    /* I: pointer to input data structure */
+);
+
+int release_input_refl_lines
+(
+    Input_t *this    /* I: pointer to input data structure */
+);
+
+int prescan_input
+(
+    Input_t *this,   /* I: pointer to input data structure */
+    Espa_internal_meta_t *metadata,  /* I: input metadata, for the QA band */
+    bool use_qa,     /* I: should the pixel_qa band be used for the clear
+                           fraction? */
+    float *valid_frac,  /* O: estimated fraction of valid pixels */
+    float *clear_frac   /* O: estimated fraction of valid, clear pixels */
+);
+
+int get_index_wavelengths
+(
+    Mysi_list_t si,      /* I: spectral index */
+    float wavelength[MAX_SI_BANDS], /* O: center wavelength (nm) of each
+                                    input band of the index, in kernel order */
+    float tolerance[MAX_SI_BANDS]   /* O: farthest (nm) a band's center may
+                                    be from the wavelength to be used */
+);
+
+int get_index_bands
+(
+    Input_t *this,       /* I: pointer to input data structure */
+    Mysi_list_t si,      /* I: spectral index */
+    int band_indx[MAX_SI_BANDS]  /* O: reflectance buffer (0-based) for each
+                                    input band of the index */
+);
+
+int open_shm_input
+(
+    Input_t *this,   /* I/O: pointer to input data structure */
+    char *shm_name   /* I: name of the shared-memory ring */
+);
+
+void close_shm_input
+(
+    Input_t *this    /* I/O: pointer to input data structure */
+);
+
+Shm_ring_slot_t *get_shm_slot
+(
+    Input_t *this,   /* I: pointer to input data structure */
+    int strip        /* I: strip index (0-based) */
+);
+
+int acquire_shm_strip
+(
+    Input_t *this,   /* I/O: pointer to input data structure */
+    int iline,       /* I: first line of the strip (0-based) */
+    int nlines       /* I: number of lines in the strip */
+);
+
+int follow_input
+(
+    Input_t *this,   /* I/O: pointer to input data structure */
+    double timeout   /* I: most seconds the band files may go without
+                           growing */
+);
+
+int wait_input_refl_lines
+(
+    Input_t *this,   /* I: pointer to input data structure */
+    int iline,       /* I: first line of the strip (0-based) */
+    int nlines       /* I: number of lines in the strip */
+);
+
 #endif
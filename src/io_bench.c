@@ -0,0 +1,1117 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "io_bench.h"
+#include "si.h"
+#include "calibration.h"
+
+/******************************************************************************
+MODULE:  si_io_bench
+
+PURPOSE:  Benchmarks the I/O backends for the strip access pattern of
+spectral_indices on a given storage tier.  For a scene geometry, band count,
+and strip height, the strip writes of put_output_line and the strip reads of
+get_input_refl_lines are replayed against each backend, and the throughput,
+latency percentiles, and CPU time per byte are reported.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An error occurred with the arguments or every backend failed
+SUCCESS         Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Each strip is handled band by band, as the application does: for
+     every strip, one write (or read) of the strip's lines per band file.
+  2. The writes are timed through the final flush to storage.  The band
+     files are then dropped from the page cache (posix_fadvise), so the
+     reads come from storage rather than memory where the filesystem
+     honors it.
+  3. A backend the filesystem doesn't support (i.e. O_DIRECT on tmpfs) is
+     reported as unavailable and skipped.
+  4. With --calibration, the index kernels are also timed and the rates are
+     saved for spectral_indices --plan.  The I/O rates saved are those of
+     the first backend run which succeeded (stdio unless --backend says
+     otherwise), since that is the backend spectral_indices uses.
+******************************************************************************/
+int main (int argc, char *argv[])
+{
+    char FUNC_NAME[] = "main"; /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char *dir = NULL;          /* directory for the band files */
+    char *mode = "both";       /* read, write, or both */
+    char *cal_file = NULL;     /* calibration profile to write */
+    int nlines = BENCH_NLINES; /* number of lines in each band */
+    int nsamps = BENCH_NSAMPS; /* number of samples in each band */
+    int nbands = BENCH_NBANDS; /* number of bands */
+    int strip = PROC_NLINES;   /* number of lines in each strip */
+    int c;                     /* current argument */
+    int option_index;          /* index for the command-line option */
+    int op;                    /* looping variable for write, then read */
+    int nok = 0;               /* number of runs which succeeded */
+    int status;                /* return status */
+    int i;                     /* looping variable */
+    bool keep = false;         /* keep the band files? */
+    bool run[NUM_IO_BACKEND];  /* run each backend? */
+    bool any_backend = false;  /* were backends specified? */
+    char band_file[STR_SIZE];  /* name of a band file */
+    Io_backend_t backend;      /* current backend */
+    Bench_result_t result;     /* results of the current run */
+    Calibration_t cal;         /* rates saved for spectral_indices --plan */
+    static struct option long_options[] =
+    {
+        {"dir", required_argument, 0, 'd'},
+        {"nlines", required_argument, 0, 'l'},
+        {"nsamps", required_argument, 0, 's'},
+        {"nbands", required_argument, 0, 'n'},
+        {"strip", required_argument, 0, 't'},
+        {"backend", required_argument, 0, 'b'},
+        {"mode", required_argument, 0, 'm'},
+        {"keep", no_argument, 0, 'k'},
+        {"calibration", required_argument, 0, 'c'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    for (backend = 0; backend < NUM_IO_BACKEND; backend++)
+        run[backend] = false;
+    memset (&cal, 0, sizeof (cal));
+
+    /* Read the command-line arguments */
+    opterr = 0;
+    while ((c = getopt_long (argc, argv, "", long_options, &option_index))
+        != -1)
+    {
+        switch (c)
+        {
+            case 'd':
+                dir = optarg;
+                break;
+            case 'l':
+                nlines = atoi (optarg);
+                break;
+            case 's':
+                nsamps = atoi (optarg);
+                break;
+            case 'n':
+                nbands = atoi (optarg);
+                break;
+            case 't':
+                strip = atoi (optarg);
+                break;
+            case 'b':
+                for (backend = 0; backend < NUM_IO_BACKEND; backend++)
+                {
+                    if (!strcmp (optarg, io_backend_name (backend)))
+                        break;
+                }
+                if (backend == NUM_IO_BACKEND)
+                {
+                    sprintf (errmsg, "Unknown backend %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    io_bench_usage ();
+                    exit (ERROR);
+                }
+                run[backend] = true;
+                any_backend = true;
+                break;
+            case 'm':
+                mode = optarg;
+                break;
+            case 'k':
+                keep = true;
+                break;
+            case 'c':
+                cal_file = optarg;
+                break;
+            case 'h':
+                io_bench_usage ();
+                exit (SUCCESS);
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                io_bench_usage ();
+                exit (ERROR);
+        }
+    }
+
+    if (dir == NULL || nlines < 1 || nsamps < 1 || nbands < 1 || strip < 1 ||
+        (strcmp (mode, "read") && strcmp (mode, "write") &&
+        strcmp (mode, "both")))
+    {
+        sprintf (errmsg, "--dir is required, the geometry must be positive, "
+            "and --mode must be read, write, or both");
+        error_handler (true, FUNC_NAME, errmsg);
+        io_bench_usage ();
+        exit (ERROR);
+    }
+    if (!any_backend)
+    {
+        for (backend = 0; backend < NUM_IO_BACKEND; backend++)
+            run[backend] = true;
+    }
+
+    printf ("si_io_bench: %d lines x %d samples x %d bands, %d-line strips "
+        "(%.1f MB per band)\n", nlines, nsamps, nbands, strip,
+        (double) nlines * nsamps * sizeof (int16) / (1024.0 * 1024.0));
+    printf ("%-7s %-6s %10s %9s %9s %9s %9s %12s\n", "backend", "op", "MB/s",
+        "p50 ms", "p90 ms", "p99 ms", "max ms", "CPU ns/byte");
+
+    for (backend = 0; backend < NUM_IO_BACKEND; backend++)
+    {
+        if (!run[backend])
+            continue;
+
+        /* Reads need the files from a write; a read-only run uses the
+           files left by an earlier --keep run */
+        for (op = 0; op < 2; op++)
+        {
+            if ((op == 0 && !strcmp (mode, "read")) ||
+                (op == 1 && !strcmp (mode, "write")))
+                continue;
+
+            if (op == 0)
+                status = bench_write (backend, dir, nlines, nsamps, nbands,
+                    strip, &result);
+            else
+                status = bench_read (backend, dir, nlines, nsamps, nbands,
+                    strip, &result);
+            if (status != SUCCESS)
+            {
+                printf ("%-7s %-6s %10s\n", io_backend_name (backend),
+                    op == 0 ? "write" : "read", "unavailable");
+                break;
+            }
+
+            /* Keep the rates of the first backend which succeeded */
+            if (cal.backend[0] == '\0' ||
+                !strcmp (cal.backend, io_backend_name (backend)))
+            {
+                strcpy (cal.backend, io_backend_name (backend));
+                if (op == 0)
+                    cal.write_mbps = result.nbytes / (1024.0 * 1024.0) /
+                        result.elapsed;
+                else
+                    cal.read_mbps = result.nbytes / (1024.0 * 1024.0) /
+                        result.elapsed;
+            }
+
+            print_result (backend, op == 0 ? "write" : "read", &result);
+            free (result.lat);
+            nok++;
+        }
+    }
+
+    /* Time the index kernels and save the calibration profile */
+    if (cal_file != NULL)
+    {
+        if (bench_kernels (nlines, nsamps, strip, cal.mpix_per_sec) !=
+            SUCCESS)
+            nok = 0;
+        else
+        {
+            printf ("\n%-7s %10s\n", "index", "Mpix/s");
+            for (i = 0; i < NUM_SI; i++)
+                printf ("%-7s %10.1f\n", si_short_name (i),
+                    cal.mpix_per_sec[i]);
+            if (write_calibration (cal_file, &cal) != SUCCESS)
+                nok = 0;
+        }
+    }
+
+    /* Remove the band files */
+    if (!keep)
+    {
+        for (i = 0; i < nbands; i++)
+        {
+            bench_file_name (dir, i, band_file);
+            unlink (band_file);
+        }
+    }
+
+    exit (nok > 0 ? SUCCESS : ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  io_backend_name
+
+PURPOSE:  Returns the name of an I/O backend, as given to --backend.
+
+RETURN VALUE:
+Type = char *
+Value      Description
+-----      -----------
+non-NULL   Name of the backend
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+char *io_backend_name
+(
+    Io_backend_t backend     /* I: I/O backend */
+)
+{
+    switch (backend)
+    {
+        case IO_STDIO: return ("stdio");
+        case IO_PREAD: return ("pread");
+        case IO_MMAP: return ("mmap");
+        case IO_DIRECT: return ("direct");
+        default: return ("unknown");
+    }
+}
+
+
+/******************************************************************************
+MODULE:  bench_file_name
+
+PURPOSE:  Builds the name of a benchmark band file.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void bench_file_name
+(
+    char *dir,               /* I: directory holding the band files */
+    int iband,               /* I: band (0-based) */
+    char *file_name          /* O: name of the band file; STR_SIZE long */
+)
+{
+    snprintf (file_name, STR_SIZE, "%s/si_io_bench_b%d.img", dir, iband + 1);
+}
+
+
+/******************************************************************************
+MODULE:  elapsed_since
+
+PURPOSE:  Returns the seconds elapsed since a monotonic clock reading.
+
+RETURN VALUE:
+Type = double
+Value      Description
+-----      -----------
+>=0        Elapsed seconds
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static double elapsed_since
+(
+    struct timespec *t0      /* I: earlier clock reading */
+)
+{
+    struct timespec t1;       /* current clock reading */
+
+    clock_gettime (CLOCK_MONOTONIC, &t1);
+    return ((t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) * 1e-9);
+}
+
+
+/******************************************************************************
+MODULE:  cpu_seconds
+
+PURPOSE:  Returns the user plus system CPU time used by the process.
+
+RETURN VALUE:
+Type = double
+Value      Description
+-----      -----------
+>=0        CPU seconds
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static double cpu_seconds ()
+{
+    struct rusage ru;         /* resource usage of the process */
+
+    getrusage (RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 +
+        ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6);
+}
+
+
+/******************************************************************************
+MODULE:  full_io
+
+PURPOSE:  Reads or writes a whole region with pread or pwrite, retrying
+short transfers.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error reading or writing, or end of file
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static int full_io
+(
+    int fd,                  /* I: file descriptor */
+    bool write_op,           /* I: write?  Otherwise read */
+    char *buf,               /* I/O: data to write or read into */
+    size_t len,              /* I: number of bytes */
+    off_t off                /* I: file offset */
+)
+{
+    ssize_t n;                /* bytes moved by one call */
+
+    while (len > 0)
+    {
+        if (write_op)
+            n = pwrite (fd, buf, len, off);
+        else
+            n = pread (fd, buf, len, off);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return (ERROR);
+        buf += n;
+        len -= n;
+        off += n;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  open_bench_file
+
+PURPOSE:  Opens a band file for reading or writing with the specified
+backend.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error opening the file, or the backend isn't supported
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Files opened for writing are reserved at their full size for mmap, as
+     with --mmap_output.
+******************************************************************************/
+static int open_bench_file
+(
+    Io_backend_t backend,    /* I: I/O backend */
+    char *file_name,         /* I: name of the band file */
+    bool write_op,           /* I: open for writing?  Otherwise reading */
+    size_t size,             /* I: size of the band in bytes */
+    size_t strip_bytes,      /* I: largest strip in bytes */
+    Bench_file_t *this       /* O: opened band file */
+)
+{
+    char FUNC_NAME[] = "open_bench_file";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int flags;                /* open flags */
+
+    memset (this, 0, sizeof (*this));
+    this->backend = backend;
+    this->fd = -1;
+    this->size = size;
+
+    if (backend == IO_STDIO)
+    {
+        this->fp = open_raw_binary (file_name, write_op ? "w" : "rb");
+        if (this->fp == NULL)
+        {
+            sprintf (errmsg, "Opening %.900s", file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        return (SUCCESS);
+    }
+
+    if (write_op)
+        flags = (backend == IO_MMAP ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC;
+    else
+        flags = O_RDONLY;
+    if (backend == IO_DIRECT)
+        flags |= O_DIRECT;
+    this->fd = open (file_name, flags, 0644);
+    if (this->fd < 0)
+    {
+        sprintf (errmsg, "Opening %.900s: %s", file_name, strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (backend == IO_MMAP)
+    {
+        if (write_op && ftruncate (this->fd, size) != 0)
+        {
+            sprintf (errmsg, "Sizing %.900s: %s", file_name, strerror (errno));
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        this->map = mmap (NULL, size, write_op ? PROT_READ | PROT_WRITE :
+            PROT_READ, MAP_SHARED, this->fd, 0);
+        if (this->map == MAP_FAILED)
+        {
+            this->map = NULL;
+            sprintf (errmsg, "Mapping %.900s: %s", file_name, strerror (errno));
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* The bounce buffer holds a strip plus the unaligned ends around it */
+    if (backend == IO_DIRECT)
+    {
+        this->bounce_size = (strip_bytes + 2 * DIRECT_ALIGN - 1) /
+            DIRECT_ALIGN * DIRECT_ALIGN + DIRECT_ALIGN;
+        if (posix_memalign ((void **) &this->bounce, DIRECT_ALIGN,
+            this->bounce_size) != 0)
+        {
+            this->bounce = NULL;
+            sprintf (errmsg, "Allocating the direct I/O buffer");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_bench_strip
+
+PURPOSE:  Reads a strip of a band file, as get_input_refl_lines does.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error reading the strip
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Direct reads cover the aligned blocks around the strip, which is then
+     copied out of the bounce buffer.
+******************************************************************************/
+static int read_bench_strip
+(
+    Bench_file_t *this,      /* I: band file */
+    size_t off,              /* I: byte offset of the strip */
+    int nlines,              /* I: number of lines in the strip */
+    int nsamps,              /* I: number of samples in each line */
+    int16 *buf               /* O: strip */
+)
+{
+    size_t len = (size_t) nlines * nsamps * sizeof (int16);  /* strip bytes */
+    size_t start;             /* aligned start of a direct read */
+    size_t end;               /* aligned end of a direct read */
+    ssize_t n;                /* bytes read by one call */
+
+    switch (this->backend)
+    {
+        case IO_STDIO:
+            if (fseek (this->fp, off, SEEK_SET))
+                return (ERROR);
+            return (read_raw_binary (this->fp, nlines, nsamps,
+                sizeof (int16), buf));
+
+        case IO_PREAD:
+            return (full_io (this->fd, false, (char *) buf, len, off));
+
+        case IO_MMAP:
+            memcpy (buf, this->map + off, len);
+            return (SUCCESS);
+
+        case IO_DIRECT:
+            start = off / DIRECT_ALIGN * DIRECT_ALIGN;
+            end = (off + len + DIRECT_ALIGN - 1) / DIRECT_ALIGN *
+                DIRECT_ALIGN;
+            while (start < end)
+            {
+                n = pread (this->fd, this->bounce + (start - off /
+                    DIRECT_ALIGN * DIRECT_ALIGN), end - start, start);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    break;
+                start += n;
+            }
+            if (start < off + len)
+                return (ERROR);
+            memcpy (buf, this->bounce + off % DIRECT_ALIGN, len);
+            return (SUCCESS);
+
+        default:
+            return (ERROR);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  write_bench_strip
+
+PURPOSE:  Writes the next strip of a band file, as put_output_line does.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error writing the strip
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Strips are written in order from the start of the file.
+  2. Mapped strips are flushed asynchronously and dropped a page at a time,
+     as with --mmap_output.
+  3. Direct writes go out in whole aligned blocks; the tail of each strip is
+     carried in the bounce buffer until the next strip completes the block.
+******************************************************************************/
+static int write_bench_strip
+(
+    Bench_file_t *this,      /* I/O: band file */
+    size_t off,              /* I: byte offset of the strip */
+    int nlines,              /* I: number of lines in the strip */
+    int nsamps,              /* I: number of samples in each line */
+    int16 *buf               /* I: strip */
+)
+{
+    size_t len = (size_t) nlines * nsamps * sizeof (int16);  /* strip bytes */
+    size_t end;               /* end of the flushed pages or aligned blocks */
+    size_t page_size;         /* system page size */
+
+    switch (this->backend)
+    {
+        case IO_STDIO:
+            return (write_raw_binary (this->fp, nlines, nsamps,
+                sizeof (int16), buf));
+
+        case IO_PREAD:
+            return (full_io (this->fd, true, (char *) buf, len, off));
+
+        case IO_MMAP:
+            memcpy (this->map + off, buf, len);
+            page_size = (size_t) sysconf (_SC_PAGESIZE);
+            end = off + len;
+            if (end < this->size)
+                end = end / page_size * page_size;
+            if (end > this->flushed)
+            {
+                if (msync (this->map + this->flushed, end - this->flushed,
+                    MS_ASYNC) != 0 || madvise (this->map + this->flushed,
+                    end - this->flushed, MADV_DONTNEED) != 0)
+                    return (ERROR);
+                this->flushed = end;
+            }
+            return (SUCCESS);
+
+        case IO_DIRECT:
+            memcpy (this->bounce + this->carry, buf, len);
+            this->carry += len;
+            end = this->carry / DIRECT_ALIGN * DIRECT_ALIGN;
+            if (end > 0)
+            {
+                if (full_io (this->fd, true, this->bounce, end,
+                    this->written) != SUCCESS)
+                    return (ERROR);
+                this->written += end;
+                this->carry -= end;
+                memmove (this->bounce, this->bounce + end, this->carry);
+            }
+            return (SUCCESS);
+
+        default:
+            return (ERROR);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  close_bench_file
+
+PURPOSE:  Flushes a band file to storage if it was written, drops it from the
+page cache, and closes it.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error flushing the file
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The partial block left in a direct write is written padded, and the
+     file is truncated back to the band size.
+******************************************************************************/
+static int close_bench_file
+(
+    Bench_file_t *this,      /* I/O: band file */
+    bool write_op            /* I: was the file written? */
+)
+{
+    int status = SUCCESS;     /* return status */
+    int fd;                   /* descriptor of the file */
+    size_t pad;               /* size of the padded last block */
+
+    if (write_op && this->backend == IO_DIRECT && this->carry > 0)
+    {
+        pad = (this->carry + DIRECT_ALIGN - 1) / DIRECT_ALIGN * DIRECT_ALIGN;
+        memset (this->bounce + this->carry, 0, pad - this->carry);
+        if (full_io (this->fd, true, this->bounce, pad, this->written) !=
+            SUCCESS || ftruncate (this->fd, this->size) != 0)
+            status = ERROR;
+    }
+
+    if (this->map != NULL)
+    {
+        if (write_op && msync (this->map, this->size, MS_SYNC) != 0)
+            status = ERROR;
+        munmap (this->map, this->size);
+    }
+
+    fd = this->fp != NULL ? fileno (this->fp) : this->fd;
+    if (this->fp != NULL && write_op && fflush (this->fp) != 0)
+        status = ERROR;
+    if (fd >= 0)
+    {
+        if (write_op && fsync (fd) != 0)
+            status = ERROR;
+        posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED);
+    }
+
+    if (this->fp != NULL)
+        close_raw_binary (this->fp);
+    else if (this->fd >= 0)
+        close (this->fd);
+    free (this->bounce);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  bench_strips
+
+PURPOSE:  Replays the strip reads or writes of a scene against a backend.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error opening, reading, or writing the band files
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. All the band files are opened up front and closed (and flushed) at the
+     end, within the timed region, as the application does.
+******************************************************************************/
+static int bench_strips
+(
+    Io_backend_t backend,    /* I: I/O backend */
+    bool write_op,           /* I: write?  Otherwise read */
+    char *dir,               /* I: directory for the band files */
+    int nlines,              /* I: number of lines in each band */
+    int nsamps,              /* I: number of samples in each band */
+    int nbands,              /* I: number of bands */
+    int strip,               /* I: number of lines in each strip */
+    Bench_result_t *result   /* O: timing of the run; lat is allocated */
+)
+{
+    char FUNC_NAME[] = "bench_strips";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char file_name[STR_SIZE]; /* name of the current band file */
+    int line;                 /* first line of the current strip */
+    int nl;                   /* number of lines in the current strip */
+    int ib;                   /* looping variable for bands */
+    int nopened = 0;          /* number of band files opened */
+    int status = SUCCESS;     /* return status */
+    long pix;                 /* looping variable for pixels */
+    size_t size = (size_t) nlines * nsamps * sizeof (int16); /* band bytes */
+    size_t off;               /* byte offset of the current strip */
+    double cpu0;              /* CPU time at the start */
+    int16 *buf = NULL;        /* strip buffer */
+    Bench_file_t *files = NULL; /* band files */
+    struct timespec t0;       /* start of the run */
+    struct timespec ts;       /* start of the current strip */
+
+    memset (result, 0, sizeof (*result));
+    result->lat = malloc ((size_t) nbands * ((nlines + strip - 1) / strip) *
+        sizeof (double));
+    files = calloc (nbands, sizeof (Bench_file_t));
+    buf = malloc ((size_t) strip * nsamps * sizeof (int16));
+    if (result->lat == NULL || files == NULL || buf == NULL)
+    {
+        free (result->lat);
+        result->lat = NULL;
+        free (files);
+        free (buf);
+        sprintf (errmsg, "Allocating the benchmark buffers");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (pix = 0; pix < (long) strip * nsamps; pix++)
+        buf[pix] = (int16) (pix % 20001 - 10000);
+
+    cpu0 = cpu_seconds ();
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    for (ib = 0; ib < nbands && status == SUCCESS; ib++)
+    {
+        bench_file_name (dir, ib, file_name);
+        status = open_bench_file (backend, file_name, write_op, size,
+            (size_t) strip * nsamps * sizeof (int16), &files[ib]);
+        if (status == SUCCESS)
+            nopened++;
+        else if (files[ib].fd >= 0)
+            close (files[ib].fd);
+    }
+
+    for (line = 0; line < nlines && status == SUCCESS; line += strip)
+    {
+        nl = line + strip > nlines ? nlines - line : strip;
+        off = (size_t) line * nsamps * sizeof (int16);
+        for (ib = 0; ib < nbands && status == SUCCESS; ib++)
+        {
+            clock_gettime (CLOCK_MONOTONIC, &ts);
+            if (write_op)
+                status = write_bench_strip (&files[ib], off, nl, nsamps, buf);
+            else
+                status = read_bench_strip (&files[ib], off, nl, nsamps, buf);
+            result->lat[result->nops++] = elapsed_since (&ts);
+            result->nbytes += (long long) nl * nsamps * sizeof (int16);
+        }
+    }
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "%s strip at line %d with %s: %s", write_op ?
+            "Writing" : "Reading", line, io_backend_name (backend),
+            strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+
+    for (ib = 0; ib < nopened; ib++)
+    {
+        if (close_bench_file (&files[ib], write_op) != SUCCESS &&
+            status == SUCCESS)
+        {
+            sprintf (errmsg, "Flushing band %d with %s", ib + 1,
+                io_backend_name (backend));
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+    result->elapsed = elapsed_since (&t0);
+    result->cpu = cpu_seconds () - cpu0;
+
+    free (files);
+    free (buf);
+    if (status != SUCCESS)
+    {
+        free (result->lat);
+        result->lat = NULL;
+    }
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  bench_write
+
+PURPOSE:  Replays the strip writes of the index bands against a backend.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error writing the band files
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+int bench_write
+(
+    Io_backend_t backend,    /* I: I/O backend */
+    char *dir,               /* I: directory to write the band files to */
+    int nlines,              /* I: number of lines in each band */
+    int nsamps,              /* I: number of samples in each band */
+    int nbands,              /* I: number of bands */
+    int strip,               /* I: number of lines in each strip */
+    Bench_result_t *result   /* O: timing of the run; lat is allocated */
+)
+{
+    return (bench_strips (backend, true, dir, nlines, nsamps, nbands, strip,
+        result));
+}
+
+
+/******************************************************************************
+MODULE:  bench_read
+
+PURPOSE:  Replays the strip reads of the reflectance bands against a backend.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error reading the band files
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+int bench_read
+(
+    Io_backend_t backend,    /* I: I/O backend */
+    char *dir,               /* I: directory holding the band files */
+    int nlines,              /* I: number of lines in each band */
+    int nsamps,              /* I: number of samples in each band */
+    int nbands,              /* I: number of bands */
+    int strip,               /* I: number of lines in each strip */
+    Bench_result_t *result   /* O: timing of the run; lat is allocated */
+)
+{
+    return (bench_strips (backend, false, dir, nlines, nsamps, nbands, strip,
+        result));
+}
+
+
+/******************************************************************************
+MODULE:  bench_kernels
+
+PURPOSE:  Times the kernel of each spectral index over the strips of a
+scene.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error allocating the strip buffers
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The input bands are synthetic reflectance, uniform over 0 to 10000
+     with a fixed seed, so the rates don't depend on a scene being at hand.
+     No pixels are fill or saturated, which is the slow path of every
+     kernel.
+  2. Each index is run once per strip on one thread, the way
+     spectral_indices calls compute_spectral_index.
+******************************************************************************/
+int bench_kernels
+(
+    int nlines,              /* I: number of lines in the scene */
+    int nsamps,              /* I: number of samples in the scene */
+    int strip,               /* I: number of lines in each strip */
+    double mpix_per_sec[NUM_SI] /* O: kernel rate of each index in millions
+                                of pixels per second */
+)
+{
+    char FUNC_NAME[] = "bench_kernels";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable for bands */
+    int line;                 /* first line of the current strip */
+    int nstrip;               /* number of lines in the current strip */
+    long pix;                 /* looping variable for pixels */
+    long npix = (long) strip * nsamps;  /* pixels in a full strip */
+    double elapsed;           /* seconds spent in the kernel */
+    int16 *band[MAX_SI_BANDS]; /* synthetic input bands */
+    int16 *spec_indx = NULL;  /* output index strip */
+    Mysi_list_t si;           /* looping variable for indices */
+    struct timespec t0;       /* start of the current strip */
+    unsigned int seed = 1;    /* state of the value generator */
+
+    spec_indx = calloc (npix, sizeof (int16));
+    if (spec_indx == NULL)
+    {
+        sprintf (errmsg, "Allocating the index strip");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (i = 0; i < MAX_SI_BANDS; i++)
+    {
+        band[i] = calloc (npix, sizeof (int16));
+        if (band[i] == NULL)
+        {
+            sprintf (errmsg, "Allocating the input strips");
+            error_handler (true, FUNC_NAME, errmsg);
+            while (--i >= 0)
+                free (band[i]);
+            free (spec_indx);
+            return (ERROR);
+        }
+        for (pix = 0; pix < npix; pix++)
+            band[i][pix] = rand_r (&seed) % 10001;
+    }
+
+    for (si = 0; si < NUM_SI; si++)
+    {
+        elapsed = 0.0;
+        for (line = 0; line < nlines; line += strip)
+        {
+            nstrip = (line + strip > nlines) ? nlines - line : strip;
+            clock_gettime (CLOCK_MONOTONIC, &t0);
+            compute_spectral_index (si, band, SCALE_FACTOR, FILL_VALUE,
+                SATURATE_VALUE, nstrip, nsamps, spec_indx);
+            elapsed += elapsed_since (&t0);
+        }
+        mpix_per_sec[si] = elapsed > 0.0 ?
+            (double) nlines * nsamps / elapsed / 1.0e6 : 0.0;
+    }
+
+    for (i = 0; i < MAX_SI_BANDS; i++)
+        free (band[i]);
+    free (spec_indx);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  compare_double
+
+PURPOSE:  qsort comparison for ascending doubles.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+<0, 0, >0  a is less than, equal to, or greater than b
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static int compare_double
+(
+    const void *a,           /* I: first value */
+    const void *b            /* I: second value */
+)
+{
+    double da = *(const double *) a;   /* first value */
+    double db = *(const double *) b;   /* second value */
+
+    return ((da > db) - (da < db));
+}
+
+
+/******************************************************************************
+MODULE:  print_result
+
+PURPOSE:  Prints the throughput, strip latency percentiles, and CPU time per
+byte of a benchmark run.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Percentiles are nearest rank over the per-band strip operations.
+******************************************************************************/
+void print_result
+(
+    Io_backend_t backend,    /* I: I/O backend */
+    char *op,                /* I: "read" or "write" */
+    Bench_result_t *result   /* I/O: results of the run; lat is sorted */
+)
+{
+    int n = result->nops;     /* number of strip operations */
+
+    qsort (result->lat, n, sizeof (double), compare_double);
+    printf ("%-7s %-6s %10.1f %9.3f %9.3f %9.3f %9.3f %12.4f\n",
+        io_backend_name (backend), op, result->nbytes / (1024.0 * 1024.0) /
+        result->elapsed, 1000.0 * result->lat[(n - 1) * 50 / 100],
+        1000.0 * result->lat[(n - 1) * 90 / 100],
+        1000.0 * result->lat[(n - 1) * 99 / 100],
+        1000.0 * result->lat[n - 1], result->cpu * 1e9 / result->nbytes);
+}
+
+
+/******************************************************************************
+MODULE:  io_bench_usage
+
+PURPOSE:  Prints the usage information for si_io_bench.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void io_bench_usage ()
+{
+    printf ("si_io_bench %s replays the strip reads and writes of "
+            "spectral_indices against each I/O backend and reports the "
+            "throughput, strip latency percentiles, and CPU time per byte, "
+            "so a backend can be chosen for a storage tier.\n\n",
+            INDEX_VERSION);
+    printf ("usage: si_io_bench --dir=directory [--nlines=n] [--nsamps=n] "
+            "[--nbands=n] [--strip=n] [--backend=name [--backend=...]] "
+            "[--mode=read|write|both] [--keep] [--calibration=file]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -dir: directory on the storage tier to benchmark\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -nlines: lines in each band (default is %d)\n",
+            BENCH_NLINES);
+    printf ("    -nsamps: samples in each band (default is %d)\n",
+            BENCH_NSAMPS);
+    printf ("    -nbands: number of int16 band files (default is %d)\n",
+            BENCH_NBANDS);
+    printf ("    -strip: lines in each strip (default is %d, as in "
+            "spectral_indices)\n", PROC_NLINES);
+    printf ("    -backend: stdio, pread, mmap, or direct; may be repeated "
+            "(default is all of them)\n");
+    printf ("    -mode: replay the writes, the reads, or the writes and then "
+            "the reads of the same files (default is both)\n");
+    printf ("    -keep: keep the band files (si_io_bench_b{n}.img), i.e. "
+            "for a later --mode=read run\n");
+    printf ("    -calibration: also time the index kernels and save the "
+            "read, write, and kernel rates to this file for spectral_indices "
+            "--plan\n");
+}
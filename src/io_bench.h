@@ -0,0 +1,111 @@
+#ifndef _IO_BENCH_H_
+#define _IO_BENCH_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "common.h"
+#include "error_handler.h"
+#include "raw_binary_io.h"
+#include "espa_metadata.h"
+
+/* I/O backends which can be benchmarked:
+     stdio   fseek plus read_raw_binary/write_raw_binary, as the application
+             does by default
+     pread   pread/pwrite at the strip offset
+     mmap    copy the strip out of or into a shared mapping of the band file;
+             written pages are flushed and dropped as with --mmap_output
+     direct  O_DIRECT reads and writes through an aligned bounce buffer */
+typedef enum {IO_STDIO=0, IO_PREAD, IO_MMAP, IO_DIRECT,
+  NUM_IO_BACKEND} Io_backend_t;
+
+/* Default scene geometry: a Landsat 8 scene with its seven reflectance
+   bands */
+#define BENCH_NLINES 7801
+#define BENCH_NSAMPS 7651
+#define BENCH_NBANDS 7
+
+/* Alignment of the O_DIRECT offsets, sizes, and buffers */
+#define DIRECT_ALIGN 4096
+
+/* One band file opened with one of the backends */
+typedef struct {
+    Io_backend_t backend;    /* I/O backend */
+    int fd;                  /* file descriptor; -1 for stdio */
+    FILE *fp;                /* file pointer for stdio; NULL otherwise */
+    size_t size;             /* size of the band in bytes */
+    char *map;               /* mapping of the band file for mmap */
+    size_t flushed;          /* bytes of the mapping flushed and dropped */
+    char *bounce;            /* aligned buffer for direct I/O */
+    size_t bounce_size;      /* size of the bounce buffer in bytes */
+    size_t carry;            /* bytes held in the bounce buffer which are
+                                waiting for a full block to be written */
+    size_t written;          /* bytes written to the file with direct I/O */
+} Bench_file_t;
+
+/* Results of one benchmark run of one backend */
+typedef struct {
+    double elapsed;          /* wall time in seconds, including the final
+                                flush to storage for the writes */
+    double cpu;              /* user plus system CPU time in seconds */
+    long long nbytes;        /* number of bytes read or written */
+    int nops;                /* number of strip reads or writes */
+    double *lat;             /* latency of each strip read or write in
+                                seconds */
+} Bench_result_t;
+
+/* Prototypes */
+char *io_backend_name
+(
+    Io_backend_t backend     /* I: I/O backend */
+);
+
+int bench_write
+(
+    Io_backend_t backend,    /* I: I/O backend */
+    char *dir,               /* I: directory to write the band files to */
+    int nlines,              /* I: number of lines in each band */
+    int nsamps,              /* I: number of samples in each band */
+    int nbands,              /* I: number of bands */
+    int strip,               /* I: number of lines in each strip */
+    Bench_result_t *result   /* O: timing of the run; lat is allocated */
+);
+
+int bench_read
+(
+    Io_backend_t backend,    /* I: I/O backend */
+    char *dir,               /* I: directory holding the band files */
+    int nlines,              /* I: number of lines in each band */
+    int nsamps,              /* I: number of samples in each band */
+    int nbands,              /* I: number of bands */
+    int strip,               /* I: number of lines in each strip */
+    Bench_result_t *result   /* O: timing of the run; lat is allocated */
+);
+
+int bench_kernels
+(
+    int nlines,              /* I: number of lines in the scene */
+    int nsamps,              /* I: number of samples in the scene */
+    int strip,               /* I: number of lines in each strip */
+    double mpix_per_sec[NUM_SI] /* O: kernel rate of each index in millions
+                                of pixels per second */
+);
+
+void bench_file_name
+(
+    char *dir,               /* I: directory holding the band files */
+    int iband,               /* I: band (0-based) */
+    char *file_name          /* O: name of the band file; STR_SIZE long */
+);
+
+void print_result
+(
+    Io_backend_t backend,    /* I: I/O backend */
+    char *op,                /* I: "read" or "write" */
+    Bench_result_t *result   /* I/O: results of the run; lat is sorted */
+);
+
+void io_bench_usage ();
+
+#endif
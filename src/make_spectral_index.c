@@ -298,3 +298,220 @@ void make_evi
         }
     }
 }
+
+
+/******************************************************************************
+MODULE:  compute_spectral_index
+
+PURPOSE:  Computes the specified spectral index by calling the kernel for
+that index with the input bands in kernel order.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Use get_index_bands to determine the input bands for the index.
+******************************************************************************/
+void compute_spectral_index
+(
+    Mysi_list_t si,       /* I: spectral index to compute */
+    int16 *band[MAX_SI_BANDS], /* I: input arrays of scaled reflectance data
+                                in kernel order */
+    float scale_factor,   /* I: scale factor for the reflectance values to
+                                unscale the pixels to their true value */
+    int fill_value,       /* I: fill value for the reflectance values */
+    int satu_value,       /* I: saturation value for the reflectance values */
+    int nlines,           /* I: number of lines in the data arrays */
+    int nsamps,           /* I: number of samples in the data arrays */
+    int16 *spec_indx      /* O: output spectral index */
+)
+{
+    switch (si)
+    {
+        case SI_EVI:
+            make_evi (band[0], band[1], band[2], scale_factor, fill_value,
+                satu_value, nlines, nsamps, spec_indx);
+            break;
+
+        case SI_SAVI:
+            make_savi (band[0], band[1], scale_factor, fill_value,
+                satu_value, nlines, nsamps, spec_indx);
+            break;
+
+        case SI_MSAVI:
+            make_modified_savi (band[0], band[1], scale_factor, fill_value,
+                satu_value, nlines, nsamps, spec_indx);
+            break;
+
+        default:
+            /* NDVI, NDMI, NBR, NBR2, NDRE, PRI, and CCI are all normalized
+               differences */
+            make_spectral_index (band[0], band[1], fill_value, satu_value,
+                nlines, nsamps, spec_indx);
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  make_index_lut
+
+PURPOSE:  Builds the lookup table of a two-band spectral index for 8-bit
+inputs by running the index kernel over every pair of input values.
+
+RETURN VALUE:
+Type = int16 *
+Value      Description
+-----      -----------
+NULL       The index isn't a two-band index, or the table couldn't be
+           allocated
+non-NULL   DN_LUT_SIZE table indexed by (band1 << 8) | band2
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The table is filled by the same kernel used for the int16 inputs, so
+     the fill and saturation handling, clamping, and rounding are identical.
+  2. EVI needs three bands and has no table; it is computed with
+     compute_spectral_index on the widened input.
+  3. The caller is responsible for freeing the table.
+******************************************************************************/
+int16 *make_index_lut
+(
+    Mysi_list_t si,       /* I: spectral index */
+    float scale_factor,   /* I: scale factor for the 8-bit values to unscale
+                                the pixels to their true value */
+    int fill_value,       /* I: fill value for the 8-bit values */
+    int satu_value        /* I: saturation value for the 8-bit values */
+)
+{
+    int i;                  /* looping variable for the table entries */
+    int16 *lut = NULL;      /* lookup table */
+    int16 *pair = NULL;     /* every pair of input values */
+    int16 *band[MAX_SI_BANDS];  /* input arrays in kernel order */
+
+    if (si == SI_EVI)
+        return (NULL);
+
+    lut = malloc (DN_LUT_SIZE * sizeof (int16));
+    pair = malloc (2 * DN_LUT_SIZE * sizeof (int16));
+    if (lut == NULL || pair == NULL)
+    {
+        free (lut);
+        free (pair);
+        return (NULL);
+    }
+
+    band[0] = pair;
+    band[1] = pair + DN_LUT_SIZE;
+    band[2] = NULL;
+    for (i = 0; i < DN_LUT_SIZE; i++)
+    {
+        band[0][i] = i >> 8;
+        band[1][i] = i & 0xff;
+    }
+    compute_spectral_index (si, band, scale_factor, fill_value, satu_value,
+        256, 256, lut);
+
+    free (pair);
+    return (lut);
+}
+
+
+/******************************************************************************
+MODULE:  apply_index_lut
+
+PURPOSE:  Computes a two-band spectral index for 8-bit inputs with the lookup
+table built by make_index_lut.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Input and output arrays are 1D arrays of size nlines * nsamps.
+  2. The 128 KB table stays in cache, so the loop is bound by the reads of
+     the two bands rather than the divide in the kernels.
+******************************************************************************/
+void apply_index_lut
+(
+    int16 *lut,           /* I: lookup table from make_index_lut */
+    uint8 *band1,         /* I: input array of 8-bit data for the first
+                                kernel band */
+    uint8 *band2,         /* I: input array of 8-bit data for the second
+                                kernel band */
+    int nlines,           /* I: number of lines in the data arrays */
+    int nsamps,           /* I: number of samples in the data arrays */
+    int16 *spec_indx      /* O: output spectral index */
+)
+{
+    int pix;                /* current pixel being processed */
+
+    for (pix = 0; pix < nlines * nsamps; pix++)
+        spec_indx[pix] = lut[(band1[pix] << 8) | band2[pix]];
+}
+
+
+/******************************************************************************
+MODULE:  si_short_name, si_upper_name, si_long_name
+
+PURPOSE:  Return the lower case short name (as used in the output band names),
+the upper case short name (as used in messages), and the long name of the
+specified spectral index.
+
+RETURN VALUE:
+Type = char *
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The returned strings are static and must not be modified or freed.
+******************************************************************************/
+char *si_short_name
+(
+    Mysi_list_t si        /* I: spectral index */
+)
+{
+    static char *names[NUM_SI] = {"ndvi", "evi", "savi", "msavi", "ndmi",
+        "nbr", "nbr2", "ndre", "pri", "cci"};
+
+    return (names[si]);
+}
+
+char *si_upper_name
+(
+    Mysi_list_t si        /* I: spectral index */
+)
+{
+    static char *names[NUM_SI] = {"NDVI", "EVI", "SAVI", "MSAVI", "NDMI",
+        "NBR", "NBR2", "NDRE", "PRI", "CCI"};
+
+    return (names[si]);
+}
+
+char *si_long_name
+(
+    Mysi_list_t si        /* I: spectral index */
+)
+{
+    static char *names[NUM_SI] = {
+        "normalized difference vegetation index",
+        "enhanced vegetation index",
+        "soil adjusted vegetation index",
+        "modified soil adjusted vegetation index",
+        "normalized difference moisture index",
+        "normalized burn ratio",
+        "normalized burn ratio 2",
+        "normalized difference red edge index",
+        "photochemical reflectance index",
+        "chlorophyll/carotenoid index"};
+
+    return (names[si]);
+}
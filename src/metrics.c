@@ -0,0 +1,464 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "error_handler.h"
+#include "metrics.h"
+
+/* Registered metrics, in the order they're written */
+static Metric_t *metric[METRIC_MAX];
+static int nmetric = 0;
+
+/* Shard of the calling thread; -1 until the thread first counts */
+static __thread int metric_shard = -1;
+static int next_shard = 0;
+
+/* Metrics file and the job metrics kept in it */
+static char *metric_file = NULL;
+static double last_flush = -1.0;
+static double job_start = 0.0;
+static Metric_t *job_duration = NULL;
+static Metric_t *job_status = NULL;
+static Metric_t *job_failures = NULL;
+
+/******************************************************************************
+MODULE:  get_metric_time
+
+PURPOSE:  Returns the CLOCK_MONOTONIC time in seconds.
+
+RETURN VALUE:
+Type = double
+Value      Description
+-----      -----------
+>=0        Current time in seconds
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static double get_metric_time ()
+{
+    struct timespec ts;      /* current time */
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec * 1.0e-9);
+}
+
+
+/******************************************************************************
+MODULE:  get_shard
+
+PURPOSE:  Returns the shard of the calling thread, assigning the next one
+round robin the first time the thread counts.
+
+RETURN VALUE:
+Type = Metric_shard_t *
+Value      Description
+-----      -----------
+non-NULL   Shard of the calling thread
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. With no more threads than shards each thread has its own cache line,
+     so the atomic adds never contend.
+******************************************************************************/
+static Metric_shard_t *get_shard
+(
+    Metric_t *this           /* I: metric being counted */
+)
+{
+    if (metric_shard < 0)
+        metric_shard = __atomic_fetch_add (&next_shard, 1, __ATOMIC_RELAXED)
+            % METRIC_NSHARD;
+    return (&this->shard[metric_shard]);
+}
+
+
+/******************************************************************************
+MODULE:  add_metric
+
+PURPOSE:  Registers a counter, gauge, or histogram with a set of labels.
+
+RETURN VALUE:
+Type = Metric_t *
+Value      Description
+-----      -----------
+NULL       Too many metrics, too many buckets, or error allocating memory
+non-NULL   Metric to count with
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Metrics with the same name should be registered one after another, so
+     the HELP and TYPE lines are written once for all of their labels.
+  2. Register the metrics before the threads which count them are started.
+******************************************************************************/
+Metric_t *add_metric
+(
+    Metric_type_t type,      /* I: kind of metric */
+    char *name,              /* I: metric name */
+    char *help,              /* I: help text */
+    char *labels,            /* I: labels without the braces; NULL if none */
+    const double *bound,     /* I: upper bound of each histogram bucket;
+                                NULL for counters and gauges */
+    int nbucket              /* I: number of histogram buckets */
+)
+{
+    char FUNC_NAME[] = "add_metric";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Metric_t *this = NULL;    /* new metric */
+
+    if (nmetric == METRIC_MAX || nbucket > METRIC_MAX_BUCKET)
+    {
+        sprintf (errmsg, "Too many metrics or buckets registering %.900s",
+            name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    /* The shards need their own cache lines */
+    this = aligned_alloc (64, sizeof (Metric_t));
+    if (this == NULL)
+    {
+        sprintf (errmsg, "Allocating metric %.900s", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    memset (this, 0, sizeof (Metric_t));
+    snprintf (this->name, sizeof (this->name), "%s", name);
+    snprintf (this->help, sizeof (this->help), "%s", help);
+    snprintf (this->labels, sizeof (this->labels), "%s",
+        labels != NULL ? labels : "");
+    this->type = type;
+    if (type == METRIC_HISTOGRAM)
+    {
+        this->nbucket = nbucket;
+        memcpy (this->bound, bound, nbucket * sizeof (double));
+    }
+
+    metric[nmetric++] = this;
+    return (this);
+}
+
+
+/******************************************************************************
+MODULE:  metric_add
+
+PURPOSE:  Adds to a counter in the shard of the calling thread.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void metric_add
+(
+    Metric_t *this,          /* I/O: counter; nothing is done if NULL */
+    int64_t n                /* I: amount to add */
+)
+{
+    if (this == NULL)
+        return;
+    __atomic_fetch_add (&get_shard (this)->count[0], n, __ATOMIC_RELAXED);
+}
+
+
+/******************************************************************************
+MODULE:  metric_set
+
+PURPOSE:  Sets a gauge.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Gauges are last writer wins; the caller serializes the writers if the
+     order matters.
+******************************************************************************/
+void metric_set
+(
+    Metric_t *this,          /* I/O: gauge; nothing is done if NULL */
+    double value             /* I: new value */
+)
+{
+    if (this == NULL)
+        return;
+    this->value = value;
+}
+
+
+/******************************************************************************
+MODULE:  metric_observe
+
+PURPOSE:  Counts an observation in its histogram bucket in the shard of the
+calling thread.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The buckets are counted individually and made cumulative when
+     written.
+******************************************************************************/
+void metric_observe
+(
+    Metric_t *this,          /* I/O: histogram; nothing is done if NULL */
+    double value             /* I: observed value */
+)
+{
+    int i;                   /* bucket of the value */
+    Metric_shard_t *shard = NULL;  /* shard of the calling thread */
+
+    if (this == NULL)
+        return;
+
+    for (i = 0; i < this->nbucket && value > this->bound[i]; i++)
+        ;
+    shard = get_shard (this);
+    __atomic_fetch_add (&shard->count[i], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&shard->sum, (int64_t) (value * METRIC_SUM_SCALE),
+        __ATOMIC_RELAXED);
+}
+
+
+/******************************************************************************
+MODULE:  write_metrics
+
+PURPOSE:  Writes the registered metrics in the Prometheus text format,
+adding up the shards.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void write_metrics
+(
+    FILE *fp                 /* I: stream to write the text format to */
+)
+{
+    static char *type_name[] = {"counter", "gauge", "histogram"};
+    int i;                   /* looping variable for metrics */
+    int b;                   /* looping variable for buckets */
+    int s;                   /* looping variable for shards */
+    int64_t count;           /* counter value or cumulative bucket count */
+    int64_t sum;             /* histogram sum in millionths */
+    Metric_t *this = NULL;   /* current metric */
+    char *sep = NULL;        /* separator between the labels and le */
+
+    for (i = 0; i < nmetric; i++)
+    {
+        this = metric[i];
+        if (i == 0 || strcmp (this->name, metric[i-1]->name))
+        {
+            fprintf (fp, "# HELP %s %s\n", this->name, this->help);
+            fprintf (fp, "# TYPE %s %s\n", this->name,
+                type_name[this->type]);
+        }
+
+        if (this->type == METRIC_GAUGE)
+        {
+            fprintf (fp, "%s%s%s%s %.15g\n", this->name,
+                this->labels[0] ? "{" : "", this->labels,
+                this->labels[0] ? "}" : "", this->value);
+        }
+        else if (this->type == METRIC_COUNTER)
+        {
+            count = 0;
+            for (s = 0; s < METRIC_NSHARD; s++)
+                count += __atomic_load_n (&this->shard[s].count[0],
+                    __ATOMIC_RELAXED);
+            fprintf (fp, "%s%s%s%s %lld\n", this->name,
+                this->labels[0] ? "{" : "", this->labels,
+                this->labels[0] ? "}" : "", (long long) count);
+        }
+        else
+        {
+            sep = this->labels[0] ? "," : "";
+            count = 0;
+            for (b = 0; b <= this->nbucket; b++)
+            {
+                for (s = 0; s < METRIC_NSHARD; s++)
+                    count += __atomic_load_n (&this->shard[s].count[b],
+                        __ATOMIC_RELAXED);
+                if (b < this->nbucket)
+                    fprintf (fp, "%s_bucket{%s%sle=\"%g\"} %lld\n",
+                        this->name, this->labels, sep, this->bound[b],
+                        (long long) count);
+                else
+                    fprintf (fp, "%s_bucket{%s%sle=\"+Inf\"} %lld\n",
+                        this->name, this->labels, sep, (long long) count);
+            }
+
+            sum = 0;
+            for (s = 0; s < METRIC_NSHARD; s++)
+                sum += __atomic_load_n (&this->shard[s].sum,
+                    __ATOMIC_RELAXED);
+            fprintf (fp, "%s_sum%s%s%s %.9g\n", this->name,
+                this->labels[0] ? "{" : "", this->labels,
+                this->labels[0] ? "}" : "", sum / METRIC_SUM_SCALE);
+            fprintf (fp, "%s_count%s%s%s %lld\n", this->name,
+                this->labels[0] ? "{" : "", this->labels,
+                this->labels[0] ? "}" : "", (long long) count);
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  metrics_exit_handler
+
+PURPOSE:  Records the exit status and duration of the job and rewrites the
+metrics file one last time.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static void metrics_exit_handler
+(
+    int status,              /* I: exit status */
+    void *arg                /* I: not used */
+)
+{
+    metric_set (job_status, status);
+    if (status == ERROR)
+        metric_add (job_failures, 1);
+    flush_metrics_file (true);
+}
+
+
+/******************************************************************************
+MODULE:  open_metrics_file
+
+PURPOSE:  Sets up the metrics file, registering the job start time,
+duration, exit status, and failures, and writes it for the first time.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error registering the metrics or writing the file
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The file is rewritten one last time when the program exits, with the
+     exit status.  A job which is killed is left with an exit status of -1.
+  2. The name is copied, since the exit handler needs it after the caller
+     has freed its arguments.
+******************************************************************************/
+int open_metrics_file
+(
+    char *file               /* I: file to keep the metrics in */
+)
+{
+    Metric_t *start = NULL;  /* start time of the job */
+
+    metric_file = strdup (file);
+    if (metric_file == NULL)
+        return (ERROR);
+    job_start = get_metric_time ();
+
+    start = add_metric (METRIC_GAUGE, "si_job_start_time_seconds",
+        "Start time of the job since the epoch.", NULL, NULL, 0);
+    job_duration = add_metric (METRIC_GAUGE, "si_job_duration_seconds",
+        "Time the job has been running.", NULL, NULL, 0);
+    job_status = add_metric (METRIC_GAUGE, "si_job_exit_status",
+        "Exit status of the job; -1 while it's running.", NULL, NULL, 0);
+    job_failures = add_metric (METRIC_COUNTER, "si_job_failures_total",
+        "Jobs which exited with an error.", NULL, NULL, 0);
+    if (start == NULL || job_duration == NULL || job_status == NULL ||
+        job_failures == NULL)
+        return (ERROR);
+    metric_set (start, (double) time (NULL));
+    metric_set (job_status, -1);
+
+    on_exit (metrics_exit_handler, NULL);
+    return (flush_metrics_file (true));
+}
+
+
+/******************************************************************************
+MODULE:  flush_metrics_file
+
+PURPOSE:  Rewrites the metrics file if METRIC_INTERVAL has passed since it
+was last written.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error writing the file
+SUCCESS    Successful completion, or there's no metrics file
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The metrics are written to {file}.tmp and renamed over the file, so a
+     collector (i.e. the node exporter textfile collector) never reads a
+     partial file.
+  2. A failed write is only a warning; the next one may succeed.
+******************************************************************************/
+int flush_metrics_file
+(
+    bool force               /* I: rewrite even if METRIC_INTERVAL hasn't
+                                passed? */
+)
+{
+    char FUNC_NAME[] = "flush_metrics_file";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char tmp_file[STR_SIZE];  /* file the metrics are written to */
+    double now;               /* current time */
+    FILE *fp = NULL;          /* temporary metrics file */
+
+    if (metric_file == NULL)
+        return (SUCCESS);
+    now = get_metric_time ();
+    if (!force && now - last_flush < METRIC_INTERVAL)
+        return (SUCCESS);
+    last_flush = now;
+    metric_set (job_duration, now - job_start);
+
+    snprintf (tmp_file, sizeof (tmp_file), "%s.tmp", metric_file);
+    fp = fopen (tmp_file, "w");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening metrics file %.900s", tmp_file);
+        error_handler (false, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    write_metrics (fp);
+    if (fclose (fp) != 0 || rename (tmp_file, metric_file) != 0)
+    {
+        sprintf (errmsg, "Writing metrics file %.900s", metric_file);
+        error_handler (false, FUNC_NAME, errmsg);
+        unlink (tmp_file);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
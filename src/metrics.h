@@ -0,0 +1,103 @@
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "common.h"
+#include "espa_metadata.h"
+
+/* Most metrics (each label set counts as one) a program can register */
+#define METRIC_MAX 64
+
+/* Number of counter shards; threads are spread over them round robin */
+#define METRIC_NSHARD 16
+
+/* Most histogram buckets, not counting +Inf */
+#define METRIC_MAX_BUCKET 15
+
+/* Histogram sums are kept in millionths so the shards can be added with
+   integer atomics */
+#define METRIC_SUM_SCALE 1.0e6
+
+/* Minimum number of seconds between rewrites of the metrics file */
+#define METRIC_INTERVAL 1.0
+
+/* Kinds of metrics, as named in the text format */
+typedef enum {METRIC_COUNTER=0, METRIC_GAUGE, METRIC_HISTOGRAM}
+  Metric_type_t;
+
+/* Counts of one shard, on a cache line of its own.  A counter uses count[0];
+   a histogram uses a count per bucket and the sum. */
+typedef struct {
+    int64_t count[METRIC_MAX_BUCKET + 1]; /* count in each bucket; the last
+                                used one is +Inf */
+    int64_t sum;             /* sum of the observations, in millionths */
+} __attribute__ ((aligned (64))) Metric_shard_t;
+
+/* One metric with one set of labels */
+typedef struct {
+    char name[STR_SIZE];     /* metric name */
+    char help[STR_SIZE];     /* help text */
+    char labels[STR_SIZE];   /* labels without the braces, i.e.
+                                index="ndvi"; empty if none */
+    Metric_type_t type;      /* kind of metric */
+    int nbucket;             /* number of histogram buckets, not counting
+                                +Inf */
+    double bound[METRIC_MAX_BUCKET]; /* upper bound of each bucket */
+    double value;            /* value of a gauge */
+    Metric_shard_t shard[METRIC_NSHARD]; /* counts of each shard */
+} Metric_t;
+
+/* Histogram buckets for durations in seconds */
+#define METRIC_SECONDS_BUCKETS {0.001, 0.005, 0.01, 0.025, 0.05, 0.1, \
+  0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0}
+#define METRIC_SECONDS_NBUCKET 14
+
+/* Prototypes */
+Metric_t *add_metric
+(
+    Metric_type_t type,      /* I: kind of metric */
+    char *name,              /* I: metric name */
+    char *help,              /* I: help text */
+    char *labels,            /* I: labels without the braces; NULL if none */
+    const double *bound,     /* I: upper bound of each histogram bucket;
+                                NULL for counters and gauges */
+    int nbucket              /* I: number of histogram buckets */
+);
+
+void metric_add
+(
+    Metric_t *this,          /* I/O: counter; nothing is done if NULL */
+    int64_t n                /* I: amount to add */
+);
+
+void metric_set
+(
+    Metric_t *this,          /* I/O: gauge; nothing is done if NULL */
+    double value             /* I: new value */
+);
+
+void metric_observe
+(
+    Metric_t *this,          /* I/O: histogram; nothing is done if NULL */
+    double value             /* I: observed value */
+);
+
+void write_metrics
+(
+    FILE *fp                 /* I: stream to write the text format to */
+);
+
+int open_metrics_file
+(
+    char *file               /* I: file to keep the metrics in */
+);
+
+int flush_metrics_file
+(
+    bool force               /* I: rewrite even if METRIC_INTERVAL hasn't
+                                passed? */
+);
+
+#endif
@@ -0,0 +1,756 @@
+#include <getopt.h>
+#include <math.h>
+#include "mosaic.h"
+
+/******************************************************************************
+MODULE:  si_mosaic
+
+PURPOSE:  Computes the specified spectral indices for several adjacent scenes
+and writes them as one mosaic on a common grid, in a single pass.  Each
+output strip is built by reading the overlapping strips of the input scenes,
+computing the indices, and resolving the overlaps with the specified rule.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An error occurred during processing of the mosaic
+SUCCESS         Processing was successful
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The scenes must be in the same projection (and UTM zone).  They are
+     resampled to the grid with nearest neighbor, so they may have different
+     pixel sizes.
+  2. The products are output as {output}_{sr|toa}_{index}.img with an ENVI
+     header.  Grid pixels not covered by any valid scene pixel are fill.
+  3. Only one scene is open at a time, and only the reflectance bands the
+     indices need are read, so memory is bounded by the strip size and
+     doesn't grow with the number of scenes.
+******************************************************************************/
+int main (int argc, char *argv[])
+{
+    bool verbose = false;      /* verbose flag */
+    bool toa = false;          /* process the TOA bands instead of SR? */
+    char FUNC_NAME[] = "main"; /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char *xml_files[MAX_MOSAIC_SCENES]; /* input XML files */
+    char *output = NULL;       /* base name of the mosaic products */
+    char *grid_spec = NULL;    /* target grid from the command line */
+    char *cptr = NULL;         /* pointer to the file extension */
+    char img_file[MAX_OUT_BANDS][STR_SIZE]; /* mosaic band files */
+    char envi_file[STR_SIZE];  /* name of the output ENVI header file */
+    int nscene = 0;            /* number of input scenes */
+    int nsi = 0;               /* number of indices to compute */
+    int c;                     /* current argument */
+    int option_index;          /* index for the command-line option */
+    int i, j;                  /* looping variables */
+    int line;                  /* first line of the current strip */
+    int nlines_proc;           /* number of lines in the current strip */
+    static int si_opt[NUM_SI]; /* index flags from the command line */
+    Mysi_list_t si_order[NUM_SI] = {SI_NDVI, SI_EVI, SI_NDMI, SI_SAVI,
+        SI_MSAVI, SI_NBR, SI_NBR2, SI_NDRE, SI_PRI, SI_CCI};
+                               /* order of the output index bands */
+    Mysi_list_t si_list[NUM_SI]; /* indices to compute */
+    Overlap_rule_t rule = OVERLAP_FIRST; /* overlap rule */
+    Mosaic_scene_t *scene = NULL; /* input scenes */
+    Mosaic_scene_t tmp_scene;  /* scene being moved while sorting */
+    Mosaic_grid_t grid;        /* target grid */
+    int16 *mosaic[MAX_OUT_BANDS]; /* one strip of each mosaic band */
+    FILE *fp_out[MAX_OUT_BANDS]; /* mosaic band files */
+    Espa_band_meta_t bmeta;    /* band metadata for the ENVI headers */
+    Espa_global_meta_t gmeta;  /* global metadata for the ENVI headers */
+    Envi_header_t envi_hdr;    /* output ENVI header information */
+    static struct option long_options[] =
+    {
+        {"ndvi", no_argument, &si_opt[SI_NDVI], 1},
+        {"evi", no_argument, &si_opt[SI_EVI], 1},
+        {"savi", no_argument, &si_opt[SI_SAVI], 1},
+        {"msavi", no_argument, &si_opt[SI_MSAVI], 1},
+        {"ndmi", no_argument, &si_opt[SI_NDMI], 1},
+        {"nbr", no_argument, &si_opt[SI_NBR], 1},
+        {"nbr2", no_argument, &si_opt[SI_NBR2], 1},
+        {"ndre", no_argument, &si_opt[SI_NDRE], 1},
+        {"pri", no_argument, &si_opt[SI_PRI], 1},
+        {"cci", no_argument, &si_opt[SI_CCI], 1},
+        {"xml", required_argument, 0, 'i'},
+        {"output", required_argument, 0, 'o'},
+        {"grid", required_argument, 0, 'g'},
+        {"overlap", required_argument, 0, 'r'},
+        {"toa", no_argument, 0, 't'},
+        {"verbose", no_argument, 0, 'b'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Read the command-line arguments */
+    opterr = 0;
+    while ((c = getopt_long (argc, argv, "", long_options, &option_index))
+        != -1)
+    {
+        switch (c)
+        {
+            case 0:
+                break;
+            case 'i':
+                if (nscene == MAX_MOSAIC_SCENES)
+                {
+                    sprintf (errmsg, "At most %d scenes may be mosaicked",
+                        MAX_MOSAIC_SCENES);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    exit (ERROR);
+                }
+                xml_files[nscene++] = optarg;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'g':
+                grid_spec = optarg;
+                break;
+            case 'r':
+                if (!strcmp (optarg, "first"))
+                    rule = OVERLAP_FIRST;
+                else if (!strcmp (optarg, "max"))
+                    rule = OVERLAP_MAX;
+                else if (!strcmp (optarg, "recent"))
+                    rule = OVERLAP_RECENT;
+                else
+                {
+                    sprintf (errmsg, "Unknown overlap rule %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    mosaic_usage ();
+                    exit (ERROR);
+                }
+                break;
+            case 't':
+                toa = true;
+                break;
+            case 'b':
+                verbose = true;
+                break;
+            case 'h':
+                mosaic_usage ();
+                exit (SUCCESS);
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                mosaic_usage ();
+                exit (ERROR);
+        }
+    }
+
+    for (i = 0; i < NUM_SI; i++)
+    {
+        if (si_opt[si_order[i]])
+            si_list[nsi++] = si_order[i];
+    }
+    if (nscene == 0 || output == NULL || nsi == 0)
+    {
+        sprintf (errmsg, "At least one --xml, --output, and at least one "
+            "index are required");
+        error_handler (true, FUNC_NAME, errmsg);
+        mosaic_usage ();
+        exit (ERROR);
+    }
+
+    /* Read the scene metadata and footprints */
+    scene = calloc (nscene, sizeof (Mosaic_scene_t));
+    if (scene == NULL)
+    {
+        sprintf (errmsg, "Allocating the scene list");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+    for (i = 0; i < nscene; i++)
+    {
+        if (open_mosaic_scene (xml_files[i], toa, &scene[i]) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading scene %s", xml_files[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        if (scene[i].metadata.global.proj_info.proj_type !=
+            scene[0].metadata.global.proj_info.proj_type ||
+            scene[i].metadata.global.proj_info.utm_zone !=
+            scene[0].metadata.global.proj_info.utm_zone)
+        {
+            sprintf (errmsg, "Scene %s is not in the same projection as %s",
+                xml_files[i], xml_files[0]);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+    }
+
+    /* The most recent rule is the first rule with the scenes ordered by
+       acquisition, newest first; ties keep the command-line order */
+    if (rule == OVERLAP_RECENT)
+    {
+        for (i = 1; i < nscene; i++)
+        {
+            tmp_scene = scene[i];
+            for (j = i; j > 0 && strcmp (scene[j-1].acquired,
+                tmp_scene.acquired) < 0; j--)
+                scene[j] = scene[j-1];
+            scene[j] = tmp_scene;
+        }
+    }
+
+    /* Set up the target grid */
+    if (grid_spec != NULL)
+    {
+        if (sscanf (grid_spec, "%lf,%lf,%lf,%d,%d", &grid.ul[0], &grid.ul[1],
+            &grid.pixsize, &grid.nlines, &grid.nsamps) != 5 ||
+            grid.pixsize <= 0.0 || grid.nlines < 1 || grid.nsamps < 1)
+        {
+            sprintf (errmsg, "Invalid grid %s; expected "
+                "ulx,uly,pixel_size,nlines,nsamps", grid_spec);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+    }
+    else
+        scene_union_grid (scene, nscene, &grid);
+
+    if (verbose)
+    {
+        for (i = 0; i < nscene; i++)
+            printf ("  Scene %d: %s (%s, %d lines, %d samples)\n", i + 1,
+                scene[i].xml_file, scene[i].acquired, scene[i].nlines,
+                scene[i].nsamps);
+        printf ("  Grid: UL %.3f,%.3f, pixel size %g, %d lines, %d "
+            "samples\n", grid.ul[0], grid.ul[1], grid.pixsize, grid.nlines,
+            grid.nsamps);
+        printf ("  Overlap rule: %s\n", rule == OVERLAP_FIRST ? "first" :
+            rule == OVERLAP_MAX ? "max" : "recent");
+    }
+
+    /* Open the mosaic band files and allocate a strip of each */
+    for (i = 0; i < nsi; i++)
+    {
+        snprintf (img_file[i], sizeof (img_file[i]), "%s_%s_%s.img", output,
+            toa ? "toa" : "sr", si_short_name (si_list[i]));
+        fp_out[i] = open_raw_binary (img_file[i], "w");
+        mosaic[i] = malloc ((size_t) PROC_NLINES * grid.nsamps *
+            sizeof (int16));
+        if (fp_out[i] == NULL || mosaic[i] == NULL)
+        {
+            sprintf (errmsg, "Opening mosaic band file %s", img_file[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+    }
+
+    /* Build and write the mosaic a strip at a time */
+    nlines_proc = PROC_NLINES;
+    for (line = 0; line < grid.nlines; line += PROC_NLINES)
+    {
+        if (line + nlines_proc >= grid.nlines)
+            nlines_proc = grid.nlines - line;
+
+        if (mosaic_strip (scene, nscene, &grid, toa, rule, nsi, si_list, line,
+            nlines_proc, mosaic) != SUCCESS)
+        {
+            sprintf (errmsg, "Building the mosaic for line %d", line);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+
+        for (i = 0; i < nsi; i++)
+        {
+            if (write_raw_binary (fp_out[i], nlines_proc, grid.nsamps,
+                sizeof (int16), mosaic[i]) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing mosaic band file %s for line %d",
+                    img_file[i], line);
+                error_handler (true, FUNC_NAME, errmsg);
+                exit (ERROR);
+            }
+        }
+
+        if (verbose)
+        {
+            printf ("  Mosaic -- %% complete: %d%%\r", 100 * (line +
+                nlines_proc) / grid.nlines);
+            fflush (stdout);
+        }
+    }
+    if (verbose)
+        printf ("\n");
+
+    /* Write the ENVI headers, placing the grid in the first scene's
+       projection */
+    gmeta = scene[0].metadata.global;
+    gmeta.proj_info.ul_corner[0] = grid.ul[0];
+    gmeta.proj_info.ul_corner[1] = grid.ul[1];
+    gmeta.proj_info.lr_corner[0] = grid.ul[0] + grid.nsamps * grid.pixsize;
+    gmeta.proj_info.lr_corner[1] = grid.ul[1] - grid.nlines * grid.pixsize;
+    if (!strcmp (gmeta.proj_info.grid_origin, "CENTER"))
+    {
+        gmeta.proj_info.ul_corner[0] += 0.5 * grid.pixsize;
+        gmeta.proj_info.ul_corner[1] -= 0.5 * grid.pixsize;
+        gmeta.proj_info.lr_corner[0] -= 0.5 * grid.pixsize;
+        gmeta.proj_info.lr_corner[1] += 0.5 * grid.pixsize;
+    }
+    for (i = 0; i < nsi; i++)
+    {
+        close_raw_binary (fp_out[i]);
+        free (mosaic[i]);
+
+        memset (&bmeta, 0, sizeof (bmeta));
+        snprintf (bmeta.name, sizeof (bmeta.name), "%s_%s", toa ? "toa" :
+            "sr", si_short_name (si_list[i]));
+        snprintf (bmeta.long_name, sizeof (bmeta.long_name), "%s",
+            si_long_name (si_list[i]));
+        snprintf (bmeta.file_name, sizeof (bmeta.file_name), "%s",
+            img_file[i]);
+        strcpy (bmeta.product, "spectral_indices");
+        strcpy (bmeta.category, "index");
+        strcpy (bmeta.pixel_units, "meters");
+        strcpy (bmeta.data_units, "band ratio index value");
+        bmeta.data_type = ESPA_INT16;
+        bmeta.nlines = grid.nlines;
+        bmeta.nsamps = grid.nsamps;
+        bmeta.pixel_size[0] = grid.pixsize;
+        bmeta.pixel_size[1] = grid.pixsize;
+        bmeta.fill_value = FILL_VALUE;
+        bmeta.saturate_value = SATURATE_VALUE;
+        bmeta.scale_factor = SCALE_FACTOR;
+        bmeta.valid_range[0] = (float) -FLOAT_TO_INT;
+        bmeta.valid_range[1] = (float) FLOAT_TO_INT;
+        if (create_envi_struct (&bmeta, &gmeta, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Creating ENVI header structure.");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+
+        strcpy (envi_file, img_file[i]);
+        cptr = strrchr (envi_file, '.');
+        strcpy (cptr, ".hdr");
+        if (write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing ENVI header file.");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        if (verbose)
+            printf ("  Mosaic written to %s\n", img_file[i]);
+    }
+
+    for (i = 0; i < nscene; i++)
+        free_metadata (&scene[i].metadata);
+    free (scene);
+
+    printf ("Spectral index mosaic complete!\n");
+    exit (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  open_mosaic_scene
+
+PURPOSE:  Reads the metadata for an input scene and works out its footprint.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error reading the XML file or finding the reflectance bands
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The footprint is kept as the outer corner of the upper left pixel, so
+     CENTER grid origins are moved half a pixel out.
+******************************************************************************/
+int open_mosaic_scene
+(
+    char *xml_file,          /* I: XML file for the scene */
+    bool toa,                /* I: use the TOA bands instead of SR? */
+    Mosaic_scene_t *scene    /* O: scene information */
+)
+{
+    char FUNC_NAME[] = "open_mosaic_scene";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int ib;                   /* looping variable for bands */
+    Espa_global_meta_t *gmeta = NULL;  /* global metadata */
+    Espa_band_meta_t *bmeta = NULL;    /* representative band metadata */
+
+    if (validate_xml_file (xml_file) != SUCCESS)
+        return (ERROR);
+    init_metadata_struct (&scene->metadata);
+    if (parse_metadata (xml_file, &scene->metadata) != SUCCESS)
+        return (ERROR);
+    scene->xml_file = xml_file;
+    gmeta = &scene->metadata.global;
+
+    for (ib = 0; ib < scene->metadata.nbands; ib++)
+    {
+        if (!strcmp (scene->metadata.band[ib].name, toa ? "toa_band1" :
+            "sr_band1") && !strcmp (scene->metadata.band[ib].product, toa ?
+            "toa_refl" : "sr_refl"))
+        {
+            bmeta = &scene->metadata.band[ib];
+            break;
+        }
+    }
+    if (bmeta == NULL)
+    {
+        sprintf (errmsg, "Unable to find the %s reflectance bands in %s",
+            toa ? "TOA" : "surface", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    scene->nlines = bmeta->nlines;
+    scene->nsamps = bmeta->nsamps;
+    scene->pixsize[0] = bmeta->pixel_size[0];
+    scene->pixsize[1] = bmeta->pixel_size[1];
+    scene->ul[0] = gmeta->proj_info.ul_corner[0];
+    scene->ul[1] = gmeta->proj_info.ul_corner[1];
+    if (!strcmp (gmeta->proj_info.grid_origin, "CENTER"))
+    {
+        scene->ul[0] -= 0.5 * scene->pixsize[0];
+        scene->ul[1] += 0.5 * scene->pixsize[1];
+    }
+    snprintf (scene->acquired, sizeof (scene->acquired), "%sT%s",
+        gmeta->acquisition_date, gmeta->scene_center_time);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  scene_union_grid
+
+PURPOSE:  Sets up a grid covering all the scenes, at the pixel size of the
+first scene and aligned to its pixels.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void scene_union_grid
+(
+    Mosaic_scene_t *scene,   /* I: input scenes */
+    int nscene,              /* I: number of scenes */
+    Mosaic_grid_t *grid      /* O: grid covering all the scenes at the first
+                                scene's pixel size */
+)
+{
+    int i;                    /* looping variable */
+    double min_x, max_x;      /* horizontal extent of the scenes */
+    double min_y, max_y;      /* vertical extent of the scenes */
+    double ps = scene[0].pixsize[0];  /* grid pixel size */
+
+    min_x = max_x = scene[0].ul[0];
+    min_y = max_y = scene[0].ul[1];
+    for (i = 0; i < nscene; i++)
+    {
+        if (scene[i].ul[0] < min_x)
+            min_x = scene[i].ul[0];
+        if (scene[i].ul[1] > max_y)
+            max_y = scene[i].ul[1];
+        if (scene[i].ul[0] + scene[i].nsamps * scene[i].pixsize[0] > max_x)
+            max_x = scene[i].ul[0] + scene[i].nsamps * scene[i].pixsize[0];
+        if (scene[i].ul[1] - scene[i].nlines * scene[i].pixsize[1] < min_y)
+            min_y = scene[i].ul[1] - scene[i].nlines * scene[i].pixsize[1];
+    }
+
+    /* Snap the corner out to the first scene's pixel grid */
+    grid->pixsize = ps;
+    grid->ul[0] = scene[0].ul[0] - ceil ((scene[0].ul[0] - min_x) / ps - 1e-6)
+        * ps;
+    grid->ul[1] = scene[0].ul[1] + ceil ((max_y - scene[0].ul[1]) / ps - 1e-6)
+        * ps;
+    grid->nsamps = (int) ceil ((max_x - grid->ul[0]) / ps - 1e-6);
+    grid->nlines = (int) ceil ((grid->ul[1] - min_y) / ps - 1e-6);
+}
+
+
+/******************************************************************************
+MODULE:  merge_index_line
+
+PURPOSE:  Merges one line of a scene's index values into a line of the
+mosaic with the overlap rule.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Fill never replaces a value, and saturated values only replace fill.
+  2. For the first and most recent rules the scenes are merged in priority
+     order, so the first valid value is kept.
+******************************************************************************/
+static void merge_index_line
+(
+    Overlap_rule_t rule,     /* I: overlap rule */
+    int16 *src,              /* I: one line of the scene's index */
+    int *col_map,            /* I: scene sample for each grid sample; -1 if
+                                outside the scene */
+    int nsamps,              /* I: number of grid samples */
+    int16 *dst               /* I/O: one line of the mosaic */
+)
+{
+    int samp;                 /* looping variable for grid samples */
+    int16 val;                /* scene index value */
+
+    for (samp = 0; samp < nsamps; samp++)
+    {
+        if (col_map[samp] < 0)
+            continue;
+        val = src[col_map[samp]];
+        if (val == FILL_VALUE)
+            continue;
+
+        if (dst[samp] == FILL_VALUE)
+            dst[samp] = val;
+        else if (val == SATURATE_VALUE)
+            continue;
+        else if (dst[samp] == SATURATE_VALUE)
+            dst[samp] = val;
+        else if (rule == OVERLAP_MAX && val > dst[samp])
+            dst[samp] = val;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  mosaic_strip
+
+PURPOSE:  Builds one strip of each mosaic band from the overlapping strips of
+the input scenes.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error reading a scene
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Each scene under the strip is opened in turn, and its rows under the
+     strip are read PROC_NLINES at a time.  Only the bands needed for the
+     requested indices are read.
+  2. Grid pixels take the scene pixel containing the pixel center (nearest
+     neighbor).
+******************************************************************************/
+int mosaic_strip
+(
+    Mosaic_scene_t *scene,   /* I: input scenes, in priority order */
+    int nscene,              /* I: number of scenes */
+    Mosaic_grid_t *grid,     /* I: target grid */
+    bool toa,                /* I: use the TOA bands instead of SR? */
+    Overlap_rule_t rule,     /* I: overlap rule */
+    int nsi,                 /* I: number of indices */
+    Mysi_list_t *si_list,    /* I: indices to compute */
+    int iline,               /* I: first grid line of the strip */
+    int nlines,              /* I: number of grid lines in the strip */
+    int16 **mosaic           /* O: nlines * grid->nsamps values of each
+                                index */
+)
+{
+    char FUNC_NAME[] = "mosaic_strip";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    bool si_flag[NUM_SI];     /* is the index computed? */
+    int s;                    /* looping variable for scenes */
+    int is;                   /* looping variable for indices */
+    int ib;                   /* looping variable for bands */
+    int line;                 /* looping variable for grid lines */
+    int samp;                 /* looping variable for grid samples */
+    int row;                  /* scene row under a grid line */
+    int col;                  /* scene column under a grid sample */
+    int row0, row1;           /* scene rows under the strip (inclusive) */
+    int r0;                   /* first scene row of the current chunk */
+    int nrows;                /* number of scene rows in the current chunk */
+    int ncols;                /* number of grid samples inside the scene */
+    int nsi_band;             /* number of input bands for the index */
+    int si_band[MAX_SI_BANDS]; /* reflectance buffer for each index band */
+    int *col_map = NULL;      /* scene column for each grid sample */
+    int16 *si_in[MAX_SI_BANDS]; /* input bands for the index */
+    int16 *idx_buf = NULL;    /* index values for the scene chunk */
+    double y;                 /* y of a grid line center */
+    Mosaic_scene_t *sc = NULL; /* current scene */
+    Input_t *input = NULL;    /* current scene's reflectance bands */
+
+    for (is = 0; is < nsi; is++)
+    {
+        for (samp = 0; samp < nlines * grid->nsamps; samp++)
+            mosaic[is][samp] = FILL_VALUE;
+    }
+
+    col_map = malloc (grid->nsamps * sizeof (int));
+    if (col_map == NULL)
+    {
+        sprintf (errmsg, "Allocating the column map");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (s = 0; s < nscene; s++)
+    {
+        sc = &scene[s];
+
+        /* Scene rows under the first and last line of the strip */
+        y = grid->ul[1] - (iline + 0.5) * grid->pixsize;
+        row0 = (int) floor ((sc->ul[1] - y) / sc->pixsize[1]);
+        y = grid->ul[1] - (iline + nlines - 0.5) * grid->pixsize;
+        row1 = (int) floor ((sc->ul[1] - y) / sc->pixsize[1]);
+        if (row0 < 0)
+            row0 = 0;
+        if (row1 > sc->nlines - 1)
+            row1 = sc->nlines - 1;
+        if (row0 > row1)
+            continue;
+
+        /* Scene column under each grid sample */
+        ncols = 0;
+        for (samp = 0; samp < grid->nsamps; samp++)
+        {
+            col = (int) floor ((grid->ul[0] + (samp + 0.5) * grid->pixsize -
+                sc->ul[0]) / sc->pixsize[0]);
+            if (col >= 0 && col < sc->nsamps)
+            {
+                col_map[samp] = col;
+                ncols++;
+            }
+            else
+                col_map[samp] = -1;
+        }
+        if (ncols == 0)
+            continue;
+
+        for (is = 0; is < NUM_SI; is++)
+            si_flag[is] = false;
+        for (is = 0; is < nsi; is++)
+            si_flag[si_list[is]] = true;
+        input = open_input (&sc->metadata, toa, false, si_flag, NULL,
+            HTTP_CACHE_MB);
+        idx_buf = malloc ((size_t) PROC_NLINES * sc->nsamps * sizeof (int16));
+        if (input == NULL || idx_buf == NULL)
+        {
+            free (col_map);
+            free (idx_buf);
+            sprintf (errmsg, "Opening the reflectance bands for %s",
+                sc->xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        for (r0 = row0; r0 <= row1; r0 += PROC_NLINES)
+        {
+            nrows = row1 - r0 + 1;
+            if (nrows > PROC_NLINES)
+                nrows = PROC_NLINES;
+
+            if (prefetch_input_refl_lines (input, r0, nrows) != SUCCESS)
+                break;
+            for (ib = 0; ib < input->nrefl_band; ib++)
+            {
+                if (get_input_refl_lines (input, ib, r0, nrows) != SUCCESS)
+                    break;
+            }
+            if (ib < input->nrefl_band)
+                break;
+
+            for (is = 0; is < nsi; is++)
+            {
+                nsi_band = get_index_bands (input, si_list[is], si_band);
+                for (ib = 0; ib < nsi_band; ib++)
+                    si_in[ib] = input->refl_buf[si_band[ib]];
+                compute_spectral_index (si_list[is], si_in,
+                    input->refl_scale_fact, input->refl_fill,
+                    input->refl_saturate_val, nrows, input->nsamps, idx_buf);
+
+                for (line = 0; line < nlines; line++)
+                {
+                    y = grid->ul[1] - (iline + line + 0.5) * grid->pixsize;
+                    row = (int) floor ((sc->ul[1] - y) / sc->pixsize[1]);
+                    if (row < r0 || row >= r0 + nrows)
+                        continue;
+                    merge_index_line (rule, idx_buf + (long) (row - r0) *
+                        input->nsamps, col_map, grid->nsamps,
+                        mosaic[is] + (long) line * grid->nsamps);
+                }
+            }
+
+            if (release_input_refl_lines (input) != SUCCESS)
+                break;
+        }
+
+        close_input (input);
+        free_input (input);
+        free (idx_buf);
+        if (r0 <= row1)
+        {
+            free (col_map);
+            sprintf (errmsg, "Reading rows %d-%d of %s", r0, row1,
+                sc->xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    free (col_map);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  mosaic_usage
+
+PURPOSE:  Prints the usage information for the mosaic application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void mosaic_usage ()
+{
+    printf ("si_mosaic %s computes spectral indices for several adjacent "
+            "scenes and writes them as one mosaic on a common grid in a "
+            "single pass.\n\n", INDEX_VERSION);
+    printf ("usage: si_mosaic --xml=input_xml_filename [--xml=...] "
+            "--output=basename [--grid=ulx,uly,pixel_size,nlines,nsamps] "
+            "[--overlap=first|max|recent] [--toa] [--ndvi] [--evi] [--savi] "
+            "[--msavi] [--ndmi] [--nbr] [--nbr2] [--ndre] [--pri] [--cci] "
+            "[--verbose]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: input XML file; may be repeated for up to %d scenes in "
+            "the same projection\n", MAX_MOSAIC_SCENES);
+    printf ("    -output: base name of the mosaic products, written as "
+            "{output}_{sr|toa}_{index}.img with ENVI headers\n");
+    printf ("    at least one of the index flags, as for spectral_indices\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -grid: target grid, given by the projection x,y of the outer "
+            "upper left corner, the pixel size, and the number of lines and "
+            "samples (default is the union of the scenes at the first "
+            "scene's pixel size)\n");
+    printf ("    -overlap: rule for pixels covered by more than one scene: "
+            "first valid value in command-line order, max valid value, or "
+            "the valid value from the most recently acquired scene (default "
+            "is first)\n");
+    printf ("    -toa: process the TOA reflectance bands instead of the "
+            "surface reflectance bands\n");
+    printf ("    -verbose: should intermediate messages be printed? (default "
+            "is false)\n");
+}
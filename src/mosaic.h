@@ -0,0 +1,78 @@
+#ifndef _MOSAIC_H_
+#define _MOSAIC_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "common.h"
+#include "error_handler.h"
+#include "si.h"
+
+/* Maximum number of scenes which may be mosaicked at once */
+#define MAX_MOSAIC_SCENES 64
+
+/* Rules for resolving pixels covered by more than one scene */
+typedef enum {
+    OVERLAP_FIRST,           /* first scene (command-line order) with a valid
+                                value */
+    OVERLAP_MAX,             /* largest valid value */
+    OVERLAP_RECENT           /* most recently acquired scene with a valid
+                                value */
+} Overlap_rule_t;
+
+/* Target grid of the mosaic, in the scenes' projection */
+typedef struct {
+    double ul[2];            /* x,y of the outer upper left corner of the
+                                upper left pixel */
+    double pixsize;          /* pixel size */
+    int nlines;              /* number of lines */
+    int nsamps;              /* number of samples */
+} Mosaic_grid_t;
+
+/* One input scene */
+typedef struct {
+    char *xml_file;          /* XML file for the scene */
+    Espa_internal_meta_t metadata; /* parsed XML metadata */
+    double ul[2];            /* x,y of the outer upper left corner */
+    double pixsize[2];       /* pixel size x,y */
+    int nlines;              /* number of lines */
+    int nsamps;              /* number of samples */
+    char acquired[2*STR_SIZE]; /* acquisition date and scene center time, for
+                                the most recent rule */
+} Mosaic_scene_t;
+
+/* Prototypes */
+int open_mosaic_scene
+(
+    char *xml_file,          /* I: XML file for the scene */
+    bool toa,                /* I: use the TOA bands instead of SR? */
+    Mosaic_scene_t *scene    /* O: scene information */
+);
+
+void scene_union_grid
+(
+    Mosaic_scene_t *scene,   /* I: input scenes */
+    int nscene,              /* I: number of scenes */
+    Mosaic_grid_t *grid      /* O: grid covering all the scenes at the first
+                                scene's pixel size */
+);
+
+int mosaic_strip
+(
+    Mosaic_scene_t *scene,   /* I: input scenes, in priority order */
+    int nscene,              /* I: number of scenes */
+    Mosaic_grid_t *grid,     /* I: target grid */
+    bool toa,                /* I: use the TOA bands instead of SR? */
+    Overlap_rule_t rule,     /* I: overlap rule */
+    int nsi,                 /* I: number of indices */
+    Mysi_list_t *si_list,    /* I: indices to compute */
+    int iline,               /* I: first grid line of the strip */
+    int nlines,              /* I: number of grid lines in the strip */
+    int16 **mosaic           /* O: nlines * grid->nsamps values of each
+                                index */
+);
+
+void mosaic_usage ();
+
+#endif
@@ -1,6 +1,143 @@
+#define _GNU_SOURCE
 #include <time.h>
 #include <ctype.h>
-#include "output.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include "si.h"
+#include "virtual_index.h"
+
+
+/******************************************************************************
+MODULE:  preallocate_output
+
+PURPOSE:  Reserves the full extent of an output band file up front, so the
+filesystem can lay it out contiguously instead of growing it strip by strip.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+0          Successful completion
+errno      Error value from the failed call
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. If the filesystem can't reserve blocks, the file is just sized.
+     posix_fallocate isn't used since glibc falls back to writing a byte
+     into every block there, which is a full extra pass over the band.
+******************************************************************************/
+static int preallocate_output
+(
+    int fd,            /* I: file descriptor of the band file */
+    size_t size        /* I: size of the band file in bytes */
+)
+{
+    int status;        /* return status */
+
+    status = fallocate (fd, 0, 0, size) ? errno : 0;
+    if (status == EOPNOTSUPP)
+        status = ftruncate (fd, size) ? errno : 0;
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  get_io_align
+
+PURPOSE:  Determines the write alignment for an output band file from the
+filesystem block size reported by statfs and the preferred I/O size reported
+by fstat (which is the stripe size on Lustre and similar filesystems).
+
+RETURN VALUE:
+Type = size_t
+Value      Description
+-----      -----------
+>0         Write alignment in bytes
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Falls back to MIN_IO_ALIGN if the sizes can't be determined.
+******************************************************************************/
+static size_t get_io_align
+(
+    int fd             /* I: file descriptor of the band file */
+)
+{
+    struct statfs fs;  /* filesystem information */
+    struct stat st;    /* file information */
+    size_t align = MIN_IO_ALIGN;  /* write alignment */
+
+    if (fstatfs (fd, &fs) == 0 && fs.f_bsize > 0 &&
+        (size_t) fs.f_bsize > align)
+        align = fs.f_bsize;
+    if (fstat (fd, &st) == 0 && st.st_blksize > 0 &&
+        (size_t) st.st_blksize > align)
+        align = st.st_blksize;
+
+    return (align);
+}
+
+
+/******************************************************************************
+MODULE:  flush_output_buffer
+
+PURPOSE:  Writes the contents of a band's write-combining buffer to the band
+file as one sequential write.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred writing the buffer
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static int flush_output_buffer
+(
+    Output_t *this,    /* I/O: Output data structure */
+    int iband          /* I: band to flush (0-based) */
+)
+{
+    char FUNC_NAME[] = "flush_output_buffer";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    size_t nwritten = 0;      /* number of bytes written so far */
+    ssize_t n;                /* number of bytes written by one call */
+    int fd = fileno (this->fp_bin[iband]);  /* descriptor for the band file */
+
+    rate_limit_io (this->io_limit, this->wbuf_len[iband]);
+
+    while (nwritten < this->wbuf_len[iband])
+    {
+        n = write (fd, this->wbuf[iband] + nwritten,
+            this->wbuf_len[iband] - nwritten);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            sprintf (errmsg, "Writing %zu bytes for output band %d: %s",
+                this->wbuf_len[iband], iband, strerror (errno));
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        nwritten += n;
+    }
+    this->wbuf_len[iband] = 0;
+
+    return (SUCCESS);
+}
 
 
 /******************************************************************************
@@ -26,7 +163,19 @@ NOTES:
   2. TOA products will have an "toa_" in the file name and SR products will
      have an "sr_" in the file name to designate products processed with TOA
      bands vs. SR bands.  Otherwise the source will be key along with the band
-     name to pull the appropriate band from the XML file.
+     name to pull the appropriate band from the XML file.  Products from the
+     8-bit Level-1 bands have "dn_" and the Level-1 product as the source.
+  3. If mmap_out is specified, each band file is preallocated to its full
+     size and mapped shared.  The caller gets a pointer to each strip's
+     region with get_output_lines, computes the index directly into it, and
+     calls put_output_line to flush the strip.
+  4. If write_buffer is specified, each band file is preallocated and the
+     strips are collected in a per-band buffer of that size (rounded up to
+     the filesystem block or stripe size).  Each band is then written in
+     large sequential, aligned writes instead of one strip at a time.
+  5. If s3 is specified, no local band files are created.  A multipart
+     upload is started for each band, named like the local file, and the
+     strips are streamed to it.  mmap_out and write_buffer are ignored.
 ******************************************************************************/
 Output_t *open_output
 (
@@ -34,7 +183,13 @@ Output_t *open_output
     Input_t *input,                 /* I: input reflectance band data */
     int nband,                      /* I: number of bands to be created */
     char short_si_names[][STR_SIZE], /* I: array of short names for SI bands */
-    char long_si_names[][STR_SIZE]   /* I: array of long names for SI bands */
+    char long_si_names[][STR_SIZE],  /* I: array of long names for SI bands */
+    bool mmap_out,                  /* I: preallocate and memory map the band
+                                          files? */
+    size_t write_buffer,            /* I: size of the per-band write-combining
+                                          buffer in bytes; 0 for none */
+    S3_upload_t *s3                 /* I: upload to stream the band files to;
+                                          NULL to write them locally */
 )
 {
     Output_t *this = NULL;
@@ -47,8 +202,11 @@ Output_t *open_output
     time_t tp;                   /* time structure */
     struct tm *tm = NULL;        /* time structure for UTC time */
     int ib;    /* looping variable for bands */
+    int status;                  /* return status */
     int refl_indx = -1;          /* band index in XML file for the reflectance
                                     band */
+    int dn_indx = -1;            /* band index in XML file for the Level-1
+                                    band1 */
     Espa_band_meta_t *bmeta = NULL;  /* pointer to the band metadata array
                                         within the output structure */
 
@@ -92,6 +250,36 @@ Output_t *open_output
         }
     }
 
+    /* Use the multi-band cube if there are no single reflectance bands */
+    for (ib = 0; ib < in_meta->nbands && refl_indx == -1; ib++)
+    {
+        if ((!strcmp (in_meta->band[ib].name, CUBE_TOA_NAME) &&
+             !strcmp (in_meta->band[ib].product, "toa_refl")) ||
+            (!strcmp (in_meta->band[ib].name, CUBE_SR_NAME) &&
+             !strcmp (in_meta->band[ib].product, "sr_refl")))
+        {
+            refl_indx = ib;
+            sprintf (ref_band_name, "_%s", in_meta->band[ib].name);
+        }
+    }
+
+    /* Find the 8-bit Level-1 band1 for products from the DN bands, and fall
+       back to it if there are no reflectance bands */
+    for (ib = 0; ib < in_meta->nbands; ib++)
+    {
+        if (!strcmp (in_meta->band[ib].name, "b1") &&
+            in_meta->band[ib].data_type == ESPA_UINT8)
+        {
+            dn_indx = ib;
+            break;
+        }
+    }
+    if (refl_indx == -1 && dn_indx != -1)
+    {
+        refl_indx = dn_indx;
+        strcpy (ref_band_name, "_b1");
+    }
+
     /* Make sure we found the TOA band 1 */
     if (refl_indx == -1)
     {
@@ -147,8 +335,27 @@ Output_t *open_output
     this->nband = nband;
     this->nlines = input->nlines;
     this->nsamps = input->nsamps;
+    if (s3 != NULL)
+    {
+        mmap_out = false;
+        write_buffer = 0;
+    }
+    this->mmap_out = mmap_out;
+    this->s3 = s3;
+    this->map_size = (size_t) this->nlines * this->nsamps * sizeof (int16);
     for (ib = 0; ib < this->nband; ib++)
+    {
         this->fp_bin[ib] = NULL;
+        this->fd[ib] = -1;
+        this->map[ib] = NULL;
+        this->flushed[ib] = 0;
+        this->wbuf[ib] = NULL;
+        this->wbuf_len[ib] = 0;
+        this->s3_obj[ib] = -1;
+    }
+    this->io_align = MIN_IO_ALIGN;
+    this->io_limit = NULL;
+    this->wbuf_size = mmap_out ? 0 : write_buffer;
  
     for (ib = 0; ib < nband; ib++)
     {
@@ -159,6 +366,8 @@ Output_t *open_output
         strcpy (bmeta[ib].product, "spectral_indices");
         if (strstr (short_si_names[ib], "toa"))
             strcpy (bmeta[ib].source, "toa_refl");
+        else if (!strncmp (short_si_names[ib], "dn_", 3))
+            strcpy (bmeta[ib].source, in_meta->band[dn_indx].product);
         else
             strcpy (bmeta[ib].source, "sr_refl");
         strcpy (bmeta[ib].category, "index");
@@ -186,6 +395,56 @@ Output_t *open_output
            file for write access */
         snprintf (bmeta[ib].file_name, sizeof (bmeta[ib].name), "%s_%s.img",
             scene_name, bmeta[ib].name);
+        if (s3 != NULL)
+        {
+            this->s3_obj[ib] = s3_begin_object (s3, bmeta[ib].file_name);
+            if (this->s3_obj[ib] < 0)
+            {
+                sprintf (errmsg, "Unable to start the upload of output band "
+                    "%d: %s", ib, bmeta[ib].file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (NULL);
+            }
+            continue;
+        }
+
+        if (mmap_out)
+        {
+            /* Reserve the full extent up front, then map it so the index
+               can be computed in place */
+            this->fd[ib] = open (bmeta[ib].file_name,
+                O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (this->fd[ib] < 0)
+            {
+                sprintf (errmsg, "Unable to open output band %d file: %s", ib,
+                    bmeta[ib].file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (NULL);
+            }
+
+            status = preallocate_output (this->fd[ib], this->map_size);
+            if (status != 0)
+            {
+                sprintf (errmsg, "Unable to preallocate %zu bytes for output "
+                    "band %d file: %s (%s)", this->map_size, ib,
+                    bmeta[ib].file_name, strerror (status));
+                error_handler (true, FUNC_NAME, errmsg);
+                return (NULL);
+            }
+
+            this->map[ib] = mmap (NULL, this->map_size,
+                PROT_READ | PROT_WRITE, MAP_SHARED, this->fd[ib], 0);
+            if (this->map[ib] == MAP_FAILED)
+            {
+                this->map[ib] = NULL;
+                sprintf (errmsg, "Unable to map output band %d file: %s", ib,
+                    bmeta[ib].file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (NULL);
+            }
+            continue;
+        }
+
         this->fp_bin[ib] = open_raw_binary (bmeta[ib].file_name, "w");
         if (this->fp_bin[ib] == NULL)
         {
@@ -194,6 +453,38 @@ Output_t *open_output
             error_handler (true, FUNC_NAME, errmsg);
             return (NULL);
         }
+
+        /* Reserve the extent and set up the write-combining buffer, sized
+           to a whole number of filesystem blocks or stripes */
+        if (this->wbuf_size > 0)
+        {
+            status = preallocate_output (fileno (this->fp_bin[ib]),
+                this->map_size);
+            if (status != 0)
+            {
+                sprintf (errmsg, "Unable to preallocate %zu bytes for output "
+                    "band %d file: %s (%s)", this->map_size, ib,
+                    bmeta[ib].file_name, strerror (status));
+                error_handler (true, FUNC_NAME, errmsg);
+                return (NULL);
+            }
+
+            if (ib == 0)
+            {
+                this->io_align = get_io_align (fileno (this->fp_bin[ib]));
+                this->wbuf_size = (this->wbuf_size + this->io_align - 1) /
+                    this->io_align * this->io_align;
+            }
+
+            this->wbuf[ib] = prof_malloc (PBUF_WRITE, this->wbuf_size);
+            if (this->wbuf[ib] == NULL)
+            {
+                sprintf (errmsg, "Allocating the %zu byte write buffer for "
+                    "output band %d", this->wbuf_size, ib);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (NULL);
+            }
+        }
     }  /* for ib */
     this->open = true;
 
@@ -218,6 +509,10 @@ PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
 at the USGS EROS
 
 NOTES:
+  1. Mapped band files are unmapped and closed.  Like the stdio files, the
+     data is left to the kernel to write back; there is no fsync.
+  2. Uploaded band files are completed; this waits for the queued parts to
+     finish uploading.
 ******************************************************************************/
 int close_output
 (
@@ -227,6 +522,7 @@ int close_output
     char FUNC_NAME[] = "close_output";   /* function name */
     char errmsg[STR_SIZE];    /* error message */
     int ib;                   /* looping variable */
+    int status = SUCCESS;     /* return status */
 
     if (!this->open)
     {
@@ -235,12 +531,68 @@ int close_output
         return (ERROR);
     }
 
+    /* Unmap and close the mapped products */
+    if (this->mmap_out)
+    {
+        for (ib = 0; ib < this->nband; ib++)
+        {
+            if (this->map[ib] != NULL &&
+                munmap (this->map[ib], this->map_size) != 0)
+            {
+                sprintf (errmsg, "Unmapping output band %d", ib);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+            }
+            if (this->fd[ib] >= 0 && close (this->fd[ib]) != 0)
+            {
+                sprintf (errmsg, "Closing output band %d", ib);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+            }
+            this->map[ib] = NULL;
+            this->fd[ib] = -1;
+        }
+        this->open = false;
+        return (status);
+    }
+
+    /* Complete the uploads */
+    if (this->s3 != NULL)
+    {
+        for (ib = 0; ib < this->nband; ib++)
+        {
+            if (s3_finish_object (this->s3, this->s3_obj[ib]) != SUCCESS)
+            {
+                sprintf (errmsg, "Completing the upload of output band %d",
+                    ib);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+            }
+        }
+        this->open = false;
+        return (status);
+    }
+
+    /* Write out what is left in the write-combining buffers */
+    for (ib = 0; ib < this->nband; ib++)
+    {
+        if (this->wbuf[ib] != NULL && this->wbuf_len[ib] > 0 &&
+            flush_output_buffer (this, ib) != SUCCESS)
+        {
+            sprintf (errmsg, "Flushing output band %d", ib);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        free (this->wbuf[ib]);
+        this->wbuf[ib] = NULL;
+    }
+
     /* Close raw binary products */
     for (ib = 0; ib < this->nband; ib++)
         close_raw_binary (this->fp_bin[ib]);
     this->open = false;
 
-    return (SUCCESS);
+    return (status);
 }
 
 
@@ -303,6 +655,18 @@ PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
 at the USGS EROS
 
 NOTES:
+  1. For mapped band files, buf is normally the region returned by
+     get_output_lines and nothing is copied; otherwise it is copied into the
+     mapping.  The completed pages behind the current strip are then handed
+     to the kernel for write-back (msync MS_ASYNC) and dropped from the
+     process (MADV_DONTNEED), so the resident set stays at about one strip
+     per band.
+  2. With write-combining buffers, the lines are copied into the band's
+     buffer and the buffer is written whenever it fills.  Since the bands are
+     written sequentially from the start of the file, every write begins on
+     a multiple of the buffer size and so stays block/stripe aligned.
+  3. For uploaded band files, the lines are appended to the band's upload;
+     this blocks while all the part buffers are waiting to be uploaded.
 ******************************************************************************/
 int put_output_line
 (
@@ -316,6 +680,12 @@ int put_output_line
 {
     char FUNC_NAME[] = "put_output_line";   /* function name */
     char errmsg[STR_SIZE];        /* error message */
+    int16 *dst = NULL;            /* strip region in the mapping */
+    size_t end;                   /* byte offset of the end of the strip */
+    size_t page_size;             /* system page size */
+    size_t nbytes;                /* number of bytes left to buffer */
+    size_t n;                     /* number of bytes copied into the buffer */
+    char *src = NULL;             /* next byte of buf to be buffered */
   
     /* Check the parameters */
     if (this == (Output_t *)NULL) 
@@ -350,7 +720,85 @@ int put_output_line
         return (ERROR);
     }
   
+    /* Copy into the mapping if needed and flush the completed pages */
+    if (this->mmap_out)
+    {
+        /* The strip's pages are dirty and due for write-back */
+        rate_limit_io (this->io_limit, (size_t) nlines * this->nsamps *
+            sizeof (int16));
+        dst = this->map[iband] + (long) iline * this->nsamps;
+        if (buf != dst)
+            memcpy (dst, buf, (size_t) nlines * this->nsamps * sizeof (int16));
+
+        /* Only whole pages can be dropped; the partial page at the end of
+           the strip is picked up with the next strip */
+        page_size = (size_t) sysconf (_SC_PAGESIZE);
+        end = (size_t) (iline + nlines) * this->nsamps * sizeof (int16);
+        if (iline + nlines < this->nlines)
+            end = end / page_size * page_size;
+        if (end > this->flushed[iband])
+        {
+            if (msync ((char *) this->map[iband] + this->flushed[iband],
+                end - this->flushed[iband], MS_ASYNC) != 0 ||
+                madvise ((char *) this->map[iband] + this->flushed[iband],
+                end - this->flushed[iband], MADV_DONTNEED) != 0)
+            {
+                sprintf (errmsg, "Flushing the output line(s) for band %d.",
+                    iband);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            this->flushed[iband] = end;
+        }
+        return (SUCCESS);
+    }
+
+    /* Stream the lines to the band's upload */
+    if (this->s3 != NULL)
+    {
+        nbytes = (size_t) nlines * this->nsamps * sizeof (int16);
+        rate_limit_io (this->io_limit, nbytes);
+        if (s3_write_object (this->s3, this->s3_obj[iband], buf, nbytes)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Error uploading the output line(s) for band "
+                "%d.", iband);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        return (SUCCESS);
+    }
+
+    /* Collect the lines in the write-combining buffer */
+    if (this->wbuf_size > 0)
+    {
+        src = (char *) buf;
+        nbytes = (size_t) nlines * this->nsamps * sizeof (int16);
+        while (nbytes > 0)
+        {
+            n = this->wbuf_size - this->wbuf_len[iband];
+            if (n > nbytes)
+                n = nbytes;
+            memcpy (this->wbuf[iband] + this->wbuf_len[iband], src, n);
+            this->wbuf_len[iband] += n;
+            src += n;
+            nbytes -= n;
+
+            if (this->wbuf_len[iband] == this->wbuf_size &&
+                flush_output_buffer (this, iband) != SUCCESS)
+            {
+                sprintf (errmsg, "Error writing the output line(s) for band "
+                    "%d.", iband);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+        return (SUCCESS);
+    }
+
     /* Write the data */
+    rate_limit_io (this->io_limit, (size_t) nlines * this->nsamps *
+        sizeof (int16));
     if (write_raw_binary (this->fp_bin[iband], nlines, this->nsamps,
         sizeof (int16), buf) != SUCCESS)
     {
@@ -364,6 +812,152 @@ int put_output_line
 }
 
 
+/******************************************************************************
+MODULE:  get_output_lines
+
+PURPOSE:  Returns the region of a mapped output band file which holds the
+specified strip, so the index can be computed directly into the file.
+
+RETURN VALUE:
+Type = int16*
+Value      Description
+-----      -----------
+NULL       The band files aren't mapped or the strip is invalid
+non-NULL   Pointer to nlines * nsamps values in the mapping
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Call put_output_line with the returned pointer once the strip is
+     complete.
+******************************************************************************/
+int16 *get_output_lines
+(
+    Output_t *this,    /* I: Output data structure */
+    int iband,         /* I: current band (0-based) */
+    int iline,         /* I: first line of the strip (0-based) */
+    int nlines         /* I: number of lines in the strip */
+)
+{
+    char FUNC_NAME[] = "get_output_lines";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+
+    if (this == NULL || !this->open || !this->mmap_out)
+    {
+        sprintf (errmsg, "Output band files are not open and mapped.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    if (iband < 0 || iband >= this->nband || iline < 0 || nlines < 0 ||
+        iline + nlines > this->nlines)
+    {
+        sprintf (errmsg, "Invalid band %d or lines %d-%d.", iband, iline,
+            iline + nlines - 1);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    return (this->map[iband] + (long) iline * this->nsamps);
+}
+
+
+/******************************************************************************
+MODULE:  write_virtual_index
+
+PURPOSE:  Writes the virtual index descriptor for the specified spectral
+index.  The descriptor takes the place of the index raster; the index values
+are computed on read from the referenced reflectance bands using the reader
+in virtual_index.c.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred writing the descriptor
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The descriptor is named {scene_name}_{short_si_name}.vidx.  See
+     virtual_index.h for the format.
+  2. The band file names are written as they appear in the XML file, which
+     are relative to the product directory where the descriptor is written.
+******************************************************************************/
+int write_virtual_index
+(
+    Espa_internal_meta_t *in_meta,  /* I: input metadata structure */
+    Input_t *input,                 /* I: input reflectance band data */
+    Mysi_list_t si,                 /* I: spectral index */
+    char *short_si_name,            /* I: short name for the SI band */
+    char *long_si_name              /* I: long name for the SI band */
+)
+{
+    char FUNC_NAME[] = "write_virtual_index";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char vidx_file[STR_SIZE];     /* name of the descriptor file */
+    int band[MAX_SI_BANDS];       /* reflectance band for each index input */
+    int nband;                    /* number of index input bands */
+    int ib;                       /* looping variable for bands */
+    FILE *fp = NULL;              /* descriptor file pointer */
+
+    nband = get_index_bands (input, si, band);
+    if (nband == 0 || input->cube || input->http)
+    {
+        sprintf (errmsg, "Virtual indices need one local file per input "
+            "band");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (snprintf (vidx_file, sizeof (vidx_file), "%s_%s%s",
+        in_meta->global.product_id, short_si_name, VIDX_EXT) >=
+        (int) sizeof (vidx_file))
+    {
+        sprintf (errmsg, "Virtual index descriptor name is too long: "
+            "%.900s", in_meta->global.product_id);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    fp = fopen (vidx_file, "w");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Unable to open the virtual index descriptor: "
+            "%.900s", vidx_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fprintf (fp, "%s\n", VIDX_MAGIC);
+    fprintf (fp, "index = %s\n", si_short_name (si));
+    fprintf (fp, "name = %s\n", short_si_name);
+    fprintf (fp, "long_name = %s\n", long_si_name);
+    fprintf (fp, "app_version = spectral_indices_%s\n", INDEX_VERSION);
+    fprintf (fp, "lines = %d\n", input->nlines);
+    fprintf (fp, "samples = %d\n", input->nsamps);
+    fprintf (fp, "refl_fill = %d\n", input->refl_fill);
+    fprintf (fp, "refl_saturate_value = %d\n", input->refl_saturate_val);
+    fprintf (fp, "refl_scale_factor = %g\n", input->refl_scale_fact);
+    fprintf (fp, "fill_value = %d\n", FILL_VALUE);
+    fprintf (fp, "saturate_value = %d\n", SATURATE_VALUE);
+    fprintf (fp, "scale_factor = %g\n", SCALE_FACTOR);
+    for (ib = 0; ib < nband; ib++)
+        fprintf (fp, "band = %s\n", input->file_name[band[ib]]);
+
+    if (fclose (fp) != 0)
+    {
+        sprintf (errmsg, "Writing the virtual index descriptor: %.900s",
+            vidx_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
 /******************************************************************************
 MODULE:  upper_case_str
 
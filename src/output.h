@@ -2,11 +2,13 @@
 #define OUTPUT_H
 
 #include "input.h"
+#include "s3_upload.h"
 
 #define MAX_DATE_LEN (28)
 
-/* Define the number of bands that might be output to the file */
-#define MAX_OUT_BANDS NUM_SI
+/* Define the number of bands that might be output to the file: every index
+   plus the anomaly and percent of normal of one of them */
+#define MAX_OUT_BANDS (NUM_SI + 2)
 
 /* Define some of the constants to use in the output data products */
 #define FILL_VALUE -9999
@@ -14,6 +16,9 @@
 #define FLOAT_TO_INT 10000.0
 #define SCALE_FACTOR 0.0001
 
+/* Smallest alignment used for the write-combining buffer writes */
+#define MIN_IO_ALIGN 4096
+
 /* Structure for the 'output' data type */
 typedef struct {
   bool open;            /* Flag to indicate whether output file is open;
@@ -25,6 +30,24 @@ typedef struct {
                            metadata for the output bands; global metadata
                            won't be valid */
   FILE *fp_bin[MAX_OUT_BANDS];  /* File pointer for binary files */
+  bool mmap_out;        /* Are the band files preallocated and memory mapped,
+                           instead of written through stdio? */
+  int fd[MAX_OUT_BANDS];   /* File descriptor for the mapped band files */
+  int16 *map[MAX_OUT_BANDS]; /* Mapping of each band file */
+  size_t map_size;      /* Size of each band file mapping in bytes */
+  size_t flushed[MAX_OUT_BANDS]; /* Byte offset in each mapping up to which
+                           the lines have been flushed and dropped */
+  size_t io_align;      /* Filesystem block or stripe size the writes are
+                           aligned to */
+  size_t wbuf_size;     /* Size of each write-combining buffer in bytes; 0 if
+                           strips are written as they are produced */
+  size_t wbuf_len[MAX_OUT_BANDS]; /* Number of bytes held in each buffer */
+  char *wbuf[MAX_OUT_BANDS]; /* Write-combining buffer for each band */
+  Rate_limit_t *io_limit; /* I/O rate limiter for the writes; NULL if
+                           unlimited */
+  S3_upload_t *s3;      /* Upload the band files are streamed to instead of
+                           being written locally; NULL if written locally */
+  int s3_obj[MAX_OUT_BANDS]; /* Upload object for each band */
 } Output_t;
 
 /* Prototypes */
@@ -34,7 +57,13 @@ Output_t *open_output
     Input_t *input,                 /* I: input reflectance band data */
     int nband,                      /* I: number of bands to be created */
     char short_si_names[][STR_SIZE], /* I: array of short names for SI bands */
-    char long_si_names[][STR_SIZE]   /* I: array of long names for SI bands */
+    char long_si_names[][STR_SIZE],  /* I: array of long names for SI bands */
+    bool mmap_out,                  /* I: preallocate and memory map the band
+                                          files? */
+    size_t write_buffer,            /* I: size of the per-band write-combining
+                                          buffer in bytes; 0 for none */
+    S3_upload_t *s3                 /* I: upload to stream the band files to;
+                                          NULL to write them locally */
 );
 
 int close_output
@@ -57,6 +86,23 @@ int put_output_line
     int nlines         /* I: number of lines to be written */
 );
 
+int16 *get_output_lines
+(
+    Output_t *this,    /* I: Output data structure */
+    int iband,         /* I: current band (0-based) */
+    int iline,         /* I: first line of the strip (0-based) */
+    int nlines         /* I: number of lines in the strip */
+);
+
+int write_virtual_index
+(
+    Espa_internal_meta_t *in_meta,  /* I: input metadata structure */
+    Input_t *input,                 /* I: input reflectance band data */
+    Mysi_list_t si,                 /* I: spectral index */
+    char *short_si_name,            /* I: short name for the SI band */
+    char *long_si_name              /* I: long name for the SI band */
+);
+
 char *upper_case_str
 (
     char *str    /* I: string to be converted to upper case */
@@ -0,0 +1,273 @@
+#include "si.h"
+#include "plan.h"
+#include "calibration.h"
+
+/******************************************************************************
+MODULE:  write_json_string
+
+PURPOSE:  Writes a string as a quoted JSON string.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static void write_json_string
+(
+    FILE *fp,                /* I: stream to write to */
+    char *str                /* I: string to write */
+)
+{
+    unsigned char *cptr = NULL;  /* current character */
+
+    fputc ('"', fp);
+    for (cptr = (unsigned char *) str; *cptr != '\0'; cptr++)
+    {
+        if (*cptr == '"' || *cptr == '\\')
+            fprintf (fp, "\\%c", *cptr);
+        else if (*cptr < 0x20)
+            fprintf (fp, "\\u%04x", *cptr);
+        else
+            fputc (*cptr, fp);
+    }
+    fputc ('"', fp);
+}
+
+
+/******************************************************************************
+MODULE:  write_json_seconds
+
+PURPOSE:  Writes an estimated number of seconds, or null if it's unknown.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static void write_json_seconds
+(
+    FILE *fp,                /* I: stream to write to */
+    double seconds           /* I: seconds; negative if unknown */
+)
+{
+    if (seconds < 0.0)
+        fprintf (fp, "null");
+    else
+        fprintf (fp, "%.3f", seconds);
+}
+
+
+/******************************************************************************
+MODULE:  io_seconds
+
+PURPOSE:  Estimates the time to read or write a number of bytes at a
+calibrated rate, held to the I/O rate limit.
+
+RETURN VALUE:
+Type = double
+Value      Description
+-----      -----------
+<0         The rate isn't known
+>=0        Estimated seconds
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static double io_seconds
+(
+    long long nbytes,        /* I: number of bytes moved */
+    double mbps,             /* I: calibrated rate in MB/s; 0 if unknown */
+    float io_rate_limit      /* I: per-process I/O limit in MB/s; 0 for
+                                none */
+)
+{
+    double mb = nbytes / (1024.0 * 1024.0);  /* megabytes moved */
+    double seconds;           /* estimated seconds */
+
+    if (nbytes == 0)
+        return (0.0);
+    if (mbps <= 0.0)
+        return (-1.0);
+
+    seconds = mb / mbps;
+    if (io_rate_limit > 0.0 && mb / io_rate_limit > seconds)
+        seconds = mb / io_rate_limit;
+    return (seconds);
+}
+
+
+/******************************************************************************
+MODULE:  write_plan
+
+PURPOSE:  Writes the plan of a run as JSON: the band files read, the bytes
+read and written, the planned buffer memory, the strips, and the wall time
+estimated from a calibration profile.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error reading the calibration profile
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The buffer memory is what prof_plan was given, so the plan block of
+     the caller has to have run.
+  2. The estimate adds the read, compute, and write times, since each strip
+     is read, computed, and written in turn.  The read rate is that of the
+     storage si_io_bench was run on; remote bands are estimated at the same
+     rate, which is likely optimistic.
+  3. The two-band DN indices are looked up from tables rather than computed,
+     which takes a small fraction of the kernel time, so they aren't
+     counted in the compute time.
+  4. Times which can't be estimated (no profile, or a rate missing from it)
+     are null, as is the total then.
+******************************************************************************/
+int write_plan
+(
+    FILE *fp,                /* I: stream to write the JSON plan to */
+    Plan_t *plan,            /* I: work the run calls for */
+    Input_t *input           /* I: input bands of the run */
+)
+{
+    char FUNC_NAME[] = "write_plan";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable */
+    int ib;                   /* looping variable for bands */
+    long long npix = (long long) input->nlines * input->nsamps;
+                              /* pixels in the scene */
+    long long nread;          /* bytes read in all */
+    long long nwrite;         /* bytes written in all */
+    long long nmem = 0;       /* bytes of buffer memory in all */
+    double read_s = -1.0;     /* estimated seconds reading */
+    double write_s = -1.0;    /* estimated seconds writing */
+    double compute_s = -1.0;  /* estimated seconds computing */
+    double total_s = -1.0;    /* estimated seconds in all */
+    Prof_buf_t buf;           /* looping variable for buffers */
+    Calibration_t cal;        /* calibrated rates */
+
+    nread = plan->read_bands + plan->read_clim + plan->read_labels;
+    nwrite = plan->write_bands + plan->write_previews + plan->write_features;
+
+    /* Estimate the wall time from the calibrated rates */
+    if (plan->cal_file != NULL)
+    {
+        if (read_calibration (plan->cal_file, &cal) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the calibration profile %s",
+                plan->cal_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        read_s = io_seconds (nread, cal.read_mbps, plan->io_rate_limit);
+        write_s = io_seconds (nwrite, cal.write_mbps, plan->io_rate_limit);
+        compute_s = 0.0;
+        for (i = 0; i < plan->nindex && strcmp (plan->mode, "virtual"); i++)
+        {
+            if (plan->lut && plan->index[i] != SI_EVI)
+                continue;
+            if (cal.mpix_per_sec[plan->index[i]] <= 0.0)
+            {
+                compute_s = -1.0;
+                break;
+            }
+            compute_s += npix / (cal.mpix_per_sec[plan->index[i]] * 1.0e6);
+        }
+        if (read_s >= 0.0 && write_s >= 0.0 && compute_s >= 0.0)
+            total_s = read_s + write_s + compute_s;
+    }
+
+    fprintf (fp, "{\n  \"version\": \"%s\",\n  \"product_id\": ",
+        INDEX_VERSION);
+    write_json_string (fp, plan->product_id);
+    fprintf (fp, ",\n  \"product\": \"%s\",\n", plan->product);
+    fprintf (fp, "  \"lines\": %d,\n  \"samples\": %d,\n", input->nlines,
+        input->nsamps);
+    fprintf (fp, "  \"strip_lines\": %d,\n  \"strips\": %d,\n", PROC_NLINES,
+        (input->nlines + PROC_NLINES - 1) / PROC_NLINES);
+
+    fprintf (fp, "  \"indices\": [");
+    for (i = 0; i < plan->nindex; i++)
+        fprintf (fp, "%s\"%s\"", i > 0 ? ", " : "",
+            si_short_name (plan->index[i]));
+    fprintf (fp, "],\n");
+
+    /* Band files, in reflectance buffer order; a cube is listed once per
+       band read out of it */
+    fprintf (fp, "  \"input_bands\": [\n");
+    for (ib = 0; ib < input->nrefl_band; ib++)
+    {
+        fprintf (fp, "    {\"file\": ");
+        write_json_string (fp, input->file_name[ib]);
+        fprintf (fp, ", \"band\": %d, \"wavelength_nm\": %g, "
+            "\"remote\": %s}%s\n", input->cat_band[ib] + 1,
+            input->cat_wavelength[input->cat_band[ib]],
+            input->http_file[ib] != NULL ? "true" : "false",
+            ib < input->nrefl_band - 1 ? "," : "");
+    }
+    fprintf (fp, "  ],\n");
+
+    fprintf (fp, "  \"output\": {\"mode\": \"%s\", \"bands\": [",
+        plan->mode);
+    for (i = 0; i < plan->nout; i++)
+    {
+        fprintf (fp, "%s", i > 0 ? ", " : "");
+        write_json_string (fp, plan->out_names[i]);
+    }
+    fprintf (fp, "]},\n");
+
+    fprintf (fp, "  \"bytes_read\": {\"bands\": %lld, \"climatology\": "
+        "%lld, \"labels\": %lld, \"total\": %lld},\n", plan->read_bands,
+        plan->read_clim, plan->read_labels, nread);
+    fprintf (fp, "  \"bytes_written\": {\"bands\": %lld, \"previews\": "
+        "%lld, \"features_max\": %lld, \"total\": %lld},\n",
+        plan->write_bands, plan->write_previews, plan->write_features,
+        nwrite);
+
+    fprintf (fp, "  \"memory_bytes\": {");
+    for (buf = 0; buf < NUM_PBUF; buf++)
+    {
+        if (prof_planned (buf) == 0)
+            continue;
+        fprintf (fp, "\"%s\": %lld, ", prof_buf_name (buf),
+            prof_planned (buf));
+        nmem += prof_planned (buf);
+    }
+    fprintf (fp, "\"total\": %lld},\n", nmem);
+
+    fprintf (fp, "  \"estimate_seconds\": ");
+    if (plan->cal_file == NULL)
+        fprintf (fp, "null\n");
+    else
+    {
+        fprintf (fp, "{\"calibration\": ");
+        write_json_string (fp, plan->cal_file);
+        fprintf (fp, ", \"backend\": ");
+        write_json_string (fp, cal.backend);
+        fprintf (fp, ", \"read\": ");
+        write_json_seconds (fp, read_s);
+        fprintf (fp, ", \"compute\": ");
+        write_json_seconds (fp, compute_s);
+        fprintf (fp, ", \"write\": ");
+        write_json_seconds (fp, write_s);
+        fprintf (fp, ", \"total\": ");
+        write_json_seconds (fp, total_s);
+        fprintf (fp, "}\n");
+    }
+    fprintf (fp, "}\n");
+    fflush (fp);
+
+    return (SUCCESS);
+}
@@ -0,0 +1,43 @@
+#ifndef _PLAN_H_
+#define _PLAN_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "common.h"
+#include "input.h"
+
+/* Work a run calls for, worked out from the XML, the options, and the
+   scene geometry without reading any pixels */
+typedef struct {
+    char *product_id;        /* product ID of the scene */
+    char *product;           /* "sr", "toa", or "dn" */
+    char *mode;              /* "bands", "tiles", "virtual", or "sample" */
+    int nindex;              /* number of requested indices */
+    Mysi_list_t index[NUM_SI]; /* requested indices in output order */
+    int nout;                /* number of output bands, including any
+                                anomaly bands */
+    char (*out_names)[STR_SIZE]; /* short name of each output band */
+    bool lut;                /* are the two-band indices looked up from the
+                                DN tables rather than computed? */
+    long long read_bands;    /* bytes of the input bands read, including the
+                                preview passes */
+    long long read_clim;     /* bytes of the climatology read */
+    long long read_labels;   /* bytes of the label raster read */
+    long long write_bands;   /* bytes of the index bands or tiles written */
+    long long write_previews; /* bytes of the previews written */
+    long long write_features; /* most bytes of feature vectors written, if
+                                every pixel is valid */
+    float io_rate_limit;     /* per-process I/O limit in MB/s; 0 for none */
+    char *cal_file;          /* calibration profile to estimate the run time
+                                from; NULL for no estimate */
+} Plan_t;
+
+/* Prototypes */
+int write_plan
+(
+    FILE *fp,                /* I: stream to write the JSON plan to */
+    Plan_t *plan,            /* I: work the run calls for */
+    Input_t *input           /* I: input bands of the run */
+);
+
+#endif
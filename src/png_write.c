@@ -0,0 +1,221 @@
+#include <string.h>
+#include <zlib.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "png_write.h"
+
+/******************************************************************************
+MODULE:  put_png_chunk
+
+PURPOSE:  Appends a PNG chunk (length, type, data, and CRC) to the buffer.
+
+RETURN VALUE:
+Type = unsigned char *
+Value      Description
+-----      -----------
+ptr        Location in the buffer following the chunk
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The buffer must have room for size + 12 bytes.
+******************************************************************************/
+unsigned char *put_png_chunk
+(
+    unsigned char *ptr,   /* I: location in the buffer to write the chunk */
+    char *type,           /* I: four character chunk type */
+    unsigned char *data,  /* I: chunk data */
+    size_t size           /* I: size of the chunk data */
+)
+{
+    uLong crc;            /* CRC of the chunk type and data */
+
+    ptr[0] = (size >> 24) & 0xff;
+    ptr[1] = (size >> 16) & 0xff;
+    ptr[2] = (size >> 8) & 0xff;
+    ptr[3] = size & 0xff;
+    memcpy (ptr + 4, type, 4);
+    if (size > 0)
+        memcpy (ptr + 8, data, size);
+
+    crc = crc32 (0L, ptr + 4, size + 4);
+    ptr += size + 8;
+    ptr[0] = (crc >> 24) & 0xff;
+    ptr[1] = (crc >> 16) & 0xff;
+    ptr[2] = (crc >> 8) & 0xff;
+    ptr[3] = crc & 0xff;
+
+    return (ptr + 4);
+}
+
+
+/******************************************************************************
+MODULE:  encode_png_rgba
+
+PURPOSE:  Encodes an 8-bit RGBA image as a PNG in memory.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred allocating memory or compressing the image
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Each scanline is written with filter type 0 (none) and compressed with
+     zlib, which is already linked for the ESPA libraries.
+******************************************************************************/
+int encode_png_rgba
+(
+    uint8 *rgba,          /* I: nlines * nsamps RGBA pixels */
+    int nlines,           /* I: number of lines in the image */
+    int nsamps,           /* I: number of samples in the image */
+    unsigned char **png,  /* O: address of the encoded PNG; the caller is
+                                responsible for freeing it */
+    size_t *png_size      /* O: size of the encoded PNG in bytes */
+)
+{
+    char FUNC_NAME[] = "encode_png_rgba";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    static unsigned char signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26,
+        '\n'};                /* PNG file signature */
+    unsigned char ihdr[13];   /* image header chunk data */
+    unsigned char *raw = NULL;  /* filtered scanlines */
+    unsigned char *zbuf = NULL; /* compressed scanlines */
+    unsigned char *ptr = NULL;  /* current location in the PNG */
+    size_t row_size = (size_t) nsamps * 4 + 1;  /* bytes per scanline */
+    uLongf zsize;             /* size of the compressed scanlines */
+    int line;                 /* looping variable for lines */
+
+    *png = NULL;
+    *png_size = 0;
+
+    /* Add the filter type byte to the start of each scanline */
+    raw = malloc (row_size * nlines);
+    zsize = compressBound (row_size * nlines);
+    zbuf = malloc (zsize);
+    if (raw == NULL || zbuf == NULL)
+    {
+        free (raw);
+        free (zbuf);
+        sprintf (errmsg, "Allocating memory for the %dx%d PNG", nsamps,
+            nlines);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (line = 0; line < nlines; line++)
+    {
+        raw[line * row_size] = 0;
+        memcpy (&raw[line * row_size + 1], &rgba[(size_t) line * nsamps * 4],
+            row_size - 1);
+    }
+
+    if (compress2 (zbuf, &zsize, raw, row_size * nlines, PNG_COMPRESSION) !=
+        Z_OK)
+    {
+        free (raw);
+        free (zbuf);
+        sprintf (errmsg, "Compressing the PNG image data");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    free (raw);
+
+    /* Signature, IHDR, IDAT, and IEND */
+    *png = malloc (sizeof (signature) + (13 + 12) + (zsize + 12) + 12);
+    if (*png == NULL)
+    {
+        free (zbuf);
+        sprintf (errmsg, "Allocating memory for the encoded PNG");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    memcpy (*png, signature, sizeof (signature));
+    ptr = *png + sizeof (signature);
+
+    ihdr[0] = (nsamps >> 24) & 0xff;
+    ihdr[1] = (nsamps >> 16) & 0xff;
+    ihdr[2] = (nsamps >> 8) & 0xff;
+    ihdr[3] = nsamps & 0xff;
+    ihdr[4] = (nlines >> 24) & 0xff;
+    ihdr[5] = (nlines >> 16) & 0xff;
+    ihdr[6] = (nlines >> 8) & 0xff;
+    ihdr[7] = nlines & 0xff;
+    ihdr[8] = 8;     /* bit depth */
+    ihdr[9] = 6;     /* color type RGBA */
+    ihdr[10] = 0;    /* compression method */
+    ihdr[11] = 0;    /* filter method */
+    ihdr[12] = 0;    /* no interlace */
+    ptr = put_png_chunk (ptr, "IHDR", ihdr, sizeof (ihdr));
+    ptr = put_png_chunk (ptr, "IDAT", zbuf, zsize);
+    ptr = put_png_chunk (ptr, "IEND", NULL, 0);
+    free (zbuf);
+
+    *png_size = ptr - *png;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_png_rgba
+
+PURPOSE:  Encodes an 8-bit RGBA image as a PNG and writes it to a file.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred encoding or writing the PNG
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+int write_png_rgba
+(
+    char *png_file,       /* I: name of the PNG file to write */
+    uint8 *rgba,          /* I: nlines * nsamps RGBA pixels */
+    int nlines,           /* I: number of lines in the image */
+    int nsamps            /* I: number of samples in the image */
+)
+{
+    char FUNC_NAME[] = "write_png_rgba";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    unsigned char *png = NULL;  /* encoded PNG */
+    size_t png_size;          /* size of the encoded PNG */
+    FILE *fp = NULL;          /* PNG file pointer */
+
+    if (encode_png_rgba (rgba, nlines, nsamps, &png, &png_size) != SUCCESS)
+    {
+        sprintf (errmsg, "Encoding the PNG for %s", png_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fp = fopen (png_file, "wb");
+    if (fp == NULL || fwrite (png, 1, png_size, fp) != png_size)
+    {
+        if (fp != NULL)
+            fclose (fp);
+        free (png);
+        sprintf (errmsg, "Writing the PNG file: %s", png_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    free (png);
+
+    if (fclose (fp) != 0)
+    {
+        sprintf (errmsg, "Closing the PNG file: %s", png_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
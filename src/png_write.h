@@ -0,0 +1,31 @@
+#ifndef _PNG_WRITE_H_
+#define _PNG_WRITE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "common.h"
+
+/* zlib compression level used for the PNG image data; favor speed (level 1
+   is Z_BEST_SPEED) since the images are generated on the fly */
+#define PNG_COMPRESSION 1
+
+/* Prototypes */
+int encode_png_rgba
+(
+    uint8 *rgba,          /* I: nlines * nsamps RGBA pixels */
+    int nlines,           /* I: number of lines in the image */
+    int nsamps,           /* I: number of samples in the image */
+    unsigned char **png,  /* O: address of the encoded PNG; the caller is
+                                responsible for freeing it */
+    size_t *png_size      /* O: size of the encoded PNG in bytes */
+);
+
+int write_png_rgba
+(
+    char *png_file,       /* I: name of the PNG file to write */
+    uint8 *rgba,          /* I: nlines * nsamps RGBA pixels */
+    int nlines,           /* I: number of lines in the image */
+    int nsamps            /* I: number of samples in the image */
+);
+
+#endif
@@ -0,0 +1,523 @@
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <libxml/xmlmemory.h>
+#include "profile.h"
+
+/* Names of the stages and buffers for the report */
+static char *stage_name[NUM_STAGE] = {"setup", "input", "prescan",
+    "allocate", "preview", "strips", "finish"};
+static char *buf_name[NUM_PBUF] = {"input", "index", "lut", "climatology",
+    "write", "http", "s3", "tile", "preview", "sample", "xml"};
+
+/* Usage of one stage */
+typedef struct {
+    bool entered;            /* was the stage run? */
+    double wall;             /* wall time in seconds */
+    long minflt;             /* minor page faults */
+    long majflt;             /* major page faults */
+    long maxrss;             /* peak RSS at the end of the stage in KB */
+    long rss_anon;           /* anonymous RSS at the end of the stage in KB;
+                                -1 if unknown */
+    long rss_file;           /* file-backed RSS in KB; -1 if unknown */
+    long rss_shmem;          /* shared-memory RSS in KB; -1 if unknown */
+    long long alloc;         /* bytes allocated during the stage */
+} Prof_usage_t;
+
+/* Counts for one buffer */
+typedef struct {
+    long long planned;       /* bytes called for by the options and scene
+                                geometry */
+    long long alloc;         /* bytes allocated in all */
+    long long live;          /* bytes currently allocated */
+    long long peak;          /* most bytes allocated at once */
+} Prof_count_t;
+
+/* Profile state; the counting sites are all on the main thread */
+static Prof_stage_t cur_stage = STAGE_SETUP;
+static double stage_start;
+static struct rusage stage_ru;
+static Prof_usage_t usage[NUM_STAGE];
+static Prof_count_t count[NUM_PBUF];
+
+/******************************************************************************
+MODULE:  get_wall_time
+
+PURPOSE:  Returns the CLOCK_MONOTONIC time in seconds.
+
+RETURN VALUE:
+Type = double
+Value      Description
+-----      -----------
+>=0        Current time in seconds
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static double get_wall_time ()
+{
+    struct timespec ts;      /* current time */
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec * 1.0e-9);
+}
+
+
+/******************************************************************************
+MODULE:  read_rss
+
+PURPOSE:  Reads the anonymous, file-backed, and shared-memory RSS of the
+process from /proc/self/status.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The values are left at -1 if the kernel doesn't report them.
+******************************************************************************/
+static void read_rss
+(
+    Prof_usage_t *this       /* O: usage to fill in the RSS of */
+)
+{
+    char line[256];          /* line of the status file */
+    FILE *fp = NULL;         /* status file */
+
+    this->rss_anon = -1;
+    this->rss_file = -1;
+    this->rss_shmem = -1;
+
+    fp = fopen ("/proc/self/status", "r");
+    if (fp == NULL)
+        return;
+    while (fgets (line, sizeof (line), fp) != NULL)
+    {
+        if (!strncmp (line, "RssAnon:", 8))
+            sscanf (line + 8, "%ld", &this->rss_anon);
+        else if (!strncmp (line, "RssFile:", 8))
+            sscanf (line + 8, "%ld", &this->rss_file);
+        else if (!strncmp (line, "RssShmem:", 9))
+            sscanf (line + 9, "%ld", &this->rss_shmem);
+    }
+    fclose (fp);
+}
+
+
+/******************************************************************************
+MODULE:  prof_init
+
+PURPOSE:  Starts the setup stage at the start of the run.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void prof_init ()
+{
+    cur_stage = STAGE_SETUP;
+    usage[cur_stage].entered = true;
+    stage_start = get_wall_time ();
+    getrusage (RUSAGE_SELF, &stage_ru);
+}
+
+
+/******************************************************************************
+MODULE:  prof_stage
+
+PURPOSE:  Ends the current stage, recording its wall time, page faults, and
+RSS, and starts the specified one.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The peak RSS is the process high-water mark, so the stage that raised
+     it is the one where it grows.
+******************************************************************************/
+void prof_stage
+(
+    Prof_stage_t stage       /* I: stage which starts now */
+)
+{
+    double now = get_wall_time ();   /* current time */
+    struct rusage ru;                /* usage at the end of the stage */
+    Prof_usage_t *this = &usage[cur_stage];  /* stage which ends */
+
+    getrusage (RUSAGE_SELF, &ru);
+    this->wall += now - stage_start;
+    this->minflt += ru.ru_minflt - stage_ru.ru_minflt;
+    this->majflt += ru.ru_majflt - stage_ru.ru_majflt;
+    this->maxrss = ru.ru_maxrss;
+    read_rss (this);
+
+    cur_stage = stage;
+    usage[cur_stage].entered = true;
+    stage_start = now;
+    stage_ru = ru;
+}
+
+
+/******************************************************************************
+MODULE:  add_alloc
+
+PURPOSE:  Counts an allocation against a buffer and the current stage.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static void add_alloc
+(
+    Prof_buf_t buf,          /* I: buffer the allocation is counted for */
+    size_t size              /* I: number of bytes allocated */
+)
+{
+    usage[cur_stage].alloc += size;
+    count[buf].alloc += size;
+    count[buf].live += size;
+    if (count[buf].live > count[buf].peak)
+        count[buf].peak = count[buf].live;
+}
+
+
+/******************************************************************************
+MODULE:  prof_malloc
+
+PURPOSE:  Allocates memory and counts it against a buffer.
+
+RETURN VALUE:
+Type = void *
+Value      Description
+-----      -----------
+NULL       Error allocating the memory
+non-NULL   Allocated memory
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void *prof_malloc
+(
+    Prof_buf_t buf,          /* I: buffer the allocation is counted for */
+    size_t size              /* I: number of bytes to allocate */
+)
+{
+    void *ptr = malloc (size);   /* allocated memory */
+
+    if (ptr != NULL)
+        add_alloc (buf, size);
+    return (ptr);
+}
+
+
+/******************************************************************************
+MODULE:  prof_calloc
+
+PURPOSE:  Allocates zeroed memory and counts it against a buffer.
+
+RETURN VALUE:
+Type = void *
+Value      Description
+-----      -----------
+NULL       Error allocating the memory
+non-NULL   Allocated memory
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void *prof_calloc
+(
+    Prof_buf_t buf,          /* I: buffer the allocation is counted for */
+    size_t nmemb,            /* I: number of elements to allocate */
+    size_t size              /* I: size of each element in bytes */
+)
+{
+    void *ptr = calloc (nmemb, size);   /* allocated memory */
+
+    if (ptr != NULL)
+        add_alloc (buf, nmemb * size);
+    return (ptr);
+}
+
+
+/******************************************************************************
+MODULE:  prof_free
+
+PURPOSE:  Frees memory which was counted against a buffer, for buffers which
+come and go during the run.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void prof_free
+(
+    Prof_buf_t buf,          /* I: buffer the allocation was counted for */
+    void *ptr,               /* I: memory to free; may be NULL */
+    size_t size              /* I: number of bytes which were allocated */
+)
+{
+    if (ptr == NULL)
+        return;
+    free (ptr);
+    count[buf].live -= size;
+}
+
+
+/******************************************************************************
+MODULE:  prof_count
+
+PURPOSE:  Counts memory allocated outside of the counting wrappers, such as
+by the index library, against a buffer.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void prof_count
+(
+    Prof_buf_t buf,          /* I: buffer the allocation is counted for */
+    size_t size              /* I: number of bytes allocated elsewhere */
+)
+{
+    add_alloc (buf, size);
+}
+
+
+/******************************************************************************
+MODULE:  prof_plan
+
+PURPOSE:  Adds to the number of bytes planned for a buffer.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void prof_plan
+(
+    Prof_buf_t buf,          /* I: buffer the plan is for */
+    size_t size              /* I: number of bytes the options and scene
+                                geometry call for */
+)
+{
+    count[buf].planned += size;
+}
+
+
+/******************************************************************************
+MODULE:  prof_planned
+
+PURPOSE:  Returns the number of bytes planned for a buffer.
+
+RETURN VALUE:
+Type = long long
+Value      Description
+-----      -----------
+>=0        Bytes added by prof_plan
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+long long prof_planned
+(
+    Prof_buf_t buf           /* I: buffer the plan is for */
+)
+{
+    return (count[buf].planned);
+}
+
+
+/******************************************************************************
+MODULE:  prof_buf_name
+
+PURPOSE:  Returns the name of a buffer, as used in the report.
+
+RETURN VALUE:
+Type = char *
+Value      Description
+-----      -----------
+non-NULL   Name of the buffer
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+char *prof_buf_name
+(
+    Prof_buf_t buf           /* I: buffer */
+)
+{
+    return (buf_name[buf]);
+}
+
+
+/******************************************************************************
+MODULE:  prof_xml_malloc, prof_xml_realloc, prof_xml_strdup
+
+PURPOSE:  Counting allocators for libxml2.
+
+RETURN VALUE:
+Type = void * or char *
+Value      Description
+-----      -----------
+NULL       Error allocating the memory
+non-NULL   Allocated memory
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. libxml2 doesn't pass the size to free, so its bytes are the total
+     allocated rather than the peak, and a realloc counts its full new size.
+******************************************************************************/
+static void *prof_xml_malloc
+(
+    size_t size              /* I: number of bytes to allocate */
+)
+{
+    void *ptr = malloc (size);   /* allocated memory */
+
+    if (ptr != NULL)
+        add_alloc (PBUF_XML, size);
+    return (ptr);
+}
+
+static void *prof_xml_realloc
+(
+    void *old,               /* I: memory to resize */
+    size_t size              /* I: new number of bytes */
+)
+{
+    void *ptr = realloc (old, size);   /* resized memory */
+
+    if (ptr != NULL)
+        add_alloc (PBUF_XML, size);
+    return (ptr);
+}
+
+static char *prof_xml_strdup
+(
+    const char *str          /* I: string to copy */
+)
+{
+    char *ptr = strdup (str);   /* copy of the string */
+
+    if (ptr != NULL)
+        add_alloc (PBUF_XML, strlen (str) + 1);
+    return (ptr);
+}
+
+
+/******************************************************************************
+MODULE:  prof_xml_setup
+
+PURPOSE:  Routes the libxml2 allocations through the counting allocators.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Must be called before libxml2 allocates anything, since memory is
+     freed with the allocator it came from.
+******************************************************************************/
+void prof_xml_setup ()
+{
+    xmlMemSetup (free, prof_xml_malloc, prof_xml_realloc, prof_xml_strdup);
+}
+
+
+/******************************************************************************
+MODULE:  prof_report
+
+PURPOSE:  Ends the current stage and prints the wall time, page faults, RSS,
+and allocations of each stage, followed by the planned versus actual size of
+each buffer.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Sizes are in MB.  The actual size of a buffer is the most that was
+     allocated at once; the total includes buffers which were freed and
+     allocated again, such as the partial tiles.
+******************************************************************************/
+void prof_report ()
+{
+    int i;                   /* looping variable */
+    Prof_usage_t *u = NULL;  /* usage of the current stage */
+    double mb = 1024.0 * 1024.0;  /* bytes per MB */
+
+    prof_stage (cur_stage);
+
+    printf ("Profile by stage:\n");
+    printf ("  %-10s %8s %9s %9s %9s %9s %9s %10s %8s\n", "stage",
+        "wall (s)", "peak RSS", "anon RSS", "file RSS", "shmem RSS",
+        "allocated", "minor flt", "major flt");
+    for (i = 0; i < NUM_STAGE; i++)
+    {
+        u = &usage[i];
+        if (!u->entered)
+            continue;
+        printf ("  %-10s %8.3f %9.1f %9.1f %9.1f %9.1f %9.1f %10ld %8ld\n",
+            stage_name[i], u->wall, u->maxrss / 1024.0, u->rss_anon / 1024.0,
+            u->rss_file / 1024.0, u->rss_shmem / 1024.0, u->alloc / mb,
+            u->minflt, u->majflt);
+    }
+
+    printf ("Profile by buffer:\n");
+    printf ("  %-12s %10s %10s %10s\n", "buffer", "planned", "actual",
+        "total");
+    for (i = 0; i < NUM_PBUF; i++)
+    {
+        if (count[i].planned == 0 && count[i].alloc == 0)
+            continue;
+        if (i == PBUF_XML)
+            printf ("  %-12s %10s %10s %10.1f\n", buf_name[i], "-", "-",
+                count[i].alloc / mb);
+        else
+            printf ("  %-12s %10.1f %10.1f %10.1f\n", buf_name[i],
+                count[i].planned / mb, count[i].peak / mb,
+                count[i].alloc / mb);
+    }
+    fflush (stdout);
+}
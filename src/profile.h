@@ -0,0 +1,73 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "common.h"
+
+/* Processing stages the memory and faults are reported for */
+typedef enum {STAGE_SETUP=0, STAGE_INPUT, STAGE_PRESCAN, STAGE_ALLOCATE,
+  STAGE_PREVIEW, STAGE_STRIPS, STAGE_FINISH, NUM_STAGE} Prof_stage_t;
+
+/* Buffers the allocations are counted for */
+typedef enum {PBUF_INPUT=0, PBUF_INDEX, PBUF_LUT, PBUF_CLIMATOLOGY,
+  PBUF_WRITE, PBUF_HTTP, PBUF_S3, PBUF_TILE, PBUF_PREVIEW, PBUF_SAMPLE,
+  PBUF_XML, NUM_PBUF} Prof_buf_t;
+
+/* Prototypes */
+void prof_init ();
+
+void prof_stage
+(
+    Prof_stage_t stage       /* I: stage which starts now */
+);
+
+void *prof_malloc
+(
+    Prof_buf_t buf,          /* I: buffer the allocation is counted for */
+    size_t size              /* I: number of bytes to allocate */
+);
+
+void *prof_calloc
+(
+    Prof_buf_t buf,          /* I: buffer the allocation is counted for */
+    size_t nmemb,            /* I: number of elements to allocate */
+    size_t size              /* I: size of each element in bytes */
+);
+
+void prof_free
+(
+    Prof_buf_t buf,          /* I: buffer the allocation was counted for */
+    void *ptr,               /* I: memory to free; may be NULL */
+    size_t size              /* I: number of bytes which were allocated */
+);
+
+void prof_count
+(
+    Prof_buf_t buf,          /* I: buffer the allocation is counted for */
+    size_t size              /* I: number of bytes allocated elsewhere */
+);
+
+void prof_plan
+(
+    Prof_buf_t buf,          /* I: buffer the plan is for */
+    size_t size              /* I: number of bytes the options and scene
+                                geometry call for */
+);
+
+long long prof_planned
+(
+    Prof_buf_t buf           /* I: buffer the plan is for */
+);
+
+char *prof_buf_name
+(
+    Prof_buf_t buf           /* I: buffer */
+);
+
+void prof_xml_setup ();
+
+void prof_report ();
+
+#endif
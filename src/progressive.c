@@ -0,0 +1,518 @@
+#include <time.h>
+#include <unistd.h>
+#include "si.h"
+#include "progressive.h"
+
+/******************************************************************************
+MODULE:  open_progressive
+
+PURPOSE:  Sets up the preview levels for computing the indices coarse to
+fine, and allocates the buffers for the pixels which still need computing.
+
+RETURN VALUE:
+Type = Progressive_t*
+Value      Description
+-----      -----------
+NULL       Error allocating memory
+non-NULL   Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The level buffers themselves are allocated by make_progressive_levels.
+******************************************************************************/
+Progressive_t *open_progressive
+(
+    Espa_internal_meta_t *in_meta, /* I: input metadata structure */
+    Input_t *input           /* I: input reflectance band data */
+)
+{
+    char FUNC_NAME[] = "open_progressive";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int factor[PROG_NLEVEL] = PROG_FACTORS; /* decimation factor of each
+                                 preview level */
+    int lev;                  /* looping variable for levels */
+    int i;                    /* looping variable */
+    bool alloc_ok = true;     /* were the buffers allocated? */
+    Progressive_t *this = NULL; /* progressive state to be returned */
+
+    this = calloc (1, sizeof (Progressive_t));
+    if (this == NULL)
+    {
+        sprintf (errmsg, "Allocating the progressive structure");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    this->nlines = input->nlines;
+    this->nsamps = input->nsamps;
+    for (lev = 0; lev < PROG_NLEVEL; lev++)
+    {
+        this->factor[lev] = factor[lev];
+        this->lnlines[lev] = (input->nlines + factor[lev] - 1) / factor[lev];
+        this->lnsamps[lev] = (input->nsamps + factor[lev] - 1) / factor[lev];
+    }
+    this->gmeta = in_meta->global;
+    this->pixsize[0] = input->pixsize[0];
+    this->pixsize[1] = input->pixsize[1];
+
+    for (i = 0; i < MAX_SI_BANDS; i++)
+    {
+        this->cband[i] = malloc (input->nsamps * sizeof (int16));
+        this->cdn[i] = malloc (input->nsamps * sizeof (uint8));
+        if (this->cband[i] == NULL || this->cdn[i] == NULL)
+            alloc_ok = false;
+    }
+    this->cout = malloc (input->nsamps * sizeof (int16));
+    this->cpos = malloc (input->nsamps * sizeof (int));
+    if (!alloc_ok || this->cout == NULL || this->cpos == NULL)
+    {
+        sprintf (errmsg, "Allocating the progressive line buffers");
+        error_handler (true, FUNC_NAME, errmsg);
+        close_progressive (this);
+        return (NULL);
+    }
+
+    return (this);
+}
+
+
+/******************************************************************************
+MODULE:  compute_level_line
+
+PURPOSE:  Computes one line of an index at one level, taking the pixels the
+previous level already computed from it.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Level sample s is full-resolution sample s * factor.  A pixel was
+     computed by the previous level if both its full-resolution line and
+     sample are multiples of the previous factor.
+  2. The remaining pixels are packed together so the kernel (or lookup
+     table) is only run over them.
+******************************************************************************/
+static void compute_level_line
+(
+    Progressive_t *this,     /* I: progressive state */
+    Input_t *input,          /* I: input reflectance band data */
+    Mysi_list_t si,          /* I: spectral index */
+    int16 *lut,              /* I: lookup table for the DN bands; NULL if
+                                computed by the kernel */
+    int bline,               /* I: line of the input strip buffers holding
+                                the full-resolution line */
+    int line,                /* I: full-resolution line (0-based) */
+    int factor,              /* I: decimation factor of this level */
+    int prev,                /* I: previous level; -1 if none */
+    int16 *out               /* O: line of the level */
+)
+{
+    int nband;                /* number of input bands for the index */
+    int band[MAX_SI_BANDS];   /* input buffer of each band of the index */
+    int ib;                   /* looping variable for bands */
+    int s;                    /* looping variable for level samples */
+    int n = 0;                /* number of packed pixels */
+    int nout;                 /* number of samples in the level */
+    int pf = 0;               /* factor of the previous level */
+    long off;                 /* offset of the line in the strip buffers */
+    long samp;                /* full-resolution sample */
+    int16 *prev_line = NULL;  /* line of the previous level, if it computed
+                                 pixels on this line */
+
+    nband = get_index_bands (input, si, band);
+    off = (long) bline * input->nsamps;
+    nout = (this->nsamps + factor - 1) / factor;
+    if (prev >= 0 && line % this->factor[prev] == 0)
+    {
+        pf = this->factor[prev];
+        prev_line = &this->level[prev][si][(long) (line / pf) *
+            this->lnsamps[prev]];
+    }
+
+    for (s = 0; s < nout; s++)
+    {
+        samp = (long) s * factor;
+        if (prev_line != NULL && samp % pf == 0)
+        {
+            out[s] = prev_line[samp / pf];
+            continue;
+        }
+        for (ib = 0; ib < nband; ib++)
+        {
+            if (lut != NULL)
+                this->cdn[ib][n] = input->dn_buf[band[ib]][off + samp];
+            else
+                this->cband[ib][n] = input->refl_buf[band[ib]][off + samp];
+        }
+        this->cpos[n++] = s;
+    }
+    if (n == 0)
+        return;
+
+    if (lut != NULL)
+        apply_index_lut (lut, this->cdn[0], this->cdn[1], 1, n, this->cout);
+    else
+        compute_spectral_index (si, this->cband, input->refl_scale_fact,
+            input->refl_fill, input->refl_saturate_val, 1, n, this->cout);
+
+    for (s = 0; s < n; s++)
+        out[this->cpos[s]] = this->cout[s];
+}
+
+
+/******************************************************************************
+MODULE:  publish_level
+
+PURPOSE:  Writes one preview level of an index with its ENVI header, so
+viewers polling for it only ever see a complete file.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error writing or uploading the level
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The level is written as {scene_name}_{index}_p{factor}.img, through a
+     temporary file which is renamed once it's complete.  The header is
+     written first.
+  2. If s3 is specified, both files are uploaded and removed locally.
+******************************************************************************/
+static int publish_level
+(
+    Progressive_t *this,     /* I: progressive state */
+    int lev,                 /* I: preview level */
+    int16 *vals,             /* I: values of the level */
+    char *short_si_name,     /* I: short name of the index */
+    char *long_si_name,      /* I: long name of the index */
+    S3_upload_t *s3          /* I: upload to publish to; NULL for local */
+)
+{
+    char FUNC_NAME[] = "publish_level";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char img_file[STR_SIZE];  /* level band file */
+    char hdr_file[STR_SIZE];  /* level ENVI header file */
+    char tmp_file[STR_SIZE + 4]; /* band file while it's written */
+    FILE *fp = NULL;          /* level band file pointer */
+    Espa_band_meta_t bmeta;   /* band metadata for the ENVI header */
+    Envi_header_t envi_hdr;   /* output ENVI header information */
+
+    if (snprintf (img_file, sizeof (img_file), "%s_%s_p%d.img",
+        this->gmeta.product_id, short_si_name, this->factor[lev]) >=
+        (int) sizeof (img_file) || snprintf (hdr_file, sizeof (hdr_file),
+        "%s_%s_p%d.hdr", this->gmeta.product_id, short_si_name,
+        this->factor[lev]) >= (int) sizeof (hdr_file))
+    {
+        sprintf (errmsg, "Preview level file name is too long: %.900s",
+            this->gmeta.product_id);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    snprintf (tmp_file, sizeof (tmp_file), "%s.tmp", img_file);
+
+    memset (&bmeta, 0, sizeof (bmeta));
+    snprintf (bmeta.name, sizeof (bmeta.name), "%s_p%d", short_si_name,
+        this->factor[lev]);
+    snprintf (bmeta.long_name, sizeof (bmeta.long_name), "%s", long_si_name);
+    strcpy (bmeta.file_name, img_file);
+    strcpy (bmeta.product, "spectral_indices");
+    strcpy (bmeta.category, "index");
+    strcpy (bmeta.pixel_units, "meters");
+    strcpy (bmeta.data_units, "band ratio index value");
+    bmeta.data_type = ESPA_INT16;
+    bmeta.nlines = this->lnlines[lev];
+    bmeta.nsamps = this->lnsamps[lev];
+    bmeta.pixel_size[0] = this->pixsize[0] * this->factor[lev];
+    bmeta.pixel_size[1] = this->pixsize[1] * this->factor[lev];
+    bmeta.fill_value = FILL_VALUE;
+    bmeta.saturate_value = SATURATE_VALUE;
+    bmeta.scale_factor = SCALE_FACTOR;
+    bmeta.valid_range[0] = (float) -FLOAT_TO_INT;
+    bmeta.valid_range[1] = (float) FLOAT_TO_INT;
+    if (create_envi_struct (&bmeta, &this->gmeta, &envi_hdr) != SUCCESS ||
+        write_envi_hdr (hdr_file, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing ENVI header file %.900s", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fp = open_raw_binary (tmp_file, "w");
+    if (fp == NULL || write_raw_binary (fp, this->lnlines[lev],
+        this->lnsamps[lev], sizeof (int16), vals) != SUCCESS)
+    {
+        if (fp != NULL)
+            close_raw_binary (fp);
+        sprintf (errmsg, "Writing the preview level %.900s", tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    close_raw_binary (fp);
+    if (rename (tmp_file, img_file) != 0)
+    {
+        sprintf (errmsg, "Renaming %.480s to %.480s", tmp_file, img_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (s3 != NULL)
+    {
+        if (s3_put_file (s3, hdr_file, hdr_file) != SUCCESS ||
+            s3_put_file (s3, img_file, img_file) != SUCCESS)
+        {
+            sprintf (errmsg, "Uploading the preview level %.900s",
+                img_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        unlink (hdr_file);
+        unlink (img_file);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  make_progressive_levels
+
+PURPOSE:  Computes and publishes each preview level of the requested
+indices, coarsest first, ahead of the full-resolution pass.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error reading the input or publishing a level
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Only the lines of the level are read, one at a time.  Pixels computed
+     by the previous level are copied, not recomputed, and each level is
+     kept for the next one.  Only the finest preview is kept for the
+     full-resolution pass.
+******************************************************************************/
+int make_progressive_levels
+(
+    Progressive_t *this,     /* I/O: progressive state */
+    Input_t *input,          /* I/O: input reflectance band data; the strip
+                                buffers are overwritten */
+    int num_si,              /* I: number of requested indices */
+    Mysi_list_t si_list[],   /* I: requested indices, in output order */
+    char short_si_names[][STR_SIZE], /* I: short names of the indices */
+    char long_si_names[][STR_SIZE],  /* I: long names of the indices */
+    int16 *si_lut[NUM_SI],   /* I: lookup table of each index for the DN
+                                bands; NULL if computed by the kernel */
+    S3_upload_t *s3,         /* I: upload to publish the levels to; NULL to
+                                publish them locally */
+    bool verbose             /* I: print the time each level took? */
+)
+{
+    char FUNC_NAME[] = "make_progressive_levels";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int lev;                  /* looping variable for levels */
+    int i;                    /* looping variable for indices */
+    int ib;                   /* looping variable for bands */
+    int ll;                   /* looping variable for level lines */
+    Mysi_list_t si;           /* current spectral index */
+    struct timespec t0, t1;   /* start and end of the current level */
+
+    for (lev = 0; lev < PROG_NLEVEL; lev++)
+    {
+        clock_gettime (CLOCK_MONOTONIC, &t0);
+        for (i = 0; i < num_si; i++)
+        {
+            si = si_list[i];
+            this->level[lev][si] = prof_malloc (PBUF_PREVIEW,
+                (size_t) this->lnlines[lev] * this->lnsamps[lev] *
+                sizeof (int16));
+            if (this->level[lev][si] == NULL)
+            {
+                sprintf (errmsg, "Allocating preview level %d of the %s", lev,
+                    si_upper_name (si));
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+
+        for (ll = 0; ll < this->lnlines[lev]; ll++)
+        {
+            for (ib = 0; ib < input->nrefl_band; ib++)
+            {
+                if (get_input_refl_lines (input, ib, ll * this->factor[lev],
+                    1) != SUCCESS)
+                {
+                    sprintf (errmsg, "Reading line %d of band %d for preview "
+                        "level %d", ll * this->factor[lev], ib, lev);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+            }
+
+            for (i = 0; i < num_si; i++)
+            {
+                si = si_list[i];
+                compute_level_line (this, input, si, si_lut[si], 0,
+                    ll * this->factor[lev], this->factor[lev], lev - 1,
+                    &this->level[lev][si][(long) ll * this->lnsamps[lev]]);
+            }
+        }
+
+        for (i = 0; i < num_si; i++)
+        {
+            if (publish_level (this, lev, this->level[lev][si_list[i]],
+                short_si_names[i], long_si_names[i], s3) != SUCCESS)
+            {
+                sprintf (errmsg, "Publishing preview level %d", lev);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+
+        /* Only the finest preview is needed from here on */
+        if (lev > 0)
+        {
+            for (i = 0; i < NUM_SI; i++)
+            {
+                prof_free (PBUF_PREVIEW, this->level[lev - 1][i],
+                    (size_t) this->lnlines[lev - 1] * this->lnsamps[lev - 1] *
+                    sizeof (int16));
+                this->level[lev - 1][i] = NULL;
+            }
+        }
+
+        clock_gettime (CLOCK_MONOTONIC, &t1);
+        if (verbose)
+            printf ("  Preview 1/%d published in %.3f seconds\n",
+                this->factor[lev], (t1.tv_sec - t0.tv_sec) +
+                (t1.tv_nsec - t0.tv_nsec) * 1e-9);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  compute_progressive_lines
+
+PURPOSE:  Computes a full-resolution strip of an index, taking the pixels
+the finest preview level already computed from it.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Runs of lines the preview didn't touch are computed in one call, as
+     without the previews.
+******************************************************************************/
+void compute_progressive_lines
+(
+    Progressive_t *this,     /* I: progressive state */
+    Input_t *input,          /* I: input reflectance band data holding the
+                                strip */
+    Mysi_list_t si,          /* I: spectral index */
+    int16 *lut,              /* I: lookup table for the DN bands; NULL if
+                                computed by the kernel */
+    int iline,               /* I: first line of the strip (0-based) */
+    int nlines,              /* I: number of lines in the strip */
+    int16 *spec_indx         /* O: full-resolution index strip */
+)
+{
+    int il;                   /* looping variable for strip lines */
+    int nrun;                 /* number of lines in the current run */
+    int nband;                /* number of input bands for the index */
+    int band[MAX_SI_BANDS];   /* input buffer of each band of the index */
+    int ib;                   /* looping variable for bands */
+    int pf = this->factor[PROG_NLEVEL - 1]; /* factor of the finest preview */
+    long off;                 /* offset of the run in the strip buffers */
+    int16 *in[MAX_SI_BANDS];  /* input bands for the run */
+
+    nband = get_index_bands (input, si, band);
+    il = 0;
+    while (il < nlines)
+    {
+        if ((iline + il) % pf == 0)
+        {
+            compute_level_line (this, input, si, lut, il, iline + il, 1,
+                PROG_NLEVEL - 1, &spec_indx[(long) il * input->nsamps]);
+            il++;
+            continue;
+        }
+
+        /* Lines up to the next preview line */
+        nrun = pf - (iline + il) % pf;
+        if (il + nrun > nlines)
+            nrun = nlines - il;
+        off = (long) il * input->nsamps;
+        if (lut != NULL)
+            apply_index_lut (lut, input->dn_buf[band[0]] + off,
+                input->dn_buf[band[1]] + off, nrun, input->nsamps,
+                &spec_indx[off]);
+        else
+        {
+            for (ib = 0; ib < nband; ib++)
+                in[ib] = input->refl_buf[band[ib]] + off;
+            compute_spectral_index (si, in, input->refl_scale_fact,
+                input->refl_fill, input->refl_saturate_val, nrun,
+                input->nsamps, &spec_indx[off]);
+        }
+        il += nrun;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  close_progressive
+
+PURPOSE:  Frees the progressive state.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void close_progressive
+(
+    Progressive_t *this      /* I: progressive state to free */
+)
+{
+    int lev;                  /* looping variable for levels */
+    int i;                    /* looping variable */
+
+    if (this == NULL)
+        return;
+
+    for (lev = 0; lev < PROG_NLEVEL; lev++)
+    {
+        for (i = 0; i < NUM_SI; i++)
+            prof_free (PBUF_PREVIEW, this->level[lev][i],
+                (size_t) this->lnlines[lev] * this->lnsamps[lev] *
+                sizeof (int16));
+    }
+    for (i = 0; i < MAX_SI_BANDS; i++)
+    {
+        free (this->cband[i]);
+        free (this->cdn[i]);
+    }
+    free (this->cout);
+    free (this->cpos);
+    free (this);
+}
@@ -0,0 +1,74 @@
+#ifndef _PROGRESSIVE_H_
+#define _PROGRESSIVE_H_
+
+#include "common.h"
+#include "input.h"
+#include "s3_upload.h"
+#include "espa_metadata.h"
+
+/* Decimation factors of the preview levels, coarsest first.  Each preview
+   keeps every factor'th line and sample, and the full-resolution products
+   are the last level. */
+#define PROG_NLEVEL 2
+#define PROG_FACTORS {16, 4}
+
+/* Structure for computing the indices coarse to fine */
+typedef struct {
+    int nlines;              /* number of full-resolution lines */
+    int nsamps;              /* number of full-resolution samples */
+    int factor[PROG_NLEVEL]; /* decimation factor of each preview level */
+    int lnlines[PROG_NLEVEL]; /* number of lines in each preview level */
+    int lnsamps[PROG_NLEVEL]; /* number of samples in each preview level */
+    int16 *level[PROG_NLEVEL][NUM_SI]; /* each preview level of each index;
+                                NULL once it's no longer needed */
+    int16 *cband[MAX_SI_BANDS]; /* input pixels of a line which still need
+                                computing, packed together */
+    uint8 *cdn[MAX_SI_BANDS]; /* same for the 8-bit DN bands */
+    int16 *cout;             /* index values of the packed pixels */
+    int *cpos;               /* level sample of each packed pixel */
+    Espa_global_meta_t gmeta; /* scene global metadata, for the headers */
+    float pixsize[2];        /* full-resolution pixel size */
+} Progressive_t;
+
+/* Prototypes */
+Progressive_t *open_progressive
+(
+    Espa_internal_meta_t *in_meta, /* I: input metadata structure */
+    Input_t *input           /* I: input reflectance band data */
+);
+
+int make_progressive_levels
+(
+    Progressive_t *this,     /* I/O: progressive state */
+    Input_t *input,          /* I/O: input reflectance band data; the strip
+                                buffers are overwritten */
+    int num_si,              /* I: number of requested indices */
+    Mysi_list_t si_list[],   /* I: requested indices, in output order */
+    char short_si_names[][STR_SIZE], /* I: short names of the indices */
+    char long_si_names[][STR_SIZE],  /* I: long names of the indices */
+    int16 *si_lut[NUM_SI],   /* I: lookup table of each index for the DN
+                                bands; NULL if computed by the kernel */
+    S3_upload_t *s3,         /* I: upload to publish the levels to; NULL to
+                                publish them locally */
+    bool verbose             /* I: print the time each level took? */
+);
+
+void compute_progressive_lines
+(
+    Progressive_t *this,     /* I: progressive state */
+    Input_t *input,          /* I: input reflectance band data holding the
+                                strip */
+    Mysi_list_t si,          /* I: spectral index */
+    int16 *lut,              /* I: lookup table for the DN bands; NULL if
+                                computed by the kernel */
+    int iline,               /* I: first line of the strip (0-based) */
+    int nlines,              /* I: number of lines in the strip */
+    int16 *spec_indx         /* O: full-resolution index strip */
+);
+
+void close_progressive
+(
+    Progressive_t *this      /* I: progressive state to free */
+);
+
+#endif
@@ -0,0 +1,376 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "si.h"
+#include "rate_limit.h"
+
+/******************************************************************************
+MODULE:  get_monotonic_time
+
+PURPOSE:  Returns the CLOCK_MONOTONIC time in seconds.  The clock is the same
+for every process on the node, so it can be stored in the shared bucket.
+
+RETURN VALUE:
+Type = double
+Value      Description
+-----      -----------
+>=0        Current time in seconds
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static double get_monotonic_time ()
+{
+    struct timespec ts;      /* current time */
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec * 1.0e-9);
+}
+
+
+/******************************************************************************
+MODULE:  take_tokens
+
+PURPOSE:  Refills the token bucket for the time since the last refill and
+takes the tokens for the specified number of bytes.
+
+RETURN VALUE:
+Type = double
+Value      Description
+-----      -----------
+>=0        Number of seconds the caller needs to wait before doing the I/O
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The caller is responsible for locking a shared bucket.
+******************************************************************************/
+static double take_tokens
+(
+    Token_bucket_t *bucket,  /* I/O: token bucket */
+    size_t nbytes            /* I: number of bytes to take tokens for */
+)
+{
+    double now = get_monotonic_time ();   /* current time */
+
+    bucket->tokens += (now - bucket->last) * bucket->rate;
+    if (bucket->tokens > bucket->burst)
+        bucket->tokens = bucket->burst;
+    bucket->last = now;
+
+    bucket->tokens -= nbytes;
+    if (bucket->tokens >= 0.0)
+        return (0.0);
+    return (-bucket->tokens / bucket->rate);
+}
+
+
+/******************************************************************************
+MODULE:  init_bucket
+
+PURPOSE:  Sets a token bucket to the specified rate with a full burst.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static void init_bucket
+(
+    Token_bucket_t *bucket,  /* O: token bucket */
+    double rate              /* I: refill rate in bytes per second */
+)
+{
+    bucket->rate = rate;
+    bucket->burst = rate * IO_BURST_SECS;
+    bucket->tokens = bucket->burst;
+    bucket->last = get_monotonic_time ();
+}
+
+
+/******************************************************************************
+MODULE:  open_node_bucket
+
+PURPOSE:  Attaches to the node-wide token bucket in POSIX shared memory,
+creating and setting it up if this is the first process to use it.
+
+RETURN VALUE:
+Type = Io_node_bucket_t*
+Value      Description
+-----      -----------
+NULL       Error occurred creating or attaching to the bucket
+non-NULL   Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The segment is left in place after the process exits so later jobs
+     share the same bucket.
+  2. Every process sets the bucket rate to its own node limit when it
+     attaches, so all jobs on a node should be given the same limit.
+  3. Another process may open the bucket between its creation and its
+     sizing, so it waits for both the size and the setup.
+******************************************************************************/
+static Io_node_bucket_t *open_node_bucket
+(
+    char *name,              /* I: name of the shared-memory bucket */
+    double rate              /* I: node-wide limit in bytes per second */
+)
+{
+    char FUNC_NAME[] = "open_node_bucket";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int fd;                   /* shared-memory file descriptor */
+    int wait;                 /* number of 0.1 second waits for the setup */
+    bool creator = true;      /* did this process create the bucket? */
+    struct stat st;           /* status of the shared-memory object */
+    pthread_mutexattr_t attr; /* attributes for the shared lock */
+    Io_node_bucket_t *node = NULL;  /* mapped bucket */
+
+    fd = shm_open (name, O_RDWR | O_CREAT | O_EXCL, 0666);
+    if (fd < 0 && errno == EEXIST)
+    {
+        creator = false;
+        fd = shm_open (name, O_RDWR, 0);
+    }
+    if (fd < 0)
+    {
+        sprintf (errmsg, "Opening the node-wide I/O bucket %s: %s", name,
+            strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    /* Let jobs run by other users share the bucket regardless of umask */
+    if (creator && (fchmod (fd, 0666) != 0 ||
+        ftruncate (fd, sizeof (Io_node_bucket_t)) != 0))
+    {
+        close (fd);
+        shm_unlink (name);
+        sprintf (errmsg, "Sizing the node-wide I/O bucket %s", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    /* Wait for the creator to size the bucket; touching a mapping past the
+       end of the object would raise SIGBUS */
+    for (wait = 0; !creator; wait++)
+    {
+        if (fstat (fd, &st) != 0)
+        {
+            close (fd);
+            sprintf (errmsg, "Checking the size of the node-wide I/O bucket "
+                "%s: %s", name, strerror (errno));
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+        if (st.st_size >= (off_t) sizeof (Io_node_bucket_t))
+            break;
+        if (wait >= IO_BUCKET_WAIT_SECS * 10)
+        {
+            close (fd);
+            sprintf (errmsg, "Node-wide I/O bucket %s was never sized", name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+        usleep (100000);
+    }
+
+    node = mmap (NULL, sizeof (Io_node_bucket_t), PROT_READ | PROT_WRITE,
+        MAP_SHARED, fd, 0);
+    close (fd);
+    if (node == MAP_FAILED)
+    {
+        sprintf (errmsg, "Mapping the node-wide I/O bucket %s", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    if (creator)
+    {
+        /* The lock is robust so a job killed while holding it doesn't hang
+           the rest of the node */
+        pthread_mutexattr_init (&attr);
+        pthread_mutexattr_setpshared (&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust (&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init (&node->lock, &attr);
+        pthread_mutexattr_destroy (&attr);
+        init_bucket (&node->bucket, rate);
+        node->version = IO_BUCKET_VERSION;
+        __sync_synchronize ();
+        node->magic = IO_BUCKET_MAGIC;
+        return (node);
+    }
+
+    /* Wait for the creator to finish setting up the bucket */
+    for (wait = 0; node->magic != IO_BUCKET_MAGIC &&
+        wait < IO_BUCKET_WAIT_SECS * 10; wait++)
+        usleep (100000);
+    if (node->magic != IO_BUCKET_MAGIC || node->version != IO_BUCKET_VERSION)
+    {
+        munmap (node, sizeof (Io_node_bucket_t));
+        sprintf (errmsg, "Node-wide I/O bucket %s is not a version %d "
+            "bucket", name, IO_BUCKET_VERSION);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    if (pthread_mutex_lock (&node->lock) == EOWNERDEAD)
+        pthread_mutex_consistent (&node->lock);
+    if (node->bucket.rate != rate)
+        init_bucket (&node->bucket, rate);
+    pthread_mutex_unlock (&node->lock);
+
+    return (node);
+}
+
+
+/******************************************************************************
+MODULE:  open_rate_limit
+
+PURPOSE:  Sets up the I/O rate limiter with a per-process limit and/or a
+node-wide limit.
+
+RETURN VALUE:
+Type = Rate_limit_t*
+Value      Description
+-----      -----------
+NULL       Error occurred setting up the limiter
+non-NULL   Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Use close_rate_limit to detach from the node-wide bucket and free the
+     limiter.
+******************************************************************************/
+Rate_limit_t *open_rate_limit
+(
+    double rate_mb,          /* I: per-process limit in MB/s; 0 for none */
+    double node_rate_mb,     /* I: node-wide limit in MB/s; 0 for none */
+    char *node_bucket        /* I: name of the node-wide bucket; NULL for the
+                                default */
+)
+{
+    char FUNC_NAME[] = "open_rate_limit";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Rate_limit_t *this = NULL;  /* rate limiter to be returned */
+
+    this = malloc (sizeof (Rate_limit_t));
+    if (this == NULL)
+    {
+        sprintf (errmsg, "Allocating the I/O rate limiter");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    init_bucket (&this->local, rate_mb * 1024.0 * 1024.0);
+    this->node = NULL;
+    this->slept = 0.0;
+
+    if (node_rate_mb > 0.0)
+    {
+        this->node = open_node_bucket (node_bucket != NULL ? node_bucket :
+            IO_NODE_BUCKET, node_rate_mb * 1024.0 * 1024.0);
+        if (this->node == NULL)
+        {
+            free (this);
+            sprintf (errmsg, "Setting up the node-wide I/O limit");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+    }
+
+    return (this);
+}
+
+
+/******************************************************************************
+MODULE:  rate_limit_io
+
+PURPOSE:  Waits, if needed, so the reads and writes stay within the
+per-process and node-wide limits.  Call before each read or write.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The tokens are taken from both buckets and the caller waits for the
+     longer of the two debts.
+******************************************************************************/
+void rate_limit_io
+(
+    Rate_limit_t *this,      /* I/O: rate limiter; NULL for no limit */
+    size_t nbytes            /* I: number of bytes about to be read or
+                                written */
+)
+{
+    double wait = 0.0;        /* seconds to wait */
+    double node_wait;         /* seconds to wait for the node-wide bucket */
+    struct timespec ts;       /* time to sleep */
+
+    if (this == NULL)
+        return;
+
+    if (this->local.rate > 0.0)
+        wait = take_tokens (&this->local, nbytes);
+
+    if (this->node != NULL)
+    {
+        if (pthread_mutex_lock (&this->node->lock) == EOWNERDEAD)
+            pthread_mutex_consistent (&this->node->lock);
+        node_wait = take_tokens (&this->node->bucket, nbytes);
+        pthread_mutex_unlock (&this->node->lock);
+        if (node_wait > wait)
+            wait = node_wait;
+    }
+
+    if (wait > 0.0)
+    {
+        ts.tv_sec = (time_t) wait;
+        ts.tv_nsec = (long) ((wait - ts.tv_sec) * 1.0e9);
+        while (nanosleep (&ts, &ts) != 0 && errno == EINTR)
+            ;
+        this->slept += wait;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  close_rate_limit
+
+PURPOSE:  Detaches from the node-wide bucket and frees the rate limiter.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void close_rate_limit
+(
+    Rate_limit_t *this       /* I: rate limiter to close and free */
+)
+{
+    if (this == NULL)
+        return;
+
+    if (this->node != NULL)
+        munmap (this->node, sizeof (Io_node_bucket_t));
+    free (this);
+}
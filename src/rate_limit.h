@@ -0,0 +1,69 @@
+#ifndef _RATE_LIMIT_H_
+#define _RATE_LIMIT_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+/* Default name of the node-wide shared-memory token bucket */
+#define IO_NODE_BUCKET "/spectral_indices_io"
+
+/* Identification of the node-wide bucket */
+#define IO_BUCKET_MAGIC 0x53494f42     /* "SIOB" */
+#define IO_BUCKET_VERSION 1
+
+/* Number of seconds of I/O at the full rate a bucket may accumulate while
+   idle; this is the largest burst allowed */
+#define IO_BURST_SECS 1.0
+
+/* How long (seconds) to wait for another process to finish setting up the
+   node-wide bucket */
+#define IO_BUCKET_WAIT_SECS 5
+
+/* Token bucket state.  Tokens are bytes; a request larger than the tokens
+   on hand drives the count negative and the caller sleeps until it's paid
+   back, so requests larger than the burst still work. */
+typedef struct {
+    double rate;             /* refill rate in bytes per second */
+    double burst;            /* maximum number of tokens held */
+    double tokens;           /* tokens currently held */
+    double last;             /* CLOCK_MONOTONIC time of the last refill */
+} Token_bucket_t;
+
+/* Node-wide bucket in POSIX shared memory, shared by every process on the
+   node which names it */
+typedef struct {
+    volatile uint32_t magic; /* IO_BUCKET_MAGIC once set up */
+    uint32_t version;        /* IO_BUCKET_VERSION */
+    pthread_mutex_t lock;    /* process-shared, robust lock for the bucket */
+    Token_bucket_t bucket;   /* node-wide bucket */
+} Io_node_bucket_t;
+
+/* Structure for the I/O rate limiter applied to the reads and writes */
+typedef struct {
+    Token_bucket_t local;    /* per-process bucket; rate 0 if unlimited */
+    Io_node_bucket_t *node;  /* node-wide bucket; NULL if none */
+    double slept;            /* total time spent throttled, in seconds */
+} Rate_limit_t;
+
+/* Prototypes */
+Rate_limit_t *open_rate_limit
+(
+    double rate_mb,          /* I: per-process limit in MB/s; 0 for none */
+    double node_rate_mb,     /* I: node-wide limit in MB/s; 0 for none */
+    char *node_bucket        /* I: name of the node-wide bucket; NULL for the
+                                default */
+);
+
+void rate_limit_io
+(
+    Rate_limit_t *this,      /* I/O: rate limiter; NULL for no limit */
+    size_t nbytes            /* I: number of bytes about to be read or
+                                written */
+);
+
+void close_rate_limit
+(
+    Rate_limit_t *this       /* I: rate limiter to close and free */
+);
+
+#endif
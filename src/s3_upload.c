@@ -0,0 +1,1026 @@
+#include <time.h>
+#include "si.h"
+#include "s3_upload.h"
+
+/******************************************************************************
+MODULE:  uri_encode
+
+PURPOSE:  Percent-encodes a string for a SigV4 canonical URI or query,
+leaving the unreserved characters (and '/' if requested) as they are.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static void uri_encode
+(
+    char *in,                /* I: string to encode */
+    bool keep_slash,         /* I: leave '/' unencoded? */
+    char *out,               /* O: encoded string */
+    size_t size              /* I: size of out */
+)
+{
+    size_t len = 0;          /* length of the encoded string */
+    unsigned char c;         /* current character */
+
+    for (; *in != '\0' && len + 4 < size; in++)
+    {
+        c = *in;
+        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+            (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.' ||
+            c == '~' || (keep_slash && c == '/'))
+            out[len++] = c;
+        else
+            len += sprintf (out + len, "%%%02X", c);
+    }
+    out[len] = '\0';
+}
+
+
+/******************************************************************************
+MODULE:  sign_s3_request
+
+PURPOSE:  Builds the AWS Signature Version 4 headers for a request.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Signs the host, x-amz-content-sha256, x-amz-date, and (if there is a
+     session token) x-amz-security-token headers.
+  2. If no access key is configured, only x-amz-content-sha256 is sent and
+     the request is unsigned, which S3-compatible stand-ins accept.
+******************************************************************************/
+static void sign_s3_request
+(
+    S3_upload_t *this,       /* I: upload state */
+    char *method,            /* I: request method */
+    char *uri,               /* I: encoded canonical URI */
+    char *query,             /* I: canonical query string (sorted, encoded) */
+    void *payload,           /* I: request body; NULL for none */
+    size_t payload_len,      /* I: size of the request body */
+    char *headers,           /* O: header lines to add to the request */
+    size_t size              /* I: size of headers */
+)
+{
+    char amz_date[32];       /* request time, YYYYMMDDTHHMMSSZ */
+    char date[16];           /* request date, YYYYMMDD */
+    char payload_hex[SHA256_HEX_SIZE]; /* hash of the payload */
+    char request_hex[SHA256_HEX_SIZE]; /* hash of the canonical request */
+    char signature[SHA256_HEX_SIZE];   /* request signature */
+    char scope[STR_SIZE + 48]; /* credential scope: date, region, and
+                                service */
+    char signed_headers[STR_SIZE]; /* names of the signed headers */
+    char *canonical = NULL;  /* canonical request */
+    char *to_sign = NULL;    /* string to sign */
+    char key[STR_SIZE + 8];  /* secret key with the AWS4 prefix */
+    unsigned char digest[SHA256_SIZE]; /* current digest or HMAC */
+    unsigned char kdate[SHA256_SIZE];  /* signing key chain */
+    time_t now = time (NULL); /* current time */
+    struct tm tm;            /* current UTC time */
+    size_t len;              /* size needed for the canonical request */
+
+    sha256 (payload != NULL ? payload : "", payload_len, digest);
+    sha256_hex (digest, payload_hex);
+    gmtime_r (&now, &tm);
+    strftime (amz_date, sizeof (amz_date), "%Y%m%dT%H%M%SZ", &tm);
+    strftime (date, sizeof (date), "%Y%m%d", &tm);
+
+    if (this->access_key[0] == '\0')
+    {
+        snprintf (headers, size, "x-amz-content-sha256: %s\r\n"
+            "x-amz-date: %s\r\n", payload_hex, amz_date);
+        return;
+    }
+
+    /* Canonical request */
+    strcpy (signed_headers, "host;x-amz-content-sha256;x-amz-date");
+    if (this->session_token[0] != '\0')
+        strcat (signed_headers, ";x-amz-security-token");
+    len = strlen (method) + strlen (uri) + strlen (query) +
+        strlen (this->endpoint.host) + strlen (this->session_token) +
+        strlen (this->region) + 512;
+    canonical = malloc (len);
+    to_sign = malloc (len);
+    if (canonical == NULL || to_sign == NULL)
+    {
+        free (canonical);
+        free (to_sign);
+        headers[0] = '\0';
+        return;
+    }
+    snprintf (canonical, len, "%s\n%s\n%s\nhost:%s:%d\n"
+        "x-amz-content-sha256:%s\nx-amz-date:%s\n%s%s%s\n%s\n%s", method, uri,
+        query, this->endpoint.host, this->endpoint.port, payload_hex,
+        amz_date, this->session_token[0] != '\0' ? "x-amz-security-token:" :
+        "", this->session_token, this->session_token[0] != '\0' ? "\n" : "",
+        signed_headers, payload_hex);
+    sha256 (canonical, strlen (canonical), digest);
+    sha256_hex (digest, request_hex);
+
+    /* String to sign and the signing key */
+    snprintf (scope, sizeof (scope), "%s/%s/s3/aws4_request", date,
+        this->region);
+    snprintf (to_sign, len, "AWS4-HMAC-SHA256\n%s\n%s\n%s", amz_date, scope,
+        request_hex);
+    snprintf (key, sizeof (key), "AWS4%s", this->secret_key);
+    hmac_sha256 (key, strlen (key), date, strlen (date), kdate);
+    hmac_sha256 (kdate, SHA256_SIZE, this->region, strlen (this->region),
+        digest);
+    hmac_sha256 (digest, SHA256_SIZE, "s3", 2, kdate);
+    hmac_sha256 (kdate, SHA256_SIZE, "aws4_request", 12, digest);
+    hmac_sha256 (digest, SHA256_SIZE, to_sign, strlen (to_sign), kdate);
+    sha256_hex (kdate, signature);
+
+    snprintf (headers, size, "x-amz-content-sha256: %s\r\n"
+        "x-amz-date: %s\r\n%s%s%sAuthorization: AWS4-HMAC-SHA256 "
+        "Credential=%s/%s, SignedHeaders=%s, Signature=%s\r\n", payload_hex,
+        amz_date, this->session_token[0] != '\0' ?
+        "x-amz-security-token: " : "", this->session_token,
+        this->session_token[0] != '\0' ? "\r\n" : "", this->access_key, scope,
+        signed_headers, signature);
+
+    free (canonical);
+    free (to_sign);
+}
+
+
+/******************************************************************************
+MODULE:  s3_request
+
+PURPOSE:  Makes a signed request for an object.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred on the connection
+SUCCESS    A response was received; check resp->status
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. resp->body is allocated; the caller frees it.
+******************************************************************************/
+static int s3_request
+(
+    S3_upload_t *this,       /* I: upload state */
+    Http_conn_t *conn,       /* I/O: connection to use */
+    char *method,            /* I: request method */
+    char *key,               /* I: object key */
+    char *query,             /* I: canonical query string; "" for none */
+    void *body,              /* I: request body; NULL for none */
+    size_t body_len,         /* I: size of the request body */
+    Http_response_t *resp    /* O: response */
+)
+{
+    char uri[2 * STR_SIZE];  /* encoded canonical URI */
+    char path[3 * STR_SIZE]; /* request path and query */
+    char bucket_key[2 * STR_SIZE]; /* bucket and key */
+    char headers[8192];      /* signing headers */
+
+    snprintf (bucket_key, sizeof (bucket_key), "/%s/%s", this->bucket, key);
+    uri_encode (bucket_key, true, uri, sizeof (uri));
+    snprintf (path, sizeof (path), "%s%s%s", uri, query[0] != '\0' ? "?" : "",
+        query);
+    sign_s3_request (this, method, uri, query, body, body_len, headers,
+        sizeof (headers));
+
+    return (http_request (conn, method, path, headers, body, body_len, NULL,
+        0, resp));
+}
+
+
+/******************************************************************************
+MODULE:  get_xml_value
+
+PURPOSE:  Gets the text of the first element with the specified tag from an
+S3 XML response.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      The element isn't in the response
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static int get_xml_value
+(
+    char *xml,               /* I: XML response body */
+    char *tag,               /* I: element name */
+    char *value,             /* O: element text */
+    size_t size              /* I: size of value */
+)
+{
+    char open_tag[STR_SIZE]; /* opening tag */
+    char close_tag[STR_SIZE]; /* closing tag */
+    char *start = NULL;      /* start of the text */
+    char *end = NULL;        /* end of the text */
+
+    if (xml == NULL)
+        return (ERROR);
+    snprintf (open_tag, sizeof (open_tag), "<%s>", tag);
+    snprintf (close_tag, sizeof (close_tag), "</%s>", tag);
+    start = strstr (xml, open_tag);
+    if (start == NULL)
+        return (ERROR);
+    start += strlen (open_tag);
+    end = strstr (start, close_tag);
+    if (end == NULL || (size_t) (end - start) >= size)
+        return (ERROR);
+    memcpy (value, start, end - start);
+    value[end - start] = '\0';
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  s3_upload_thread
+
+PURPOSE:  Upload thread which takes parts from the queue, uploads them on its
+own connection, records the ETags, and returns the buffers to the pool.
+
+RETURN VALUE:
+Type = void*
+Value      Description
+-----      -----------
+NULL       Always
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static void *s3_upload_thread
+(
+    void *arg                /* I: S3_upload_t upload state */
+)
+{
+    char FUNC_NAME[] = "s3_upload_thread";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char query[S3_ID_SIZE * 3 + 64]; /* part upload query */
+    char upload_id[S3_ID_SIZE * 3]; /* encoded upload ID */
+    char key[STR_SIZE];       /* object key */
+    char etag[S3_ETAG_SIZE];  /* ETag of the part */
+    int status;               /* return status */
+    S3_upload_t *this = arg;  /* upload state */
+    S3_part_t *part = NULL;   /* part being uploaded */
+    S3_object_t *obj = NULL;  /* object the part belongs to */
+    Http_conn_t *conn = NULL; /* connection for the thread */
+    Http_response_t resp;     /* response */
+    int64_t t0;               /* start of the part upload */
+
+    conn = open_http_conn (&this->endpoint);
+
+    while (1)
+    {
+        pthread_mutex_lock (&this->lock);
+        while (this->queue_head == NULL && !this->shutdown)
+            pthread_cond_wait (&this->changed, &this->lock);
+        if (this->queue_head == NULL)
+        {
+            pthread_mutex_unlock (&this->lock);
+            break;
+        }
+        part = this->queue_head;
+        this->queue_head = part->next;
+        if (this->queue_head == NULL)
+            this->queue_tail = NULL;
+        this->nqueued--;
+        metric_set (this->queue_depth, this->nqueued);
+        obj = &this->object[part->obj];
+        uri_encode (obj->upload_id, false, upload_id, sizeof (upload_id));
+        strcpy (key, obj->key);
+        pthread_mutex_unlock (&this->lock);
+
+        /* Upload the part */
+        t0 = flight_now ();
+        snprintf (query, sizeof (query), "partNumber=%d&uploadId=%s",
+            part->part_number, upload_id);
+        status = ERROR;
+        if (conn != NULL && s3_request (this, conn, "PUT", key, query,
+            part->data, part->len, &resp) == SUCCESS)
+        {
+            if (resp.status == 200 && get_http_header (&resp, "ETag", etag,
+                sizeof (etag)) == SUCCESS)
+                status = SUCCESS;
+            else
+            {
+                sprintf (errmsg, "Uploading part %d of %.800s returned "
+                    "status %d", part->part_number, key, resp.status);
+                error_handler (true, FUNC_NAME, errmsg);
+            }
+            free (resp.body);
+        }
+
+        /* Record the ETag and return the buffer */
+        pthread_mutex_lock (&this->lock);
+        if (status == SUCCESS)
+        {
+            flight_event (FLIGHT_UPLOAD, part->part_number, part->obj,
+                part->len, t0);
+            metric_add (this->upload_bytes, part->len);
+            metric_observe (this->upload_seconds, (flight_now () - t0) *
+                1.0e-9);
+            strcpy (obj->etag[part->part_number - 1], etag);
+            this->bytes_uploaded += part->len;
+        }
+        else
+            obj->failed = true;
+        obj->ndone++;
+        part->next = this->free_list;
+        this->free_list = part;
+        pthread_cond_broadcast (&this->changed);
+        pthread_mutex_unlock (&this->lock);
+    }
+
+    close_http_conn (conn);
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE:  open_s3_upload
+
+PURPOSE:  Sets up the streaming upload to an S3-compatible endpoint, with the
+part buffer pool and the upload threads.
+
+RETURN VALUE:
+Type = S3_upload_t*
+Value      Description
+-----      -----------
+NULL       Error occurred setting up the upload
+non-NULL   Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The credentials come from AWS_ACCESS_KEY_ID, AWS_SECRET_ACCESS_KEY, and
+     AWS_SESSION_TOKEN, and the region from AWS_REGION or AWS_DEFAULT_REGION.
+     Without an access key the requests are not signed.
+  2. Path-style addressing is used (http://host/bucket/key).
+  3. The pool holds nbuffer part buffers; s3_write_object blocks when all of
+     them are full and waiting to be uploaded, which bounds the memory to
+     nbuffer * part_size.
+******************************************************************************/
+S3_upload_t *open_s3_upload
+(
+    char *url,               /* I: http://host[:port]/bucket[/prefix] */
+    size_t part_size,        /* I: size of each part in bytes */
+    int nthread,             /* I: number of parallel part uploads */
+    int nbuffer              /* I: number of part buffers in the pool */
+)
+{
+    char FUNC_NAME[] = "open_s3_upload";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *bucket = NULL;      /* start of the bucket name */
+    char *prefix = NULL;      /* start of the key prefix */
+    char *env = NULL;         /* environment variable value */
+    int i;                    /* looping variable */
+    S3_upload_t *this = NULL; /* upload state to be returned */
+
+    if (nthread < 1 || nthread > S3_MAX_THREADS || nbuffer < 1)
+    {
+        sprintf (errmsg, "Invalid number of upload threads (%d) or buffers "
+            "(%d)", nthread, nbuffer);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    this = calloc (1, sizeof (S3_upload_t));
+    if (this == NULL)
+    {
+        sprintf (errmsg, "Allocating the upload structure");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    pthread_mutex_init (&this->lock, NULL);
+    pthread_cond_init (&this->changed, NULL);
+
+    /* Split the URL into the endpoint, bucket, and prefix */
+    if (parse_http_url (url, &this->endpoint) != SUCCESS)
+    {
+        close_s3_upload (this);
+        return (NULL);
+    }
+    bucket = this->endpoint.path + 1;
+    prefix = strchr (bucket, '/');
+    if (prefix != NULL)
+        *prefix++ = '\0';
+    if (*bucket == '\0')
+    {
+        close_s3_upload (this);
+        sprintf (errmsg, "No bucket in the upload URL: %.900s", url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    snprintf (this->bucket, sizeof (this->bucket), "%s", bucket);
+    snprintf (this->prefix, sizeof (this->prefix), "%s",
+        prefix != NULL ? prefix : "");
+    i = strlen (this->prefix);
+    while (i > 0 && this->prefix[i-1] == '/')
+        this->prefix[--i] = '\0';
+    strcpy (this->endpoint.path, "/");
+
+    /* Credentials and region */
+    env = getenv ("AWS_ACCESS_KEY_ID");
+    snprintf (this->access_key, sizeof (this->access_key), "%s",
+        env != NULL ? env : "");
+    env = getenv ("AWS_SECRET_ACCESS_KEY");
+    snprintf (this->secret_key, sizeof (this->secret_key), "%s",
+        env != NULL ? env : "");
+    env = getenv ("AWS_SESSION_TOKEN");
+    snprintf (this->session_token, sizeof (this->session_token), "%s",
+        env != NULL ? env : "");
+    env = getenv ("AWS_REGION");
+    if (env == NULL)
+        env = getenv ("AWS_DEFAULT_REGION");
+    snprintf (this->region, sizeof (this->region), "%s",
+        env != NULL ? env : S3_DEFAULT_REGION);
+
+    this->conn = open_http_conn (&this->endpoint);
+    if (this->conn == NULL)
+    {
+        close_s3_upload (this);
+        sprintf (errmsg, "Opening the connection to %s", this->endpoint.host);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    /* Part buffer pool */
+    this->part_size = part_size;
+    this->nbuffer = nbuffer;
+    this->buffers = calloc (nbuffer, sizeof (S3_part_t));
+    if (this->buffers == NULL)
+    {
+        close_s3_upload (this);
+        sprintf (errmsg, "Allocating the part buffer pool");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    for (i = 0; i < nbuffer; i++)
+    {
+        this->buffers[i].data = prof_malloc (PBUF_S3, part_size);
+        if (this->buffers[i].data == NULL)
+        {
+            close_s3_upload (this);
+            sprintf (errmsg, "Allocating %d part buffers of %zu bytes",
+                nbuffer, part_size);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+        this->buffers[i].next = this->free_list;
+        this->free_list = &this->buffers[i];
+    }
+
+    /* Upload threads */
+    for (i = 0; i < nthread; i++)
+    {
+        if (pthread_create (&this->thread[i], NULL, s3_upload_thread, this)
+            != 0)
+        {
+            close_s3_upload (this);
+            sprintf (errmsg, "Starting the upload threads");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+        this->nthread++;
+    }
+
+    return (this);
+}
+
+
+/******************************************************************************
+MODULE:  s3_object_key
+
+PURPOSE:  Forms the object key for a name under the prefix.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      The key is too long
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static int s3_object_key
+(
+    S3_upload_t *this,       /* I: upload state */
+    char *name,              /* I: object name */
+    char *key,               /* O: object key */
+    size_t size              /* I: size of key */
+)
+{
+    char FUNC_NAME[] = "s3_object_key";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int len;                  /* length of the key */
+
+    if (this->prefix[0] != '\0')
+        len = snprintf (key, size, "%s/%s", this->prefix, name);
+    else
+        len = snprintf (key, size, "%s", name);
+    if (len < 0 || (size_t) len >= size)
+    {
+        sprintf (errmsg, "Object key for %.800s is too long", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  s3_begin_object
+
+PURPOSE:  Starts the multipart upload of an object.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+-1         Error occurred starting the upload
+>=0        Object number for s3_write_object and s3_finish_object
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+int s3_begin_object
+(
+    S3_upload_t *this,       /* I/O: upload state */
+    char *name               /* I: object name under the prefix */
+)
+{
+    char FUNC_NAME[] = "s3_begin_object";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int obj;                  /* new object number */
+    S3_object_t *object = NULL;  /* new object */
+    Http_response_t resp;     /* response */
+
+    if (this->nobject >= S3_MAX_OBJECTS)
+    {
+        sprintf (errmsg, "Too many objects; the maximum is %d",
+            S3_MAX_OBJECTS);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (-1);
+    }
+    obj = this->nobject;
+    object = &this->object[obj];
+    memset (object, 0, sizeof (S3_object_t));
+    if (s3_object_key (this, name, object->key, sizeof (object->key)) !=
+        SUCCESS)
+        return (-1);
+
+    if (s3_request (this, this->conn, "POST", object->key, "uploads=", NULL,
+        0, &resp) != SUCCESS)
+        return (-1);
+    if (resp.status != 200 || get_xml_value (resp.body, "UploadId",
+        object->upload_id, sizeof (object->upload_id)) != SUCCESS)
+    {
+        sprintf (errmsg, "Starting the upload of %.800s returned status %d",
+            object->key, resp.status);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (resp.body);
+        return (-1);
+    }
+    free (resp.body);
+
+    pthread_mutex_lock (&this->lock);
+    object->active = true;
+    this->nobject++;
+    pthread_mutex_unlock (&this->lock);
+
+    return (obj);
+}
+
+
+/******************************************************************************
+MODULE:  queue_part
+
+PURPOSE:  Queues the part being filled for an object for upload.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred growing the ETag list
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The caller holds the lock.
+******************************************************************************/
+static int queue_part
+(
+    S3_upload_t *this,       /* I/O: upload state */
+    int obj                  /* I: object number */
+)
+{
+    S3_object_t *object = &this->object[obj];   /* object */
+    S3_part_t *part = object->current;          /* part to queue */
+    char (*etag)[S3_ETAG_SIZE] = NULL;          /* grown ETag list */
+
+    if (object->npart >= object->nalloc)
+    {
+        etag = realloc (object->etag, (object->nalloc + 64) *
+            sizeof (*etag));
+        if (etag == NULL)
+            return (ERROR);
+        object->etag = etag;
+        object->nalloc += 64;
+    }
+
+    part->part_number = ++object->npart;
+    part->next = NULL;
+    if (this->queue_tail != NULL)
+        this->queue_tail->next = part;
+    else
+        this->queue_head = part;
+    this->queue_tail = part;
+    this->nqueued++;
+    metric_set (this->queue_depth, this->nqueued);
+    object->current = NULL;
+    pthread_cond_broadcast (&this->changed);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  s3_write_object
+
+PURPOSE:  Appends data to an object being uploaded.  Full parts are queued
+for the upload threads.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred, or an earlier part of the object failed
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Waits for a free buffer when the whole pool is queued for upload.
+******************************************************************************/
+int s3_write_object
+(
+    S3_upload_t *this,       /* I/O: upload state */
+    int obj,                 /* I: object returned by s3_begin_object */
+    void *data,              /* I: next bytes of the object */
+    size_t len               /* I: number of bytes */
+)
+{
+    char FUNC_NAME[] = "s3_write_object";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *src = data;         /* next byte to copy */
+    size_t n;                 /* number of bytes copied into the part */
+    S3_object_t *object = &this->object[obj];   /* object */
+
+    pthread_mutex_lock (&this->lock);
+    while (len > 0)
+    {
+        if (object->failed)
+        {
+            pthread_mutex_unlock (&this->lock);
+            sprintf (errmsg, "Upload of %.800s has failed", object->key);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Take a buffer from the pool */
+        if (object->current == NULL)
+        {
+            while (this->free_list == NULL)
+                pthread_cond_wait (&this->changed, &this->lock);
+            object->current = this->free_list;
+            this->free_list = object->current->next;
+            object->current->obj = obj;
+            object->current->len = 0;
+        }
+
+        /* Copy outside the lock; only this thread fills the part */
+        pthread_mutex_unlock (&this->lock);
+        n = this->part_size - object->current->len;
+        if (n > len)
+            n = len;
+        memcpy (object->current->data + object->current->len, src, n);
+        object->current->len += n;
+        src += n;
+        len -= n;
+        pthread_mutex_lock (&this->lock);
+
+        if (object->current->len == this->part_size &&
+            queue_part (this, obj) != SUCCESS)
+        {
+            pthread_mutex_unlock (&this->lock);
+            sprintf (errmsg, "Queueing a part of %.800s", object->key);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+    pthread_mutex_unlock (&this->lock);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  abort_object
+
+PURPOSE:  Aborts the multipart upload of an object so the endpoint discards
+the uploaded parts.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static void abort_object
+(
+    S3_upload_t *this,       /* I/O: upload state */
+    int obj                  /* I: object number */
+)
+{
+    char query[S3_ID_SIZE * 3 + 16]; /* abort query */
+    char upload_id[S3_ID_SIZE * 3];  /* encoded upload ID */
+    Http_response_t resp;     /* response */
+
+    uri_encode (this->object[obj].upload_id, false, upload_id,
+        sizeof (upload_id));
+    snprintf (query, sizeof (query), "uploadId=%s", upload_id);
+    if (s3_request (this, this->conn, "DELETE", this->object[obj].key, query,
+        NULL, 0, &resp) == SUCCESS)
+        free (resp.body);
+    this->object[obj].active = false;
+}
+
+
+/******************************************************************************
+MODULE:  s3_finish_object
+
+PURPOSE:  Queues the last part of an object, waits for its parts to upload,
+and completes the multipart upload.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred; the upload is aborted
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+int s3_finish_object
+(
+    S3_upload_t *this,       /* I/O: upload state */
+    int obj                  /* I: object returned by s3_begin_object */
+)
+{
+    char FUNC_NAME[] = "s3_finish_object";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char query[S3_ID_SIZE * 3 + 16]; /* complete query */
+    char upload_id[S3_ID_SIZE * 3];  /* encoded upload ID */
+    char *xml = NULL;         /* CompleteMultipartUpload body */
+    size_t len = 0;           /* length of the body */
+    int i;                    /* looping variable for parts */
+    int status = SUCCESS;     /* return status */
+    S3_object_t *object = &this->object[obj];   /* object */
+    Http_response_t resp;     /* response */
+
+    /* Queue the last (possibly short) part; an empty object still needs
+       one part */
+    pthread_mutex_lock (&this->lock);
+    if (object->current == NULL && object->npart == 0)
+    {
+        while (this->free_list == NULL)
+            pthread_cond_wait (&this->changed, &this->lock);
+        object->current = this->free_list;
+        this->free_list = object->current->next;
+        object->current->obj = obj;
+        object->current->len = 0;
+    }
+    if (object->current != NULL && queue_part (this, obj) != SUCCESS)
+        object->failed = true;
+
+    /* Wait for all the parts */
+    while (object->ndone < object->npart)
+        pthread_cond_wait (&this->changed, &this->lock);
+    pthread_mutex_unlock (&this->lock);
+
+    if (object->failed)
+    {
+        abort_object (this, obj);
+        sprintf (errmsg, "Upload of %.800s failed", object->key);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Complete the upload with the part list */
+    xml = malloc ((size_t) object->npart * (S3_ETAG_SIZE + 64) + 128);
+    if (xml == NULL)
+    {
+        abort_object (this, obj);
+        sprintf (errmsg, "Allocating the part list for %.800s", object->key);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    len = sprintf (xml, "<CompleteMultipartUpload>");
+    for (i = 0; i < object->npart; i++)
+        len += sprintf (xml + len, "<Part><PartNumber>%d</PartNumber>"
+            "<ETag>%s</ETag></Part>", i + 1, object->etag[i]);
+    len += sprintf (xml + len, "</CompleteMultipartUpload>");
+
+    uri_encode (object->upload_id, false, upload_id, sizeof (upload_id));
+    snprintf (query, sizeof (query), "uploadId=%s", upload_id);
+    if (s3_request (this, this->conn, "POST", object->key, query, xml, len,
+        &resp) != SUCCESS)
+        status = ERROR;
+    else
+    {
+        /* S3 can report an error in the body of a 200 response */
+        if (resp.status != 200 || (resp.body != NULL &&
+            strstr (resp.body, "<Error>") != NULL))
+        {
+            sprintf (errmsg, "Completing the upload of %.800s returned "
+                "status %d", object->key, resp.status);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        free (resp.body);
+    }
+    free (xml);
+
+    if (status != SUCCESS)
+    {
+        abort_object (this, obj);
+        return (ERROR);
+    }
+    object->active = false;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  s3_put_file
+
+PURPOSE:  Uploads a small local file (header, XML, browse) as one object.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred reading or uploading the file
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+int s3_put_file
+(
+    S3_upload_t *this,       /* I/O: upload state */
+    char *local_file,        /* I: local file to upload */
+    char *name               /* I: object name under the prefix */
+)
+{
+    char FUNC_NAME[] = "s3_put_file";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char key[STR_SIZE];       /* object key */
+    char *data = NULL;        /* file contents */
+    long len;                 /* size of the file */
+    int status = SUCCESS;     /* return status */
+    FILE *fp = NULL;          /* local file */
+    Http_response_t resp;     /* response */
+
+    fp = fopen (local_file, "rb");
+    if (fp == NULL || fseek (fp, 0, SEEK_END) != 0 || (len = ftell (fp)) < 0)
+    {
+        if (fp != NULL)
+            fclose (fp);
+        sprintf (errmsg, "Opening %.900s", local_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    rewind (fp);
+    data = malloc (len + 1);
+    if (data == NULL || fread (data, 1, len, fp) != (size_t) len)
+    {
+        fclose (fp);
+        free (data);
+        sprintf (errmsg, "Reading %.900s", local_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    fclose (fp);
+
+    if (s3_object_key (this, name, key, sizeof (key)) != SUCCESS)
+    {
+        free (data);
+        return (ERROR);
+    }
+    if (s3_request (this, this->conn, "PUT", key, "", data, len, &resp)
+        != SUCCESS)
+        status = ERROR;
+    else
+    {
+        if (resp.status != 200)
+        {
+            sprintf (errmsg, "Uploading %.800s returned status %d", key,
+                resp.status);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else
+            this->bytes_uploaded += len;
+        free (resp.body);
+    }
+    free (data);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  close_s3_upload
+
+PURPOSE:  Stops the upload threads, aborts any unfinished uploads, and frees
+the upload state.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void close_s3_upload
+(
+    S3_upload_t *this        /* I: upload state to close and free */
+)
+{
+    int i;                    /* looping variable */
+
+    if (this == NULL)
+        return;
+
+    pthread_mutex_lock (&this->lock);
+    this->shutdown = true;
+    pthread_cond_broadcast (&this->changed);
+    pthread_mutex_unlock (&this->lock);
+    for (i = 0; i < this->nthread; i++)
+        pthread_join (this->thread[i], NULL);
+
+    for (i = 0; i < this->nobject; i++)
+    {
+        if (this->object[i].active)
+            abort_object (this, i);
+        free (this->object[i].etag);
+    }
+
+    if (this->buffers != NULL)
+    {
+        for (i = 0; i < this->nbuffer; i++)
+            free (this->buffers[i].data);
+        free (this->buffers);
+    }
+    close_http_conn (this->conn);
+    pthread_mutex_destroy (&this->lock);
+    pthread_cond_destroy (&this->changed);
+    free (this);
+}
@@ -0,0 +1,127 @@
+#ifndef _S3_UPLOAD_H_
+#define _S3_UPLOAD_H_
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "http_client.h"
+#include "sha256.h"
+#include "metrics.h"
+
+/* Default and minimum multipart part sizes, in megabytes.  S3 requires all
+   but the last part to be at least 5 MB. */
+#define S3_PART_MB 8
+#define S3_MIN_PART_MB 5
+
+/* Default number of parallel part uploads */
+#define S3_THREADS 4
+
+/* Maximum number of threads and objects uploaded at once */
+#define S3_MAX_THREADS 32
+#define S3_MAX_OBJECTS 16
+
+/* Default signing region if AWS_REGION isn't set */
+#define S3_DEFAULT_REGION "us-east-1"
+
+/* Sizes of the upload ID and ETag strings */
+#define S3_ID_SIZE 1024
+#define S3_ETAG_SIZE 128
+
+/* One part buffer in the pool */
+typedef struct S3_part {
+    int obj;                 /* object the part belongs to */
+    int part_number;         /* part number (1-based) */
+    size_t len;              /* number of bytes in the part */
+    char *data;              /* part_size bytes */
+    struct S3_part *next;    /* next part in the free list or upload queue */
+} S3_part_t;
+
+/* Object being uploaded with a multipart upload */
+typedef struct {
+    char key[STR_SIZE];      /* object key, including the prefix */
+    char upload_id[S3_ID_SIZE]; /* multipart upload ID */
+    bool active;             /* is the upload in progress? */
+    bool failed;             /* did a part fail to upload? */
+    int npart;               /* number of parts queued */
+    int ndone;               /* number of parts finished uploading */
+    int nalloc;              /* number of entries allocated in etag */
+    char (*etag)[S3_ETAG_SIZE]; /* ETag of each uploaded part */
+    S3_part_t *current;      /* part being filled; NULL if none */
+} S3_object_t;
+
+/* Structure for the streaming upload of the output products to an
+   S3-compatible endpoint */
+typedef struct {
+    Http_url_t endpoint;     /* endpoint host and port */
+    char bucket[STR_SIZE];   /* bucket name */
+    char prefix[STR_SIZE];   /* key prefix, without the trailing '/'; may be
+                                empty */
+    char access_key[STR_SIZE]; /* AWS_ACCESS_KEY_ID; empty for unsigned
+                                requests */
+    char secret_key[STR_SIZE]; /* AWS_SECRET_ACCESS_KEY */
+    char session_token[4096];  /* AWS_SESSION_TOKEN; may be empty */
+    char region[STR_SIZE];   /* signing region */
+    Http_conn_t *conn;       /* connection for the main thread's requests */
+    size_t part_size;        /* size of each part in bytes */
+    int nbuffer;             /* number of part buffers in the pool */
+    S3_part_t *buffers;      /* part buffer pool */
+    S3_part_t *free_list;    /* part buffers available to fill */
+    S3_part_t *queue_head;   /* parts waiting to be uploaded */
+    S3_part_t *queue_tail;   /* last part waiting to be uploaded */
+    int nobject;             /* number of objects started */
+    S3_object_t object[S3_MAX_OBJECTS]; /* objects started */
+    int nthread;             /* number of upload threads */
+    pthread_t thread[S3_MAX_THREADS]; /* upload threads */
+    bool shutdown;           /* are the upload threads to exit? */
+    pthread_mutex_t lock;    /* protects the pool, queue, and objects */
+    pthread_cond_t changed;  /* signaled when a part is queued or done */
+    long long bytes_uploaded; /* number of bytes uploaded */
+    int nqueued;             /* number of parts waiting to be uploaded */
+    Metric_t *upload_bytes;  /* counter of the bytes uploaded; NULL if not
+                                exported */
+    Metric_t *upload_seconds; /* histogram of the part upload times */
+    Metric_t *queue_depth;   /* gauge of the parts waiting to be
+                                uploaded */
+} S3_upload_t;
+
+/* Prototypes */
+S3_upload_t *open_s3_upload
+(
+    char *url,               /* I: http://host[:port]/bucket[/prefix] */
+    size_t part_size,        /* I: size of each part in bytes */
+    int nthread,             /* I: number of parallel part uploads */
+    int nbuffer              /* I: number of part buffers in the pool */
+);
+
+int s3_begin_object
+(
+    S3_upload_t *this,       /* I/O: upload state */
+    char *name               /* I: object name under the prefix */
+);
+
+int s3_write_object
+(
+    S3_upload_t *this,       /* I/O: upload state */
+    int obj,                 /* I: object returned by s3_begin_object */
+    void *data,              /* I: next bytes of the object */
+    size_t len               /* I: number of bytes */
+);
+
+int s3_finish_object
+(
+    S3_upload_t *this,       /* I/O: upload state */
+    int obj                  /* I: object returned by s3_begin_object */
+);
+
+int s3_put_file
+(
+    S3_upload_t *this,       /* I/O: upload state */
+    char *local_file,        /* I: local file to upload */
+    char *name               /* I: object name under the prefix */
+);
+
+void close_s3_upload
+(
+    S3_upload_t *this        /* I: upload state to close and free */
+);
+
+#endif
@@ -0,0 +1,501 @@
+#include <stdint.h>
+#include "si.h"
+#include "sample.h"
+
+/******************************************************************************
+MODULE:  sample_random
+
+PURPOSE:  Returns the next uniform random number in (0, 1).
+
+RETURN VALUE:
+Type = double
+Value      Description
+-----      -----------
+(0, 1)     Random number
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. xorshift64*, which is plenty for drawing samples and gives the same
+     draws on every platform for the same seed.  The result is never 0 or 1,
+     so its log is always finite.
+******************************************************************************/
+static double sample_random
+(
+    Sample_t *this           /* I/O: sample holding the generator state */
+)
+{
+    this->rng ^= this->rng >> 12;
+    this->rng ^= this->rng << 25;
+    this->rng ^= this->rng >> 27;
+    return (((this->rng * 2685821657736338717ULL >> 11) + 0.5) /
+        9007199254740992.0);
+}
+
+
+/******************************************************************************
+MODULE:  sample_skip
+
+PURPOSE:  Draws the next random key of a full reservoir and the number of
+pixels to pass over before the next one enters it.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Algorithm L (Li, 1994): rather than a random number for every pixel,
+     the gap to the next replacement is drawn from its geometric
+     distribution, so each pixel only costs a comparison.
+******************************************************************************/
+static void sample_skip
+(
+    Sample_t *this,          /* I/O: sample holding the generator state */
+    Sample_class_t *cls      /* I/O: full reservoir of one class */
+)
+{
+    double skip;              /* pixels to pass over */
+
+    cls->w *= exp (log (sample_random (this)) / this->size);
+    skip = floor (log (sample_random (this)) / log (1.0 - cls->w));
+    if (!(skip < 1.0e18))
+        skip = 1.0e18;
+    cls->next = cls->seen + (long long) skip + 1;
+}
+
+
+/******************************************************************************
+MODULE:  open_sample
+
+PURPOSE:  Opens the label raster, allocates its strip buffer, and sets up
+empty reservoirs for the classes.
+
+RETURN VALUE:
+Type = Sample_t*
+Value      Description
+-----      -----------
+NULL       Error opening the label raster or it doesn't match the scene
+non-NULL   Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The label raster must be nlines x nsamps uint8 values, aligned with the
+     scene.  Only the size of the file can be checked.
+  2. The random numbers are seeded from a hash of the seed text (the product
+     ID), so a scene draws the same pixels on every run and different scenes
+     draw independently.
+  3. The reservoir of a class is only allocated once the class is seen, so
+     the memory is bounded by the sample size of the classes present.
+******************************************************************************/
+Sample_t *open_sample
+(
+    char *label_file,        /* I: name of the label raster */
+    int size,                /* I: number of pixels to draw from each class */
+    Input_t *input,          /* I: reflectance bands, for the scene size and
+                                the band count, wavelengths, fill, and
+                                scale */
+    char *refl_prefix,       /* I: prefix of the band value names (sr, toa,
+                                or dn) */
+    int nindex,              /* I: number of index values */
+    char index_names[][STR_SIZE], /* I: name of each index value */
+    char *seed               /* I: text the random numbers are seeded from */
+)
+{
+    char FUNC_NAME[] = "open_sample";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int ib;                   /* looping variable for bands */
+    long size_file;           /* size of the label file */
+    long expected;            /* expected size of the label file */
+    char *cptr = NULL;        /* current character of the seed */
+    Sample_t *this = NULL;    /* sample to be returned */
+
+    this = calloc (1, sizeof (Sample_t));
+    if (this == NULL)
+    {
+        sprintf (errmsg, "Allocating the sample structure");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    this->size = size;
+    this->nlines = input->nlines;
+    this->nsamps = input->nsamps;
+    this->nrefl = input->nrefl_band;
+    this->nindex = nindex;
+    this->ncol = this->nrefl + nindex;
+    this->refl_fill = input->refl_fill;
+    this->refl_scale = input->refl_scale_fact;
+    for (ib = 0; ib < this->nrefl; ib++)
+        snprintf (this->col_name[ib], STR_SIZE, "%s_%.0fnm", refl_prefix,
+            input->cat_wavelength[input->cat_band[ib]]);
+    for (ib = 0; ib < nindex; ib++)
+        strcpy (this->col_name[this->nrefl + ib], index_names[ib]);
+
+    /* FNV-1a hash of the seed text; the generator state can't be 0 */
+    this->rng = 14695981039346656037ULL;
+    for (cptr = seed; *cptr != '\0'; cptr++)
+        this->rng = (this->rng ^ (uint8) *cptr) * 1099511628211ULL;
+    if (this->rng == 0)
+        this->rng = 1;
+
+    /* Open the labels and make sure they cover the scene */
+    this->fp_label = open_raw_binary (label_file, "rb");
+    if (this->fp_label == NULL)
+    {
+        sprintf (errmsg, "Opening the label file: %s", label_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_sample (this);
+        return (NULL);
+    }
+    expected = (long) this->nlines * this->nsamps;
+    fseek (this->fp_label, 0, SEEK_END);
+    size_file = ftell (this->fp_label);
+    if (size_file != expected)
+    {
+        sprintf (errmsg, "Label file %s is %ld bytes; a %d x %d uint8 "
+            "raster is %ld bytes", label_file, size_file, this->nsamps,
+            this->nlines, expected);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_sample (this);
+        return (NULL);
+    }
+
+    this->label_buf = prof_malloc (PBUF_SAMPLE, PROC_NLINES * this->nsamps);
+    if (this->label_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating the label strip");
+        error_handler (true, FUNC_NAME, errmsg);
+        close_sample (this);
+        return (NULL);
+    }
+
+    return (this);
+}
+
+
+/******************************************************************************
+MODULE:  get_sample_lines
+
+PURPOSE:  Reads a strip of the label raster, alongside the same strip of the
+reflectance bands.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error reading the labels
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+int get_sample_lines
+(
+    Sample_t *this,          /* I/O: sample */
+    int iline,               /* I: first line of the strip (0-based) */
+    int nlines               /* I: number of lines in the strip */
+)
+{
+    char FUNC_NAME[] = "get_sample_lines";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+
+    rate_limit_io (this->io_limit, (size_t) nlines * this->nsamps);
+    if (fseek (this->fp_label, (long) iline * this->nsamps, SEEK_SET) ||
+        read_raw_binary (this->fp_label, nlines, this->nsamps, sizeof (uint8),
+        this->label_buf) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading %d lines of the labels starting at line %d",
+            nlines, iline);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  add_sample_lines
+
+PURPOSE:  Offers each valid, labeled pixel of a strip to the reservoir of
+its class.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error allocating the reservoir of a class
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. A pixel is valid if none of its bands is fill and none of its indices
+     is FILL_VALUE.  Unlabeled (class 0) pixels are passed over without
+     looking at their values.
+  2. Each reservoir holds a uniform random sample of the valid pixels of its
+     class seen so far.  Once full, a pixel only enters when the seen count
+     reaches the skip drawn by sample_skip, and then replaces a random one.
+******************************************************************************/
+int add_sample_lines
+(
+    Sample_t *this,          /* I/O: sample holding the labels of the
+                                strip */
+    int16 **refl_buf,        /* I: strip of each reflectance band */
+    int16 **index_buf,       /* I: strip of each index, in value order */
+    int iline,               /* I: first line of the strip (0-based) */
+    int nlines               /* I: number of lines in the strip */
+)
+{
+    char FUNC_NAME[] = "add_sample_lines";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int c;                    /* looping variable for values */
+    int slot;                 /* reservoir slot the pixel goes in */
+    long pix;                 /* looping variable for strip pixels */
+    long npix = (long) nlines * this->nsamps; /* pixels in the strip */
+    int16 fill[MAX_SAMPLE_VALUES]; /* fill value of each value */
+    int16 *plane[MAX_SAMPLE_VALUES]; /* strip of each value */
+    int16 *vals = NULL;       /* values of the reservoir slot */
+    Sample_class_t *cls = NULL; /* reservoir of the pixel's class */
+
+    for (c = 0; c < this->ncol; c++)
+    {
+        if (c < this->nrefl)
+        {
+            plane[c] = refl_buf[c];
+            fill[c] = this->refl_fill;
+        }
+        else
+        {
+            plane[c] = index_buf[c - this->nrefl];
+            fill[c] = FILL_VALUE;
+        }
+    }
+
+    for (pix = 0; pix < npix; pix++)
+    {
+        if (this->label_buf[pix] == 0)
+            continue;
+
+        for (c = 0; c < this->ncol; c++)
+        {
+            if (plane[c][pix] == fill[c])
+                break;
+        }
+        if (c < this->ncol)
+            continue;
+
+        cls = &this->cls[this->label_buf[pix]];
+        if (cls->pix == NULL)
+        {
+            cls->pix = prof_malloc (PBUF_SAMPLE, (size_t) this->size * 2 *
+                sizeof (int32_t));
+            cls->vals = prof_malloc (PBUF_SAMPLE, (size_t) this->size *
+                this->ncol * sizeof (int16));
+            if (cls->pix == NULL || cls->vals == NULL)
+            {
+                sprintf (errmsg, "Allocating the reservoir of class %d",
+                    this->label_buf[pix]);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+
+        /* Fill the reservoir, then replace at the drawn skips */
+        cls->seen++;
+        if (cls->n < this->size)
+        {
+            slot = cls->n++;
+            if (cls->n == this->size)
+            {
+                cls->w = 1.0;
+                sample_skip (this, cls);
+            }
+        }
+        else if (cls->seen == cls->next)
+        {
+            slot = (int) (sample_random (this) * this->size);
+            sample_skip (this, cls);
+        }
+        else
+            continue;
+
+        cls->pix[2*slot] = iline + pix / this->nsamps;
+        cls->pix[2*slot+1] = pix % this->nsamps;
+        vals = &cls->vals[(long) slot * this->ncol];
+        for (c = 0; c < this->ncol; c++)
+            vals[c] = plane[c][pix];
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  compare_pix
+
+PURPOSE:  Orders the sampled pixels of a class by line and sample, for
+qsort.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+< 0        The first pixel comes first
+0          Same pixel
+> 0        The second pixel comes first
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The pixels are given as their line and sample pairs.
+******************************************************************************/
+static int compare_pix
+(
+    const void *a,           /* I: line and sample of the first pixel */
+    const void *b            /* I: line and sample of the second pixel */
+)
+{
+    const int32_t *pa = *(const int32_t * const *) a;
+    const int32_t *pb = *(const int32_t * const *) b;
+
+    if (pa[0] != pb[0])
+        return (pa[0] < pb[0] ? -1 : 1);
+    return ((pa[1] > pb[1]) - (pa[1] < pb[1]));
+}
+
+
+/******************************************************************************
+MODULE:  write_sample
+
+PURPOSE:  Writes the sampled pixels of every class as CSV.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred writing the file
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. One row per pixel: the class, line, and sample, then the band values
+     times the band scale factor and the index values times SCALE_FACTOR.
+     The rows are in class order, then line and sample order.
+  2. A class with fewer valid pixels than the sample size gives all of
+     them.
+******************************************************************************/
+int write_sample
+(
+    Sample_t *this,          /* I: sample */
+    char *csv_file           /* I: name of the CSV file to write */
+)
+{
+    char FUNC_NAME[] = "write_sample";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int k;                    /* looping variable for classes */
+    int i;                    /* looping variable for pixels */
+    int c;                    /* looping variable for values */
+    int slot;                 /* reservoir slot of the current pixel */
+    int32_t **order = NULL;   /* pixels of the class in line/sample order */
+    Sample_class_t *cls = NULL; /* reservoir of the current class */
+    FILE *fp = NULL;          /* CSV file */
+
+    order = malloc (this->size * sizeof (int32_t *));
+    if (order == NULL)
+    {
+        sprintf (errmsg, "Allocating the sample order");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fp = fopen (csv_file, "w");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the sample file %s", csv_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (order);
+        return (ERROR);
+    }
+
+    fprintf (fp, "class,line,sample");
+    for (c = 0; c < this->ncol; c++)
+        fprintf (fp, ",%s", this->col_name[c]);
+    fprintf (fp, "\n");
+
+    for (k = 1; k < SAMPLE_NCLASS; k++)
+    {
+        cls = &this->cls[k];
+        for (i = 0; i < cls->n; i++)
+            order[i] = &cls->pix[2*i];
+        qsort (order, cls->n, sizeof (int32_t *), compare_pix);
+
+        for (i = 0; i < cls->n; i++)
+        {
+            slot = (order[i] - cls->pix) / 2;
+            fprintf (fp, "%d,%d,%d", k, order[i][0], order[i][1]);
+            for (c = 0; c < this->ncol; c++)
+                fprintf (fp, ",%.6g", cls->vals[(long) slot * this->ncol + c] *
+                    (c < this->nrefl ? this->refl_scale : SCALE_FACTOR));
+            fprintf (fp, "\n");
+        }
+    }
+
+    free (order);
+    if (fclose (fp) != 0)
+    {
+        sprintf (errmsg, "Writing the sample file %s", csv_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  close_sample
+
+PURPOSE:  Closes the label raster and frees the sample.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void close_sample
+(
+    Sample_t *this           /* I: sample to close and free; may be NULL */
+)
+{
+    int k;                    /* looping variable for classes */
+
+    if (this == NULL)
+        return;
+
+    if (this->fp_label != NULL)
+        close_raw_binary (this->fp_label);
+    for (k = 0; k < SAMPLE_NCLASS; k++)
+    {
+        prof_free (PBUF_SAMPLE, this->cls[k].pix, (size_t) this->size * 2 *
+            sizeof (int32_t));
+        prof_free (PBUF_SAMPLE, this->cls[k].vals, (size_t) this->size *
+            this->ncol * sizeof (int16));
+    }
+    free (this->label_buf);
+    free (this);
+}
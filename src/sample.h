@@ -0,0 +1,95 @@
+#ifndef _SAMPLE_H_
+#define _SAMPLE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "common.h"
+#include "input.h"
+#include "rate_limit.h"
+
+/* The label raster is a raw uint8 file on the scene grid holding the class
+   of each pixel; class 0 is unlabeled and never sampled */
+#define SAMPLE_NCLASS 256
+
+/* Default number of pixels drawn from each class */
+#define SAMPLE_SIZE 1000
+
+/* Most values kept for a sampled pixel: every band read plus every index */
+#define MAX_SAMPLE_VALUES (NBAND_REFL_MAX + NUM_SI)
+
+/* Reservoir of the pixels drawn from one class */
+typedef struct {
+    long long seen;          /* valid pixels of the class seen so far */
+    long long next;          /* count of seen pixels at which the next pixel
+                                enters the full reservoir */
+    double w;                /* largest of the random keys kept, for the
+                                skips of Algorithm L */
+    int n;                   /* number of pixels in the reservoir */
+    int32_t *pix;            /* line and sample of each pixel; NULL until
+                                the class is seen */
+    int16 *vals;             /* band and index values of each pixel */
+} Sample_class_t;
+
+/* Structure for the stratified sample of pixels drawn during the pass */
+typedef struct {
+    int size;                /* number of pixels drawn from each class */
+    int nlines;              /* number of lines in the scene */
+    int nsamps;              /* number of samples in the scene */
+    int nrefl;               /* number of reflectance band values */
+    int nindex;              /* number of index values */
+    int ncol;                /* number of values of each pixel */
+    int16 refl_fill;         /* fill value of the reflectance bands */
+    float refl_scale;        /* scale factor of the reflectance bands */
+    char col_name[MAX_SAMPLE_VALUES][STR_SIZE]; /* name of each value */
+    uint64_t rng;            /* state of the random number generator */
+    FILE *fp_label;          /* label raster */
+    uint8 *label_buf;        /* PROC_NLINES lines of the labels */
+    Rate_limit_t *io_limit;  /* I/O rate limiter for the reads; NULL if
+                                unlimited */
+    Sample_class_t cls[SAMPLE_NCLASS]; /* reservoir of each class */
+} Sample_t;
+
+/* Prototypes */
+Sample_t *open_sample
+(
+    char *label_file,        /* I: name of the label raster */
+    int size,                /* I: number of pixels to draw from each class */
+    Input_t *input,          /* I: reflectance bands, for the scene size and
+                                the band count, wavelengths, fill, and
+                                scale */
+    char *refl_prefix,       /* I: prefix of the band value names (sr, toa,
+                                or dn) */
+    int nindex,              /* I: number of index values */
+    char index_names[][STR_SIZE], /* I: name of each index value */
+    char *seed               /* I: text the random numbers are seeded from */
+);
+
+int get_sample_lines
+(
+    Sample_t *this,          /* I/O: sample */
+    int iline,               /* I: first line of the strip (0-based) */
+    int nlines               /* I: number of lines in the strip */
+);
+
+int add_sample_lines
+(
+    Sample_t *this,          /* I/O: sample holding the labels of the
+                                strip */
+    int16 **refl_buf,        /* I: strip of each reflectance band */
+    int16 **index_buf,       /* I: strip of each index, in value order */
+    int iline,               /* I: first line of the strip (0-based) */
+    int nlines               /* I: number of lines in the strip */
+);
+
+int write_sample
+(
+    Sample_t *this,          /* I: sample */
+    char *csv_file           /* I: name of the CSV file to write */
+);
+
+void close_sample
+(
+    Sample_t *this           /* I: sample to close and free; may be NULL */
+);
+
+#endif
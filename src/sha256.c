@@ -0,0 +1,291 @@
+#include <string.h>
+#include <stdio.h>
+#include "sha256.h"
+
+/* SHA-256 round constants (FIPS 180-4) */
+static const uint32_t k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/******************************************************************************
+MODULE:  sha256_block
+
+PURPOSE:  Hashes one 64-byte block into the state.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static void sha256_block
+(
+    Sha256_t *ctx,           /* I/O: hashing state */
+    const unsigned char *p   /* I: 64-byte block */
+)
+{
+    uint32_t w[64];          /* message schedule */
+    uint32_t a, b, c, d, e, f, g, h;  /* working variables */
+    uint32_t t1, t2;         /* temporaries */
+    int i;                   /* looping variable */
+
+    for (i = 0; i < 16; i++)
+        w[i] = (uint32_t) p[4*i] << 24 | (uint32_t) p[4*i+1] << 16 |
+            (uint32_t) p[4*i+2] << 8 | p[4*i+3];
+    for (i = 16; i < 64; i++)
+        w[i] = (ROTR (w[i-2], 17) ^ ROTR (w[i-2], 19) ^ (w[i-2] >> 10)) +
+            w[i-7] + (ROTR (w[i-15], 7) ^ ROTR (w[i-15], 18) ^
+            (w[i-15] >> 3)) + w[i-16];
+
+    a = ctx->h[0]; b = ctx->h[1]; c = ctx->h[2]; d = ctx->h[3];
+    e = ctx->h[4]; f = ctx->h[5]; g = ctx->h[6]; h = ctx->h[7];
+    for (i = 0; i < 64; i++)
+    {
+        t1 = h + (ROTR (e, 6) ^ ROTR (e, 11) ^ ROTR (e, 25)) +
+            ((e & f) ^ (~e & g)) + k[i] + w[i];
+        t2 = (ROTR (a, 2) ^ ROTR (a, 13) ^ ROTR (a, 22)) +
+            ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    ctx->h[0] += a; ctx->h[1] += b; ctx->h[2] += c; ctx->h[3] += d;
+    ctx->h[4] += e; ctx->h[5] += f; ctx->h[6] += g; ctx->h[7] += h;
+}
+
+
+/******************************************************************************
+MODULE:  sha256_init
+
+PURPOSE:  Initializes the SHA-256 hashing state.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void sha256_init
+(
+    Sha256_t *ctx            /* O: hashing state */
+)
+{
+    ctx->h[0] = 0x6a09e667; ctx->h[1] = 0xbb67ae85;
+    ctx->h[2] = 0x3c6ef372; ctx->h[3] = 0xa54ff53a;
+    ctx->h[4] = 0x510e527f; ctx->h[5] = 0x9b05688c;
+    ctx->h[6] = 0x1f83d9ab; ctx->h[7] = 0x5be0cd19;
+    ctx->nbytes = 0;
+    ctx->nbuf = 0;
+}
+
+
+/******************************************************************************
+MODULE:  sha256_update
+
+PURPOSE:  Adds data to the hash.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void sha256_update
+(
+    Sha256_t *ctx,           /* I/O: hashing state */
+    const void *data,        /* I: data to hash */
+    size_t len               /* I: number of bytes of data */
+)
+{
+    const unsigned char *p = data;   /* next byte to hash */
+    size_t n;                /* number of bytes added to the partial block */
+
+    ctx->nbytes += len;
+    if (ctx->nbuf > 0)
+    {
+        n = SHA256_BLOCK_SIZE - ctx->nbuf;
+        if (n > len)
+            n = len;
+        memcpy (ctx->buf + ctx->nbuf, p, n);
+        ctx->nbuf += n;
+        p += n;
+        len -= n;
+        if (ctx->nbuf < SHA256_BLOCK_SIZE)
+            return;
+        sha256_block (ctx, ctx->buf);
+        ctx->nbuf = 0;
+    }
+
+    while (len >= SHA256_BLOCK_SIZE)
+    {
+        sha256_block (ctx, p);
+        p += SHA256_BLOCK_SIZE;
+        len -= SHA256_BLOCK_SIZE;
+    }
+
+    memcpy (ctx->buf, p, len);
+    ctx->nbuf = len;
+}
+
+
+/******************************************************************************
+MODULE:  sha256_final
+
+PURPOSE:  Pads the message and returns the digest.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void sha256_final
+(
+    Sha256_t *ctx,           /* I/O: hashing state */
+    unsigned char digest[SHA256_SIZE]  /* O: digest */
+)
+{
+    uint64_t nbits = ctx->nbytes * 8;  /* message length in bits */
+    int i;                   /* looping variable */
+
+    ctx->buf[ctx->nbuf++] = 0x80;
+    if (ctx->nbuf > SHA256_BLOCK_SIZE - 8)
+    {
+        memset (ctx->buf + ctx->nbuf, 0, SHA256_BLOCK_SIZE - ctx->nbuf);
+        sha256_block (ctx, ctx->buf);
+        ctx->nbuf = 0;
+    }
+    memset (ctx->buf + ctx->nbuf, 0, SHA256_BLOCK_SIZE - 8 - ctx->nbuf);
+    for (i = 0; i < 8; i++)
+        ctx->buf[SHA256_BLOCK_SIZE - 1 - i] = (unsigned char) (nbits >> (8*i));
+    sha256_block (ctx, ctx->buf);
+
+    for (i = 0; i < 8; i++)
+    {
+        digest[4*i] = ctx->h[i] >> 24;
+        digest[4*i+1] = ctx->h[i] >> 16;
+        digest[4*i+2] = ctx->h[i] >> 8;
+        digest[4*i+3] = ctx->h[i];
+    }
+}
+
+
+/******************************************************************************
+MODULE:  sha256
+
+PURPOSE:  Computes the SHA-256 digest of a buffer.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void sha256
+(
+    const void *data,        /* I: data to hash */
+    size_t len,              /* I: number of bytes of data */
+    unsigned char digest[SHA256_SIZE]  /* O: digest */
+)
+{
+    Sha256_t ctx;            /* hashing state */
+
+    sha256_init (&ctx);
+    sha256_update (&ctx, data, len);
+    sha256_final (&ctx, digest);
+}
+
+
+/******************************************************************************
+MODULE:  hmac_sha256
+
+PURPOSE:  Computes the HMAC-SHA256 (RFC 2104) of a message.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void hmac_sha256
+(
+    const void *key,         /* I: HMAC key */
+    size_t key_len,          /* I: number of bytes in the key */
+    const void *data,        /* I: message */
+    size_t len,              /* I: number of bytes in the message */
+    unsigned char digest[SHA256_SIZE]  /* O: HMAC */
+)
+{
+    unsigned char kpad[SHA256_BLOCK_SIZE]; /* padded key */
+    unsigned char inner[SHA256_SIZE];      /* inner hash */
+    Sha256_t ctx;            /* hashing state */
+    int i;                   /* looping variable */
+
+    memset (kpad, 0, sizeof (kpad));
+    if (key_len > SHA256_BLOCK_SIZE)
+        sha256 (key, key_len, kpad);
+    else
+        memcpy (kpad, key, key_len);
+
+    for (i = 0; i < SHA256_BLOCK_SIZE; i++)
+        kpad[i] ^= 0x36;
+    sha256_init (&ctx);
+    sha256_update (&ctx, kpad, SHA256_BLOCK_SIZE);
+    sha256_update (&ctx, data, len);
+    sha256_final (&ctx, inner);
+
+    for (i = 0; i < SHA256_BLOCK_SIZE; i++)
+        kpad[i] ^= 0x36 ^ 0x5c;
+    sha256_init (&ctx);
+    sha256_update (&ctx, kpad, SHA256_BLOCK_SIZE);
+    sha256_update (&ctx, inner, SHA256_SIZE);
+    sha256_final (&ctx, digest);
+}
+
+
+/******************************************************************************
+MODULE:  sha256_hex
+
+PURPOSE:  Formats a digest as a lower case hex string.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void sha256_hex
+(
+    const unsigned char digest[SHA256_SIZE],  /* I: digest */
+    char hex[SHA256_HEX_SIZE]  /* O: lower case hex string */
+)
+{
+    int i;                   /* looping variable */
+
+    for (i = 0; i < SHA256_SIZE; i++)
+        sprintf (hex + 2*i, "%02x", digest[i]);
+}
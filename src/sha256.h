@@ -0,0 +1,63 @@
+#ifndef _SHA256_H_
+#define _SHA256_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Size of a SHA-256 digest in bytes and as a hex string (with the NUL) */
+#define SHA256_SIZE 32
+#define SHA256_HEX_SIZE 65
+
+/* SHA-256 block size in bytes, also the HMAC block size */
+#define SHA256_BLOCK_SIZE 64
+
+/* SHA-256 hashing state */
+typedef struct {
+    uint32_t h[8];           /* intermediate hash value */
+    uint64_t nbytes;         /* number of bytes hashed */
+    size_t nbuf;             /* number of bytes in buf */
+    unsigned char buf[SHA256_BLOCK_SIZE]; /* partial block */
+} Sha256_t;
+
+/* Prototypes */
+void sha256_init
+(
+    Sha256_t *ctx            /* O: hashing state */
+);
+
+void sha256_update
+(
+    Sha256_t *ctx,           /* I/O: hashing state */
+    const void *data,        /* I: data to hash */
+    size_t len               /* I: number of bytes of data */
+);
+
+void sha256_final
+(
+    Sha256_t *ctx,           /* I/O: hashing state */
+    unsigned char digest[SHA256_SIZE]  /* O: digest */
+);
+
+void sha256
+(
+    const void *data,        /* I: data to hash */
+    size_t len,              /* I: number of bytes of data */
+    unsigned char digest[SHA256_SIZE]  /* O: digest */
+);
+
+void hmac_sha256
+(
+    const void *key,         /* I: HMAC key */
+    size_t key_len,          /* I: number of bytes in the key */
+    const void *data,        /* I: message */
+    size_t len,              /* I: number of bytes in the message */
+    unsigned char digest[SHA256_SIZE]  /* O: HMAC */
+);
+
+void sha256_hex
+(
+    const unsigned char digest[SHA256_SIZE],  /* I: digest */
+    char hex[SHA256_HEX_SIZE]  /* O: lower case hex string */
+);
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef _SHM_RING_H_
+#define _SHM_RING_H_
+
+#include <stdint.h>
+#include <semaphore.h>
+
+/******************************************************************************
+Shared-memory ring buffer protocol for handing reflectance strips from an
+upstream producer (i.e. surface reflectance) running on the same node to
+spectral_indices, without writing the bands to disk.
+
+The producer creates a POSIX shared-memory segment (shm_open) laid out as:
+    Shm_ring_header_t                  at offset 0
+    slot 0 .. slot nslots-1            at slot_offset + islot * slot_size
+Each slot is a Shm_ring_slot_t header followed, at SHM_SLOT_HDR_SIZE bytes
+into the slot, by nbands int16 band planes of slot_nlines * nsamps pixels
+each.  The band planes are in the same order as the reflectance bands read
+from the XML file (0=b1, 1=b2, ... as documented in spectral_indices.c).
+
+Strips are handed off in line order.  Strip N covers lines
+N * slot_nlines .. N * slot_nlines + nlines - 1 and lives in slot
+N % nslots.  The producer waits on slots_free, fills the slot, sets its
+state to SHM_SLOT_FULL and posts slots_full.  spectral_indices waits on
+slots_full, computes the indices directly from the shared band planes, then
+sets the state back to SHM_SLOT_EMPTY and posts slots_free so the slot can be
+reused.  The producer initializes slots_free to nslots and slots_full to 0
+(sem_init with pshared=1).
+
+slot_nlines must currently match PROC_NLINES so the strips line up with the
+spectral_indices processing loop.
+******************************************************************************/
+
+/* Identification of the ring header */
+#define SHM_RING_MAGIC 0x53495242     /* "SIRB" */
+#define SHM_RING_VERSION 1
+
+/* Size of the per-slot header; band planes start at this offset */
+#define SHM_SLOT_HDR_SIZE 64
+
+/* Slot states */
+#define SHM_SLOT_EMPTY 0
+#define SHM_SLOT_FULL 1
+
+/* How long (seconds) to wait on the producer for the next strip before
+   giving up */
+#define SHM_WAIT_SECS 600
+
+/* Header at the start of the shared-memory segment */
+typedef struct {
+    uint32_t magic;          /* SHM_RING_MAGIC */
+    uint32_t version;        /* SHM_RING_VERSION */
+    int32_t nslots;          /* number of strip slots in the ring */
+    int32_t nbands;          /* number of band planes in each slot */
+    int32_t nlines;          /* number of lines in the scene */
+    int32_t nsamps;          /* number of samples in the scene */
+    int32_t slot_nlines;     /* number of lines per strip/slot */
+    int32_t refl_fill;       /* fill value for reflectance bands */
+    int32_t refl_saturate_val; /* saturation value for reflectance bands */
+    float refl_scale_fact;   /* scale factor for reflectance bands */
+    int64_t slot_offset;     /* byte offset of slot 0 in the segment */
+    int64_t slot_size;       /* byte size of each slot, including the slot
+                                header */
+    sem_t slots_full;        /* posted by the producer when a slot is filled */
+    sem_t slots_free;        /* posted by the consumer when a slot is
+                                released */
+} Shm_ring_header_t;
+
+/* Header at the start of each slot */
+typedef struct {
+    volatile int32_t state;  /* SHM_SLOT_EMPTY or SHM_SLOT_FULL */
+    int32_t strip;           /* strip index (0-based) held in this slot */
+    int32_t iline;           /* first line of the strip (0-based) */
+    int32_t nlines;          /* number of valid lines in the strip */
+} Shm_ring_slot_t;
+
+#endif
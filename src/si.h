@@ -9,12 +9,27 @@
 #include "common.h"
 #include "input.h"
 #include "output.h"
+#include "anomaly.h"
+#include "browse.h"
+#include "footprint.h"
+#include "feature_vectors.h"
+#include "sample.h"
+#include "plan.h"
+#include "progressive.h"
+#include "profile.h"
+#include "flight.h"
+#include "metrics.h"
+#include "tile_grid.h"
 #include "espa_metadata.h"
 #include "parse_metadata.h"
 #include "write_metadata.h"
 #include "envi_header.h"
 #include "error_handler.h"
 
+/* Number of entries in the lookup table of a two-band index for 8-bit
+   inputs, indexed by (band1 << 8) | band2 */
+#define DN_LUT_SIZE (256 * 256)
+
 /* Prototypes */
 void usage ();
 void version ();
@@ -24,14 +39,69 @@ short get_args
     int argc,             /* I: number of cmd-line args */
     char *argv[],         /* I: string of cmd-line args */
     char **xml_infile,    /* O: address of input XML file */
+    char **shm_name,      /* O: address of the shared-memory ring name */
     bool *toa,            /* O: flag to process TOA reflectance */
+    bool *dn,             /* O: flag to process the 8-bit Level-1 DN bands */
     bool *ndvi,           /* O: flag to process NDVI */
     bool *ndmi,           /* O: flag to process NDMI */
     bool *nbr,            /* O: flag to process NBR */
     bool *nbr2,           /* O: flag to process NBR2 */
+    bool *ndre,           /* O: flag to process NDRE */
+    bool *pri,            /* O: flag to process PRI */
+    bool *cci,            /* O: flag to process CCI */
     bool *savi,           /* O: flag to process SAVI */
     bool *msavi,          /* O: flag to process MSAVI */
     bool *evi,            /* O: flag to process EVI */
+    bool *virtual,        /* O: flag to write virtual index descriptors */
+    char **browse_name,   /* O: address of the index for the browse image */
+    int *browse_factor,   /* O: decimation factor for the browse image */
+    float *prescan,       /* O: minimum valid fraction for the pre-scan; -1.0
+                                if no pre-scan */
+    bool *prescan_qa,     /* O: flag to use pixel_qa in the pre-scan */
+    bool *mmap_output,    /* O: flag to write the index bands through
+                                preallocated memory maps */
+    int *write_buffer,    /* O: size of the per-band write-combining buffer
+                                in megabytes; 0 for none */
+    float *io_rate_limit, /* O: per-process I/O limit in MB/s; 0 for none */
+    float *io_node_limit, /* O: node-wide I/O limit in MB/s; 0 for none */
+    char **io_node_bucket, /* O: address of the node-wide I/O bucket name */
+    int *http_cache,      /* O: memory budget for the remote band block
+                                caches in megabytes */
+    char **s3_output,     /* O: address of the S3 URL to upload the products
+                                to */
+    int *s3_part_size,    /* O: multipart upload part size in megabytes */
+    int *s3_threads,      /* O: number of parallel part uploads */
+    char **tile_grid,     /* O: address of the tile grid to write the
+                                indices to */
+    int *tile_buffer,     /* O: memory budget for the partial tiles in
+                                megabytes */
+    char **anomaly_name,  /* O: address of the index to compare with the
+                                climatology */
+    char **clim_mean,     /* O: address of the climatology mean file */
+    char **clim_std,      /* O: address of the climatology standard
+                                deviation file */
+    bool *pct_normal,     /* O: flag to also write the percent of normal */
+    bool *progressive,    /* O: flag to publish coarse previews first */
+    bool *profile,        /* O: flag to report the memory and faults of each
+                                stage */
+    char **flight_file,   /* O: address of the file to keep the flight
+                                recorder in */
+    char **metrics_file,  /* O: address of the file to write the metrics
+                                to */
+    bool *footprint,      /* O: flag to write the valid-data footprint */
+    char **features,      /* O: address of the data type of the feature
+                                vectors (int16 or float32) */
+    char **sample_labels, /* O: address of the label raster to draw the
+                                sample by */
+    int *sample_size,     /* O: number of pixels to draw from each class */
+    bool *plan,           /* O: flag to print the run plan instead of
+                                processing */
+    char **cal_file,      /* O: address of the calibration profile to
+                                estimate the run time from */
+    bool *follow,         /* O: flag to wait for the strips of band files
+                                which are still being written */
+    float *follow_timeout, /* O: most seconds the band files may go without
+                                growing */
     bool *verbose         /* O: verbose flag */
 );
 
@@ -95,4 +165,54 @@ void make_evi
     int16 *evi            /* O: output EVI */
 );
 
+void compute_spectral_index
+(
+    Mysi_list_t si,       /* I: spectral index to compute */
+    int16 *band[MAX_SI_BANDS], /* I: input arrays of scaled reflectance data
+                                in kernel order */
+    float scale_factor,   /* I: scale factor for the reflectance values to
+                                unscale the pixels to their true value */
+    int fill_value,       /* I: fill value for the reflectance values */
+    int satu_value,       /* I: saturation value for the reflectance values */
+    int nlines,           /* I: number of lines in the data arrays */
+    int nsamps,           /* I: number of samples in the data arrays */
+    int16 *spec_indx      /* O: output spectral index */
+);
+
+int16 *make_index_lut
+(
+    Mysi_list_t si,       /* I: spectral index */
+    float scale_factor,   /* I: scale factor for the 8-bit values to unscale
+                                the pixels to their true value */
+    int fill_value,       /* I: fill value for the 8-bit values */
+    int satu_value        /* I: saturation value for the 8-bit values */
+);
+
+void apply_index_lut
+(
+    int16 *lut,           /* I: lookup table from make_index_lut */
+    uint8 *band1,         /* I: input array of 8-bit data for the first
+                                kernel band */
+    uint8 *band2,         /* I: input array of 8-bit data for the second
+                                kernel band */
+    int nlines,           /* I: number of lines in the data arrays */
+    int nsamps,           /* I: number of samples in the data arrays */
+    int16 *spec_indx      /* O: output spectral index */
+);
+
+char *si_short_name
+(
+    Mysi_list_t si        /* I: spectral index */
+);
+
+char *si_upper_name
+(
+    Mysi_list_t si        /* I: spectral index */
+);
+
+char *si_long_name
+(
+    Mysi_list_t si        /* I: spectral index */
+);
+
 #endif
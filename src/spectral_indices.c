@@ -1,3 +1,4 @@
+#include <unistd.h>
 #include "si.h"
 
 /******************************************************************************
@@ -27,19 +28,68 @@ NOTES:
      have an "sr_" in the file name to designate products processed with TOA
      bands vs. SR bands.  Otherwise the source will be key along with the band
      name to pull the appropriate band from the XML file.
+  4. With --dn the 8-bit Level-1 bands are processed and the products have
+     "dn_" in the file name.  The two-band indices are looked up in a table
+     built once per index; EVI is computed from the widened bands.
+  5. With --anomaly the climatology strips are read alongside the
+     reflectance strips, and the standardized anomaly (and percent of normal)
+     of the index are computed from each index strip while it's in memory.
+     They are written after the index bands as {index}_anom and
+     {index}_pctn.
+  6. With --progressive, previews of the indices at every 16th and then
+     every 4th line and sample are computed and published before the
+     full-resolution pass, and each level reuses the pixels of the one
+     before it.
+  7. The flight recorder keeps the last FLIGHT_NEVENT reads, computes,
+     writes, and uploads with their timing, and dumps them on a fatal error
+     or signal (see flight.c).
+  8. With --footprint, the extent of the valid data in each line is kept
+     as the strips are computed, and written as a GeoJSON outline once the
+     pass is done (see footprint.c).
+  9. With --features, the bands and indices of each strip are transposed
+     into pixel-interleaved feature vectors before the strip is released
+     (see feature_vectors.c).
+  10. With --sample, a label raster is read with the strips and each class
+      keeps a fixed-size reservoir of its valid pixels, in place of the
+      index bands (see sample.c).
+  11. With --plan, the run stops once the inputs are opened and the buffer
+      sizes are planned, and prints the work it would do as JSON (see
+      plan.c).  The pre-scan is skipped and no output files are created.
+  12. With --follow, each strip waits until the band files being written
+      hold its lines (see wait_input_refl_lines), so a scene can be
+      processed while its reflectance is still being produced.
 ******************************************************************************/
 int main (int argc, char *argv[])
 {
     bool verbose;            /* verbose flag for printing messages */
     bool toa_flag;           /* should the TOA bands be processed, otherwise
                                 process surface reflectance bands */
+    bool dn_flag;            /* should the 8-bit Level-1 DN bands be
+                                processed instead? */
     bool ndvi_flag;          /* should we process the NDVI product? */
     bool ndmi_flag;          /* should we process the NDMI product? */
     bool nbr_flag;           /* should we process the NBR product? */
     bool nbr2_flag;          /* should we process the NBR2 product? */
+    bool ndre_flag;          /* should we process the NDRE product? */
+    bool pri_flag;           /* should we process the PRI product? */
+    bool cci_flag;           /* should we process the CCI product? */
     bool savi_flag;          /* should we process the SAVI product? */
     bool msavi_flag;         /* should we process the modified SAVI product? */
     bool evi_flag;           /* should we process the EVI product? */
+    bool virtual_flag;       /* write virtual index descriptors instead of
+                                the index rasters? */
+    bool prescan_qa;         /* use pixel_qa for the pre-scan clear fraction? */
+    bool mmap_output;        /* compute the indices directly into memory
+                                mapped output files? */
+    bool pct_normal;         /* also write the percent of normal? */
+    bool progressive;        /* publish coarse previews before the
+                                full-resolution products? */
+    bool profile;            /* report the memory and faults of each stage? */
+    bool footprint;          /* write the valid-data footprint? */
+    bool plan;               /* print the run plan instead of processing? */
+    bool follow;             /* wait for the strips of band files which are
+                                still being written? */
+    bool si_flag[NUM_SI];    /* should we process each spectral index? */
 
     char FUNC_NAME[] = "main"; /* function name */
     char errmsg[STR_SIZE];     /* error message */
@@ -49,7 +99,26 @@ int main (int argc, char *argv[])
     char long_si_names[MAX_OUT_BANDS][STR_SIZE];  /* output long names for SI
                                                      bands */
     char *xml_infile = NULL; /* input XML filename */
+    char *shm_name = NULL;   /* shared-memory ring to read the strips from */
     char *cptr = NULL;       /* pointer to the file extension */
+    char *browse_name = NULL; /* index to render in the browse image */
+    char *io_node_bucket = NULL; /* name of the node-wide I/O bucket */
+    char *s3_output = NULL;  /* S3 URL to upload the products to */
+    char *tile_grid = NULL;  /* tile grid to write the indices to */
+    char *anomaly_name = NULL; /* index to compare with the climatology */
+    char *clim_mean = NULL;  /* climatology mean file */
+    char *clim_std = NULL;   /* climatology standard deviation file */
+    char *flight_file = NULL; /* file to keep the flight recorder in */
+    char *metrics_file = NULL; /* file to write the Prometheus metrics to */
+    char *features = NULL;   /* data type of the feature vectors */
+    char *sample_labels = NULL; /* label raster to draw the sample by */
+    char *cal_file = NULL;   /* calibration profile for the plan's
+                                estimate */
+    char labels[STR_SIZE];   /* labels of a metric */
+    char browse_file[STR_SIZE]; /* name of the browse PNG file */
+    char footprint_file[STR_SIZE + 32]; /* name of the footprint GeoJSON
+                                file */
+    char sample_file[STR_SIZE + 32]; /* name of the sample CSV file */
 
     int retval;              /* return status */
     int k;                   /* variable to keep track of the % complete */
@@ -57,45 +126,155 @@ int main (int argc, char *argv[])
     int ib;                  /* looping variable for bands */
     int line;                /* current line to be processed */
     int nlines_proc;         /* number of lines to process at one time */
+    int browse_factor;       /* decimation factor for the browse image */
+    int sample_size;         /* number of pixels drawn from each class */
+    int write_buffer;        /* size of the per-band write-combining buffer
+                                in megabytes */
+    float io_rate_limit;     /* per-process I/O limit in MB/s */
+    float io_node_limit;     /* node-wide I/O limit in MB/s */
+    float follow_timeout;    /* most seconds the band files may go without
+                                growing */
+    int http_cache;          /* memory budget for the remote band block
+                                caches in megabytes */
+    long long http_bytes = 0; /* number of bytes fetched for remote bands */
+    int s3_part_size;        /* multipart upload part size in megabytes */
+    int s3_threads;          /* number of parallel part uploads */
+    int tile_buffer;         /* memory budget for the partial tiles in
+                                megabytes */
+    int prog_factor[PROG_NLEVEL] = PROG_FACTORS; /* decimation factor of each
+                                preview level */
+    size_t strip_bytes;      /* size of one int16 strip in bytes */
+    int64_t t0;              /* start of the current flight recorder event */
+    int64_t strip_t0;        /* start of the current strip */
+    int64_t strip_nbytes;    /* bytes in one int16 band of the current
+                                strip */
+    int64_t feat_nbytes;     /* bytes of feature vectors written for the
+                                current strip */
+    float prescan;           /* minimum valid fraction for the pre-scan; -1.0
+                                if no pre-scan */
+    float valid_frac;        /* pre-scan estimate of the valid fraction */
+    float clear_frac;        /* pre-scan estimate of the clear fraction */
     int num_si;              /* number of spectral index products */
+    int num_index;           /* number of index bands, before any anomaly
+                                bands */
     int si_indx[NUM_SI];     /* index of each of the bands within the spectral
                                 index product */
-    int16 *blue=NULL;        /* blue band index */
-    int16 *red=NULL;         /* red band index */
-    int16 *nir=NULL;         /* NIR band index */
-    int16 *mir=NULL;         /* MIR band index */
-    int16 *swir=NULL;        /* SWIR band index */
-    int16 *ndvi=NULL;        /* NDVI values */
-    int16 *ndmi=NULL;        /* NDMI values */
-    int16 *nbr=NULL;         /* NBR values */
-    int16 *nbr2=NULL;        /* NBR2 values */
-    int16 *savi=NULL;        /* SAVI values */
-    int16 *msavi=NULL;       /* MSAVI values */
-    int16 *evi=NULL;         /* EVI values */
+    int nsi_band;            /* number of input bands for the current index */
+    int nwiden;              /* number of DN bands widened to int16 */
+    bool dn_widen[NBAND_REFL_MAX]; /* is each DN band read as int16 strips? */
+    int si_band[MAX_SI_BANDS]; /* reflectance buffer for each input band of
+                                the current index */
+    Mysi_list_t si;          /* current spectral index */
+    Mysi_list_t browse_si = NUM_SI; /* index rendered in the browse image */
+    Mysi_list_t anom_si = NUM_SI; /* index compared with the climatology */
+    int anom_indx = -1;      /* output band of the standardized anomaly */
+    int pctn_indx = -1;      /* output band of the percent of normal */
+    Mysi_list_t si_order[NUM_SI] = {SI_NDVI, SI_EVI, SI_NDMI, SI_SAVI,
+        SI_MSAVI, SI_NBR, SI_NBR2, SI_NDRE, SI_PRI, SI_CCI};
+                             /* order of the output index bands */
+    Mysi_list_t prog_si[NUM_SI]; /* requested indices in output order */
+    int16 *si_in[MAX_SI_BANDS]; /* input bands for the current index */
+    int16 *si_buf[NUM_SI];   /* computed values for each spectral index */
+    int16 *si_lut[NUM_SI];   /* lookup table of each two-band index for the
+                                DN bands; NULL if computed by the kernel */
+    int16 *spec_indx = NULL; /* output strip for the current index */
+    int16 *anom_buf = NULL;  /* standardized anomaly strip */
+    int16 *pctn_buf = NULL;  /* percent of normal strip */
+    int16 *anom_out = NULL;  /* output strip for the anomaly */
+    int16 *pctn_out = NULL;  /* output strip for the percent of normal */
+    int16 *tile_in[MAX_OUT_BANDS]; /* index strips in output band order, for
+                                the tiles and feature vectors */
+
     Input_t *refl_input=NULL;  /* input structure for the TOA or SR product */
     Output_t *si_output=NULL;   /* output structure and metadata for the
                                    SI products */
+    Browse_t *browse=NULL;   /* browse image built during the main pass */
+    Footprint_t *fprint=NULL; /* valid-data footprint tracked during the main
+                                pass */
+    Features_t *feat=NULL;   /* pixel feature vectors written during the main
+                                pass */
+    Sample_t *sample=NULL;   /* stratified sample drawn during the main pass,
+                                in place of the index bands */
+    Anomaly_t *clim=NULL;    /* climatology the anomaly is computed from */
+    Progressive_t *prog=NULL; /* coarse-to-fine previews */
+    Rate_limit_t *io_limit=NULL; /* I/O rate limiter for the reads and
+                                    writes */
+    S3_upload_t *s3=NULL;    /* upload of the products to S3 */
+    Tile_grid_t *tiles=NULL; /* grid-aligned tiles written in place of the
+                                scene bands */
+    Plan_t run_plan;         /* work the run calls for, with --plan */
+    long long npix;          /* pixels in the scene */
+    int pix_bytes;           /* bytes in each input pixel */
     Espa_internal_meta_t xml_metadata;  /* XML metadata structure */
     Espa_global_meta_t *gmeta = NULL; /* pointer to global meta */
     Envi_header_t envi_hdr;   /* output ENVI header information */
+    double seconds_buckets[] = METRIC_SECONDS_BUCKETS; /* histogram buckets
+                                for durations */
+    Metric_t *m_pixels[NUM_SI]; /* pixels computed for each index */
+    Metric_t *m_read_bytes = NULL; /* bytes of the input bands read */
+    Metric_t *m_written_bytes = NULL; /* bytes of the index bands written */
+    Metric_t *m_fetch_bytes = NULL; /* bytes of the remote bands fetched */
+    Metric_t *m_strip_seconds = NULL; /* time taken by each strip */
+    Metric_t *m_lines_done = NULL; /* lines of the scene processed */
+    Metric_t *m_lines_total = NULL; /* lines in the scene */
+
+    /* Start the clock and fault counts of the setup stage */
+    prof_init ();
 
     /* Read the command-line arguments */
-    retval = get_args (argc, argv, &xml_infile, &toa_flag, &ndvi_flag,
-        &ndmi_flag, &nbr_flag, &nbr2_flag, &savi_flag, &msavi_flag, &evi_flag,
-        &verbose);
+    retval = get_args (argc, argv, &xml_infile, &shm_name, &toa_flag,
+        &dn_flag, &ndvi_flag, &ndmi_flag, &nbr_flag, &nbr2_flag, &ndre_flag,
+        &pri_flag, &cci_flag, &savi_flag, &msavi_flag, &evi_flag,
+        &virtual_flag, &browse_name, &browse_factor, &prescan, &prescan_qa,
+        &mmap_output, &write_buffer, &io_rate_limit, &io_node_limit,
+        &io_node_bucket, &http_cache, &s3_output, &s3_part_size, &s3_threads,
+        &tile_grid, &tile_buffer, &anomaly_name, &clim_mean, &clim_std,
+        &pct_normal, &progressive, &profile, &flight_file, &metrics_file,
+        &footprint, &features, &sample_labels, &sample_size, &plan,
+        &cal_file, &follow, &follow_timeout, &verbose);
     if (retval != SUCCESS)
     {   /* get_args already printed the error message */
         exit (ERROR);
     }
 
-    printf ("Starting spectral_indices version %s ...\n", INDEX_VERSION);
+    /* Count the libxml2 allocations before it makes any */
+    if (profile)
+        prof_xml_setup ();
+
+    /* Record the recent pipeline events, to be dumped if the run dies */
+    if (flight_open (flight_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Starting the flight recorder.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* Export the job metrics for the node's collector; the exit status is
+       recorded however the run ends */
+    if (metrics_file != NULL && open_metrics_file (metrics_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Setting up the metrics file %s", metrics_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* The plan is the only output on stdout, so it can be piped */
+    if (plan)
+        verbose = false;
+    else
+        printf ("Starting spectral_indices version %s ...\n",
+            INDEX_VERSION);
 
     /* Provide user information if verbose is turned on */
     if (verbose)
     {
         printf ("  XML input file: %s\n", xml_infile);
+        if (shm_name != NULL)
+            printf ("  Shared-memory input ring: %s\n", shm_name);
 
-        if (toa_flag)
+        if (dn_flag)
+            printf ("  Process 8-bit Level-1 DN bands\n");
+        else if (toa_flag)
             printf ("  Process TOA reflectance bands\n");
         else
             printf ("  Process surface reflectance bands\n");
@@ -141,16 +320,147 @@ int main (int argc, char *argv[])
             printf ("yes\n");
         else
             printf ("no\n");
+
+        printf ("  Process NDRE - ");
+        if (ndre_flag)
+            printf ("yes\n");
+        else
+            printf ("no\n");
+
+        printf ("  Process PRI  - ");
+        if (pri_flag)
+            printf ("yes\n");
+        else
+            printf ("no\n");
+
+        printf ("  Process CCI  - ");
+        if (cci_flag)
+            printf ("yes\n");
+        else
+            printf ("no\n");
+
+        if (virtual_flag)
+            printf ("  Write virtual index descriptors\n");
+        if (browse_name != NULL)
+            printf ("  Browse image: %s, decimated by %d\n", browse_name,
+                browse_factor);
+        if (mmap_output)
+            printf ("  Write the index bands through memory maps\n");
+        if (write_buffer > 0)
+            printf ("  Write-combining buffer: %d MB per band\n",
+                write_buffer);
+        if (io_rate_limit > 0.0)
+            printf ("  I/O rate limit: %g MB/s\n", io_rate_limit);
+        if (io_node_limit > 0.0)
+            printf ("  Node-wide I/O rate limit: %g MB/s (%s)\n",
+                io_node_limit, io_node_bucket != NULL ? io_node_bucket :
+                IO_NODE_BUCKET);
+        if (s3_output != NULL)
+            printf ("  Upload the products to %s (%d MB parts, %d threads)\n",
+                s3_output, s3_part_size, s3_threads);
+        if (tile_grid != NULL)
+            printf ("  Tile grid: %s (%d MB of partial tiles)\n", tile_grid,
+                tile_buffer);
+        if (prescan >= 0.0)
+            printf ("  Pre-scan minimum %s fraction: %g\n",
+                prescan_qa ? "clear" : "valid", prescan);
+        if (anomaly_name != NULL)
+            printf ("  Anomaly of %s%s: mean %s, std %s\n", anomaly_name,
+                pct_normal ? " and percent of normal" : "", clim_mean,
+                clim_std);
+        if (progressive)
+            printf ("  Publish coarse previews first\n");
+        if (profile)
+            printf ("  Report the memory and faults of each stage\n");
+        if (flight_file != NULL)
+            printf ("  Flight recorder file: %s\n", flight_file);
+        if (metrics_file != NULL)
+            printf ("  Metrics file: %s\n", metrics_file);
+        if (footprint)
+            printf ("  Write the valid-data footprint\n");
+        if (features != NULL)
+            printf ("  Write %s pixel feature vectors\n", features);
+        if (sample_labels != NULL)
+            printf ("  Draw %d pixels of each class of %s\n", sample_size,
+                sample_labels);
+        if (follow)
+            printf ("  Follow the band files as they're written (timeout "
+                "%g s)\n", follow_timeout);
     }
 
     if (!ndvi_flag && !ndmi_flag && !nbr_flag && !nbr2_flag && !savi_flag &&
-        !msavi_flag && !evi_flag)
+        !msavi_flag && !evi_flag && !ndre_flag && !pri_flag && !cci_flag)
     {
         sprintf (errmsg, "No index product was specified for processing.");
         error_handler (true, FUNC_NAME, errmsg);
         exit (ERROR);
     }
 
+    /* The browse is built from the computed strips, which virtual mode
+       doesn't produce */
+    if (browse_name != NULL && virtual_flag)
+    {
+        sprintf (errmsg, "The browse image is not available with virtual "
+            "index descriptors.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* The footprint is found from the computed strips as well */
+    if (footprint && virtual_flag)
+    {
+        sprintf (errmsg, "The footprint is not available with virtual index "
+            "descriptors.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* Virtual descriptors reference the local reflectance bands */
+    if (s3_output != NULL && virtual_flag)
+    {
+        sprintf (errmsg, "Uploading to S3 is not available with virtual "
+            "index descriptors.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* Virtual descriptors are computed on read, not strip by strip */
+    if (tile_grid != NULL && virtual_flag)
+    {
+        sprintf (errmsg, "The tile grid is not available with virtual index "
+            "descriptors.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* The anomaly is computed from the index strips, and its bands carry
+       their own scale */
+    if (anomaly_name != NULL && (virtual_flag || tile_grid != NULL))
+    {
+        sprintf (errmsg, "The anomaly is not available with virtual index "
+            "descriptors or the tile grid.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* The ring strips can only be read once, in order */
+    if ((prescan >= 0.0 || progressive) && shm_name != NULL)
+    {
+        sprintf (errmsg, "The pre-scan and previews are not available with "
+            "the shared-memory ring.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* Virtual descriptors have no rasters to preview */
+    if (progressive && virtual_flag)
+    {
+        sprintf (errmsg, "The previews are not available with virtual index "
+            "descriptors.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
     /* Validate the input metadata file */
     if (validate_xml_file (xml_infile) != SUCCESS)
     {  /* Error messages already written */
@@ -170,8 +480,21 @@ int main (int argc, char *argv[])
     gmeta = &xml_metadata.global;
 
     /* Open the reflectance product, set up the input data structure, and
-       allocate memory for the data buffers */
-    refl_input = open_input (&xml_metadata, toa_flag);
+       allocate memory for the data buffers.  Only the bands used by the
+       requested indices are read. */
+    si_flag[SI_NDVI] = ndvi_flag;
+    si_flag[SI_EVI] = evi_flag;
+    si_flag[SI_SAVI] = savi_flag;
+    si_flag[SI_MSAVI] = msavi_flag;
+    si_flag[SI_NDMI] = ndmi_flag;
+    si_flag[SI_NBR] = nbr_flag;
+    si_flag[SI_NBR2] = nbr2_flag;
+    si_flag[SI_NDRE] = ndre_flag;
+    si_flag[SI_PRI] = pri_flag;
+    si_flag[SI_CCI] = cci_flag;
+    prof_stage (STAGE_INPUT);
+    refl_input = open_input (&xml_metadata, toa_flag, dn_flag, si_flag,
+        shm_name, http_cache);
     if (refl_input == (Input_t *) NULL)
     {
         sprintf (errmsg, "Error opening/reading the reflectance data: %s",
@@ -180,175 +503,607 @@ int main (int argc, char *argv[])
         exit (ERROR);
     }
 
+    /* Virtual descriptors name the band files for the reader to open, and
+       the reader only opens local files */
+    if (virtual_flag && refl_input->http)
+    {
+        sprintf (errmsg, "Virtual index descriptors are not available with "
+            "remote (http://) bands.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
     /* Output some information from the input files if verbose */
     if (verbose)
     {
         printf ("  Number of lines/samples: %d/%d\n", refl_input->nlines,
             refl_input->nsamps);
-        printf ("  Number of reflective bands: %d\n", refl_input->nrefl_band);
+        printf ("  Number of reflective bands: %d read of %d\n",
+            refl_input->nrefl_band, refl_input->ncat_band);
+        for (ib = 0; ib < refl_input->nrefl_band; ib++)
+            printf ("    Band %d: %g nm\n", refl_input->cat_band[ib] + 1,
+                refl_input->cat_wavelength[refl_input->cat_band[ib]]);
         printf ("  Fill value: %d\n", refl_input->refl_fill);
         printf ("  Scale factor: %f\n", refl_input->refl_scale_fact);
         printf ("  Saturation value: %d\n", refl_input->refl_saturate_val);
     }
 
-    /* Initialize the si_indx */
+    /* Throttle the reads and writes if requested */
+    if (io_rate_limit > 0.0 || io_node_limit > 0.0)
+    {
+        io_limit = open_rate_limit (io_rate_limit, io_node_limit,
+            io_node_bucket);
+        if (io_limit == NULL)
+        {
+            sprintf (errmsg, "Setting up the I/O rate limit.");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        refl_input->io_limit = io_limit;
+    }
+
+    /* Wait for each strip of band files which are still being written */
+    if (follow && follow_input (refl_input, follow_timeout) != SUCCESS)
+    {
+        sprintf (errmsg, "Following the reflectance bands.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* Estimate the valid (and clear) fraction from a sparse sample of lines
+       and stop early if the scene isn't worth processing */
+    if (prescan >= 0.0 && !plan)
+    {
+        prof_stage (STAGE_PRESCAN);
+        if (prescan_input (refl_input, &xml_metadata, prescan_qa, &valid_frac,
+            &clear_frac) != SUCCESS)
+        {
+            sprintf (errmsg, "Pre-scanning the reflectance data.");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+
+        printf ("Pre-scan valid fraction: %.4f\n", valid_frac);
+        if (prescan_qa)
+            printf ("Pre-scan clear fraction: %.4f\n", clear_frac);
+
+        if ((prescan_qa ? clear_frac : valid_frac) < prescan)
+        {
+            printf ("Pre-scan %s fraction is below %g; skipping the scene.\n",
+                prescan_qa ? "clear" : "valid", prescan);
+            close_input (refl_input);
+            free_input (refl_input);
+            free_metadata (&xml_metadata);
+            free (xml_infile);
+            free (shm_name);
+            free (browse_name);
+            free (io_node_bucket);
+            free (s3_output);
+            free (tile_grid);
+            free (anomaly_name);
+            free (clim_mean);
+            free (clim_std);
+            close_rate_limit (io_limit);
+            if (profile)
+                prof_report ();
+            flight_close ();
+            exit (PRESCAN_REJECT);
+        }
+    }
+
+    /* Initialize the si_indx and the index buffers */
+    prof_stage (STAGE_ALLOCATE);
     for (i = 0; i < NUM_SI; i++)
+    {
         si_indx[i] = -1;
+        si_buf[i] = NULL;
+        si_lut[i] = NULL;
+        m_pixels[i] = NULL;
+    }
 
-    /* Allocate memory for the NDVI */
+    /* Allocate memory for each of the requested indices, in the order they
+       are to be written to the output product */
     num_si = 0;
-    if (ndvi_flag)
+    for (i = 0; i < NUM_SI; i++)
     {
-        ndvi = calloc (PROC_NLINES*refl_input->nsamps, sizeof (int16));
-        if (ndvi == NULL)
+        si = si_order[i];
+        if (!si_flag[si])
+            continue;
+
+        /* Virtual indices are computed on read, and mapped indices are
+           computed in place, so no buffer is needed */
+        if (!virtual_flag && !mmap_output)
         {
-            sprintf (errmsg, "Error allocating memory for the NDVI");
+            si_buf[si] = prof_calloc (PBUF_INDEX,
+                PROC_NLINES*refl_input->nsamps, sizeof (int16));
+            if (si_buf[si] == NULL)
+            {
+                sprintf (errmsg, "Error allocating memory for the %s",
+                    si_upper_name (si));
+                error_handler (true, FUNC_NAME, errmsg);
+                exit (ERROR);
+            }
+        }
+
+        /* update band info for opening the SI product */
+        tile_in[num_si] = si_buf[si];
+        si_indx[si] = num_si;
+        sprintf (short_si_names[num_si], "%s_%s",
+            dn_flag ? "dn" : (toa_flag ? "toa" : "sr"), si_short_name (si));
+
+        /* Build the lookup table for a two-band index of the DN bands */
+        if (dn_flag && si != SI_EVI)
+        {
+            si_lut[si] = make_index_lut (si, refl_input->refl_scale_fact,
+                refl_input->refl_fill, refl_input->refl_saturate_val);
+            if (si_lut[si] == NULL)
+            {
+                sprintf (errmsg, "Error building the lookup table for the %s",
+                    si_upper_name (si));
+                error_handler (true, FUNC_NAME, errmsg);
+                exit (ERROR);
+            }
+            prof_count (PBUF_LUT, DN_LUT_SIZE * sizeof (int16));
+        }
+        strcpy (long_si_names[num_si++], si_long_name (si));
+    }
+
+    /* Widen the DN bands which are read as int16 strips: those of EVI, or
+       all of them for the feature vectors and the training sample */
+    if (dn_flag)
+    {
+        for (ib = 0; ib < refl_input->nrefl_band; ib++)
+            dn_widen[ib] = features != NULL || sample_labels != NULL;
+        if (si_flag[SI_EVI])
+        {
+            nsi_band = get_index_bands (refl_input, SI_EVI, si_band);
+            for (ib = 0; ib < nsi_band; ib++)
+                dn_widen[si_band[ib]] = true;
+        }
+        for (ib = 0; ib < refl_input->nrefl_band; ib++)
+        {
+            if (dn_widen[ib] && widen_input_dn (refl_input, ib) != SUCCESS)
+            {
+                sprintf (errmsg, "Error widening DN band %d", ib);
+                error_handler (true, FUNC_NAME, errmsg);
+                exit (ERROR);
+            }
+        }
+    }
+
+    /* Set up the browse image for one of the requested indices */
+    if (browse_name != NULL)
+    {
+        for (i = 0; i < NUM_SI; i++)
+        {
+            if (!strcmp (browse_name, si_short_name (i)))
+                browse_si = i;
+        }
+        if (browse_si == NUM_SI || si_indx[browse_si] == -1)
+        {
+            sprintf (errmsg, "Browse index %s is not one of the requested "
+                "indices.", browse_name);
             error_handler (true, FUNC_NAME, errmsg);
             exit (ERROR);
         }
 
-        /* update band info for opening the VI product */
-        si_indx[SI_NDVI] = num_si;
-        if (toa_flag)
-            strcpy (short_si_names[num_si], "toa_ndvi");
-        else
-            strcpy (short_si_names[num_si], "sr_ndvi");
-        strcpy (long_si_names[num_si++],
-            "normalized difference vegetation index");
+        if (snprintf (browse_file, sizeof (browse_file), "%s_%s_browse.png",
+            gmeta->product_id, short_si_names[si_indx[browse_si]]) >=
+            (int) sizeof (browse_file))
+        {
+            sprintf (errmsg, "Browse image file name is too long: %.900s",
+                gmeta->product_id);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        browse = open_browse (browse_si, browse_factor, refl_input->nlines,
+            refl_input->nsamps, browse_file);
+        if (browse == NULL)
+        {
+            sprintf (errmsg, "Setting up the browse image.");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
     }
 
-    /* Allocate memory for the EVI */
-    if (evi_flag)
+    /* Track the first and last valid sample of each line, for the
+       footprint */
+    if (footprint)
     {
-        evi = calloc (PROC_NLINES*refl_input->nsamps, sizeof (int16));
-        if (evi == NULL)
+        snprintf (footprint_file, sizeof (footprint_file),
+            "%s_footprint.geojson", gmeta->product_id);
+        fprint = open_footprint (gmeta, refl_input->nlines,
+            refl_input->nsamps, refl_input->pixsize);
+        if (fprint == NULL)
         {
-            sprintf (errmsg, "Error allocating memory for the EVI");
+            sprintf (errmsg, "Setting up the footprint.");
             error_handler (true, FUNC_NAME, errmsg);
             exit (ERROR);
         }
-
-        /* update info for opening the VI product */
-        si_indx[SI_EVI] = num_si;
-        if (toa_flag)
-            strcpy (short_si_names[num_si], "toa_evi");
-        else
-            strcpy (short_si_names[num_si], "sr_evi");
-        strcpy (long_si_names[num_si++], "enhanced vegetation index");
     }
 
-    /* Allocate memory for the NDMI */
-    if (ndmi_flag)
+    /* Set up the anomaly bands of one of the requested indices, after the
+       index bands */
+    num_index = num_si;
+    if (anomaly_name != NULL)
     {
-        ndmi = calloc (PROC_NLINES*refl_input->nsamps, sizeof (int16));
-        if (ndmi == NULL)
+        for (i = 0; i < NUM_SI; i++)
         {
-            sprintf (errmsg, "Error allocating memory for the NDMI");
+            if (!strcmp (anomaly_name, si_short_name (i)))
+                anom_si = i;
+        }
+        if (anom_si == NUM_SI || si_indx[anom_si] == -1)
+        {
+            sprintf (errmsg, "Anomaly index %s is not one of the requested "
+                "indices.", anomaly_name);
             error_handler (true, FUNC_NAME, errmsg);
             exit (ERROR);
         }
 
-        /* update info for opening the VI product */
-        si_indx[SI_NDMI] = num_si;
-        if (toa_flag)
-            strcpy (short_si_names[num_si], "toa_ndmi");
-        else
-            strcpy (short_si_names[num_si], "sr_ndmi");
-        strcpy (long_si_names[num_si++],
-            "normalized difference moisture index");
+        clim = open_anomaly (anom_si, clim_mean, clim_std,
+            refl_input->nlines, refl_input->nsamps);
+        if (clim == NULL)
+        {
+            sprintf (errmsg, "Opening the climatology.");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        clim->io_limit = io_limit;
+
+        anom_indx = num_si;
+        sprintf (short_si_names[num_si], "%s_%s_anom",
+            dn_flag ? "dn" : (toa_flag ? "toa" : "sr"), anomaly_name);
+        sprintf (long_si_names[num_si++], "standardized anomaly of the %s",
+            si_long_name (anom_si));
+        if (pct_normal)
+        {
+            pctn_indx = num_si;
+            sprintf (short_si_names[num_si], "%s_%s_pctn",
+                dn_flag ? "dn" : (toa_flag ? "toa" : "sr"), anomaly_name);
+            sprintf (long_si_names[num_si++], "percent of normal of the %s",
+                si_long_name (anom_si));
+        }
+
+        /* Mapped bands are computed in place */
+        if (!mmap_output)
+        {
+            anom_buf = prof_calloc (PBUF_INDEX,
+                PROC_NLINES*refl_input->nsamps, sizeof (int16));
+            if (pct_normal)
+                pctn_buf = prof_calloc (PBUF_INDEX,
+                    PROC_NLINES*refl_input->nsamps, sizeof (int16));
+            if (anom_buf == NULL || (pct_normal && pctn_buf == NULL))
+            {
+                sprintf (errmsg, "Error allocating memory for the anomaly");
+                error_handler (true, FUNC_NAME, errmsg);
+                exit (ERROR);
+            }
+        }
     }
 
-    /* Allocate memory for the SAVI */
-    if (savi_flag)
+    /* Open the feature vectors of the bands and indices; the anomaly bands
+       aren't included */
+    if (features != NULL && !plan)
     {
-        savi = calloc (PROC_NLINES*refl_input->nsamps, sizeof (int16));
-        if (savi == NULL)
+        feat = open_features (gmeta->product_id, !strcmp (features,
+            "float32"), refl_input, dn_flag ? "dn" : (toa_flag ? "toa" :
+            "sr"), num_index, short_si_names);
+        if (feat == NULL)
         {
-            sprintf (errmsg, "Error allocating memory for the SAVI");
+            sprintf (errmsg, "Setting up the feature vectors.");
             error_handler (true, FUNC_NAME, errmsg);
             exit (ERROR);
         }
-
-        /* update info for opening the VI product */
-        si_indx[SI_SAVI] = num_si;
-        if (toa_flag)
-            strcpy (short_si_names[num_si], "toa_savi");
-        else
-            strcpy (short_si_names[num_si], "sr_savi");
-        strcpy (long_si_names[num_si++], "soil adjusted vegetation index");
     }
 
-    /* Allocate memory for the MSAVI */
-    if (msavi_flag)
+    /* Open the labels to draw the sample by; the index bands aren't
+       written */
+    if (sample_labels != NULL)
     {
-        msavi = calloc (PROC_NLINES*refl_input->nsamps, sizeof (int16));
-        if (msavi == NULL)
+        snprintf (sample_file, sizeof (sample_file), "%s_samples.csv",
+            gmeta->product_id);
+        sample = open_sample (sample_labels, sample_size, refl_input,
+            dn_flag ? "dn" : (toa_flag ? "toa" : "sr"), num_index,
+            short_si_names, gmeta->product_id);
+        if (sample == NULL)
         {
-            sprintf (errmsg, "Error allocating memory for the MSAVI");
+            sprintf (errmsg, "Setting up the sample.");
             error_handler (true, FUNC_NAME, errmsg);
             exit (ERROR);
         }
+        sample->io_limit = io_limit;
+    }
 
-        /* update info for opening the VI product */
-        si_indx[SI_MSAVI] = num_si;
-        if (toa_flag)
-            strcpy (short_si_names[num_si], "toa_msavi");
-        else
-            strcpy (short_si_names[num_si], "sr_msavi");
-        strcpy (long_si_names[num_si++], 
-            "modified soil adjusted vegetation index");
+    /* Record the buffer sizes the options and scene geometry call for, to
+       compare with what's actually allocated, or for the plan */
+    if (profile || plan)
+    {
+        strip_bytes = (size_t) PROC_NLINES * refl_input->nsamps *
+            sizeof (int16);
+        if (shm_name == NULL)
+        {
+            if (dn_flag)
+            {
+                nwiden = 0;
+                for (ib = 0; ib < refl_input->nrefl_band; ib++)
+                {
+                    if (refl_input->dn_widen[ib])
+                        nwiden++;
+                }
+                prof_plan (PBUF_INPUT, strip_bytes * (refl_input->nrefl_band +
+                    2 * nwiden) / 2);
+            }
+            else
+                prof_plan (PBUF_INPUT, strip_bytes * refl_input->nrefl_band);
+        }
+        if (!virtual_flag && !mmap_output)
+            prof_plan (PBUF_INDEX, strip_bytes * num_si);
+        for (i = 0; i < NUM_SI; i++)
+        {
+            if (si_lut[i] != NULL)
+                prof_plan (PBUF_LUT, DN_LUT_SIZE * sizeof (int16));
+        }
+        if (clim != NULL)
+            prof_plan (PBUF_CLIMATOLOGY, 2 * strip_bytes);
+        if (tile_grid == NULL)
+            prof_plan (PBUF_WRITE, (size_t) write_buffer * 1024 * 1024 *
+                num_si);
+        if (refl_input->http)
+            prof_plan (PBUF_HTTP, (size_t) http_cache * 1024 * 1024);
+        if (s3_output != NULL)
+            prof_plan (PBUF_S3, (size_t) s3_part_size * 1024 * 1024 *
+                (num_si + 2 * s3_threads));
+        if (tile_grid != NULL)
+            prof_plan (PBUF_TILE, (size_t) tile_buffer * 1024 * 1024);
+        if (browse != NULL)
+            prof_plan (PBUF_PREVIEW, (size_t) browse->nlines *
+                browse->nsamps * sizeof (int16));
+        for (i = 0; progressive && i < PROG_NLEVEL; i++)
+            prof_plan (PBUF_PREVIEW, (size_t) ((refl_input->nlines +
+                prog_factor[i] - 1) / prog_factor[i]) *
+                ((refl_input->nsamps + prog_factor[i] - 1) / prog_factor[i]) *
+                sizeof (int16) * num_index);
+
+        /* Only the label strip is known ahead; the reservoirs depend on the
+           classes present */
+        if (sample != NULL)
+            prof_plan (PBUF_SAMPLE, (size_t) PROC_NLINES *
+                refl_input->nsamps);
     }
 
-    /* Allocate memory for the NBR */
-    if (nbr_flag)
+    /* Work out the bytes the run would read and write and print the plan,
+       without reading any pixels */
+    if (plan)
     {
-        nbr = calloc (PROC_NLINES*refl_input->nsamps, sizeof (int16));
-        if (nbr == NULL)
+        memset (&run_plan, 0, sizeof (run_plan));
+        npix = (long long) refl_input->nlines * refl_input->nsamps;
+        pix_bytes = dn_flag ? sizeof (uint8) : sizeof (int16);
+        run_plan.product_id = gmeta->product_id;
+        run_plan.product = dn_flag ? "dn" : (toa_flag ? "toa" : "sr");
+        run_plan.mode = virtual_flag ? "virtual" : (sample != NULL ?
+            "sample" : (tile_grid != NULL ? "tiles" : "bands"));
+        for (i = 0; i < NUM_SI; i++)
+        {
+            if (si_indx[si_order[i]] != -1)
+                run_plan.index[run_plan.nindex++] = si_order[i];
+        }
+        run_plan.nout = sample != NULL ? 0 : num_si;
+        run_plan.out_names = short_si_names;
+        run_plan.lut = dn_flag;
+        run_plan.io_rate_limit = io_rate_limit;
+        run_plan.cal_file = cal_file;
+
+        /* Virtual descriptors read and write no rasters */
+        if (!virtual_flag)
+        {
+            run_plan.read_bands = npix * pix_bytes * refl_input->nrefl_band;
+            for (i = 0; progressive && i < PROG_NLEVEL; i++)
+            {
+                run_plan.read_bands += (long long) ((refl_input->nlines +
+                    prog_factor[i] - 1) / prog_factor[i]) *
+                    refl_input->nsamps * pix_bytes * refl_input->nrefl_band;
+                run_plan.write_previews += (long long) ((refl_input->nlines +
+                    prog_factor[i] - 1) / prog_factor[i]) *
+                    ((refl_input->nsamps + prog_factor[i] - 1) /
+                    prog_factor[i]) * sizeof (int16) * num_index;
+            }
+            if (clim != NULL)
+                run_plan.read_clim = 2 * npix * sizeof (int16);
+            if (sample != NULL)
+                run_plan.read_labels = npix * sizeof (uint8);
+            else
+                run_plan.write_bands = npix * sizeof (int16) * num_si;
+            if (features != NULL)
+                run_plan.write_features = npix *
+                    ((refl_input->nrefl_band + num_index) *
+                    (!strcmp (features, "float32") ? sizeof (float) :
+                    sizeof (int16)) + 2 * sizeof (int32_t));
+        }
+
+        if (write_plan (stdout, &run_plan, refl_input) != SUCCESS)
         {
-            sprintf (errmsg, "Error allocating memory for the NBR");
+            sprintf (errmsg, "Writing the plan.");
             error_handler (true, FUNC_NAME, errmsg);
             exit (ERROR);
         }
 
-        /* update info for opening the VI product */
-        si_indx[SI_NBR] = num_si;
-        if (toa_flag)
-            strcpy (short_si_names[num_si], "toa_nbr");
-        else
-            strcpy (short_si_names[num_si], "sr_nbr");
-        strcpy (long_si_names[num_si++], "normalized burn ratio");
+        close_input (refl_input);
+        free_input (refl_input);
+        free_metadata (&xml_metadata);
+        free (xml_infile);
+        free (cal_file);
+        flight_close ();
+        exit (SUCCESS);
+    }
+
+    /* Write the virtual index descriptors; there are no rasters to
+       compute or write */
+    if (virtual_flag)
+    {
+        for (i = 0; i < NUM_SI; i++)
+        {
+            si = si_order[i];
+            if (si_indx[si] == -1)
+                continue;
+
+            if (write_virtual_index (&xml_metadata, refl_input, si,
+                short_si_names[si_indx[si]], long_si_names[si_indx[si]])
+                != SUCCESS)
+            {
+                sprintf (errmsg, "Writing the virtual %s descriptor",
+                    si_upper_name (si));
+                error_handler (true, FUNC_NAME, errmsg);
+                exit (ERROR);
+            }
+        }
+
+        close_input (refl_input);
+        free_input (refl_input);
+        free_metadata (&xml_metadata);
+        free (xml_infile);
+        free (shm_name);
+        if (profile)
+            prof_report ();
+        flight_close ();
+        printf ("Spectral indices processing complete!\n");
+        exit (SUCCESS);
     }
 
-    /* Allocate memory for the NBR2 */
-    if (nbr2_flag)
+    /* Set up the upload; each band is streamed in parts as it's computed,
+       with enough part buffers for one per band plus two per thread */
+    if (s3_output != NULL)
     {
-        nbr2 = calloc (PROC_NLINES*refl_input->nsamps, sizeof (int16));
-        if (nbr2 == NULL)
+        s3 = open_s3_upload (s3_output, (size_t) s3_part_size * 1024 * 1024,
+            s3_threads, num_si + 2 * s3_threads);
+        if (s3 == NULL)
         {
-            sprintf (errmsg, "Error allocating memory for the NBR2");
+            sprintf (errmsg, "Setting up the upload to %s", s3_output);
             error_handler (true, FUNC_NAME, errmsg);
             exit (ERROR);
         }
+    }
 
-        /* update info for opening the VI product */
-        si_indx[SI_NBR2] = num_si;
-        if (toa_flag)
-            strcpy (short_si_names[num_si], "toa_nbr2");
-        else
-            strcpy (short_si_names[num_si], "sr_nbr2");
-        strcpy (long_si_names[num_si++], "normalized burn ratio 2");
+    /* Write grid-aligned tiles instead of the scene bands */
+    if (tile_grid != NULL)
+    {
+        tiles = open_tile_grid (tile_grid, tile_buffer, gmeta,
+            refl_input->nlines, refl_input->nsamps, refl_input->pixsize,
+            num_si, short_si_names, long_si_names);
+        if (tiles == NULL)
+        {
+            sprintf (errmsg, "Setting up the tile grid %s", tile_grid);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
     }
 
     /* Open the specified output files and create the metadata structure */
-    if (num_si > 0)
+    else if (num_si > 0 && sample == NULL)
     {
         si_output = open_output (&xml_metadata, refl_input, num_si,
-            short_si_names, long_si_names);
+            short_si_names, long_si_names, mmap_output,
+            (size_t) write_buffer * 1024 * 1024, s3);
         if (si_output == NULL)
         {   /* error message already printed */
             error_handler (true, FUNC_NAME, errmsg);
             exit (ERROR);
         }
+        si_output->io_limit = io_limit;
+
+        /* The anomaly bands aren't in the index scale */
+        if (anom_indx != -1)
+            set_anomaly_band_meta (&si_output->metadata.band[anom_indx],
+                false);
+        if (pctn_indx != -1)
+            set_anomaly_band_meta (&si_output->metadata.band[pctn_indx],
+                true);
+    }
+
+    /* Register the throughput metrics; the upload and fetch threads count
+       into their own shards */
+    if (metrics_file != NULL)
+    {
+        for (i = 0; i < NUM_SI; i++)
+        {
+            si = si_order[i];
+            if (si_indx[si] == -1)
+                continue;
+            sprintf (labels, "index=\"%s\"", si_short_name (si));
+            m_pixels[si] = add_metric (METRIC_COUNTER, "si_pixels_total",
+                "Pixels computed for each index.", labels, NULL, 0);
+            if (m_pixels[si] == NULL)
+                exit (ERROR);
+        }
+        m_read_bytes = add_metric (METRIC_COUNTER, "si_read_bytes_total",
+            "Bytes of the input bands read.", NULL, NULL, 0);
+        m_written_bytes = add_metric (METRIC_COUNTER,
+            "si_written_bytes_total", "Bytes of the output bands written.",
+            NULL, NULL, 0);
+        m_strip_seconds = add_metric (METRIC_HISTOGRAM, "si_strip_seconds",
+            "Time to read, compute, and write each strip.", NULL,
+            seconds_buckets, METRIC_SECONDS_NBUCKET);
+        m_lines_done = add_metric (METRIC_GAUGE, "si_lines_done",
+            "Lines of the scene processed.", NULL, NULL, 0);
+        m_lines_total = add_metric (METRIC_GAUGE, "si_lines_total",
+            "Lines in the scene.", NULL, NULL, 0);
+        if (m_read_bytes == NULL || m_written_bytes == NULL ||
+            m_strip_seconds == NULL || m_lines_done == NULL ||
+            m_lines_total == NULL)
+            exit (ERROR);
+        metric_set (m_lines_total, refl_input->nlines);
+
+        if (refl_input->http)
+        {
+            m_fetch_bytes = add_metric (METRIC_COUNTER,
+                "si_fetched_bytes_total", "Bytes of the remote bands "
+                "fetched.", NULL, NULL, 0);
+            if (m_fetch_bytes == NULL)
+                exit (ERROR);
+            for (ib = 0; ib < refl_input->nrefl_band; ib++)
+            {
+                if (refl_input->http_file[ib] != NULL)
+                    refl_input->http_file[ib]->fetch_bytes = m_fetch_bytes;
+            }
+        }
+
+        if (s3 != NULL)
+        {
+            s3->upload_bytes = add_metric (METRIC_COUNTER,
+                "si_uploaded_bytes_total", "Bytes of the parts uploaded.",
+                NULL, NULL, 0);
+            s3->upload_seconds = add_metric (METRIC_HISTOGRAM,
+                "si_upload_part_seconds", "Time to upload each part.", NULL,
+                seconds_buckets, METRIC_SECONDS_NBUCKET);
+            s3->queue_depth = add_metric (METRIC_GAUGE,
+                "si_upload_queue_depth", "Parts waiting to be uploaded.",
+                NULL, NULL, 0);
+            if (s3->upload_bytes == NULL || s3->upload_seconds == NULL ||
+                s3->queue_depth == NULL)
+                exit (ERROR);
+        }
+    }
+
+    /* Compute and publish the coarse previews of the indices */
+    if (progressive)
+    {
+        prof_stage (STAGE_PREVIEW);
+        for (si = 0; si < NUM_SI; si++)
+        {
+            if (si_indx[si] != -1)
+                prog_si[si_indx[si]] = si;
+        }
+
+        t0 = flight_now ();
+        prog = open_progressive (&xml_metadata, refl_input);
+        if (prog == NULL || make_progressive_levels (prog, refl_input,
+            num_index, prog_si, short_si_names, long_si_names, si_lut, s3,
+            verbose) != SUCCESS)
+        {
+            sprintf (errmsg, "Computing the previews.");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        flight_event (FLIGHT_PREVIEW, -1, -1, 0, t0);
     }
 
     /* Print the processing status if verbose */
@@ -360,6 +1115,7 @@ int main (int argc, char *argv[])
 
     /* Loop through the lines and samples in the reflectance product,
        computing the desired indices */
+    prof_stage (STAGE_STRIPS);
     nlines_proc = PROC_NLINES;
     k = 0;
     for (line = 0; line < refl_input->nlines; line += PROC_NLINES)
@@ -376,10 +1132,41 @@ int main (int argc, char *argv[])
             fflush (stdout);
         }
 
+        /* Wait for the reflectance writer to get through the strip */
+        if (follow)
+        {
+            t0 = flight_now ();
+            if (wait_input_refl_lines (refl_input, line, nlines_proc) !=
+                SUCCESS)
+            {
+                sprintf (errmsg, "Error waiting for %d lines starting at "
+                    "line %d", nlines_proc, line);
+                error_handler (true, FUNC_NAME, errmsg);
+                exit (ERROR);
+            }
+            flight_event (FLIGHT_WAIT, line, -1, 0, t0);
+        }
+
+        /* Fetch the strip of any remote bands in parallel */
+        strip_t0 = flight_now ();
+        strip_nbytes = (int64_t) nlines_proc * refl_input->nsamps *
+            sizeof (int16);
+        if (prefetch_input_refl_lines (refl_input, line, nlines_proc) !=
+            SUCCESS)
+        {
+            sprintf (errmsg, "Error fetching %d remote lines starting at "
+                "line %d", nlines_proc, line);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        if (refl_input->http)
+            flight_event (FLIGHT_FETCH, line, -1, 0, strip_t0);
+
         /* Read the current lines from the reflectance file for each of the
            reflectance bands */
         for (ib = 0; ib < refl_input->nrefl_band; ib++)
         {
+            t0 = flight_now ();
             if (get_input_refl_lines (refl_input, ib, line, nlines_proc) !=
                 SUCCESS)
             {
@@ -389,231 +1176,373 @@ int main (int argc, char *argv[])
                 error_handler (true, FUNC_NAME, errmsg);
                 exit (ERROR);
             }
+            flight_event (FLIGHT_READ, line, ib, dn_flag ? strip_nbytes / 2 :
+                strip_nbytes, t0);
+            metric_add (m_read_bytes, dn_flag ? strip_nbytes / 2 :
+                strip_nbytes);
         }  /* end for ib */
 
-        /* Compute the NDVI and write to output file
-           NDVI = (nir - red) / (nir + red) */
-        if (ndvi_flag)
+        /* Read the matching climatology lines */
+        t0 = flight_now ();
+        if (clim != NULL && get_anomaly_lines (clim, line, nlines_proc) !=
+            SUCCESS)
+        {
+            sprintf (errmsg, "Error reading %d climatology lines starting at "
+                "line %d", nlines_proc, line);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        if (clim != NULL)
+            flight_event (FLIGHT_CLIMATOLOGY, line, -1, 2 * strip_nbytes,
+                t0);
+
+        /* Read the matching labels */
+        t0 = flight_now ();
+        if (sample != NULL && get_sample_lines (sample, line, nlines_proc) !=
+            SUCCESS)
+        {
+            sprintf (errmsg, "Error reading %d label lines starting at line "
+                "%d", nlines_proc, line);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        if (sample != NULL)
+        {
+            flight_event (FLIGHT_READ, line, -1, strip_nbytes / 2, t0);
+            metric_add (m_read_bytes, strip_nbytes / 2);
+        }
+
+        /* Compute each of the requested indices and write them to the
+           output file.  See make_spectral_index.c for the formulas. */
+        for (si = 0; si < NUM_SI; si++)
         {
-            if (!strcmp (gmeta->instrument, "TM") ||
-                !strncmp (gmeta->instrument, "ETM", 3))
+            if (si_indx[si] == -1)
+                continue;
+
+            nsi_band = get_index_bands (refl_input, si, si_band);
+            for (ib = 0; ib < nsi_band; ib++)
+                si_in[ib] = refl_input->refl_buf[si_band[ib]];
+
+            /* Compute straight into the output file if it's mapped */
+            if (mmap_output)
             {
-                nir = refl_input->refl_buf[3];  /* b4 */
-                red = refl_input->refl_buf[2];  /* b3 */
+                spec_indx = get_output_lines (si_output, si_indx[si], line,
+                    nlines_proc);
+                if (spec_indx == NULL)
+                {
+                    sprintf (errmsg, "Mapping output %s data for line %d",
+                        si_upper_name (si), line);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    exit (ERROR);
+                }
             }
-            else if (!strcmp (gmeta->instrument, "OLI_TIRS") ||
-                     !strcmp (gmeta->instrument, "OLI"))
+            else
+                spec_indx = si_buf[si];
+
+            t0 = flight_now ();
+            if (prog != NULL)
+                compute_progressive_lines (prog, refl_input, si, si_lut[si],
+                    line, nlines_proc, spec_indx);
+            else if (si_lut[si] != NULL)
+                apply_index_lut (si_lut[si], refl_input->dn_buf[si_band[0]],
+                    refl_input->dn_buf[si_band[1]], nlines_proc,
+                    refl_input->nsamps, spec_indx);
+            else
+                compute_spectral_index (si, si_in,
+                    refl_input->refl_scale_fact, refl_input->refl_fill,
+                    refl_input->refl_saturate_val, nlines_proc,
+                    refl_input->nsamps, spec_indx);
+            flight_event (FLIGHT_COMPUTE, line, si_indx[si], 0, t0);
+            metric_add (m_pixels[si], (int64_t) nlines_proc *
+                refl_input->nsamps);
+
+            /* Compare the strip with the climatology before it's flushed */
+            if (si == anom_si)
             {
-                nir = refl_input->refl_buf[4];  /* b5 */
-                red = refl_input->refl_buf[3];  /* b4 */
+                t0 = flight_now ();
+                if (mmap_output)
+                {
+                    anom_out = get_output_lines (si_output, anom_indx, line,
+                        nlines_proc);
+                    if (pctn_indx != -1)
+                        pctn_out = get_output_lines (si_output, pctn_indx,
+                            line, nlines_proc);
+                    if (anom_out == NULL || (pctn_indx != -1 &&
+                        pctn_out == NULL))
+                    {
+                        sprintf (errmsg, "Mapping output anomaly data for "
+                            "line %d", line);
+                        error_handler (true, FUNC_NAME, errmsg);
+                        exit (ERROR);
+                    }
+                }
+                else
+                {
+                    anom_out = anom_buf;
+                    pctn_out = pctn_buf;
+                }
+
+                make_anomaly (clim, spec_indx, nlines_proc, anom_out,
+                    pctn_out);
+                if (put_output_line (si_output, anom_out, anom_indx, line,
+                    nlines_proc) != SUCCESS || (pctn_indx != -1 &&
+                    put_output_line (si_output, pctn_out, pctn_indx, line,
+                    nlines_proc) != SUCCESS))
+                {
+                    sprintf (errmsg, "Writing output anomaly data for line "
+                        "%d", line);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    exit (ERROR);
+                }
+                flight_event (FLIGHT_ANOMALY, line, anom_indx,
+                    (pctn_indx != -1 ? 2 : 1) * strip_nbytes, t0);
+                metric_add (m_written_bytes, (pctn_indx != -1 ? 2 : 1) *
+                    strip_nbytes);
             }
 
-            make_spectral_index (nir, red, refl_input->refl_fill,
-                refl_input->refl_saturate_val, nlines_proc,
-                refl_input->nsamps, ndvi);
-
-            if (put_output_line (si_output, ndvi, si_indx[SI_NDVI], line,
-                nlines_proc) != SUCCESS)
+            t0 = flight_now ();
+            if (si_output != NULL && put_output_line (si_output, spec_indx,
+                si_indx[si], line, nlines_proc) != SUCCESS)
             {
-                sprintf (errmsg, "Writing output NDVI data for line %d", line);
+                sprintf (errmsg, "Writing output %s data for line %d",
+                    si_upper_name (si), line);
                 error_handler (true, FUNC_NAME, errmsg);
                 exit (ERROR);
             }
-        }
-
-        /* Compute the EVI and write to output file
-           EVI = (nir - red) / (nir + C1 * red - C2 * blue + L) */
-        if (evi_flag)
-        {
-            if (!strcmp (gmeta->instrument, "TM") ||
-                !strncmp (gmeta->instrument, "ETM", 3))
-            {
-                nir = refl_input->refl_buf[3];  /* b4 */
-                red = refl_input->refl_buf[2];  /* b3 */
-                blue = refl_input->refl_buf[0]; /* b1 */
-            }
-            else if (!strcmp (gmeta->instrument, "OLI_TIRS") ||
-                     !strcmp (gmeta->instrument, "OLI"))
+            if (si_output != NULL)
             {
-                nir = refl_input->refl_buf[4];  /* b5 */
-                red = refl_input->refl_buf[3];  /* b4 */
-                blue = refl_input->refl_buf[1]; /* b2 */
+                flight_event (FLIGHT_WRITE, line, si_indx[si], strip_nbytes,
+                    t0);
+                metric_add (m_written_bytes, strip_nbytes);
             }
 
-            make_evi (nir, red, blue, refl_input->refl_scale_fact,
-                refl_input->refl_fill, refl_input->refl_saturate_val,
-                nlines_proc, refl_input->nsamps, evi);
+            /* Decimate the strip into the browse while it's in memory */
+            if (si == browse_si)
+                add_browse_lines (browse, spec_indx, line, nlines_proc,
+                    refl_input->nsamps);
 
-            if (put_output_line (si_output, evi, si_indx[SI_EVI], line,
-                nlines_proc) != SUCCESS)
-            {
-                sprintf (errmsg, "Writing output EVI data for line %d", line);
-                error_handler (true, FUNC_NAME, errmsg);
-                exit (ERROR);
-            }
+            /* Widen the footprint to the valid samples of the strip */
+            add_footprint_lines (fprint, spec_indx, line, nlines_proc);
         }
 
-        /* Compute the SAVI and write to output file
-           SAVI = ((nir - red) / (nir + red + L)) * (1 + L), where L is a
-           constant 0.5. */
-        if (savi_flag)
+        /* Resample the strip into the tiles it covers */
+        t0 = flight_now ();
+        if (tiles != NULL && add_tile_lines (tiles, tile_in, line,
+            nlines_proc, refl_input->nsamps) != SUCCESS)
         {
-            if (!strcmp (gmeta->instrument, "TM") ||
-                !strncmp (gmeta->instrument, "ETM", 3))
-            {
-                nir = refl_input->refl_buf[3];  /* b4 */
-                red = refl_input->refl_buf[2];  /* b3 */
-            }
-            else if (!strcmp (gmeta->instrument, "OLI_TIRS") ||
-                     !strcmp (gmeta->instrument, "OLI"))
-            {
-                nir = refl_input->refl_buf[4];  /* b5 */
-                red = refl_input->refl_buf[3];  /* b4 */
-            }
-
-            make_savi (nir, red, refl_input->refl_scale_fact,
-                refl_input->refl_fill, refl_input->refl_saturate_val,
-                nlines_proc, refl_input->nsamps, savi);
+            sprintf (errmsg, "Writing the tiles for line %d", line);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        if (tiles != NULL)
+        {
+            flight_event (FLIGHT_TILE, line, -1, num_si * strip_nbytes, t0);
+            metric_add (m_written_bytes, num_si * strip_nbytes);
+        }
 
-            if (put_output_line (si_output, savi, si_indx[SI_SAVI], line,
-                nlines_proc) != SUCCESS)
+        /* Interleave the bands and indices of the valid pixels */
+        if (feat != NULL)
+        {
+            t0 = flight_now ();
+            feat_nbytes = feat->nrows;
+            if (add_features_lines (feat, refl_input->refl_buf, tile_in,
+                line, nlines_proc) != SUCCESS)
             {
-                sprintf (errmsg, "Writing output SAVI data for line %d", line);
+                sprintf (errmsg, "Writing the feature vectors for line %d",
+                    line);
                 error_handler (true, FUNC_NAME, errmsg);
                 exit (ERROR);
             }
+            feat_nbytes = (feat->nrows - feat_nbytes) * feat->ncol *
+                (feat->float32 ? sizeof (float) : sizeof (int16));
+            flight_event (FLIGHT_WRITE, line, -1, feat_nbytes, t0);
+            metric_add (m_written_bytes, feat_nbytes);
         }
 
-        /* Compute the MSAVI (modified SAVI) and write to output file
-           MSAVI = (2 * nir + 1) - SQRT (SQR (2 * nir + 1) - (8 * (nir - red)))
-                    * L
-           where L is the soil brightness correction factor of 0.5*/
-        if (msavi_flag)
+        /* Offer the valid, labeled pixels to the reservoirs */
+        if (sample != NULL && add_sample_lines (sample, refl_input->refl_buf,
+            tile_in, line, nlines_proc) != SUCCESS)
         {
-            if (!strcmp (gmeta->instrument, "TM") ||
-                !strncmp (gmeta->instrument, "ETM", 3))
-            {
-                nir = refl_input->refl_buf[3];  /* b4 */
-                red = refl_input->refl_buf[2];  /* b3 */
-            }
-            else if (!strcmp (gmeta->instrument, "OLI_TIRS") ||
-                     !strcmp (gmeta->instrument, "OLI"))
-            {
-                nir = refl_input->refl_buf[4];  /* b5 */
-                red = refl_input->refl_buf[3];  /* b4 */
-            }
-
-            make_modified_savi (nir, red, refl_input->refl_scale_fact,
-                refl_input->refl_fill, refl_input->refl_saturate_val,
-                nlines_proc, refl_input->nsamps, msavi);
+            sprintf (errmsg, "Drawing the sample for line %d", line);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
 
-            if (put_output_line (si_output, msavi, si_indx[SI_MSAVI], line,
-                nlines_proc) != SUCCESS)
-            {
-                sprintf (errmsg, "Writing output MSAVI data for line %d", line);
-                error_handler (true, FUNC_NAME, errmsg);
-                exit (ERROR);
-            }
+        /* Done with the current reflectance lines */
+        if (release_input_refl_lines (refl_input) != SUCCESS)
+        {
+            sprintf (errmsg, "Releasing the reflectance lines starting at "
+                "line %d", line);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
         }
+        flight_event (FLIGHT_STRIP, line, -1, 0, strip_t0);
 
-        /* Compute the NDMI and write to output file
-           NDMI = (nir - mir) / (nir + mir) */
-        if (ndmi_flag)
+        /* Rewrite the metrics file at most every METRIC_INTERVAL */
+        metric_observe (m_strip_seconds, (flight_now () - strip_t0) *
+            1.0e-9);
+        metric_set (m_lines_done, line + nlines_proc);
+        flush_metrics_file (false);
+    }  /* end for line */
+    prof_stage (STAGE_FINISH);
+
+    /* Print the processing status if verbose */
+    if (verbose)
+        printf ("  Spectral indices -- %% complete: 100%%\n");
+
+    /* Report the bytes transferred for the remote bands */
+    if (verbose && refl_input->http)
+    {
+        for (ib = 0; ib < refl_input->nrefl_band; ib++)
         {
-            if (!strcmp (gmeta->instrument, "TM") ||
-                !strncmp (gmeta->instrument, "ETM", 3))
-            {
-                nir = refl_input->refl_buf[3];  /* b4 */
-                mir = refl_input->refl_buf[4];  /* b5 */
-            }
-            else if (!strcmp (gmeta->instrument, "OLI_TIRS") ||
-                     !strcmp (gmeta->instrument, "OLI"))
-            {
-                nir = refl_input->refl_buf[4];  /* b5 */
-                mir = refl_input->refl_buf[5];  /* b6 */
-            }
+            if (refl_input->http_file[ib] != NULL)
+                http_bytes += refl_input->http_file[ib]->bytes_fetched;
+        }
+        printf ("  Remote band bytes fetched: %lld\n", http_bytes);
+    }
+
+    /* Close the reflectance product and the climatology */
+    close_input (refl_input);
+    free_input (refl_input);
+    close_anomaly (clim);
+    close_progressive (prog);
 
-            make_spectral_index (nir, mir, refl_input->refl_fill,
-                refl_input->refl_saturate_val, nlines_proc,
-                refl_input->nsamps, ndmi);
+    /* Colormap and write the browse image */
+    if (browse != NULL)
+    {
+        if (close_browse (browse) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the browse image.");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        if (verbose)
+            printf ("  Browse image written to %s\n", browse_file);
 
-            if (put_output_line (si_output, ndmi, si_indx[SI_NDMI], line,
-                nlines_proc) != SUCCESS)
+        if (s3 != NULL)
+        {
+            if (s3_put_file (s3, browse_file, browse_file) != SUCCESS)
             {
-                sprintf (errmsg, "Writing output NDMI data for line %d", line);
+                sprintf (errmsg, "Uploading the browse image.");
                 error_handler (true, FUNC_NAME, errmsg);
                 exit (ERROR);
             }
+            unlink (browse_file);
         }
+    }
 
-        /* Compute the NBR and write to output file
-           NBR = (nir - swir) / (nir + swir) */
-        if (nbr_flag)
+    /* Write the footprint of the valid data, for catalog ingest */
+    if (fprint != NULL)
+    {
+        if (write_footprint (fprint, footprint_file) != SUCCESS)
         {
-            if (!strcmp (gmeta->instrument, "TM") ||
-                !strncmp (gmeta->instrument, "ETM", 3))
-            {
-                nir = refl_input->refl_buf[3];  /* b4 */
-                swir = refl_input->refl_buf[5]; /* b7 */
-            }
-            else if (!strcmp (gmeta->instrument, "OLI_TIRS") ||
-                     !strcmp (gmeta->instrument, "OLI"))
-            {
-                nir = refl_input->refl_buf[4];  /* b5 */
-                swir = refl_input->refl_buf[6]; /* b7 */
-            }
-
-            make_spectral_index (nir, swir, refl_input->refl_fill,
-                refl_input->refl_saturate_val, nlines_proc,
-                refl_input->nsamps, nbr);
+            sprintf (errmsg, "Writing the footprint.");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        close_footprint (fprint);
+        if (verbose)
+            printf ("  Footprint written to %s\n", footprint_file);
 
-            if (put_output_line (si_output, nbr, si_indx[SI_NBR], line,
-                nlines_proc) != SUCCESS)
+        if (s3 != NULL)
+        {
+            if (s3_put_file (s3, footprint_file, footprint_file) != SUCCESS)
             {
-                sprintf (errmsg, "Writing output NBR data for line %d", line);
+                sprintf (errmsg, "Uploading the footprint.");
                 error_handler (true, FUNC_NAME, errmsg);
                 exit (ERROR);
             }
+            unlink (footprint_file);
         }
+    }
 
-        /* Compute the NBR2 and write to output file
-           NBR2 = (mir - swir) / (mir + swir) */
-        if (nbr2_flag)
+    /* Write the headers of the feature vectors */
+    if (feat != NULL)
+    {
+        if (close_features (feat) != SUCCESS)
         {
-            if (!strcmp (gmeta->instrument, "TM") ||
-                !strncmp (gmeta->instrument, "ETM", 3))
-            {
-                mir = refl_input->refl_buf[4];  /* b5 */
-                swir = refl_input->refl_buf[5]; /* b7 */
-            }
-            else if (!strcmp (gmeta->instrument, "OLI_TIRS") ||
-                     !strcmp (gmeta->instrument, "OLI"))
-            {
-                mir = refl_input->refl_buf[5];  /* b6 */
-                swir = refl_input->refl_buf[6]; /* b7 */
-            }
-
-            make_spectral_index (mir, swir, refl_input->refl_fill,
-                refl_input->refl_saturate_val, nlines_proc,
-                refl_input->nsamps, nbr2);
+            sprintf (errmsg, "Closing the feature vectors.");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        if (verbose)
+            printf ("  Feature vectors written to %s: %lld valid pixels\n",
+                feat->img_file, feat->nrows);
 
-            if (put_output_line (si_output, nbr2, si_indx[SI_NBR2], line,
-                nlines_proc) != SUCCESS)
+        if (s3 != NULL)
+        {
+            if (s3_put_file (s3, feat->img_file, feat->img_file) != SUCCESS ||
+                s3_put_file (s3, feat->hdr_file, feat->hdr_file) != SUCCESS ||
+                s3_put_file (s3, feat->pix_file, feat->pix_file) != SUCCESS ||
+                s3_put_file (s3, feat->pix_hdr_file, feat->pix_hdr_file) !=
+                SUCCESS)
             {
-                sprintf (errmsg, "Writing output NBR2 data for line %d", line);
+                sprintf (errmsg, "Uploading the feature vectors.");
                 error_handler (true, FUNC_NAME, errmsg);
                 exit (ERROR);
             }
+            unlink (feat->img_file);
+            unlink (feat->hdr_file);
+            unlink (feat->pix_file);
+            unlink (feat->pix_hdr_file);
         }
-    }  /* end for line */
+        free_features (feat);
+    }
 
-    /* Print the processing status if verbose */
-    if (verbose)
-        printf ("  Spectral indices -- %% complete: 100%%\n");
+    /* Write the pixels drawn from each class */
+    if (sample != NULL)
+    {
+        if (write_sample (sample, sample_file) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the sample.");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        if (verbose)
+        {
+            for (i = 1; i < SAMPLE_NCLASS; i++)
+            {
+                if (sample->cls[i].seen > 0)
+                    printf ("  Class %d: drew %d of %lld valid pixels\n", i,
+                        sample->cls[i].n, sample->cls[i].seen);
+            }
+            printf ("  Sample written to %s\n", sample_file);
+        }
+        close_sample (sample);
+    }
 
-    /* Close the reflectance product */
-    close_input (refl_input);
-    free_input (refl_input);
+    /* The tiles carry their own headers and metadata, and a sample has no
+       index bands; the scene XML is left as is */
+    if (tiles != NULL || sample != NULL)
+    {
+        if (verbose && tiles != NULL)
+            printf ("  Tiles written: %d (%d partial tiles spilled)\n",
+                tiles->ntile_written, tiles->nspill);
+        if (tiles != NULL && close_tile_grid (tiles) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the remaining tiles.");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        free_metadata (&xml_metadata);
+        close_rate_limit (io_limit);
+        free (xml_infile);
+        free (shm_name);
+        free (browse_name);
+        free (io_node_bucket);
+        free (tile_grid);
+        free (sample_labels);
+        for (i = 0; i < NUM_SI; i++)
+        {
+            free (si_buf[i]);
+            free (si_lut[i]);
+        }
+        if (profile)
+            prof_report ();
+        flight_close ();
+        printf ("Spectral indices processing complete!\n");
+        exit (SUCCESS);
+    }
 
     /* Write the ENVI header for spectral indices files */
     for (ib = 0; ib < si_output->nband; ib++)
@@ -637,6 +1566,18 @@ int main (int argc, char *argv[])
             error_handler (true, FUNC_NAME, errmsg);
             exit (ERROR);
         }
+
+        /* The header goes alongside the uploaded band */
+        if (s3 != NULL)
+        {
+            if (s3_put_file (s3, envi_file, envi_file) != SUCCESS)
+            {
+                sprintf (errmsg, "Uploading ENVI header file.");
+                error_handler (true, FUNC_NAME, errmsg);
+                exit (ERROR);
+            }
+            unlink (envi_file);
+        }
     }
   
     /* Append the spectral index bands to the XML file */
@@ -647,25 +1588,79 @@ int main (int argc, char *argv[])
         error_handler (true, FUNC_NAME, errmsg);
         exit (ERROR);
     }
-  
+
     /* Free the metadata structure */
     free_metadata (&xml_metadata);
 
     /* Close the output spectral indices products */
-    close_output (si_output);
+    if (close_output (si_output) != SUCCESS)
+    {
+        sprintf (errmsg, "Closing the spectral index products.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
     free_output (si_output);
 
+    /* Upload the updated XML file next to the products.  It marks the
+       products as complete, so it goes up only once the band uploads have
+       been completed by close_output. */
+    if (s3 != NULL)
+    {
+        cptr = strrchr (xml_infile, '/');
+        if (s3_put_file (s3, xml_infile, cptr != NULL ? cptr + 1 : xml_infile)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Uploading the XML file.");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+    }
+
+    /* Report and release the upload */
+    if (s3 != NULL)
+    {
+        if (verbose)
+            printf ("  Bytes uploaded to %s: %lld\n", s3_output,
+                s3->bytes_uploaded);
+        close_s3_upload (s3);
+    }
+
+    /* Report and release the I/O rate limiter */
+    if (verbose && io_limit != NULL)
+        printf ("  Time throttled by the I/O rate limit: %.2f seconds\n",
+            io_limit->slept);
+    close_rate_limit (io_limit);
+
     /* Free the filename pointers */
     free (xml_infile);
+    free (shm_name);
+    free (browse_name);
+    free (io_node_bucket);
+    free (s3_output);
+    free (tile_grid);
+    free (anomaly_name);
+    free (clim_mean);
+    free (clim_std);
+    free (flight_file);
+    free (metrics_file);
+    free (features);
+    free (sample_labels);
+
+    /* Free the index buffers */
+    for (i = 0; i < NUM_SI; i++)
+    {
+        free (si_buf[i]);
+        free (si_lut[i]);
+    }
+    free (anom_buf);
+    free (pctn_buf);
+
+    /* Report the memory and faults of each stage */
+    if (profile)
+        prof_report ();
 
-    /* Free the mask pointers */
-    free (ndvi);
-    free (ndmi);
-    free (nbr);
-    free (nbr2);
-    free (savi);
-    free (msavi);
-    free (evi);
+    /* Mark the run as complete in the flight recorder */
+    flight_close ();
 
     /* Indicate successful completion of processing */
     printf ("Spectral indices processing complete!\n");
@@ -688,19 +1683,42 @@ void usage ()
     printf ("spectral_indices %s produces the desired spectral index products "
             "for the input surface reflectance or TOA reflectance bands. The "
             "options include NDVI, EVI, SAVI, MSAVI, NDMI (also known as NDWI "
-            "or NDII), NBR, and NBR2. The user may specify one, some, or all "
-            "of the supported indices for output.\n\n", INDEX_VERSION);
+            "or NDII), NBR, NBR2, NDRE, PRI, and CCI. The user may specify "
+            "one, some, or all of the supported indices for output.\n\n",
+            INDEX_VERSION);
     printf ("usage: spectral_indices "
-            "--xml=input_xml_filename [--toa] "
+            "--xml=input_xml_filename [--shm=ring_name] [--toa] [--dn] "
             "[--ndvi] [--evi] [--savi] [--msavi] [--ndmi] [--nbr] [--nbr2] "
-            "[--verbose]\n");
+            "[--ndre] [--pri] [--cci] "
+            "[--virtual] [--browse=index] [--browse_factor=n] "
+            "[--prescan=fraction] [--prescan_qa] [--mmap_output] "
+            "[--write_buffer=MB] [--io_rate_limit=MB/s] "
+            "[--io_node_limit=MB/s] [--io_node_bucket=name] "
+            "[--http_cache=MB] [--s3_output=url] [--s3_part_size=MB] "
+            "[--s3_threads=n] [--tile_grid=x,y,pixel_size,tile_size] "
+            "[--tile_buffer=MB] [--anomaly=index --clim_mean=file "
+            "--clim_std=file [--pct_normal]] [--progressive] [--profile] "
+            "[--flight_file=file] [--metrics_file=file] [--footprint] "
+            "[--features=int16|float32] "
+            "[--sample=label_file [--sample_size=n]] "
+            "[--plan [--calibration=file]] "
+            "[--follow [--follow_timeout=seconds]] [--verbose]\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML file to be processed\n");
 
     printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -shm: name of the POSIX shared-memory ring holding the "
+            "reflectance strips from an upstream producer.  The bands are "
+            "read from the ring instead of the band files listed in the XML "
+            "file.\n");
     printf ("    -toa: process the TOA reflectance bands instead of the "
             "surface reflectance bands.\n");
+    printf ("    -dn: process the 8-bit Level-1 DN bands (TM and ETM+ b1-b5 "
+            "and b7) instead of the reflectance bands, for quick screening.  "
+            "The DN values are scaled to 0.0-1.0 for SAVI, MSAVI, and EVI, "
+            "and the products are named dn_{index}.  Can't be used with "
+            "--toa, --shm, or --virtual.\n");
     printf ("    -ndvi: process the normalized difference vegetation index "
             "(NDVI) product\n");
     printf ("    -evi: process the enhanced vegetation index (EVI) product\n");
@@ -713,6 +1731,164 @@ void usage ()
             "or NDII.\n");
     printf ("    -nbr: process the normalized burn ratio (NBR) product\n");
     printf ("    -nbr2: process the normalized burn ratio 2 (NBR2) product\n");
+    printf ("    -ndre: process the normalized difference red edge index "
+            "(NDRE) product.  Needs a red edge band near 705 nm.\n");
+    printf ("    -pri: process the photochemical reflectance index (PRI) "
+            "product.  Needs narrow bands near 531 and 570 nm.\n");
+    printf ("    -cci: process the chlorophyll/carotenoid index (CCI) "
+            "product.  Needs a narrow band near 531 nm.\n");
+    printf ("    -virtual: write a small virtual index descriptor "
+            "({scene_name}_{index}.vidx) for each index instead of the index "
+            "raster.  The index values are computed on read by the "
+            "lib_si_virtual reader library.  The virtual bands are not "
+            "appended to the XML file.  Not available with remote (http://) "
+            "bands.\n");
+    printf ("    -browse: build a colormapped quick-look PNG "
+            "({scene_name}_{index}_browse.png) of the specified index (ndvi, "
+            "evi, savi, msavi, ndmi, nbr, nbr2, ndre, pri, or cci) while the "
+            "index is computed.  The index must also be requested.\n");
+    printf ("    -browse_factor: decimation factor for the browse image "
+            "(default is %d)\n", BROWSE_FACTOR);
+    printf ("    -prescan: read a sparse sample of %d lines before "
+            "processing and estimate the fraction of valid (non-fill) "
+            "pixels.  If the estimate is below the specified fraction "
+            "(0.0-1.0), no products are written and the application exits "
+            "with status %d.\n", PRESCAN_NLINES, PRESCAN_REJECT);
+    printf ("    -prescan_qa: use the pixel_qa band to estimate the fraction "
+            "of valid, clear (or water) pixels for the pre-scan instead.\n");
+    printf ("    -mmap_output: preallocate each index band file to its full "
+            "size, memory map it, and compute the index directly into the "
+            "mapping instead of writing each strip through stdio.\n");
+    printf ("    -write_buffer: preallocate each index band file and collect "
+            "the strips for each band in a write-combining buffer of this "
+            "many megabytes (rounded up to the filesystem block or stripe "
+            "size), so each band is written in large sequential, aligned "
+            "writes.  Useful on HDD-backed and parallel filesystems.\n");
+    printf ("    -io_rate_limit: limit the reflectance reads and index writes "
+            "of this process to this many MB/s (token bucket, bursts of up "
+            "to %g second)\n", IO_BURST_SECS);
+    printf ("    -io_node_limit: limit the combined reads and writes of all "
+            "spectral_indices processes on the node which use the same "
+            "bucket to this many MB/s.  All jobs on a node should use the "
+            "same limit.\n");
+    printf ("    -io_node_bucket: name of the POSIX shared-memory bucket for "
+            "the node-wide limit (default is %s)\n", IO_NODE_BUCKET);
+    printf ("    -http_cache: memory budget in megabytes for the block caches "
+            "of reflectance bands whose file names in the XML file are "
+            "http:// URLs.  Only the byte ranges of the strips being "
+            "processed are fetched, with the bands fetched in parallel and "
+            "the next strip read ahead.  Each band always gets room for two "
+            "strips.  (default is %d)\n", HTTP_CACHE_MB);
+    printf ("    -s3_output: stream the index bands to an S3-compatible "
+            "object store (http://host[:port]/bucket[/prefix]) with multipart "
+            "uploads as they are computed, instead of writing them locally.  "
+            "The ENVI headers and browse image are uploaded and removed "
+            "locally, and the updated XML file is uploaded.  Credentials are "
+            "taken from AWS_ACCESS_KEY_ID, AWS_SECRET_ACCESS_KEY, and "
+            "AWS_SESSION_TOKEN and the region from AWS_REGION (default is "
+            "%s); without credentials the requests are not signed.\n",
+            S3_DEFAULT_REGION);
+    printf ("    -s3_part_size: size of each upload part in megabytes, at "
+            "least %d (default is %d)\n", S3_MIN_PART_MB, S3_PART_MB);
+    printf ("    -s3_threads: number of parts uploaded in parallel (default "
+            "is %d)\n", S3_THREADS);
+    printf ("    -tile_grid: write each index as tiles of a fixed grid "
+            "instead of the scene band files.  The grid is given by the "
+            "projection x,y of its upper left origin, its pixel size, and the "
+            "tile size in pixels, and must be in the scene's projection.  "
+            "Each strip is resampled (nearest neighbor) into the tiles as it "
+            "is computed.  Tiles are written as "
+            "{scene_name}_{index}_hHHHvVVV.img with an ENVI header, plus a "
+            "{scene_name}_hHHHvVVV%s metadata file; tiles with no valid "
+            "pixels are skipped.  The XML file is not updated.\n", TILE_EXT);
+    printf ("    -tile_buffer: memory budget in megabytes for the partially "
+            "filled tiles.  Past it, partial tiles are written out and "
+            "completed later.  (default is %d)\n", TILE_BUFFER_MB);
+    printf ("    -anomaly: compare the specified index (which must also be "
+            "requested) with a per-pixel climatology and write its "
+            "standardized anomaly, (index - mean) / std, as "
+            "{scene_name}_{index}_anom.img in thousandths of a standard "
+            "deviation.  Can't be used with --virtual or --tile_grid.\n");
+    printf ("    -clim_mean: climatology mean of the index, a raw int16 "
+            "raster aligned with the scene in the scale of the index "
+            "products (fill is %d)\n", FILL_VALUE);
+    printf ("    -clim_std: climatology standard deviation of the index, in "
+            "the same form as the mean\n");
+    printf ("    -pct_normal: also write the percent of normal, 100 * index "
+            "/ mean, as {scene_name}_{index}_pctn.img in tenths of a "
+            "percent\n");
+    printf ("    -progressive: before the full-resolution pass, compute and "
+            "publish previews of the indices from every 16th and then every "
+            "4th line and sample, as {scene_name}_{index}_p16.img and "
+            "_p4.img with ENVI headers.  Each preview is renamed into place "
+            "once complete so viewers can poll for it, and pixels computed "
+            "for one level are reused by the next.  The previews are not "
+            "appended to the XML file.  Can't be used with --shm or "
+            "--virtual.\n");
+    printf ("    -profile: report the wall time, peak and current RSS, "
+            "minor and major page faults, and bytes allocated by each stage "
+            "of the run, and the planned versus actual size of each of the "
+            "large buffers\n");
+    printf ("    -flight_file: keep the flight recorder of the last %d "
+            "pipeline events (strip, stage, duration, bytes) in a shared "
+            "mapping of this file, so it survives the process however it "
+            "dies.  The last %d events are always dumped to stderr on a fatal "
+            "error, SIGTERM, SIGINT, SIGSEGV, SIGBUS, or SIGABRT; the ring "
+            "is kept in memory only if no file is given.\n", FLIGHT_NEVENT,
+            FLIGHT_NDUMP);
+    printf ("    -metrics_file: write counters and histograms of the pixels "
+            "computed for each index, bytes read, written, fetched, and "
+            "uploaded, strip and part upload times, the upload queue depth, "
+            "and the job duration and exit status to this file in the "
+            "Prometheus text format (i.e. for the node exporter textfile "
+            "collector).  The file is rewritten atomically at most every "
+            "%g seconds and when the run exits.\n", METRIC_INTERVAL);
+    printf ("    -footprint: track the first and last valid sample of "
+            "each line while the strips are computed, and write the "
+            "simplified outline and bounding box of the valid data, in the "
+            "projection coordinates of the scene, as a GeoJSON feature "
+            "({scene_name}_footprint.geojson).  Catalogs can then ingest the "
+            "scene without reading any pixels.  Can't be used with "
+            "--virtual.\n");
+    printf ("    -features: also write the feature vector of each valid "
+            "pixel (the bands read followed by the indices, in output "
+            "order) to {scene_name}_features.img, pixel interleaved, as "
+            "scaled int16 or unscaled float32 values, with the line and "
+            "sample of each vector in {scene_name}_features_pix.img.  Pixels "
+            "with fill in any band or index are left out.  The vectors are "
+            "gathered from the strips already in memory, so training data "
+            "comes out of the same pass.  Can't be used with --mmap_output "
+            "or --virtual.\n");
+    printf ("    -sample: draw a stratified random sample of the valid "
+            "pixels by the classes of this label raster (raw uint8, aligned "
+            "with the scene; class 0 is unlabeled), read alongside the "
+            "strips.  Each class keeps a reservoir of the line, sample, "
+            "band, and index values of its pixels, and the samples are "
+            "written to {scene_name}_samples.csv at the end.  The index "
+            "bands aren't written and the XML file isn't updated.  Can't be "
+            "used with --virtual, --mmap_output, --write_buffer, "
+            "--s3_output, --tile_grid, --anomaly, or --progressive.\n");
+    printf ("    -sample_size: number of pixels drawn from each class "
+            "(default is %d)\n", SAMPLE_SIZE);
+    printf ("    -plan: parse the XML file and the options and print the "
+            "plan of the run as JSON on stdout, without reading any pixels "
+            "or writing any products: the band files to be read, the bytes "
+            "read and written, the buffer memory, and the strips.  Can't be "
+            "used with --shm.\n");
+    printf ("    -calibration: with --plan, estimate the wall time from this "
+            "calibration profile, as written by si_io_bench "
+            "--calibration on the node\n");
+    printf ("    -follow: process the band files while they're still being "
+            "written.  Before each strip is read, wait (with inotify, or by "
+            "polling the file sizes every %d ms) until every band needed "
+            "holds the strip's lines, then compute and write it, so the "
+            "indices trail the reflectance writer by one strip.  The bands "
+            "must be written in place and in line order, not preallocated "
+            "or renamed into place.  Can't be used with --shm, --virtual, "
+            "--prescan, --progressive, --plan, or remote bands.\n",
+            FOLLOW_POLL_MS);
+    printf ("    -follow_timeout: give up if the band files don't grow for "
+            "this many seconds (default is %g)\n", FOLLOW_TIMEOUT);
     printf ("    -verbose: should intermediate messages be printed? (default "
             "is false)\n");
     printf ("\nExample: spectral_indices "
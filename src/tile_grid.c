@@ -0,0 +1,762 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <unistd.h>
+#include "si.h"
+#include "tile_grid.h"
+
+/******************************************************************************
+MODULE:  floor_div
+
+PURPOSE:  Divides, rounding toward negative infinity, so grid positions left
+of or above the origin fall in negative tiles.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+n/a        Quotient
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static int floor_div
+(
+    int a,                   /* I: dividend */
+    int b                    /* I: divisor (positive) */
+)
+{
+    return (a >= 0 ? a / b : -((-a + b - 1) / b));
+}
+
+
+/******************************************************************************
+MODULE:  open_tile_grid
+
+PURPOSE:  Sets up writing the indices as grid-aligned tiles, including the
+tables of the scene line and sample under each grid line and column the
+scene covers.
+
+RETURN VALUE:
+Type = Tile_grid_t*
+Value      Description
+-----      -----------
+NULL       Error in the grid or allocating the tables
+non-NULL   Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Grid pixels take the scene pixel containing the pixel center (nearest
+     neighbor).  Grid lines and columns whose centers fall outside the scene
+     are not covered, and the parts of the edge tiles outside the scene are
+     fill.
+  2. The grid must be in the scene's projection.
+******************************************************************************/
+Tile_grid_t *open_tile_grid
+(
+    char *grid_spec,         /* I: origin_x,origin_y,pixel_size,tile_size */
+    int buffer_mb,           /* I: memory budget for the partial tiles */
+    Espa_global_meta_t *gmeta, /* I: scene global metadata */
+    int nlines,              /* I: number of scene lines */
+    int nsamps,              /* I: number of scene samples */
+    float pixsize[2],        /* I: scene pixel size x,y */
+    int nband,               /* I: number of index bands */
+    char band_names[][STR_SIZE], /* I: index band names */
+    char long_names[][STR_SIZE]  /* I: index band long names */
+)
+{
+    char FUNC_NAME[] = "open_tile_grid";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int ib;                   /* looping variable for bands */
+    int g;                    /* looping variable for grid lines/columns */
+    int first, last;          /* grid lines/columns searched */
+    int src;                  /* scene line or sample */
+    double ul[2];             /* outer upper left corner of the scene */
+    size_t tile_bytes;        /* memory for one tile of all the bands */
+    Tile_grid_t *this = NULL; /* tile grid state to be returned */
+
+    this = calloc (1, sizeof (Tile_grid_t));
+    if (this == NULL)
+    {
+        sprintf (errmsg, "Allocating the tile grid structure");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    if (sscanf (grid_spec, "%lf,%lf,%lf,%d", &this->origin[0],
+        &this->origin[1], &this->pixsize, &this->tile_size) != 4 ||
+        this->pixsize <= 0.0 || this->tile_size < 1)
+    {
+        free (this);
+        sprintf (errmsg, "Invalid tile grid %s; expected "
+            "origin_x,origin_y,pixel_size,tile_size", grid_spec);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    if (strlen (gmeta->product_id) > TILE_ID_MAX)
+    {
+        free (this);
+        sprintf (errmsg, "Product ID is too long for the tile file names");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    this->nband = nband;
+    for (ib = 0; ib < nband; ib++)
+    {
+        if (strlen (band_names[ib]) > TILE_BAND_MAX)
+        {
+            free (this);
+            sprintf (errmsg, "Band name is too long for the tile file names");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+        strcpy (this->band_name[ib], band_names[ib]);
+        strcpy (this->long_name[ib], long_names[ib]);
+    }
+    snprintf (this->product_id, sizeof (this->product_id), "%s",
+        gmeta->product_id);
+    this->gmeta = *gmeta;
+    this->scene_nlines = nlines;
+
+    /* Outer corner of the scene */
+    ul[0] = gmeta->proj_info.ul_corner[0];
+    ul[1] = gmeta->proj_info.ul_corner[1];
+    if (!strcmp (gmeta->proj_info.grid_origin, "CENTER"))
+    {
+        ul[0] -= 0.5 * pixsize[0];
+        ul[1] += 0.5 * pixsize[1];
+    }
+
+    /* Scene line under each grid line the scene covers */
+    first = (int) floor ((this->origin[1] - ul[1]) / this->pixsize) - 1;
+    last = (int) ceil ((this->origin[1] - (ul[1] - nlines * pixsize[1])) /
+        this->pixsize) + 1;
+    this->row_src = malloc ((last - first + 1) * sizeof (int));
+    this->ngl = 0;
+    for (g = first; this->row_src != NULL && g <= last; g++)
+    {
+        src = (int) floor ((ul[1] - (this->origin[1] - (g + 0.5) *
+            this->pixsize)) / pixsize[1]);
+        if (src < 0 || src >= nlines)
+            continue;
+        if (this->ngl == 0)
+            this->gl0 = g;
+        this->row_src[this->ngl++] = src;
+    }
+
+    /* Scene sample under each grid column the scene covers */
+    first = (int) floor ((ul[0] - this->origin[0]) / this->pixsize) - 1;
+    last = (int) ceil ((ul[0] + nsamps * pixsize[0] - this->origin[0]) /
+        this->pixsize) + 1;
+    this->col_src = malloc ((last - first + 1) * sizeof (int));
+    this->ngc = 0;
+    for (g = first; this->col_src != NULL && g <= last; g++)
+    {
+        src = (int) floor ((this->origin[0] + (g + 0.5) * this->pixsize -
+            ul[0]) / pixsize[0]);
+        if (src < 0 || src >= nsamps)
+            continue;
+        if (this->ngc == 0)
+            this->gc0 = g;
+        this->col_src[this->ngc++] = src;
+    }
+
+    if (this->row_src == NULL || this->col_src == NULL || this->ngl == 0 ||
+        this->ngc == 0)
+    {
+        close_tile_grid (this);
+        sprintf (errmsg, "Setting up the tile grid coordinate tables");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    this->h0 = floor_div (this->gc0, this->tile_size);
+    this->ntile_cols = floor_div (this->gc0 + this->ngc - 1,
+        this->tile_size) - this->h0 + 1;
+
+    /* Number of partial tiles which fit in the budget */
+    tile_bytes = (size_t) nband * this->tile_size * this->tile_size *
+        sizeof (int16);
+    this->max_tile = (int) ((size_t) buffer_mb * 1024 * 1024 / tile_bytes);
+    if (this->max_tile < 1)
+    {
+        close_tile_grid (this);
+        sprintf (errmsg, "The tile buffer budget of %d MB doesn't hold one "
+            "tile of %zu bytes", buffer_mb, tile_bytes);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    return (this);
+}
+
+
+/******************************************************************************
+MODULE:  tile_file_name
+
+PURPOSE:  Forms the file name of a tile band or metadata file.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. open_tile_grid checks the product ID and band names against
+     TILE_ID_MAX and TILE_BAND_MAX, so the bounds here never cut them.
+******************************************************************************/
+static void tile_file_name
+(
+    Tile_grid_t *this,       /* I: tile grid state */
+    Grid_tile_t *tile,       /* I: tile */
+    int iband,               /* I: index band; -1 for the metadata file */
+    char *ext,               /* I: file extension */
+    char *file_name          /* O: file name (STR_SIZE) */
+)
+{
+    if (iband < 0)
+        snprintf (file_name, STR_SIZE, "%.*s_h%03dv%03d%s", TILE_ID_MAX,
+            this->product_id, tile->h, tile->v, ext);
+    else
+        snprintf (file_name, STR_SIZE, "%.*s_%.*s_h%03dv%03d%s", TILE_ID_MAX,
+            this->product_id, TILE_BAND_MAX, this->band_name[iband], tile->h,
+            tile->v, ext);
+}
+
+
+/******************************************************************************
+MODULE:  write_tile_lines
+
+PURPOSE:  Writes the lines held in a tile's buffers to its band files and
+frees the buffers.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error writing the tile band files
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The lines go at their place in the file, so a tile spilled part way
+     through is completed by later writes of the remaining lines.
+******************************************************************************/
+static int write_tile_lines
+(
+    Tile_grid_t *this,       /* I/O: tile grid state */
+    Grid_tile_t *tile        /* I/O: tile to write */
+)
+{
+    char FUNC_NAME[] = "write_tile_lines";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char file_name[STR_SIZE]; /* tile band file */
+    int ib;                   /* looping variable for bands */
+    int fd;                   /* tile band file descriptor */
+    int status = SUCCESS;     /* return status */
+    size_t nbytes;            /* number of bytes to write */
+    off_t offset;             /* offset of the first line in the file */
+    ssize_t n;                /* number of bytes written */
+
+    nbytes = (size_t) (tile->l1 - tile->l0) * this->tile_size *
+        sizeof (int16);
+    offset = (off_t) tile->l0 * this->tile_size * sizeof (int16);
+    for (ib = 0; ib < this->nband; ib++)
+    {
+        tile_file_name (this, tile, ib, ".img", file_name);
+        fd = open (file_name, O_WRONLY | O_CREAT | (tile->written ? 0 :
+            O_TRUNC), 0644);
+        if (fd < 0)
+        {
+            sprintf (errmsg, "Opening tile file %.900s: %s", file_name,
+                strerror (errno));
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            continue;
+        }
+        n = pwrite (fd, tile->buf[ib] + (long) tile->l0 * this->tile_size,
+            nbytes, offset);
+        if (n < 0 || (size_t) n != nbytes)
+        {
+            sprintf (errmsg, "Writing tile file %.900s", file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        close (fd);
+        prof_free (PBUF_TILE, tile->buf[ib], (size_t) this->tile_size *
+            this->tile_size * sizeof (int16));
+        tile->buf[ib] = NULL;
+    }
+    tile->written = true;
+    tile->l0 = tile->l1;
+    this->nbuffered--;
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  write_tile_metadata
+
+PURPOSE:  Writes the ENVI headers and the metadata file for a finished tile.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error writing the headers or metadata file
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static int write_tile_metadata
+(
+    Tile_grid_t *this,       /* I: tile grid state */
+    Grid_tile_t *tile        /* I: finished tile */
+)
+{
+    char FUNC_NAME[] = "write_tile_metadata";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char file_name[STR_SIZE]; /* tile band or metadata file */
+    int ib;                   /* looping variable for bands */
+    double ul[2];             /* outer upper left corner of the tile */
+    double size;              /* tile size in projection units */
+    FILE *fp = NULL;          /* metadata file */
+    Espa_band_meta_t bmeta;   /* band metadata for the ENVI headers */
+    Espa_global_meta_t gmeta; /* global metadata for the ENVI headers */
+    Envi_header_t envi_hdr;   /* output ENVI header information */
+
+    size = this->tile_size * this->pixsize;
+    ul[0] = this->origin[0] + tile->h * size;
+    ul[1] = this->origin[1] - tile->v * size;
+    gmeta = this->gmeta;
+    gmeta.proj_info.ul_corner[0] = ul[0];
+    gmeta.proj_info.ul_corner[1] = ul[1];
+    gmeta.proj_info.lr_corner[0] = ul[0] + size;
+    gmeta.proj_info.lr_corner[1] = ul[1] - size;
+    if (!strcmp (gmeta.proj_info.grid_origin, "CENTER"))
+    {
+        gmeta.proj_info.ul_corner[0] += 0.5 * this->pixsize;
+        gmeta.proj_info.ul_corner[1] -= 0.5 * this->pixsize;
+        gmeta.proj_info.lr_corner[0] -= 0.5 * this->pixsize;
+        gmeta.proj_info.lr_corner[1] += 0.5 * this->pixsize;
+    }
+
+    /* ENVI header for each band */
+    for (ib = 0; ib < this->nband; ib++)
+    {
+        memset (&bmeta, 0, sizeof (bmeta));
+        strcpy (bmeta.name, this->band_name[ib]);
+        strcpy (bmeta.long_name, this->long_name[ib]);
+        tile_file_name (this, tile, ib, ".img", bmeta.file_name);
+        strcpy (bmeta.product, "spectral_indices");
+        strcpy (bmeta.category, "index");
+        strcpy (bmeta.pixel_units, "meters");
+        strcpy (bmeta.data_units, "band ratio index value");
+        bmeta.data_type = ESPA_INT16;
+        bmeta.nlines = this->tile_size;
+        bmeta.nsamps = this->tile_size;
+        bmeta.pixel_size[0] = this->pixsize;
+        bmeta.pixel_size[1] = this->pixsize;
+        bmeta.fill_value = FILL_VALUE;
+        bmeta.saturate_value = SATURATE_VALUE;
+        bmeta.scale_factor = SCALE_FACTOR;
+        bmeta.valid_range[0] = (float) -FLOAT_TO_INT;
+        bmeta.valid_range[1] = (float) FLOAT_TO_INT;
+
+        tile_file_name (this, tile, ib, ".hdr", file_name);
+        if (create_envi_struct (&bmeta, &gmeta, &envi_hdr) != SUCCESS ||
+            write_envi_hdr (file_name, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing ENVI header file %.900s", file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Metadata file for the tile */
+    tile_file_name (this, tile, -1, TILE_EXT, file_name);
+    fp = fopen (file_name, "w");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening tile metadata file %.900s", file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    fprintf (fp, "%s\n", TILE_MAGIC);
+    fprintf (fp, "tile_h = %d\n", tile->h);
+    fprintf (fp, "tile_v = %d\n", tile->v);
+    fprintf (fp, "ul_x = %.6f\n", ul[0]);
+    fprintf (fp, "ul_y = %.6f\n", ul[1]);
+    fprintf (fp, "pixel_size = %g\n", this->pixsize);
+    fprintf (fp, "tile_size = %d\n", this->tile_size);
+    fprintf (fp, "source = %s\n", this->product_id);
+    fprintf (fp, "acquisition_date = %s\n", this->gmeta.acquisition_date);
+    for (ib = 0; ib < this->nband; ib++)
+    {
+        tile_file_name (this, tile, ib, ".img", file_name);
+        fprintf (fp, "band = %s %s %ld\n", this->band_name[ib], file_name,
+            tile->valid[ib]);
+    }
+    if (fclose (fp) != 0)
+    {
+        sprintf (errmsg, "Writing the tile metadata file");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  alloc_tile_buffers
+
+PURPOSE:  Allocates a tile's buffers, filled with fill values.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error allocating the buffers
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static int alloc_tile_buffers
+(
+    Tile_grid_t *this,       /* I/O: tile grid state */
+    Grid_tile_t *tile        /* I/O: tile to allocate the buffers for */
+)
+{
+    int ib;                   /* looping variable for bands */
+    long i;                   /* looping variable for pixels */
+    long npix = (long) this->tile_size * this->tile_size; /* tile pixels */
+
+    for (ib = 0; ib < this->nband; ib++)
+    {
+        tile->buf[ib] = prof_malloc (PBUF_TILE, npix * sizeof (int16));
+        if (tile->buf[ib] == NULL)
+            return (ERROR);
+        for (i = 0; i < npix; i++)
+            tile->buf[ib][i] = FILL_VALUE;
+    }
+    this->nbuffered++;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  finish_tile
+
+PURPOSE:  Writes out a tile whose lines are all filled, with its headers and
+metadata, and removes it from the tiles being filled.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error writing the tile
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Tiles with no valid pixels in any band are dropped unless part of them
+     has already been spilled to disk.
+******************************************************************************/
+static int finish_tile
+(
+    Tile_grid_t *this,       /* I/O: tile grid state */
+    int itile                /* I: tile to finish */
+)
+{
+    char FUNC_NAME[] = "finish_tile";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int ib;                   /* looping variable for bands */
+    int status = SUCCESS;     /* return status */
+    bool empty = true;        /* does the tile have no valid pixels? */
+    Grid_tile_t *tile = &this->tile[itile];   /* tile to finish */
+
+    for (ib = 0; ib < this->nband; ib++)
+    {
+        if (tile->valid[ib] > 0)
+            empty = false;
+    }
+
+    if (empty && !tile->written)
+    {
+        if (tile->buf[0] != NULL)
+            this->nbuffered--;
+        for (ib = 0; ib < this->nband; ib++)
+            prof_free (PBUF_TILE, tile->buf[ib], (size_t) this->tile_size *
+                this->tile_size * sizeof (int16));
+    }
+    else
+    {
+        /* The lines after the last one filled are fill */
+        if (tile->buf[0] == NULL && alloc_tile_buffers (this, tile) !=
+            SUCCESS)
+        {
+            sprintf (errmsg, "Allocating the buffers for tile h%03dv%03d",
+                tile->h, tile->v);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        tile->l1 = this->tile_size;
+        if (write_tile_lines (this, tile) != SUCCESS ||
+            write_tile_metadata (this, tile) != SUCCESS)
+            status = ERROR;
+        this->ntile_written++;
+    }
+
+    this->tile[itile] = this->tile[--this->ntile];
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  get_tile
+
+PURPOSE:  Finds the tile being filled at a tile column and row, adding it if
+needed, and makes sure it holds buffers, spilling the least recently filled
+tile if the budget is used up.
+
+RETURN VALUE:
+Type = Grid_tile_t*
+Value      Description
+-----      -----------
+NULL       Error allocating or spilling
+non-NULL   Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static Grid_tile_t *get_tile
+(
+    Tile_grid_t *this,       /* I/O: tile grid state */
+    int h,                   /* I: tile column */
+    int v                    /* I: tile row */
+)
+{
+    int i;                    /* looping variable for tiles */
+    int lru;                  /* least recently filled tile with buffers */
+    Grid_tile_t *tile = NULL; /* tile found or added */
+    Grid_tile_t *grown = NULL; /* grown tile list */
+
+    for (i = 0; i < this->ntile; i++)
+    {
+        if (this->tile[i].h == h && this->tile[i].v == v)
+        {
+            tile = &this->tile[i];
+            break;
+        }
+    }
+
+    if (tile == NULL)
+    {
+        grown = realloc (this->tile, (this->ntile + 1) *
+            sizeof (Grid_tile_t));
+        if (grown == NULL)
+            return (NULL);
+        this->tile = grown;
+        tile = &this->tile[this->ntile++];
+        memset (tile, 0, sizeof (Grid_tile_t));
+        tile->h = h;
+        tile->v = v;
+    }
+
+    if (tile->buf[0] == NULL)
+    {
+        /* Spill the least recently filled tile to stay in the budget */
+        if (this->nbuffered >= this->max_tile)
+        {
+            lru = -1;
+            for (i = 0; i < this->ntile; i++)
+            {
+                if (&this->tile[i] != tile && this->tile[i].buf[0] != NULL &&
+                    (lru < 0 || this->tile[i].last_used <
+                    this->tile[lru].last_used))
+                    lru = i;
+            }
+            if (lru >= 0)
+            {
+                if (write_tile_lines (this, &this->tile[lru]) != SUCCESS)
+                    return (NULL);
+                this->nspill++;
+            }
+        }
+        if (alloc_tile_buffers (this, tile) != SUCCESS)
+            return (NULL);
+    }
+    tile->last_used = ++this->nuse;
+
+    return (tile);
+}
+
+
+/******************************************************************************
+MODULE:  add_tile_lines
+
+PURPOSE:  Resamples a strip of the index bands into the grid tiles it
+covers, and writes out the tiles which are then complete.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error filling or writing the tiles
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The strips must be added in order.  A tile is complete once the last
+     grid line the scene covers in it has been filled.
+******************************************************************************/
+int add_tile_lines
+(
+    Tile_grid_t *this,       /* I/O: tile grid state */
+    int16 **spec_indx,       /* I: strip of each index band */
+    int iline,               /* I: first scene line of the strip */
+    int nlines,              /* I: number of scene lines in the strip */
+    int nsamps               /* I: number of scene samples */
+)
+{
+    char FUNC_NAME[] = "add_tile_lines";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int k;                    /* looping variable for covered grid lines */
+    int h;                    /* looping variable for tile columns */
+    int tc;                   /* looping variable for tile columns */
+    int ib;                   /* looping variable for bands */
+    int i;                    /* looping variable for tiles */
+    int gl;                   /* grid line */
+    int gc;                   /* grid column relative to the first covered */
+    int v;                    /* tile row of the grid line */
+    int tl;                   /* line within the tile */
+    int src;                  /* scene sample */
+    int last_line;            /* last covered tile line of a tile */
+    long offset;              /* offset of the scene line in the strip */
+    int16 val;                /* index value */
+    int16 *dst = NULL;        /* tile line being filled */
+    Grid_tile_t *tile = NULL; /* tile being filled */
+
+    for (k = 0; k < this->ngl; k++)
+    {
+        if (this->row_src[k] < iline || this->row_src[k] >= iline + nlines)
+            continue;
+        gl = this->gl0 + k;
+        v = floor_div (gl, this->tile_size);
+        tl = gl - v * this->tile_size;
+        offset = (long) (this->row_src[k] - iline) * nsamps;
+
+        for (h = this->h0; h < this->h0 + this->ntile_cols; h++)
+        {
+            tile = get_tile (this, h, v);
+            if (tile == NULL)
+            {
+                sprintf (errmsg, "Allocating the buffers for tile h%03dv%03d",
+                    h, v);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            for (ib = 0; ib < this->nband; ib++)
+            {
+                dst = tile->buf[ib] + (long) tl * this->tile_size;
+                for (tc = 0; tc < this->tile_size; tc++)
+                {
+                    gc = h * this->tile_size + tc - this->gc0;
+                    if (gc < 0 || gc >= this->ngc)
+                        continue;
+                    src = this->col_src[gc];
+                    val = spec_indx[ib][offset + src];
+                    dst[tc] = val;
+                    if (val != FILL_VALUE)
+                        tile->valid[ib]++;
+                }
+            }
+            tile->l1 = tl + 1;
+        }
+    }
+
+    /* Write out the complete tiles */
+    for (i = this->ntile - 1; i >= 0; i--)
+    {
+        last_line = this->gl0 + this->ngl - 1 - this->tile[i].v *
+            this->tile_size;
+        if (last_line > this->tile_size - 1)
+            last_line = this->tile_size - 1;
+        if (this->tile[i].l1 > last_line && finish_tile (this, i) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing a completed tile");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  close_tile_grid
+
+PURPOSE:  Writes out any tiles still being filled and frees the tile grid
+state.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error writing the remaining tiles
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Normally every tile has been written by add_tile_lines by the time the
+     last strip is added.
+******************************************************************************/
+int close_tile_grid
+(
+    Tile_grid_t *this        /* I: tile grid state to flush and free */
+)
+{
+    int status = SUCCESS;     /* return status */
+
+    if (this == NULL)
+        return (SUCCESS);
+
+    while (this->ntile > 0)
+    {
+        if (finish_tile (this, this->ntile - 1) != SUCCESS)
+            status = ERROR;
+    }
+    free (this->tile);
+    free (this->row_src);
+    free (this->col_src);
+    free (this);
+
+    return (status);
+}
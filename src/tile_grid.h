@@ -0,0 +1,93 @@
+#ifndef _TILE_GRID_H_
+#define _TILE_GRID_H_
+
+#include <stdbool.h>
+#include "common.h"
+#include "espa_metadata.h"
+
+/* Default memory budget for the partially filled tiles, in megabytes */
+#define TILE_BUFFER_MB 256
+
+/* Per-tile metadata files are small text files next to the tile bands.  The
+   first line is TILE_MAGIC followed by "key = value" lines:
+       tile_h, tile_v, ul_x, ul_y, pixel_size, tile_size, source,
+       acquisition_date, and one "band = name file valid_pixels" line per
+       index. */
+#define TILE_MAGIC "ESPA_SPECTRAL_INDEX_TILE 1"
+#define TILE_EXT ".tile"
+
+/* Most characters of the product ID and of a band name which go into the
+   tile file names, so the names fit in STR_SIZE */
+#define TILE_ID_MAX 500
+#define TILE_BAND_MAX 400
+
+/* One tile of the grid which the scene touches */
+typedef struct {
+    int h;                   /* tile column in the grid */
+    int v;                   /* tile row in the grid */
+    int l0;                  /* first tile line held in the buffers */
+    int l1;                  /* tile line after the last one filled */
+    bool written;            /* have lines been spilled to the files? */
+    unsigned long last_used; /* fill counter value when last filled */
+    long valid[MAX_OUT_BANDS]; /* number of valid pixels in each band */
+    int16 *buf[MAX_OUT_BANDS]; /* tile_size x tile_size values of each
+                                band; NULL while spilled */
+} Grid_tile_t;
+
+/* Structure for writing the indices as grid-aligned tiles */
+typedef struct {
+    double origin[2];        /* x,y of the grid origin (upper left) */
+    double pixsize;          /* grid pixel size */
+    int tile_size;           /* tile size in grid pixels */
+    int nband;               /* number of index bands */
+    char band_name[MAX_OUT_BANDS][STR_SIZE]; /* index band names */
+    char long_name[MAX_OUT_BANDS][STR_SIZE]; /* index band long names */
+    char product_id[STR_SIZE]; /* scene product ID for the file names */
+    Espa_global_meta_t gmeta;  /* scene global metadata, for the headers */
+    int scene_nlines;        /* number of scene lines */
+    int gl0;                 /* first grid line covered by the scene */
+    int ngl;                 /* number of grid lines covered */
+    int gc0;                 /* first grid column covered by the scene */
+    int ngc;                 /* number of grid columns covered */
+    int *row_src;            /* scene line under each covered grid line */
+    int *col_src;            /* scene sample under each covered grid column;
+                                -1 outside the scene */
+    int h0, ntile_cols;      /* first tile column and number of columns */
+    int ntile;               /* number of tiles being filled */
+    int max_tile;            /* number of tile buffers the budget allows */
+    int nbuffered;           /* number of tiles holding buffers */
+    Grid_tile_t *tile;       /* tiles being filled */
+    unsigned long nuse;      /* fill counter for picking tiles to spill */
+    int ntile_written;       /* number of tiles written */
+    int nspill;              /* number of partial tiles spilled */
+} Tile_grid_t;
+
+/* Prototypes */
+Tile_grid_t *open_tile_grid
+(
+    char *grid_spec,         /* I: origin_x,origin_y,pixel_size,tile_size */
+    int buffer_mb,           /* I: memory budget for the partial tiles */
+    Espa_global_meta_t *gmeta, /* I: scene global metadata */
+    int nlines,              /* I: number of scene lines */
+    int nsamps,              /* I: number of scene samples */
+    float pixsize[2],        /* I: scene pixel size x,y */
+    int nband,               /* I: number of index bands */
+    char band_names[][STR_SIZE], /* I: index band names */
+    char long_names[][STR_SIZE]  /* I: index band long names */
+);
+
+int add_tile_lines
+(
+    Tile_grid_t *this,       /* I/O: tile grid state */
+    int16 **spec_indx,       /* I: strip of each index band */
+    int iline,               /* I: first scene line of the strip */
+    int nlines,              /* I: number of scene lines in the strip */
+    int nsamps               /* I: number of scene samples */
+);
+
+int close_tile_grid
+(
+    Tile_grid_t *this        /* I: tile grid state to flush and free */
+);
+
+#endif
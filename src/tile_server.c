@@ -0,0 +1,904 @@
+#include <getopt.h>
+#include <math.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "tile_server.h"
+
+/******************************************************************************
+MODULE:  si_tile_server
+
+PURPOSE:  Serves rendered spectral index tiles on demand over HTTP on a local
+TCP port or UNIX socket.  Tiles are computed from the reflectance bands
+referenced by virtual index descriptors (see spectral_indices --virtual),
+reading only the windows needed, and the rendered PNGs are kept in a
+memory-bounded LRU cache.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An error occurred starting the server
+SUCCESS         Not reached; the server runs until it is killed
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Requests are:
+       GET /{name}/{z}/{x}/{y}.png[?colormap={gray|ndvi}]
+       GET /{name}/window/{line}/{samp}/{nlines}/{nsamps}.png[?colormap=...]
+       GET /stats
+       GET /metrics
+     where {name} is the index band name from the descriptor (i.e. sr_ndvi).
+     /metrics is the Prometheus text format.
+  2. Zoom level z is full resolution at the largest z for the image, and each
+     level below that halves the resolution (nearest neighbor decimation).
+     Tile x,y at zoom z covers TILE_SIZE * 2^(maxz - z) source pixels.
+  3. Requests are handled one at a time, since the virtual index readers and
+     their tile caches aren't shared between threads.  A client which
+     doesn't send its request within REQUEST_TIMEOUT_SECS gets a 408, so
+     an idle connection can't hold up the others.
+******************************************************************************/
+int main (int argc, char *argv[])
+{
+    bool verbose = false;      /* verbose flag */
+    char FUNC_NAME[] = "main"; /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char *vidx_files[MAX_SERVED_INDICES]; /* virtual index descriptors */
+    char *socket_path = NULL;  /* UNIX socket to listen on */
+    int nvidx = 0;             /* number of virtual index descriptors */
+    int port = -1;             /* TCP port to listen on (localhost only) */
+    int cache_mb = TILE_CACHE_MB;  /* tile cache budget in megabytes */
+    int c;                     /* current argument */
+    int option_index;          /* index for the command-line option */
+    int i;                     /* looping variable */
+    int listen_sock;           /* listening socket */
+    int sock;                  /* connected client socket */
+    int cache_tiles;           /* virtual index reader tiles to cache */
+    int max_dim;               /* larger of the lines and samples */
+    int max_nsamps = 0;        /* largest number of samples served */
+    double seconds_buckets[] = METRIC_SECONDS_BUCKETS; /* histogram buckets
+                                  for the request latency */
+    struct sockaddr_un unix_addr;  /* UNIX socket address */
+    struct sockaddr_in inet_addr;  /* TCP socket address */
+    Tile_server_t server;      /* tile server state */
+    static struct option long_options[] =
+    {
+        {"vidx", required_argument, 0, 'x'},
+        {"socket", required_argument, 0, 's'},
+        {"port", required_argument, 0, 'p'},
+        {"cache_mb", required_argument, 0, 'c'},
+        {"verbose", no_argument, 0, 'b'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Read the command-line arguments */
+    opterr = 0;
+    while ((c = getopt_long (argc, argv, "", long_options, &option_index))
+        != -1)
+    {
+        switch (c)
+        {
+            case 'x':
+                if (nvidx == MAX_SERVED_INDICES)
+                {
+                    sprintf (errmsg, "At most %d index products may be "
+                        "served", MAX_SERVED_INDICES);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    exit (ERROR);
+                }
+                vidx_files[nvidx++] = optarg;
+                break;
+            case 's':
+                socket_path = optarg;
+                break;
+            case 'p':
+                port = atoi (optarg);
+                break;
+            case 'c':
+                cache_mb = atoi (optarg);
+                break;
+            case 'b':
+                verbose = true;
+                break;
+            case 'h':
+                tile_server_usage ();
+                exit (SUCCESS);
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                tile_server_usage ();
+                exit (ERROR);
+        }
+    }
+
+    if (nvidx == 0 || (socket_path == NULL && port < 0) ||
+        (socket_path != NULL && port >= 0) || cache_mb < 1)
+    {
+        sprintf (errmsg, "At least one --vidx and exactly one of --socket or "
+            "--port are required");
+        error_handler (true, FUNC_NAME, errmsg);
+        tile_server_usage ();
+        exit (ERROR);
+    }
+
+    /* Open the index products to be served */
+    memset (&server, 0, sizeof (server));
+    if (init_tile_cache (&server.cache, (size_t) cache_mb * 1024 * 1024) !=
+        SUCCESS)
+    {
+        sprintf (errmsg, "Setting up the tile cache");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+    for (i = 0; i < nvidx; i++)
+    {
+        server.vidx[i] = open_virtual_index (vidx_files[i], VIDX_CACHE_TILES);
+        if (server.vidx[i] == NULL)
+        {
+            sprintf (errmsg, "Opening virtual index %s", vidx_files[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+
+        /* Decimated tiles walk across whole lines of reader tiles, so keep
+           at least two rows of them cached */
+        cache_tiles = 2 * ((server.vidx[i]->nsamps + VIDX_TILE_SIZE - 1) /
+            VIDX_TILE_SIZE);
+        if (cache_tiles > VIDX_CACHE_TILES)
+        {
+            close_virtual_index (server.vidx[i]);
+            server.vidx[i] = open_virtual_index (vidx_files[i], cache_tiles);
+            if (server.vidx[i] == NULL)
+                exit (ERROR);
+        }
+
+        max_dim = server.vidx[i]->nlines > server.vidx[i]->nsamps ?
+            server.vidx[i]->nlines : server.vidx[i]->nsamps;
+        for (server.maxzoom[i] = 0; TILE_SIZE << server.maxzoom[i] < max_dim;
+             server.maxzoom[i]++)
+            ;
+        if (server.vidx[i]->nsamps > max_nsamps)
+            max_nsamps = server.vidx[i]->nsamps;
+        if (verbose)
+            printf ("  Serving %s (%d lines, %d samples, zoom 0-%d)\n",
+                server.vidx[i]->name, server.vidx[i]->nlines,
+                server.vidx[i]->nsamps, server.maxzoom[i]);
+    }
+    server.nindex = nvidx;
+
+    server.vals = malloc ((size_t) MAX_WINDOW_SIZE * MAX_WINDOW_SIZE *
+        sizeof (int16));
+    server.rgba = malloc ((size_t) MAX_WINDOW_SIZE * MAX_WINDOW_SIZE * 4);
+    /* The line buffer holds a full resolution tile or one decimated line */
+    if (max_nsamps < TILE_SIZE * TILE_SIZE)
+        max_nsamps = TILE_SIZE * TILE_SIZE;
+    server.line_buf = malloc ((size_t) max_nsamps * sizeof (int16));
+    if (server.vals == NULL || server.rgba == NULL || server.line_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating the rendering buffers");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* Register the metrics served on /metrics */
+    server.req_ok = add_metric (METRIC_COUNTER, "si_tile_requests_total",
+        "Requests handled by status.", "code=\"200\"", NULL, 0);
+    server.req_bad = add_metric (METRIC_COUNTER, "si_tile_requests_total",
+        "Requests handled by status.", "code=\"400\"", NULL, 0);
+    server.req_missing = add_metric (METRIC_COUNTER,
+        "si_tile_requests_total", "Requests handled by status.",
+        "code=\"404\"", NULL, 0);
+    server.req_timeout = add_metric (METRIC_COUNTER,
+        "si_tile_requests_total", "Requests handled by status.",
+        "code=\"408\"", NULL, 0);
+    server.req_seconds = add_metric (METRIC_HISTOGRAM,
+        "si_tile_request_seconds", "Time to handle each request.", NULL,
+        seconds_buckets, METRIC_SECONDS_NBUCKET);
+    server.cache_hits = add_metric (METRIC_COUNTER,
+        "si_tile_cache_hits_total", "Requests served from the tile cache.",
+        NULL, NULL, 0);
+    server.cache_misses = add_metric (METRIC_COUNTER,
+        "si_tile_cache_misses_total", "Requests rendered.", NULL, NULL, 0);
+    server.cache_bytes = add_metric (METRIC_GAUGE, "si_tile_cache_bytes",
+        "Bytes in the tile cache.", NULL, NULL, 0);
+    server.cache_tiles = add_metric (METRIC_GAUGE, "si_tile_cache_tiles",
+        "Tiles in the tile cache.", NULL, NULL, 0);
+    if (server.req_ok == NULL || server.req_bad == NULL ||
+        server.req_missing == NULL || server.req_timeout == NULL ||
+        server.req_seconds == NULL ||
+        server.cache_hits == NULL || server.cache_misses == NULL ||
+        server.cache_bytes == NULL || server.cache_tiles == NULL)
+        exit (ERROR);
+
+    /* Set up the listening socket */
+    if (socket_path != NULL)
+    {
+        listen_sock = socket (AF_UNIX, SOCK_STREAM, 0);
+        memset (&unix_addr, 0, sizeof (unix_addr));
+        unix_addr.sun_family = AF_UNIX;
+        snprintf (unix_addr.sun_path, sizeof (unix_addr.sun_path), "%s",
+            socket_path);
+        unlink (socket_path);
+        if (listen_sock < 0 || bind (listen_sock,
+            (struct sockaddr *) &unix_addr, sizeof (unix_addr)) != 0)
+        {
+            sprintf (errmsg, "Binding to UNIX socket %s", socket_path);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+    }
+    else
+    {
+        listen_sock = socket (AF_INET, SOCK_STREAM, 0);
+        c = 1;
+        setsockopt (listen_sock, SOL_SOCKET, SO_REUSEADDR, &c, sizeof (c));
+        memset (&inet_addr, 0, sizeof (inet_addr));
+        inet_addr.sin_family = AF_INET;
+        inet_addr.sin_port = htons (port);
+        inet_addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+        if (listen_sock < 0 || bind (listen_sock,
+            (struct sockaddr *) &inet_addr, sizeof (inet_addr)) != 0)
+        {
+            sprintf (errmsg, "Binding to localhost port %d", port);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+    }
+    if (listen (listen_sock, 64) != 0)
+    {
+        sprintf (errmsg, "Listening for connections");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+    signal (SIGPIPE, SIG_IGN);
+
+    if (socket_path != NULL)
+        printf ("si_tile_server listening on UNIX socket %s\n", socket_path);
+    else
+        printf ("si_tile_server listening on localhost port %d\n", port);
+    fflush (stdout);
+
+    /* Handle requests one at a time */
+    while (1)
+    {
+        sock = accept (listen_sock, NULL, NULL);
+        if (sock < 0)
+            continue;
+        handle_request (&server, sock, verbose);
+        close (sock);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  hash_tile_key
+
+PURPOSE:  Hashes a tile cache key (FNV-1a).
+
+RETURN VALUE:
+Type = unsigned long
+Value      Description
+-----      -----------
+n/a        Hash of the key
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static unsigned long hash_tile_key
+(
+    char *key                /* I: cache key */
+)
+{
+    unsigned long hash = 2166136261UL;  /* running hash */
+    unsigned char *cptr = NULL;          /* current character */
+
+    for (cptr = (unsigned char *) key; *cptr != '\0'; cptr++)
+    {
+        hash ^= *cptr;
+        hash *= 16777619UL;
+    }
+
+    return (hash);
+}
+
+
+/******************************************************************************
+MODULE:  init_tile_cache
+
+PURPOSE:  Sets up an empty tile cache and its hash table.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error allocating the hash table
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. There is a bucket per TILE_CACHE_BUCKET_BYTES of the budget, rounded
+     up to a power of two, so a full cache keeps its chains short.
+******************************************************************************/
+int init_tile_cache
+(
+    Tile_cache_t *cache,     /* O: tile cache */
+    size_t max_bytes         /* I: memory budget for the cached PNGs */
+)
+{
+    memset (cache, 0, sizeof (Tile_cache_t));
+    cache->max_bytes = max_bytes;
+    cache->nbucket = 1;
+    while (cache->nbucket * TILE_CACHE_BUCKET_BYTES < max_bytes)
+        cache->nbucket *= 2;
+    cache->bucket = calloc (cache->nbucket, sizeof (Tile_entry_t *));
+    if (cache->bucket == NULL)
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  find_cached_tile
+
+PURPOSE:  Looks up a rendered PNG in the tile cache and moves it to the most
+recently used position.
+
+RETURN VALUE:
+Type = Tile_entry_t *
+Value      Description
+-----      -----------
+NULL       Not in the cache
+non-NULL   Cached entry
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+Tile_entry_t *find_cached_tile
+(
+    Tile_cache_t *cache,     /* I/O: tile cache */
+    char *key                /* I: cache key */
+)
+{
+    Tile_entry_t *entry = NULL;   /* current cache entry */
+
+    entry = cache->bucket[hash_tile_key (key) & (cache->nbucket - 1)];
+    while (entry != NULL && strcmp (entry->key, key))
+        entry = entry->hnext;
+    if (entry == NULL)
+        return (NULL);
+
+    /* Move to the head of the list */
+    if (entry != cache->head)
+    {
+        entry->prev->next = entry->next;
+        if (entry->next != NULL)
+            entry->next->prev = entry->prev;
+        else
+            cache->tail = entry->prev;
+        entry->prev = NULL;
+        entry->next = cache->head;
+        cache->head->prev = entry;
+        cache->head = entry;
+    }
+
+    return (entry);
+}
+
+
+/******************************************************************************
+MODULE:  add_cached_tile
+
+PURPOSE:  Adds a rendered PNG to the tile cache, evicting the least recently
+used entries until the cache is within its memory budget.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+true       The PNG was added and is now owned by the cache
+false      The PNG is too large for the cache or the entry couldn't be
+           allocated; the caller still owns it
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The key isn't already cached; handle_request only adds after a miss.
+******************************************************************************/
+bool add_cached_tile
+(
+    Tile_cache_t *cache,     /* I/O: tile cache */
+    char *key,               /* I: cache key */
+    unsigned char *png,      /* I: encoded PNG; owned by the cache if it was
+                                added */
+    size_t png_size          /* I: size of the encoded PNG in bytes */
+)
+{
+    Tile_entry_t *entry = NULL;   /* new or evicted cache entry */
+    Tile_entry_t **link = NULL;   /* link to the evicted entry in its
+                                     bucket */
+    unsigned long ib;             /* hash bucket of the entry */
+
+    if (png_size > cache->max_bytes ||
+        (entry = malloc (sizeof (Tile_entry_t))) == NULL)
+        return (false);
+    snprintf (entry->key, sizeof (entry->key), "%s", key);
+    entry->png = png;
+    entry->png_size = png_size;
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head != NULL)
+        cache->head->prev = entry;
+    cache->head = entry;
+    if (cache->tail == NULL)
+        cache->tail = entry;
+    ib = hash_tile_key (entry->key) & (cache->nbucket - 1);
+    entry->hnext = cache->bucket[ib];
+    cache->bucket[ib] = entry;
+    cache->nbytes += png_size + sizeof (Tile_entry_t);
+    cache->nentry++;
+
+    /* Evict from the tail */
+    while (cache->nbytes > cache->max_bytes && cache->tail != cache->head)
+    {
+        entry = cache->tail;
+        cache->tail = entry->prev;
+        cache->tail->next = NULL;
+        link = &cache->bucket[hash_tile_key (entry->key) &
+            (cache->nbucket - 1)];
+        while (*link != entry)
+            link = &(*link)->hnext;
+        *link = entry->hnext;
+        cache->nbytes -= entry->png_size + sizeof (Tile_entry_t);
+        cache->nentry--;
+        free (entry->png);
+        free (entry);
+    }
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  render_tile
+
+PURPOSE:  Computes and renders the specified zoom/x/y tile of an index
+product.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Tile is outside the image or an error occurred computing it
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Pixels beyond the edge of the image are rendered as fill (transparent).
+  2. Decimated tiles only read the source lines that are sampled.
+******************************************************************************/
+int render_tile
+(
+    Tile_server_t *this,     /* I/O: tile server state */
+    int indx,                /* I: index product to render */
+    int zoom,                /* I: zoom level */
+    int tile_col,            /* I: tile column (x) */
+    int tile_row,            /* I: tile row (y) */
+    Colormap_t cmap,         /* I: colormap to apply */
+    unsigned char **png,     /* O: encoded PNG */
+    size_t *png_size         /* O: size of the encoded PNG */
+)
+{
+    Virtual_index_t *vidx = this->vidx[indx];  /* index product */
+    int factor;              /* decimation factor for the zoom level */
+    int iline;               /* first source line of the tile */
+    int isamp;               /* first source sample of the tile */
+    int nlines;              /* number of output lines within the image */
+    int nsamps;              /* number of output samples within the image */
+    int src_nsamps;          /* number of source samples within the image */
+    int line;                /* looping variable for output lines */
+    int samp;                /* looping variable for output samples */
+    int pix;                 /* looping variable for pixels */
+
+    if (zoom < 0 || zoom > this->maxzoom[indx] || tile_col < 0 ||
+        tile_row < 0)
+        return (ERROR);
+    factor = 1 << (this->maxzoom[indx] - zoom);
+    iline = tile_row * TILE_SIZE * factor;
+    isamp = tile_col * TILE_SIZE * factor;
+    if (iline >= vidx->nlines || isamp >= vidx->nsamps)
+        return (ERROR);
+
+    nlines = (vidx->nlines - iline + factor - 1) / factor;
+    if (nlines > TILE_SIZE)
+        nlines = TILE_SIZE;
+    nsamps = (vidx->nsamps - isamp + factor - 1) / factor;
+    if (nsamps > TILE_SIZE)
+        nsamps = TILE_SIZE;
+
+    for (pix = 0; pix < TILE_SIZE * TILE_SIZE; pix++)
+        this->vals[pix] = FILL_VALUE;
+
+    if (factor == 1)
+    {
+        /* Full resolution; read the window directly */
+        if (read_virtual_index (vidx, iline, isamp, nlines, nsamps,
+            this->line_buf) != SUCCESS)
+            return (ERROR);
+        for (line = 0; line < nlines; line++)
+            memcpy (&this->vals[line * TILE_SIZE],
+                &this->line_buf[line * nsamps], nsamps * sizeof (int16));
+    }
+    else
+    {
+        /* Decimated; read each sampled source line and pick every
+           factor'th sample */
+        src_nsamps = (nsamps - 1) * factor + 1;
+        for (line = 0; line < nlines; line++)
+        {
+            if (read_virtual_index (vidx, iline + line * factor, isamp, 1,
+                src_nsamps, this->line_buf) != SUCCESS)
+                return (ERROR);
+            for (samp = 0; samp < nsamps; samp++)
+                this->vals[line * TILE_SIZE + samp] =
+                    this->line_buf[samp * factor];
+        }
+    }
+
+    apply_colormap (this->vals, TILE_SIZE * TILE_SIZE, cmap, this->rgba);
+    return (encode_png_rgba (this->rgba, TILE_SIZE, TILE_SIZE, png,
+        png_size));
+}
+
+
+/******************************************************************************
+MODULE:  render_window
+
+PURPOSE:  Computes and renders a full resolution pixel window of an index
+product.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Window is invalid or an error occurred computing it
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+int render_window
+(
+    Tile_server_t *this,     /* I/O: tile server state */
+    int indx,                /* I: index product to render */
+    int iline,               /* I: first line of the window */
+    int isamp,               /* I: first sample of the window */
+    int nlines,              /* I: number of lines in the window */
+    int nsamps,              /* I: number of samples in the window */
+    Colormap_t cmap,         /* I: colormap to apply */
+    unsigned char **png,     /* O: encoded PNG */
+    size_t *png_size         /* O: size of the encoded PNG */
+)
+{
+    if (nlines > MAX_WINDOW_SIZE || nsamps > MAX_WINDOW_SIZE)
+        return (ERROR);
+
+    if (read_virtual_index (this->vidx[indx], iline, isamp, nlines, nsamps,
+        this->vals) != SUCCESS)
+        return (ERROR);
+
+    apply_colormap (this->vals, (long) nlines * nsamps, cmap, this->rgba);
+    return (encode_png_rgba (this->rgba, nlines, nsamps, png, png_size));
+}
+
+
+/******************************************************************************
+MODULE:  handle_request
+
+PURPOSE:  Reads one HTTP request from the client, serves the tile or window
+from the cache or renders it, and writes the response.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Only GET is supported and the connection is closed after the response.
+  2. The whole request header has to arrive within REQUEST_TIMEOUT_SECS of
+     the connection being handled, so a client trickling bytes can't hold
+     the server either.  Each write of the response times out the same way.
+  3. Tiles and windows are cached by index product, position, and colormap,
+     so requests which differ only in other query parameters share an
+     entry.
+******************************************************************************/
+void handle_request
+(
+    Tile_server_t *this,     /* I/O: tile server state */
+    int sock,                /* I: connected client socket */
+    bool verbose             /* I: verbose flag */
+)
+{
+    char request[MAX_REQUEST_SIZE];  /* request header */
+    char path[MAX_REQUEST_SIZE];     /* requested path */
+    char name[MAX_REQUEST_SIZE];     /* index name from the path */
+    char key[TILE_KEY_SIZE];         /* tile cache key */
+    char cmap_name[32];              /* colormap name from the query */
+    char header[STR_SIZE];           /* response header */
+    char body[STR_SIZE];             /* text response body */
+    char *query = NULL;              /* query string in the path */
+    char *cptr = NULL;               /* pointer within the query string */
+    char *status = "200 OK";         /* response status */
+    char *text = NULL;               /* metrics response body */
+    size_t text_size = 0;            /* size of the metrics */
+    FILE *fp = NULL;                 /* stream the metrics are written to */
+    unsigned char *png = NULL;       /* PNG to be returned */
+    size_t png_size = 0;             /* size of the PNG */
+    bool png_cached = false;         /* is the PNG owned by the cache? */
+    size_t nread = 0;                /* bytes of the request read */
+    ssize_t n;                       /* bytes read or written */
+    bool timed_out = false;          /* did the request header time out? */
+    long wait_ms;                    /* time left to read the request */
+    struct pollfd pfd;               /* client socket to wait on */
+    struct timeval timeout;          /* time limit for each write */
+    int indx;                        /* index product requested */
+    int v[4];                        /* numbers parsed from the path */
+    int cmap = CMAP_GRAY;            /* colormap requested */
+    int rendered;                    /* status of rendering the tile */
+    bool is_window = false;          /* is a window requested, otherwise
+                                        a tile? */
+    struct timespec t0, t1;          /* request start and end times */
+    Tile_entry_t *entry = NULL;      /* cached PNG */
+
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    path[0] = '\0';
+
+    /* Don't let a client which stops reading block the response writes */
+    timeout.tv_sec = REQUEST_TIMEOUT_SECS;
+    timeout.tv_usec = 0;
+    setsockopt (sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+
+    /* Read up to the end of the request header, within the time limit */
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+    while (nread < sizeof (request) - 1)
+    {
+        clock_gettime (CLOCK_MONOTONIC, &t1);
+        wait_ms = REQUEST_TIMEOUT_SECS * 1000L - ((t1.tv_sec - t0.tv_sec) *
+            1000L + (t1.tv_nsec - t0.tv_nsec) / 1000000L);
+        if (wait_ms <= 0 || poll (&pfd, 1, (int) wait_ms) <= 0)
+        {
+            timed_out = true;
+            break;
+        }
+        n = read (sock, request + nread, sizeof (request) - 1 - nread);
+        if (n <= 0)
+            break;
+        nread += n;
+        request[nread] = '\0';
+        if (strstr (request, "\r\n\r\n") || strstr (request, "\n\n"))
+            break;
+    }
+    request[nread] = '\0';
+
+    body[0] = '\0';
+    if (timed_out)
+    {
+        status = "408 Request Timeout";
+        strcpy (body, "Timed out waiting for the request\n");
+    }
+    else if (sscanf (request, "GET %4095s", path) != 1)
+    {
+        status = "400 Bad Request";
+        strcpy (body, "Only GET requests are supported\n");
+    }
+    else if (!strcmp (path, "/stats"))
+    {
+        snprintf (body, sizeof (body), "tiles_cached %d\nbytes_cached %ld\n"
+            "cache_hits %ld\ncache_misses %ld\n", this->cache.nentry,
+            (long) this->cache.nbytes, this->cache.nhits,
+            this->cache.nmisses);
+    }
+    else if (!strcmp (path, "/metrics"))
+    {
+        metric_set (this->cache_bytes, this->cache.nbytes);
+        metric_set (this->cache_tiles, this->cache.nentry);
+        fp = open_memstream (&text, &text_size);
+        if (fp != NULL)
+        {
+            write_metrics (fp);
+            fclose (fp);
+        }
+        if (text == NULL)
+        {
+            status = "500 Internal Server Error";
+            strcpy (body, "Unable to write the metrics\n");
+        }
+    }
+    else
+    {
+        /* Find the index product and the colormap, leaving the path as it
+           was requested */
+        indx = -1;
+        if (sscanf (path, "/%4095[^/?]", name) == 1)
+            for (indx = this->nindex - 1; indx >= 0; indx--)
+                if (!strcmp (name, this->vidx[indx]->name))
+                    break;
+        query = strchr (path, '?');
+        if (query != NULL && (cptr = strstr (query, "colormap=")) != NULL)
+        {
+            cptr += strlen ("colormap=");
+            snprintf (cmap_name, sizeof (cmap_name), "%.*s",
+                (int) strcspn (cptr, "&"), cptr);
+            cmap = get_colormap (cmap_name);
+        }
+
+        /* Key the cache by what's rendered, so other query parameters
+           don't split the entries */
+        key[0] = '\0';
+        is_window = false;
+        if (indx >= 0 && cmap >= 0)
+        {
+            cptr = path + strlen (name) + 1;
+            if (sscanf (cptr, "/window/%d/%d/%d/%d.png", &v[0], &v[1], &v[2],
+                &v[3]) == 4)
+            {
+                is_window = true;
+                snprintf (key, sizeof (key), "%d/w/%d/%d/%d/%d/%d", indx,
+                    v[0], v[1], v[2], v[3], cmap);
+            }
+            else if (sscanf (cptr, "/%d/%d/%d.png", &v[0], &v[1], &v[2]) == 3)
+                snprintf (key, sizeof (key), "%d/%d/%d/%d/%d", indx, v[0],
+                    v[1], v[2], cmap);
+        }
+
+        rendered = ERROR;
+        if (key[0] != '\0' &&
+            (entry = find_cached_tile (&this->cache, key)) != NULL)
+        {
+            this->cache.nhits++;
+            metric_add (this->cache_hits, 1);
+            png = entry->png;
+            png_size = entry->png_size;
+            png_cached = true;
+            rendered = SUCCESS;
+        }
+        else if (key[0] != '\0')
+        {
+            if (is_window)
+                rendered = render_window (this, indx, v[0], v[1], v[2], v[3],
+                    cmap, &png, &png_size);
+            else
+                rendered = render_tile (this, indx, v[0], v[1], v[2], cmap,
+                    &png, &png_size);
+            if (rendered == SUCCESS)
+            {
+                this->cache.nmisses++;
+                metric_add (this->cache_misses, 1);
+                png_cached = add_cached_tile (&this->cache, key, png,
+                    png_size);
+            }
+        }
+
+        if (rendered != SUCCESS)
+        {
+            status = "404 Not Found";
+            strcpy (body, "No such index, tile, window, or colormap\n");
+            free (png);
+            png = NULL;
+        }
+    }
+
+    /* Write the response */
+    if (png != NULL)
+        snprintf (header, sizeof (header), "HTTP/1.1 %s\r\n"
+            "Content-Type: image/png\r\nContent-Length: %ld\r\n"
+            "Connection: close\r\n\r\n", status, (long) png_size);
+    else if (text != NULL)
+        snprintf (header, sizeof (header), "HTTP/1.1 %s\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: %ld\r\nConnection: close\r\n\r\n", status,
+            (long) text_size);
+    else
+        snprintf (header, sizeof (header), "HTTP/1.1 %s\r\n"
+            "Content-Type: text/plain\r\nContent-Length: %ld\r\n"
+            "Connection: close\r\n\r\n", status, (long) strlen (body));
+    if (write (sock, header, strlen (header)) > 0)
+    {
+        if (png != NULL)
+            n = write (sock, png, png_size);
+        else if (text != NULL)
+            n = write (sock, text, text_size);
+        else
+            n = write (sock, body, strlen (body));
+    }
+    free (text);
+
+    /* PNGs which didn't fit in the cache are freed once they're sent */
+    if (!png_cached)
+        free (png);
+
+    /* Count the request by status */
+    clock_gettime (CLOCK_MONOTONIC, &t1);
+    if (!strncmp (status, "200", 3))
+        metric_add (this->req_ok, 1);
+    else if (!strncmp (status, "400", 3))
+        metric_add (this->req_bad, 1);
+    else if (!strncmp (status, "404", 3))
+        metric_add (this->req_missing, 1);
+    else if (!strncmp (status, "408", 3))
+        metric_add (this->req_timeout, 1);
+    metric_observe (this->req_seconds, (t1.tv_sec - t0.tv_sec) +
+        (t1.tv_nsec - t0.tv_nsec) * 1.0e-9);
+
+    if (verbose)
+    {
+        printf ("  %s %s %.3f ms\n", status, path,
+            (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+        fflush (stdout);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  tile_server_usage
+
+PURPOSE:  Prints the usage information for the tile server.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void tile_server_usage ()
+{
+    printf ("si_tile_server %s serves spectral index tiles on demand, "
+            "computing them from the reflectance bands referenced by virtual "
+            "index descriptors (see spectral_indices --virtual).\n\n",
+            INDEX_VERSION);
+    printf ("usage: si_tile_server --vidx=descriptor [--vidx=...] "
+            "(--socket=path | --port=number) [--cache_mb=megabytes] "
+            "[--verbose]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -vidx: virtual index descriptor to serve; may be repeated "
+            "for up to %d index products\n", MAX_SERVED_INDICES);
+    printf ("    -socket: UNIX socket to listen on, or\n");
+    printf ("    -port: TCP port on localhost to listen on\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -cache_mb: memory budget for cached tiles (default is %d "
+            "MB)\n", TILE_CACHE_MB);
+    printf ("    -verbose: print each request and its latency\n");
+
+    printf ("\nRequests:\n");
+    printf ("    GET /{name}/{z}/{x}/{y}.png[?colormap=gray|ndvi]\n");
+    printf ("    GET /{name}/window/{line}/{samp}/{nlines}/{nsamps}.png"
+            "[?colormap=gray|ndvi]\n");
+    printf ("    GET /stats\n");
+    printf ("    GET /metrics (Prometheus text format)\n");
+    printf ("where {name} is the index band name, i.e. sr_ndvi.\n");
+}
@@ -0,0 +1,145 @@
+#ifndef _TILE_SERVER_H_
+#define _TILE_SERVER_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "common.h"
+#include "error_handler.h"
+#include "output.h"
+#include "virtual_index.h"
+#include "colormap.h"
+#include "png_write.h"
+#include "metrics.h"
+
+/* Size of the square tiles served */
+#define TILE_SIZE 256
+
+/* Largest pixel window which may be requested, in lines or samples */
+#define MAX_WINDOW_SIZE 4096
+
+/* Default memory budget for the rendered tile cache, in megabytes */
+#define TILE_CACHE_MB 256
+
+/* Maximum number of index products which may be served at once */
+#define MAX_SERVED_INDICES 16
+
+/* Maximum size of an HTTP request header */
+#define MAX_REQUEST_SIZE 4096
+
+/* Most seconds a client may take to send its request header, or to take
+   each write of the response, before the connection is dropped */
+#define REQUEST_TIMEOUT_SECS 5
+
+/* Size of a tile cache key, which is the index product, the tile or window,
+   and the colormap (see handle_request) */
+#define TILE_KEY_SIZE 96
+
+/* Cache memory per hash bucket, which sizes the hash table from the budget
+   for a short chain per bucket at typical tile sizes */
+#define TILE_CACHE_BUCKET_BYTES 16384
+
+/* One rendered PNG in the tile cache */
+typedef struct Tile_entry {
+    char key[TILE_KEY_SIZE]; /* index, tile or window, and colormap */
+    unsigned char *png;      /* encoded PNG */
+    size_t png_size;         /* size of the encoded PNG in bytes */
+    struct Tile_entry *prev; /* more recently used entry */
+    struct Tile_entry *next; /* less recently used entry */
+    struct Tile_entry *hnext; /* next entry in the same hash bucket */
+} Tile_entry_t;
+
+/* Memory-bounded LRU cache of rendered PNGs */
+typedef struct {
+    size_t max_bytes;        /* memory budget for the cached PNGs */
+    size_t nbytes;           /* memory used by the cached PNGs */
+    int nentry;              /* number of cached PNGs */
+    Tile_entry_t **bucket;   /* hash chains of the cached PNGs */
+    unsigned long nbucket;   /* number of hash buckets, a power of two */
+    Tile_entry_t *head;      /* most recently used entry */
+    Tile_entry_t *tail;      /* least recently used entry */
+    long nhits;              /* number of requests served from the cache */
+    long nmisses;            /* number of requests rendered */
+} Tile_cache_t;
+
+/* Structure for the tile server state */
+typedef struct {
+    int nindex;              /* number of index products served */
+    Virtual_index_t *vidx[MAX_SERVED_INDICES]; /* index products served,
+                                opened from their virtual descriptors */
+    int maxzoom[MAX_SERVED_INDICES]; /* zoom level of the full resolution
+                                tiles for each index product */
+    Tile_cache_t cache;      /* rendered tile cache */
+    int16 *vals;             /* index values for the tile or window being
+                                rendered */
+    int16 *line_buf;         /* one line of index values for decimation */
+    uint8 *rgba;             /* RGBA pixels for the tile or window */
+    Metric_t *req_ok;        /* requests served */
+    Metric_t *req_bad;       /* requests which weren't GETs */
+    Metric_t *req_missing;   /* requests for unknown tiles or windows */
+    Metric_t *req_timeout;   /* requests which weren't sent in time */
+    Metric_t *req_seconds;   /* histogram of the request latency */
+    Metric_t *cache_hits;    /* requests served from the tile cache */
+    Metric_t *cache_misses;  /* requests rendered */
+    Metric_t *cache_bytes;   /* gauge of the bytes in the tile cache */
+    Metric_t *cache_tiles;   /* gauge of the tiles in the tile cache */
+} Tile_server_t;
+
+/* Prototypes */
+int init_tile_cache
+(
+    Tile_cache_t *cache,     /* O: tile cache */
+    size_t max_bytes         /* I: memory budget for the cached PNGs */
+);
+
+Tile_entry_t *find_cached_tile
+(
+    Tile_cache_t *cache,     /* I/O: tile cache */
+    char *key                /* I: cache key */
+);
+
+bool add_cached_tile
+(
+    Tile_cache_t *cache,     /* I/O: tile cache */
+    char *key,               /* I: cache key */
+    unsigned char *png,      /* I: encoded PNG; owned by the cache if it was
+                                added */
+    size_t png_size          /* I: size of the encoded PNG in bytes */
+);
+
+int render_tile
+(
+    Tile_server_t *this,     /* I/O: tile server state */
+    int indx,                /* I: index product to render */
+    int zoom,                /* I: zoom level */
+    int tile_col,            /* I: tile column (x) */
+    int tile_row,            /* I: tile row (y) */
+    Colormap_t cmap,         /* I: colormap to apply */
+    unsigned char **png,     /* O: encoded PNG */
+    size_t *png_size         /* O: size of the encoded PNG */
+);
+
+int render_window
+(
+    Tile_server_t *this,     /* I/O: tile server state */
+    int indx,                /* I: index product to render */
+    int iline,               /* I: first line of the window */
+    int isamp,               /* I: first sample of the window */
+    int nlines,              /* I: number of lines in the window */
+    int nsamps,              /* I: number of samples in the window */
+    Colormap_t cmap,         /* I: colormap to apply */
+    unsigned char **png,     /* O: encoded PNG */
+    size_t *png_size         /* O: size of the encoded PNG */
+);
+
+void handle_request
+(
+    Tile_server_t *this,     /* I/O: tile server state */
+    int sock,                /* I: connected client socket */
+    bool verbose             /* I: verbose flag */
+);
+
+void tile_server_usage ();
+
+#endif
@@ -0,0 +1,419 @@
+#include <libgen.h>
+#include "si.h"
+#include "virtual_index.h"
+
+/******************************************************************************
+MODULE:  open_virtual_index
+
+PURPOSE:  Reads the virtual index descriptor, opens the referenced input
+reflectance bands for read access, and allocates the tile cache.
+
+RETURN VALUE:
+Type = Virtual_index_t*
+Value      Description
+-----      -----------
+NULL       Error occurred reading the descriptor or opening the bands
+non-NULL   Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. It is up to the caller to use close_virtual_index to close the files and
+     free the memory when done.
+  2. The cache holds cache_tiles tiles of VIDX_TILE_SIZE x VIDX_TILE_SIZE
+     int16 values, so the memory used is bounded by
+     cache_tiles * VIDX_TILE_SIZE^2 * 2 bytes plus one tile per input band.
+******************************************************************************/
+Virtual_index_t *open_virtual_index
+(
+    char *vidx_file,         /* I: name of the virtual index descriptor */
+    int cache_tiles          /* I: number of tiles to cache; 0 for the
+                                default */
+)
+{
+    char FUNC_NAME[] = "open_virtual_index";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char line[STR_SIZE];      /* current line from the descriptor */
+    char key[STR_SIZE];       /* key from the current line */
+    char value[STR_SIZE];     /* value from the current line */
+    char dir[STR_SIZE];       /* directory of the descriptor */
+    char path[STR_SIZE*2+1];  /* band file name relative to the descriptor */
+    char index[STR_SIZE] = ""; /* short name of the index */
+    char *cptr = NULL;        /* pointer to the value */
+    int ib;                   /* looping variable for bands */
+    int ic;                   /* looping variable for cache tiles */
+    int si;                   /* looping variable for spectral indices */
+    FILE *fp = NULL;          /* descriptor file pointer */
+    Virtual_index_t *this = NULL;  /* virtual index to be returned */
+
+    fp = fopen (vidx_file, "r");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening virtual index descriptor: %s", vidx_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    if (fgets (line, sizeof (line), fp) == NULL ||
+        strncmp (line, VIDX_MAGIC, strlen (VIDX_MAGIC)))
+    {
+        fclose (fp);
+        sprintf (errmsg, "Not a virtual index descriptor: %s", vidx_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    this = calloc (1, sizeof (Virtual_index_t));
+    if (this == NULL)
+    {
+        fclose (fp);
+        sprintf (errmsg, "Allocating the virtual index structure");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    /* Band file names are relative to the descriptor's directory */
+    snprintf (dir, sizeof (dir), "%s", vidx_file);
+    snprintf (dir, sizeof (dir), "%s", dirname (dir));
+
+    /* Read the key = value pairs */
+    while (fgets (line, sizeof (line), fp) != NULL)
+    {
+        cptr = strchr (line, '=');
+        if (cptr == NULL)
+            continue;
+        *cptr = '\0';
+        if (sscanf (line, "%s", key) != 1)
+            continue;
+        cptr++;
+        while (*cptr == ' ')
+            cptr++;
+        snprintf (value, sizeof (value), "%s", cptr);
+        value[strcspn (value, "\r\n")] = '\0';
+
+        if (!strcmp (key, "index"))
+            strcpy (index, value);
+        else if (!strcmp (key, "name"))
+            strcpy (this->name, value);
+        else if (!strcmp (key, "lines"))
+            this->nlines = atoi (value);
+        else if (!strcmp (key, "samples"))
+            this->nsamps = atoi (value);
+        else if (!strcmp (key, "refl_fill"))
+            this->refl_fill = atoi (value);
+        else if (!strcmp (key, "refl_saturate_value"))
+            this->refl_saturate_val = atoi (value);
+        else if (!strcmp (key, "refl_scale_factor"))
+            this->refl_scale_fact = atof (value);
+        else if (!strcmp (key, "band") && this->nband < MAX_SI_BANDS)
+        {
+            if (value[0] == '/')
+                snprintf (path, sizeof (path), "%s", value);
+            else
+                snprintf (path, sizeof (path), "%s/%s", dir, value);
+            this->band_file[this->nband++] = strdup (path);
+        }
+    }
+    fclose (fp);
+
+    /* Determine which index this is */
+    this->si = NUM_SI;
+    for (si = 0; si < NUM_SI; si++)
+        if (!strcmp (index, si_short_name (si)))
+            this->si = si;
+    if (this->si == NUM_SI || this->nband < 2 || this->nlines < 1 ||
+        this->nsamps < 1)
+    {
+        close_virtual_index (this);
+        sprintf (errmsg, "Incomplete or unsupported virtual index "
+            "descriptor: %s", vidx_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    /* Open the input bands and allocate a tile for each */
+    for (ib = 0; ib < this->nband; ib++)
+    {
+        this->fp_band[ib] = fopen (this->band_file[ib], "rb");
+        this->band_buf[ib] = calloc (VIDX_TILE_SIZE * VIDX_TILE_SIZE,
+            sizeof (int16));
+        if (this->fp_band[ib] == NULL || this->band_buf[ib] == NULL)
+        {
+            sprintf (errmsg, "Opening input band for the virtual index: %s",
+                this->band_file[ib]);
+            close_virtual_index (this);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+    }
+
+    /* Allocate the tile cache */
+    this->ncache = cache_tiles > 0 ? cache_tiles : VIDX_CACHE_TILES;
+    this->cache = calloc (this->ncache, sizeof (Vidx_tile_t));
+    if (this->cache == NULL)
+    {
+        close_virtual_index (this);
+        sprintf (errmsg, "Allocating the virtual index tile cache");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    for (ic = 0; ic < this->ncache; ic++)
+        this->cache[ic].tile_row = -1;
+
+    return (this);
+}
+
+
+/******************************************************************************
+MODULE:  close_virtual_index
+
+PURPOSE:  Closes the input bands and frees the virtual index structure.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void close_virtual_index
+(
+    Virtual_index_t *this    /* I: virtual index to close and free */
+)
+{
+    int ib;                   /* looping variable for bands */
+    int ic;                   /* looping variable for cache tiles */
+
+    if (this == NULL)
+        return;
+
+    for (ib = 0; ib < this->nband; ib++)
+    {
+        if (this->fp_band[ib] != NULL)
+            fclose (this->fp_band[ib]);
+        free (this->band_file[ib]);
+        free (this->band_buf[ib]);
+    }
+
+    if (this->cache != NULL)
+    {
+        for (ic = 0; ic < this->ncache; ic++)
+            free (this->cache[ic].data);
+        free (this->cache);
+    }
+
+    free (this);
+}
+
+
+/******************************************************************************
+MODULE:  get_virtual_tile
+
+PURPOSE:  Returns the computed index values for the specified tile, from the
+cache if present.  Otherwise the least recently used cache entry is replaced
+by reading the tile from each input band and running the index kernel.
+
+RETURN VALUE:
+Type = Vidx_tile_t*
+Value      Description
+-----      -----------
+NULL       Error occurred reading the input bands
+non-NULL   Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Edge tiles are computed for the valid lines/samples only; the remainder
+     of the tile is unused.
+******************************************************************************/
+Vidx_tile_t *get_virtual_tile
+(
+    Virtual_index_t *this,   /* I: virtual index opened for reading */
+    int tile_row,            /* I: tile row in the image */
+    int tile_col             /* I: tile column in the image */
+)
+{
+    char FUNC_NAME[] = "get_virtual_tile";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int ic;                   /* looping variable for cache tiles */
+    int ib;                   /* looping variable for bands */
+    int line;                 /* looping variable for lines in the tile */
+    int iline;                /* first line of the tile */
+    int isamp;                /* first sample of the tile */
+    int tile_nlines;          /* number of valid lines in the tile */
+    int tile_nsamps;          /* number of valid samples in the tile */
+    long loc;                 /* location in the input band file */
+    Vidx_tile_t *tile = NULL; /* tile to be returned */
+    int16 tmp[VIDX_TILE_SIZE]; /* one line of computed values */
+
+    this->nuse++;
+
+    /* Look for the tile in the cache, remembering the LRU entry */
+    for (ic = 0; ic < this->ncache; ic++)
+    {
+        if (this->cache[ic].tile_row == tile_row &&
+            this->cache[ic].tile_col == tile_col)
+        {
+            this->cache[ic].last_used = this->nuse;
+            return (&this->cache[ic]);
+        }
+        if (tile == NULL || this->cache[ic].last_used < tile->last_used)
+            tile = &this->cache[ic];
+    }
+
+    /* Compute the tile into the LRU entry */
+    if (tile->data == NULL)
+    {
+        tile->data = malloc (VIDX_TILE_SIZE * VIDX_TILE_SIZE * sizeof (int16));
+        if (tile->data == NULL)
+        {
+            sprintf (errmsg, "Allocating a virtual index cache tile");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+    }
+    tile->tile_row = -1;
+
+    iline = tile_row * VIDX_TILE_SIZE;
+    isamp = tile_col * VIDX_TILE_SIZE;
+    tile_nlines = this->nlines - iline;
+    if (tile_nlines > VIDX_TILE_SIZE)
+        tile_nlines = VIDX_TILE_SIZE;
+    tile_nsamps = this->nsamps - isamp;
+    if (tile_nsamps > VIDX_TILE_SIZE)
+        tile_nsamps = VIDX_TILE_SIZE;
+
+    /* Read only the tile window from each input band */
+    for (ib = 0; ib < this->nband; ib++)
+    {
+        for (line = 0; line < tile_nlines; line++)
+        {
+            loc = ((long) (iline + line) * this->nsamps + isamp) *
+                sizeof (int16);
+            if (fseek (this->fp_band[ib], loc, SEEK_SET) ||
+                fread (&this->band_buf[ib][line * tile_nsamps], sizeof (int16),
+                tile_nsamps, this->fp_band[ib]) != (size_t) tile_nsamps)
+            {
+                sprintf (errmsg, "Reading line %d of input band %s",
+                    iline + line, this->band_file[ib]);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (NULL);
+            }
+        }
+    }
+
+    /* Compute the index with the same kernels used by spectral_indices */
+    compute_spectral_index (this->si, this->band_buf, this->refl_scale_fact,
+        this->refl_fill, this->refl_saturate_val, tile_nlines, tile_nsamps,
+        tile->data);
+
+    /* Spread the lines out to the tile stride, last line first so nothing is
+       overwritten before it's moved */
+    if (tile_nsamps < VIDX_TILE_SIZE)
+    {
+        for (line = tile_nlines - 1; line > 0; line--)
+        {
+            memcpy (tmp, &tile->data[line * tile_nsamps],
+                tile_nsamps * sizeof (int16));
+            memcpy (&tile->data[line * VIDX_TILE_SIZE], tmp,
+                tile_nsamps * sizeof (int16));
+        }
+    }
+
+    tile->tile_row = tile_row;
+    tile->tile_col = tile_col;
+    tile->last_used = this->nuse;
+    return (tile);
+}
+
+
+/******************************************************************************
+MODULE:  read_virtual_index
+
+PURPOSE:  Reads a window of index values from the virtual index, computing
+any tiles which are not already cached.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Invalid window or error reading the input bands
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The values are the same as those spectral_indices would have written to
+     the index raster, using FILL_VALUE, SATURATE_VALUE, and SCALE_FACTOR.
+******************************************************************************/
+int read_virtual_index
+(
+    Virtual_index_t *this,   /* I: virtual index opened for reading */
+    int iline,               /* I: first line of the window (0-based) */
+    int isamp,               /* I: first sample of the window (0-based) */
+    int nlines,              /* I: number of lines in the window */
+    int nsamps,              /* I: number of samples in the window */
+    int16 *buf               /* O: nlines * nsamps index values */
+)
+{
+    char FUNC_NAME[] = "read_virtual_index";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int tile_row;             /* current tile row */
+    int tile_col;             /* current tile column */
+    int line0, line1;         /* window lines covered by the current tile */
+    int samp0, samp1;         /* window samples covered by the current tile */
+    int line;                 /* looping variable for lines */
+    Vidx_tile_t *tile = NULL; /* current tile */
+
+    if (iline < 0 || isamp < 0 || nlines < 1 || nsamps < 1 ||
+        iline + nlines > this->nlines || isamp + nsamps > this->nsamps)
+    {
+        sprintf (errmsg, "Window %d,%d of %dx%d is outside the %dx%d image",
+            iline, isamp, nlines, nsamps, this->nlines, this->nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (tile_row = iline / VIDX_TILE_SIZE;
+         tile_row <= (iline + nlines - 1) / VIDX_TILE_SIZE; tile_row++)
+    {
+        line0 = tile_row * VIDX_TILE_SIZE;
+        if (line0 < iline)
+            line0 = iline;
+        line1 = (tile_row + 1) * VIDX_TILE_SIZE;
+        if (line1 > iline + nlines)
+            line1 = iline + nlines;
+
+        for (tile_col = isamp / VIDX_TILE_SIZE;
+             tile_col <= (isamp + nsamps - 1) / VIDX_TILE_SIZE; tile_col++)
+        {
+            samp0 = tile_col * VIDX_TILE_SIZE;
+            if (samp0 < isamp)
+                samp0 = isamp;
+            samp1 = (tile_col + 1) * VIDX_TILE_SIZE;
+            if (samp1 > isamp + nsamps)
+                samp1 = isamp + nsamps;
+
+            tile = get_virtual_tile (this, tile_row, tile_col);
+            if (tile == NULL)
+            {
+                sprintf (errmsg, "Computing tile %d,%d of %.900s", tile_row,
+                    tile_col, this->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            /* Copy the overlapping part of the tile into the window */
+            for (line = line0; line < line1; line++)
+                memcpy (&buf[(long) (line - iline) * nsamps + samp0 - isamp],
+                    &tile->data[(line % VIDX_TILE_SIZE) * VIDX_TILE_SIZE +
+                    samp0 % VIDX_TILE_SIZE], (samp1 - samp0) * sizeof (int16));
+        }
+    }
+
+    return (SUCCESS);
+}
@@ -0,0 +1,83 @@
+#ifndef _VIRTUAL_INDEX_H_
+#define _VIRTUAL_INDEX_H_
+
+#include <stdio.h>
+#include "common.h"
+#include "espa_metadata.h"
+
+/* Virtual index descriptors are small text files written by
+   spectral_indices --virtual in place of the index rasters.  They hold the
+   index definition and references to the source reflectance bands, and the
+   index values are computed on read by read_virtual_index.  The first line is
+   VIDX_MAGIC followed by "key = value" lines:
+       index, name, long_name, lines, samples, refl_fill,
+       refl_saturate_value, refl_scale_factor, fill_value, saturate_value,
+       scale_factor, and one "band" line per input band in kernel order.
+   Relative band file names are relative to the descriptor's directory. */
+#define VIDX_MAGIC "ESPA_SPECTRAL_INDEX_VIRTUAL 1"
+#define VIDX_EXT ".vidx"
+
+/* Size of the square tiles computed and cached by the reader */
+#define VIDX_TILE_SIZE 256
+
+/* Default number of tiles held in the reader's LRU cache */
+#define VIDX_CACHE_TILES 64
+
+/* One cached tile of computed index values */
+typedef struct {
+    int tile_row;            /* tile row in the image; -1 if unused */
+    int tile_col;            /* tile column in the image */
+    unsigned long last_used; /* access counter value when last used */
+    int16 *data;             /* VIDX_TILE_SIZE x VIDX_TILE_SIZE index values,
+                                stored with a stride of VIDX_TILE_SIZE */
+} Vidx_tile_t;
+
+/* Structure for a virtual index opened for reading */
+typedef struct {
+    Mysi_list_t si;          /* spectral index */
+    char name[STR_SIZE];     /* band name of the index (i.e. sr_ndvi) */
+    int nlines;              /* number of lines in the index */
+    int nsamps;              /* number of samples in the index */
+    int refl_fill;           /* fill value for reflectance bands */
+    int refl_saturate_val;   /* saturation value for reflectance bands */
+    float refl_scale_fact;   /* scale factor for reflectance bands */
+    int nband;               /* number of input bands */
+    char *band_file[MAX_SI_BANDS]; /* input band file names */
+    FILE *fp_band[MAX_SI_BANDS];   /* input band file pointers */
+    int16 *band_buf[MAX_SI_BANDS]; /* one tile of each input band */
+    int ncache;              /* number of tiles in the cache */
+    Vidx_tile_t *cache;      /* LRU cache of computed tiles */
+    unsigned long nuse;      /* access counter for the LRU cache */
+} Virtual_index_t;
+
+/* Prototypes */
+Virtual_index_t *open_virtual_index
+(
+    char *vidx_file,         /* I: name of the virtual index descriptor */
+    int cache_tiles          /* I: number of tiles to cache; 0 for the
+                                default */
+);
+
+Vidx_tile_t *get_virtual_tile
+(
+    Virtual_index_t *this,   /* I: virtual index opened for reading */
+    int tile_row,            /* I: tile row in the image */
+    int tile_col             /* I: tile column in the image */
+);
+
+int read_virtual_index
+(
+    Virtual_index_t *this,   /* I: virtual index opened for reading */
+    int iline,               /* I: first line of the window (0-based) */
+    int isamp,               /* I: first sample of the window (0-based) */
+    int nlines,              /* I: number of lines in the window */
+    int nsamps,              /* I: number of samples in the window */
+    int16 *buf               /* O: nlines * nsamps index values */
+);
+
+void close_virtual_index
+(
+    Virtual_index_t *this    /* I: virtual index to close and free */
+);
+
+#endif